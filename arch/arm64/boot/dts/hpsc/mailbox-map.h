@@ -121,4 +121,8 @@
 #define HPPS_MBOX1_CHAN__HPPS_SMP_APP__RTPS_R52_SMP_SSW 0
 #define HPPS_MBOX1_CHAN__RTPS_R52_SMP_SSW__HPPS_SMP_APP 1
 
+// HPPS SSW (remoteproc) <-> RTPS R52 SSW: virtqueue notifications for rpmsg
+#define HPPS_MBOX1_CHAN__HPPS_SMP_SSW__RTPS_R52_SSW__RPROC 30
+#define HPPS_MBOX1_CHAN__RTPS_R52_SSW__HPPS_SMP_SSW__RPROC 31
+
 #endif // MAILBOX_MAP_H
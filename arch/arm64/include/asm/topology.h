@@ -4,12 +4,15 @@
 
 #include <linux/cpumask.h>
 
+struct sched_cluster_energy;
+
 struct cpu_topology {
 	int thread_id;
 	int core_id;
 	int cluster_id;
 	cpumask_t thread_sibling;
 	cpumask_t core_sibling;
+	const struct sched_cluster_energy *energy;
 };
 
 extern struct cpu_topology cpu_topology[NR_CPUS];
@@ -18,6 +21,7 @@ extern struct cpu_topology cpu_topology[NR_CPUS];
 #define topology_core_id(cpu)		(cpu_topology[cpu].core_id)
 #define topology_core_cpumask(cpu)	(&cpu_topology[cpu].core_sibling)
 #define topology_sibling_cpumask(cpu)	(&cpu_topology[cpu].thread_sibling)
+#define arch_cluster_energy(cpu)	(cpu_topology[cpu].energy)
 
 void init_cpu_topology(void);
 void store_cpu_topology(unsigned int cpuid);
@@ -99,6 +99,74 @@ static int __init parse_core(struct device_node *core, int cluster_id,
 	return 0;
 }
 
+/*
+ * Optional power costs of a leaf cluster, for cluster packing:
+ *   cluster-idle-power-uw = <uW>;
+ *   core-busy-power-uw = <capacity uW>, ...;
+ * Being optional, a malformed one is ignored rather than failing the
+ * whole cpu-map.
+ */
+static void __init parse_cluster_energy(struct device_node *cluster,
+					int cluster_id)
+{
+	struct sched_cluster_energy *energy;
+	int i, cpu, count;
+	u32 val;
+
+	count = of_property_count_u32_elems(cluster, "core-busy-power-uw");
+	if (count <= 0)
+		return;
+	if (count & 1) {
+		pr_warn("%pOF: core-busy-power-uw needs capacity/power pairs, ignored\n",
+			cluster);
+		return;
+	}
+
+	energy = kzalloc(sizeof(*energy), GFP_KERNEL);
+	if (!energy)
+		return;
+	energy->nr_cap_states = count / 2;
+	energy->cap_states = kcalloc(energy->nr_cap_states,
+				     sizeof(*energy->cap_states), GFP_KERNEL);
+	if (!energy->cap_states) {
+		kfree(energy);
+		return;
+	}
+
+	for (i = 0; i < energy->nr_cap_states; i++) {
+		of_property_read_u32_index(cluster, "core-busy-power-uw",
+					   2 * i, &val);
+		energy->cap_states[i].cap = val;
+		of_property_read_u32_index(cluster, "core-busy-power-uw",
+					   2 * i + 1, &val);
+		energy->cap_states[i].power = val;
+	}
+	if (!of_property_read_u32(cluster, "cluster-idle-power-uw", &val))
+		energy->idle_power = val;
+
+	for_each_possible_cpu(cpu)
+		if (cpu_topology[cpu].cluster_id == cluster_id)
+			cpu_topology[cpu].energy = energy;
+}
+
+/* Each cluster's power costs are shared by all of its CPUs */
+static void __init free_cluster_energy(void)
+{
+	const struct sched_cluster_energy *energy;
+	unsigned int cpu, sibling;
+
+	for_each_possible_cpu(cpu) {
+		energy = cpu_topology[cpu].energy;
+		if (!energy)
+			continue;
+		for_each_possible_cpu(sibling)
+			if (cpu_topology[sibling].energy == energy)
+				cpu_topology[sibling].energy = NULL;
+		kfree(energy->cap_states);
+		kfree(energy);
+	}
+}
+
 static int __init parse_cluster(struct device_node *cluster, int depth)
 {
 	char name[10];
@@ -161,8 +229,10 @@ static int __init parse_cluster(struct device_node *cluster, int depth)
 	if (leaf && !has_cores)
 		pr_warn("%pOF: empty cluster\n", cluster);
 
-	if (leaf)
+	if (leaf) {
+		parse_cluster_energy(cluster, cluster_id);
 		cluster_id++;
+	}
 
 	return 0;
 }
@@ -286,6 +356,9 @@ static void __init reset_cpu_topology(void)
 {
 	unsigned int cpu;
 
+	/* The cpu-map may have been parsed in part, before falling back */
+	free_cluster_energy();
+
 	for_each_possible_cpu(cpu) {
 		struct cpu_topology *cpu_topo = &cpu_topology[cpu];
 
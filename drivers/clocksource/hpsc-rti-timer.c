@@ -11,6 +11,7 @@
 #include <linux/of_address.h>
 #include <linux/of_irq.h>
 #include <linux/smp.h>
+#include <linux/trace.h>
 #include <linux/types.h>
 #include <linux/wait.h>
 #include <linux/workqueue.h>
@@ -92,10 +93,16 @@ static uint64_t capture(struct hpsc_rti_tmr *tmr)
 	return readq(tmr->regs + REG__COUNT);
 }
 
+// Reference clock for the hwlat tracer, called with IRQs disabled
+static u64 hpsc_rti_tmr_read_local(void)
+{
+	return capture(this_cpu_ptr(&per_cpu_rti_tmr));
+}
+
 static irqreturn_t hpsc_rti_tmr_event(int irq, void *priv)
 {
 	struct hpsc_rti_tmr *tmr = priv;
-	pr_info("%s: event interrupt for cpu %u on cpu %u\n", LOG_CAT,
+	pr_debug("%s: event interrupt for cpu %u on cpu %u\n", LOG_CAT,
 		smp_processor_id(), tmr->cpu);
 	BUG_ON(smp_processor_id() != tmr->cpu); // ensured by IRQ framework
 	interval_timer_notify(&tmr->itmr);
@@ -245,6 +252,7 @@ static int __init hpsc_rti_tmr_init(struct device_node *np)
 			LOG_CAT, ret);
 		goto hp_fail;
 	}
+	trace_hwlat_set_ref_clock(hpsc_rti_tmr_read_local);
 	return 0;
 
 hp_fail:
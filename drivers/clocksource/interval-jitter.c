@@ -0,0 +1,559 @@
+/*
+ * Jitter monitor for per-CPU interval timers
+ *
+ * Uses a per-CPU timer that implements the interval timer interface (the
+ * HPSC RTI timers) as a heartbeat for each CPU and as a reference clock
+ * that is independent of the arch timer: on every event, the time from
+ * the timer expiry to the callback is read from the timer's own counter,
+ * and the time since the previous event is taken from sched_clock(), so
+ * that OS noise on tick-less (nohz_full) CPUs shows up as IRQ latency
+ * without relying on the clock that is being disturbed.
+ *
+ * The timers are listed in the device tree node for this device (via
+ * phandle references), timer N belonging to CPU N.  The counter is taken
+ * to count up and the event to fire every time it crosses a multiple of
+ * the interval, so the counter value modulo the interval is the time
+ * since the expiry.  The counter rate is taken from the optional
+ * "clock-frequency" property, or else measured against sched_clock().
+ *
+ * Each CPU keeps its statistics, a log2 latency histogram and a ring of
+ * recent samples; all of them are written only by the timer callback on
+ * that CPU, so no locking is needed on the event path.  They are exposed
+ * in debugfs under rti_jitter/, and every sample is also emitted as the
+ * rti_jitter_sample trace event.
+ *
+ * NOTE: the monitor sets the interval of the timers it uses, so those
+ * timers should not be used through interval-dev at the same time.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/cpu.h>
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/of.h>
+#include <linux/platform_device.h>
+#include <linux/sched/clock.h>
+#include <linux/seq_file.h>
+#include <linux/smp.h>
+#include <linux/types.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+
+#include "interval_timer.h"
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/rti_jitter.h>
+
+#define DT_TIMERS_PROP "timers"
+#define DT_TIMER_CELLS "#timer-cells"
+
+#define INTERVAL_JITTER_BUCKETS		32	/* log2 ns, up to ~2 s */
+#define INTERVAL_JITTER_SAMPLES		256	/* ring of recent samples */
+#define INTERVAL_JITTER_RATE_MS		20	/* counter rate measurement */
+
+static unsigned int period_us = 1000;
+module_param(period_us, uint, 0444);
+MODULE_PARM_DESC(period_us, "Initial heartbeat period in microseconds");
+
+static bool start = true;
+module_param(start, bool, 0444);
+MODULE_PARM_DESC(start, "Start monitoring at probe time");
+
+struct interval_jitter_sample {
+	u64 time;		/* sched_clock() at the callback */
+	u32 latency;		/* ns from the timer expiry to the callback */
+	s32 period_err;		/* ns, sched_clock() period minus nominal */
+};
+
+struct interval_jitter_cpu {
+	struct interval_jitter *ij;
+	int cpu;
+	struct interval_timer *itmr;
+	struct interval_timer_cb *cb_handle;
+
+	// Written only by the timer callback on this CPU, or from an IPI to it
+	u64 last;		/* sched_clock() of the previous event, 0 if none */
+	u64 events;
+	u64 missed;
+	u64 lat_sum;
+	u64 lat_max;
+	s64 err_min;
+	s64 err_max;
+	u64 hist[INTERVAL_JITTER_BUCKETS];
+	unsigned int head;
+	struct interval_jitter_sample ring[INTERVAL_JITTER_SAMPLES];
+};
+
+struct interval_jitter {
+	struct device *dev;
+	struct mutex lock;	/* enable, period, reset */
+	bool enabled;
+	u64 hz;			/* timer counter rate */
+	u64 period_ns;
+	u64 period_counts;
+	unsigned num_instances;
+	struct interval_jitter_cpu *instances;
+	struct dentry *debugfs;
+};
+
+static inline u64 counts_to_ns(struct interval_jitter *ij, u64 counts)
+{
+	return div64_u64(counts * NSEC_PER_SEC, ij->hz);
+}
+
+static void handle_timer_event(void *opaque)
+{
+	struct interval_jitter_cpu *jc = opaque;
+	struct interval_jitter *ij = jc->ij;
+	struct interval_jitter_sample *s;
+	u64 now = sched_clock();
+	u64 count, lat, delta;
+	s64 err = 0;
+	int bucket;
+
+	if (!READ_ONCE(ij->enabled))
+		return;
+	if (jc->itmr->ops->capture(jc->itmr, &count))
+		return;
+
+	div64_u64_rem(count, ij->period_counts, &count);
+	lat = counts_to_ns(ij, count);
+
+	if (jc->last) {
+		delta = now - jc->last;
+		err = delta - ij->period_ns;
+		if (delta > ij->period_ns + ij->period_ns / 2) {
+			jc->missed += div64_u64(delta + ij->period_ns / 2,
+						ij->period_ns) - 1;
+		} else {
+			jc->err_min = min(jc->err_min, err);
+			jc->err_max = max(jc->err_max, err);
+		}
+	}
+	jc->last = now;
+
+	jc->events++;
+	jc->lat_sum += lat;
+	jc->lat_max = max(jc->lat_max, lat);
+	bucket = lat ? ilog2(lat) + 1 : 0;
+	jc->hist[min(bucket, INTERVAL_JITTER_BUCKETS - 1)]++;
+
+	s = &jc->ring[jc->head % INTERVAL_JITTER_SAMPLES];
+	s->time = now;
+	s->latency = min_t(u64, lat, U32_MAX);
+	s->period_err = clamp_t(s64, err, S32_MIN, S32_MAX);
+	smp_store_release(&jc->head, jc->head + 1);
+
+	trace_rti_jitter_sample(jc->cpu, lat, err);
+}
+
+/* Runs on the timer's CPU */
+static void clear_instance(void *arg)
+{
+	struct interval_jitter_cpu *jc = arg;
+
+	jc->last = 0;
+	jc->events = 0;
+	jc->missed = 0;
+	jc->lat_sum = 0;
+	jc->lat_max = 0;
+	jc->err_min = S64_MAX;
+	jc->err_max = S64_MIN;
+	memset(jc->hist, 0, sizeof(jc->hist));
+	jc->head = 0;
+}
+
+static void arm_instance(void *arg)
+{
+	struct interval_jitter_cpu *jc = arg;
+
+	jc->last = 0;
+	jc->itmr->ops->set_interval(jc->itmr, jc->ij->period_counts);
+}
+
+static void disarm_instance(void *arg)
+{
+	struct interval_jitter_cpu *jc = arg;
+
+	// Set to max to not create load on the system
+	jc->itmr->ops->set_interval(jc->itmr, ~0ULL);
+}
+
+/* Call @func on each timer's CPU; offline CPUs are skipped */
+static void for_each_instance(struct interval_jitter *ij,
+			      smp_call_func_t func)
+{
+	struct interval_jitter_cpu *jc;
+	int i;
+
+	get_online_cpus();
+	for (i = 0; i < ij->num_instances; ++i) {
+		jc = &ij->instances[i];
+		if (!jc->itmr)
+			continue;
+		if (cpu_online(jc->cpu))
+			smp_call_function_single(jc->cpu, func, jc, 1);
+		else if (func == clear_instance)
+			clear_instance(jc);
+	}
+	put_online_cpus();
+}
+
+static void interval_jitter_start(struct interval_jitter *ij)
+{
+	if (ij->enabled)
+		return;
+	WRITE_ONCE(ij->enabled, true);
+	for_each_instance(ij, arm_instance);
+	dev_info(ij->dev, "monitoring with %llu ns period (%llu counts)\n",
+		 ij->period_ns, ij->period_counts);
+}
+
+static void interval_jitter_stop(struct interval_jitter *ij)
+{
+	if (!ij->enabled)
+		return;
+	for_each_instance(ij, disarm_instance);
+	WRITE_ONCE(ij->enabled, false);
+}
+
+static int interval_jitter_set_period(struct interval_jitter *ij, u64 ns)
+{
+	u64 counts = div64_u64(ns * ij->hz, NSEC_PER_SEC);
+
+	if (!counts)
+		return -EINVAL;
+	ij->period_counts = counts;
+	ij->period_ns = counts_to_ns(ij, counts);
+	return 0;
+}
+
+/* Runs bound to the timer's CPU, which capture() requires */
+static long measure_rate(void *arg)
+{
+	struct interval_jitter_cpu *jc = arg;
+	struct interval_timer *itmr = jc->itmr;
+	u64 c0, c1, t0, t1;
+
+	itmr->ops->set_interval(itmr, ~0ULL);
+	if (itmr->ops->capture(itmr, &c0))
+		return 0;
+	t0 = sched_clock();
+	msleep(INTERVAL_JITTER_RATE_MS);
+	if (itmr->ops->capture(itmr, &c1))
+		return 0;
+	t1 = sched_clock();
+
+	if (c1 <= c0 || t1 <= t0)
+		return 0;
+	return div64_u64((c1 - c0) * NSEC_PER_SEC, t1 - t0);
+}
+
+/* debugfs */
+
+static int summary_show(struct seq_file *s, void *unused)
+{
+	struct interval_jitter *ij = s->private;
+	struct interval_jitter_cpu *jc;
+	u64 now = sched_clock(), events, last;
+	int i;
+
+	seq_printf(s, "period %llu ns, counter %llu Hz, %s\n", ij->period_ns,
+		   ij->hz, ij->enabled ? "enabled" : "disabled");
+	seq_puts(s, "cpu       events   missed  lat_avg  lat_max  err_min  err_max  last_ago\n");
+	for (i = 0; i < ij->num_instances; ++i) {
+		jc = &ij->instances[i];
+		if (!jc->itmr)
+			continue;
+		events = READ_ONCE(jc->events);
+		last = READ_ONCE(jc->last);
+		seq_printf(s, "%3d %12llu %8llu %8llu %8llu %8lld %8lld %9lld\n",
+			   jc->cpu, events, READ_ONCE(jc->missed),
+			   events ? div64_u64(jc->lat_sum, events) : 0,
+			   jc->lat_max,
+			   jc->err_min == S64_MAX ? 0 : jc->err_min,
+			   jc->err_max == S64_MIN ? 0 : jc->err_max,
+			   last ? (s64)(now - last) : -1LL);
+	}
+	return 0;
+}
+
+static int histogram_show(struct seq_file *s, void *unused)
+{
+	struct interval_jitter_cpu *jc = s->private;
+	u64 count;
+	int i;
+
+	for (i = 0; i < INTERVAL_JITTER_BUCKETS; ++i) {
+		count = READ_ONCE(jc->hist[i]);
+		if (!count)
+			continue;
+		if (i == INTERVAL_JITTER_BUCKETS - 1)
+			seq_printf(s, ">= %10llu ns: %llu\n",
+				   1ULL << (i - 1), count);
+		else
+			seq_printf(s, "<  %10llu ns: %llu\n", 1ULL << i, count);
+	}
+	return 0;
+}
+
+static int samples_show(struct seq_file *s, void *unused)
+{
+	struct interval_jitter_cpu *jc = s->private;
+	struct interval_jitter_sample sample;
+	unsigned int head = smp_load_acquire(&jc->head), i;
+
+	// Oldest first; a sample may be overwritten while it is printed
+	for (i = head > INTERVAL_JITTER_SAMPLES ?
+		 head - INTERVAL_JITTER_SAMPLES : 0; i != head; ++i) {
+		sample = jc->ring[i % INTERVAL_JITTER_SAMPLES];
+		seq_printf(s, "%llu %u %d\n", sample.time, sample.latency,
+			   sample.period_err);
+	}
+	return 0;
+}
+
+#define INTERVAL_JITTER_SHOW_FOPS(name)					\
+static int name##_open(struct inode *inode, struct file *file)		\
+{									\
+	return single_open(file, name##_show, inode->i_private);	\
+}									\
+static const struct file_operations name##_fops = {			\
+	.open		= name##_open,					\
+	.read		= seq_read,					\
+	.llseek		= seq_lseek,					\
+	.release	= single_release,				\
+}
+
+INTERVAL_JITTER_SHOW_FOPS(summary);
+INTERVAL_JITTER_SHOW_FOPS(histogram);
+INTERVAL_JITTER_SHOW_FOPS(samples);
+
+static int enable_get(void *data, u64 *val)
+{
+	struct interval_jitter *ij = data;
+
+	*val = ij->enabled;
+	return 0;
+}
+
+static int enable_set(void *data, u64 val)
+{
+	struct interval_jitter *ij = data;
+
+	mutex_lock(&ij->lock);
+	if (val)
+		interval_jitter_start(ij);
+	else
+		interval_jitter_stop(ij);
+	mutex_unlock(&ij->lock);
+	return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(enable_fops, enable_get, enable_set, "%llu\n");
+
+static int period_get(void *data, u64 *val)
+{
+	struct interval_jitter *ij = data;
+
+	*val = div_u64(ij->period_ns, NSEC_PER_USEC);
+	return 0;
+}
+
+static int period_set(void *data, u64 val)
+{
+	struct interval_jitter *ij = data;
+	int ret;
+
+	mutex_lock(&ij->lock);
+	if (ij->enabled)
+		ret = -EBUSY;
+	else
+		ret = interval_jitter_set_period(ij, val * NSEC_PER_USEC);
+	mutex_unlock(&ij->lock);
+	return ret;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(period_fops, period_get, period_set, "%llu\n");
+
+static int reset_set(void *data, u64 val)
+{
+	struct interval_jitter *ij = data;
+
+	mutex_lock(&ij->lock);
+	for_each_instance(ij, clear_instance);
+	mutex_unlock(&ij->lock);
+	return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(reset_fops, NULL, reset_set, "%llu\n");
+
+static void create_debugfs(struct interval_jitter *ij)
+{
+	struct interval_jitter_cpu *jc;
+	struct dentry *dir;
+	char name[16];
+	int i;
+
+	ij->debugfs = debugfs_create_dir("rti_jitter", NULL);
+	if (IS_ERR_OR_NULL(ij->debugfs))
+		return;
+
+	debugfs_create_file_unsafe("enable", 0644, ij->debugfs, ij,
+				   &enable_fops);
+	debugfs_create_file_unsafe("period_us", 0644, ij->debugfs, ij,
+				   &period_fops);
+	debugfs_create_file_unsafe("reset", 0200, ij->debugfs, ij,
+				   &reset_fops);
+	debugfs_create_file("summary", 0444, ij->debugfs, ij, &summary_fops);
+
+	for (i = 0; i < ij->num_instances; ++i) {
+		jc = &ij->instances[i];
+		if (!jc->itmr)
+			continue;
+		snprintf(name, sizeof(name), "cpu%d", jc->cpu);
+		dir = debugfs_create_dir(name, ij->debugfs);
+		debugfs_create_file("histogram", 0444, dir, jc,
+				    &histogram_fops);
+		debugfs_create_file("samples", 0444, dir, jc, &samples_fops);
+	}
+}
+
+static void cleanup_instances(struct interval_jitter *ij)
+{
+	int i;
+
+	for (i = 0; i < ij->num_instances; ++i)
+		if (ij->instances[i].cb_handle)
+			interval_timer_unsubscribe(ij->instances[i].cb_handle);
+}
+
+static int interval_jitter_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct device_node *np = dev->of_node;
+	struct interval_jitter *ij;
+	struct interval_jitter_cpu *jc;
+	struct of_phandle_args spec;
+	u32 hz;
+	int num_instances, ret, i;
+
+	ij = devm_kzalloc(dev, sizeof(*ij), GFP_KERNEL);
+	if (!ij)
+		return -ENOMEM;
+	ij->dev = dev;
+	mutex_init(&ij->lock);
+
+	num_instances = of_count_phandle_with_args(np,
+				DT_TIMERS_PROP, DT_TIMER_CELLS);
+	if (num_instances <= 0) {
+		dev_err(dev, "no timers in '%s' property\n", DT_TIMERS_PROP);
+		return -EINVAL;
+	}
+	ij->num_instances = min_t(unsigned, num_instances, nr_cpu_ids);
+	ij->instances = devm_kcalloc(dev, ij->num_instances,
+				     sizeof(*ij->instances), GFP_KERNEL);
+	if (!ij->instances)
+		return -ENOMEM;
+
+	for (i = 0; i < ij->num_instances; ++i) {
+		jc = &ij->instances[i];
+		jc->ij = ij;
+		jc->cpu = i;
+		clear_instance(jc);
+		if (!cpu_possible(i))
+			continue;
+
+		ret = of_parse_phandle_with_args(np,
+				DT_TIMERS_PROP, DT_TIMER_CELLS, i, &spec);
+		if (ret) {
+			dev_err(dev, "unable to parse phandle %d in prop '%s': rc %d\n",
+				i, DT_TIMERS_PROP, ret);
+			ret = -ENODEV;
+			goto fail;
+		}
+		jc->itmr = interval_timer_lookup(&spec);
+		of_node_put(spec.np);
+		if (IS_ERR_OR_NULL(jc->itmr) || !jc->itmr->ops->capture ||
+		    !jc->itmr->ops->set_interval) {
+			dev_err(dev, "timer %d does not support capture and set interval\n",
+				i);
+			jc->itmr = NULL;
+			ret = -ENODEV;
+			goto fail;
+		}
+
+		jc->cb_handle = interval_timer_subscribe(jc->itmr,
+						handle_timer_event, jc);
+		if (!jc->cb_handle) {
+			ret = -ENOMEM;
+			goto fail;
+		}
+	}
+
+	if (!of_property_read_u32(np, "clock-frequency", &hz)) {
+		ij->hz = hz;
+	} else {
+		for (i = 0; i < ij->num_instances && !ij->hz; ++i) {
+			jc = &ij->instances[i];
+			if (jc->itmr && cpu_online(jc->cpu))
+				ij->hz = work_on_cpu(jc->cpu, measure_rate, jc);
+		}
+		dev_info(dev, "measured timer counter rate: %llu Hz\n", ij->hz);
+	}
+	if (!ij->hz) {
+		dev_err(dev, "unknown timer counter rate\n");
+		ret = -EINVAL;
+		goto fail;
+	}
+
+	ret = interval_jitter_set_period(ij, (u64)period_us * NSEC_PER_USEC);
+	if (ret) {
+		dev_err(dev, "period of %u us is too short\n", period_us);
+		goto fail;
+	}
+
+	platform_set_drvdata(pdev, ij);
+	create_debugfs(ij);
+
+	if (start)
+		interval_jitter_start(ij);
+	return 0;
+fail:
+	cleanup_instances(ij);
+	return ret;
+}
+
+static int interval_jitter_remove(struct platform_device *pdev)
+{
+	struct interval_jitter *ij = platform_get_drvdata(pdev);
+
+	debugfs_remove_recursive(ij->debugfs);
+	mutex_lock(&ij->lock);
+	interval_jitter_stop(ij);
+	mutex_unlock(&ij->lock);
+	cleanup_instances(ij);
+	return 0;
+}
+
+static const struct of_device_id interval_jitter_match[] = {
+	{ .compatible = "interval-jitter" },
+	{},
+};
+MODULE_DEVICE_TABLE(of, interval_jitter_match);
+
+static struct platform_driver interval_jitter_driver = {
+	.driver = {
+		.name = "interval-jitter",
+		.of_match_table = interval_jitter_match,
+	},
+	.probe  = interval_jitter_probe,
+	.remove = interval_jitter_remove,
+};
+module_platform_driver(interval_jitter_driver);
+
+MODULE_DESCRIPTION("Per-CPU heartbeat and jitter monitor on interval timers");
+MODULE_LICENSE("GPL v2");
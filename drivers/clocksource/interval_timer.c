@@ -1,6 +1,13 @@
+#include <linux/export.h>
+#include <linux/mutex.h>
+#include <linux/rculist.h>
 #include <linux/slab.h>
 #include "interval_timer.h"
 
+// Serializes subscribers; notify walks the callback list under RCU, from
+// the timer IRQ.
+static DEFINE_MUTEX(interval_timer_lock);
+
 static struct interval_timer_block itmr_blocks = {
 	.list = LIST_HEAD_INIT(itmr_blocks.list),
 };
@@ -44,6 +51,7 @@ struct interval_timer *interval_timer_lookup(const struct of_phandle_args *spec)
 	}
 	return NULL;
 }
+EXPORT_SYMBOL_GPL(interval_timer_lookup);
 
 struct interval_timer_cb *interval_timer_subscribe(struct interval_timer *itmr,
 					void (*func)(void *cb_arg), void *arg)
@@ -55,22 +63,32 @@ struct interval_timer_cb *interval_timer_subscribe(struct interval_timer *itmr,
 		return NULL;
 	cb->func = func;
 	cb->arg = arg;
-	list_add_tail(&cb->list, &itmr->callbacks.list);
+	mutex_lock(&interval_timer_lock);
+	list_add_tail_rcu(&cb->list, &itmr->callbacks.list);
+	mutex_unlock(&interval_timer_lock);
 	return cb;
 }
+EXPORT_SYMBOL_GPL(interval_timer_subscribe);
 
 void interval_timer_unsubscribe(struct interval_timer_cb *cb)
 {
-	list_del(&cb->list);
+	mutex_lock(&interval_timer_lock);
+	list_del_rcu(&cb->list);
+	mutex_unlock(&interval_timer_lock);
+	// notify runs in hard IRQ context, i.e. an RCU-sched read section
+	synchronize_sched();
 	kfree(cb);
 }
+EXPORT_SYMBOL_GPL(interval_timer_unsubscribe);
 
 void interval_timer_notify(struct interval_timer *itmr)
 {
-	// TODO: lock from unsubscribe (is there a way to call the cb unlocked, tho?)
 	struct interval_timer_cb *cb;
-	list_for_each_entry(cb, &itmr->callbacks.list, list) {
+
+	rcu_read_lock_sched();
+	list_for_each_entry_rcu(cb, &itmr->callbacks.list, list) {
 		BUG_ON(!cb->func);
 		cb->func(cb->arg);
 	}
+	rcu_read_unlock_sched();
 }
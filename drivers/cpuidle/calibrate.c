@@ -0,0 +1,307 @@
+/*
+ * cpuidle exit latency calibration
+ *
+ * The latencies of DT idle states are estimates written by hand.  This
+ * measures them: for each state of a CPU, all deeper states are disabled
+ * so that the governor picks that state once the CPU has been idle long
+ * enough, and the CPU is then woken with an IPI from a CPU of another
+ * cluster (so that cluster states can be reached) after a varying idle
+ * period.  Short periods catch the CPU while it is still entering the
+ * state, long ones once it is in it, so the worst case round trip minus
+ * the WFI baseline is the entry + exit latency the cpuidle exit_latency
+ * stands for.
+ *
+ * Writing a CPU number to the cpuidle_calibrate debugfs file calibrates
+ * that CPU, and with "apply" the measured latencies (and, if shorter
+ * than those, the target residencies) are written to the idle drivers
+ * of all CPUs of its cluster.  cpuidle_calibrate.boot=1 calibrates the
+ * first CPU of every cluster at boot.  Reading the file shows the last
+ * results.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) "cpuidle calibrate: " fmt
+
+#include <linux/cpu.h>
+#include <linux/cpuidle.h>
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/random.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/smp.h>
+#include <linux/topology.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+
+#ifdef MODULE_PARAM_PREFIX
+#undef MODULE_PARAM_PREFIX
+#endif
+#define MODULE_PARAM_PREFIX "cpuidle_calibrate."
+
+static bool boot;
+module_param(boot, bool, 0444);
+MODULE_PARM_DESC(boot, "Calibrate one CPU per cluster at boot");
+
+static bool apply = true;
+module_param(apply, bool, 0644);
+MODULE_PARM_DESC(apply, "Update the idle state latencies with the results");
+
+static unsigned int samples = 64;
+module_param(samples, uint, 0644);
+MODULE_PARM_DESC(samples, "Wakeups per idle state");
+
+struct calib_result {
+	unsigned int	old_us;		/* exit_latency before calibration */
+	unsigned int	max_us;		/* worst case, minus baseline */
+	unsigned int	avg_us;
+	unsigned long long entered;	/* times the state was really used */
+	bool		valid;
+};
+
+struct calib_req {
+	int		cpu;		/* CPU under test */
+};
+
+static struct calib_result *calib_results;	/* [cpu][state] */
+static DEFINE_MUTEX(calib_lock);
+
+static struct calib_result *calib_result(int cpu, int state)
+{
+	return &calib_results[cpu * CPUIDLE_STATE_MAX + state];
+}
+
+static void calib_nop(void *info)
+{
+}
+
+/*
+ * Wake @cpu @samples times after random idle periods of up to @max_idle_us
+ * and return the worst and average IPI round trip in ns.
+ */
+static void calib_ping(int cpu, unsigned int max_idle_us, u64 *worst,
+		       u64 *avg)
+{
+	u64 total = 0, ns;
+	unsigned int i, idle;
+	ktime_t start;
+
+	*worst = 0;
+	for (i = 0; i < samples; i++) {
+		idle = prandom_u32_max(max_idle_us) + 1;
+		usleep_range(idle, idle + 50);
+
+		start = ktime_get();
+		smp_call_function_single(cpu, calib_nop, NULL, 1);
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		total += ns;
+		*worst = max(*worst, ns);
+	}
+	*avg = samples ? div_u64(total, samples) : 0;
+}
+
+/* Runs on a CPU outside the cluster under test */
+static long calib_cpu_fn(void *arg)
+{
+	struct calib_req *req = arg;
+	struct cpuidle_device *dev = per_cpu(cpuidle_devices, req->cpu);
+	struct cpuidle_driver *drv = cpuidle_get_cpu_driver(dev);
+	unsigned long long saved[CPUIDLE_STATE_MAX];
+	u64 base_worst = 0, base_avg = 0, worst, avg;
+	unsigned int max_idle;
+	int i, j;
+
+	if (!dev || !drv || !dev->enabled)
+		return -ENODEV;
+
+	for (i = 0; i < drv->state_count; i++)
+		saved[i] = dev->states_usage[i].disable;
+
+	for (i = 0; i < drv->state_count; i++) {
+		struct calib_result *res = calib_result(req->cpu, i);
+		unsigned long long usage;
+
+		for (j = 0; j < drv->state_count; j++)
+			dev->states_usage[j].disable = j > i;
+
+		/* idle long enough to get in, and short enough to catch entry */
+		max_idle = 2 * drv->states[i].target_residency + 1000;
+		usage = dev->states_usage[i].usage;
+		calib_ping(req->cpu, max_idle, &worst, &avg);
+
+		if (i == 0) {
+			base_worst = worst;
+			base_avg = avg;
+		}
+
+		res->old_us = drv->states[i].exit_latency;
+		res->entered = dev->states_usage[i].usage - usage;
+		res->max_us = DIV_ROUND_UP_ULL(worst > base_avg ?
+					       worst - base_avg : 0,
+					       NSEC_PER_USEC);
+		res->avg_us = DIV_ROUND_UP_ULL(avg > base_avg ?
+					       avg - base_avg : 0,
+					       NSEC_PER_USEC);
+		res->valid = i > 0 && res->entered;
+	}
+
+	for (i = 0; i < drv->state_count; i++)
+		dev->states_usage[i].disable = saved[i];
+
+	pr_debug("CPU%d: baseline worst %llu ns avg %llu ns\n", req->cpu,
+		 base_worst, base_avg);
+
+	return 0;
+}
+
+static void calib_apply(int cpu)
+{
+	struct cpuidle_driver *drv;
+	int i, sibling;
+
+	for_each_cpu(sibling, topology_core_cpumask(cpu)) {
+		drv = cpuidle_get_cpu_driver(per_cpu(cpuidle_devices, sibling));
+		if (!drv)
+			continue;
+
+		for (i = 1; i < drv->state_count; i++) {
+			struct calib_result *res = calib_result(cpu, i);
+			struct cpuidle_state *s = &drv->states[i];
+
+			if (!res->valid)
+				continue;
+			s->exit_latency = max(res->max_us, 1U);
+			s->target_residency = max(s->target_residency,
+						  s->exit_latency);
+		}
+	}
+}
+
+static int calib_cpu(int cpu)
+{
+	struct calib_req req = { .cpu = cpu };
+	struct cpuidle_driver *drv;
+	int control, i;
+	long ret;
+
+	if (cpu < 0 || cpu >= nr_cpu_ids || !cpu_online(cpu))
+		return -EINVAL;
+
+	get_online_cpus();
+	control = cpumask_any_but(cpu_online_mask, cpu);
+	for_each_online_cpu(i) {
+		if (!cpumask_test_cpu(i, topology_core_cpumask(cpu))) {
+			control = i;
+			break;
+		}
+	}
+	if (control >= nr_cpu_ids) {
+		put_online_cpus();
+		return -ENODEV;
+	}
+
+	mutex_lock(&calib_lock);
+	ret = work_on_cpu(control, calib_cpu_fn, &req);
+	if (!ret) {
+		drv = cpuidle_get_cpu_driver(per_cpu(cpuidle_devices, cpu));
+		for (i = 1; i < drv->state_count; i++) {
+			struct calib_result *res = calib_result(cpu, i);
+
+			pr_info("CPU%d %s: exit latency %u us (avg %u, was %u)%s\n",
+				cpu, drv->states[i].name, res->max_us,
+				res->avg_us, res->old_us,
+				res->valid ? "" : ", state not entered");
+		}
+		if (apply)
+			calib_apply(cpu);
+	}
+	mutex_unlock(&calib_lock);
+	put_online_cpus();
+
+	return ret;
+}
+
+static int calib_show(struct seq_file *s, void *unused)
+{
+	struct cpuidle_driver *drv;
+	int cpu, i;
+
+	mutex_lock(&calib_lock);
+	for_each_possible_cpu(cpu) {
+		drv = cpuidle_get_cpu_driver(per_cpu(cpuidle_devices, cpu));
+		if (!drv)
+			continue;
+
+		for (i = 1; i < drv->state_count; i++) {
+			struct calib_result *res = calib_result(cpu, i);
+
+			if (!res->valid)
+				continue;
+			seq_printf(s, "cpu%d %-12s max %u avg %u was %u entered %llu\n",
+				   cpu, drv->states[i].name, res->max_us,
+				   res->avg_us, res->old_us, res->entered);
+		}
+	}
+	mutex_unlock(&calib_lock);
+
+	return 0;
+}
+
+static int calib_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, calib_show, NULL);
+}
+
+static ssize_t calib_write(struct file *file, const char __user *ubuf,
+			   size_t count, loff_t *ppos)
+{
+	int cpu, ret;
+
+	ret = kstrtoint_from_user(ubuf, count, 0, &cpu);
+	if (ret)
+		return ret;
+
+	ret = calib_cpu(cpu);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations calib_fops = {
+	.open		= calib_open,
+	.read		= seq_read,
+	.write		= calib_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init cpuidle_calibrate_init(void)
+{
+	int cpu;
+
+	calib_results = kcalloc(nr_cpu_ids * CPUIDLE_STATE_MAX,
+				sizeof(*calib_results), GFP_KERNEL);
+	if (!calib_results)
+		return -ENOMEM;
+
+	debugfs_create_file("cpuidle_calibrate", 0644, NULL, NULL,
+			    &calib_fops);
+
+	if (!boot)
+		return 0;
+
+	for_each_online_cpu(cpu)
+		if (cpumask_first(topology_core_cpumask(cpu)) == cpu)
+			calib_cpu(cpu);
+
+	return 0;
+}
+late_initcall(cpuidle_calibrate_init);
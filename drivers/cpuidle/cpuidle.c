@@ -22,6 +22,7 @@
 #include <linux/module.h>
 #include <linux/suspend.h>
 #include <linux/tick.h>
+#include <linux/topology.h>
 #include <trace/events/power.h>
 
 #include "cpuidle.h"
@@ -680,5 +681,36 @@ static int __init cpuidle_init(void)
 	return 0;
 }
 
+#define CPUIDLE_MAX_CLUSTERS	8
+
+/*
+ * Exit latency limit in us for the CPUs of each cluster (as numbered by the
+ * cpu-map), -1 for no limit.  This lets a cluster running latency critical
+ * (e.g. RT) work be kept out of its deep states while the other clusters
+ * still use theirs.  A new limit applies from the next idle entry.
+ */
+static int cluster_latency_us[CPUIDLE_MAX_CLUSTERS] = {
+	[0 ... CPUIDLE_MAX_CLUSTERS - 1] = -1
+};
+
+/**
+ * cpuidle_cluster_latency_req - exit latency limit of the cluster of a CPU
+ * @cpu: the CPU
+ *
+ * Returns the limit in us, INT_MAX if there is none.
+ */
+int cpuidle_cluster_latency_req(int cpu)
+{
+	int cluster = topology_physical_package_id(cpu);
+	int latency;
+
+	if (cluster < 0 || cluster >= CPUIDLE_MAX_CLUSTERS)
+		return INT_MAX;
+
+	latency = READ_ONCE(cluster_latency_us[cluster]);
+	return latency < 0 ? INT_MAX : latency;
+}
+
 module_param(off, int, 0444);
+module_param_array(cluster_latency_us, int, NULL, 0644);
 core_initcall(cpuidle_init);
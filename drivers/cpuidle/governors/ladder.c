@@ -70,7 +70,8 @@ static int ladder_select_state(struct cpuidle_driver *drv,
 	struct ladder_device_state *last_state;
 	int last_residency, last_idx = ldev->last_state_idx;
 	int first_idx = drv->states[0].flags & CPUIDLE_FLAG_POLLING ? 1 : 0;
-	int latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	int latency_req = min(pm_qos_request(PM_QOS_CPU_DMA_LATENCY),
+			      cpuidle_cluster_latency_req(dev->cpu));
 
 	/* Special case when user has set very strict latency requirement */
 	if (unlikely(latency_req == 0)) {
@@ -302,6 +302,8 @@ static int menu_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 	if (resume_latency && resume_latency < latency_req)
 		latency_req = resume_latency;
 
+	latency_req = min(latency_req, cpuidle_cluster_latency_req(dev->cpu));
+
 	/* Special case when user has set very strict latency requirement */
 	if (unlikely(latency_req == 0))
 		return 0;
@@ -0,0 +1,168 @@
+/*
+ * HPSC Chiplet hardware spinlock driver
+ *
+ * Locks shared between the TRCH, RTPS and HPPS subsystems. The Chiplet has
+ * no lock block, so each lock is a 32-bit word in a page of reserved memory
+ * that all subsystems map non-cacheable: 0 when free, else the master ID of
+ * the subsystem that holds it. A lock is taken with an exclusive
+ * compare-and-swap of 0 to the owner's ID, which relies on the global
+ * exclusive monitor of the interconnect, and released by writing 0.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/delay.h>
+#include <linux/device.h>
+#include <linux/hwspinlock.h>
+#include <linux/io.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/of.h>
+#include <linux/of_address.h>
+#include <linux/platform_device.h>
+
+#include "hwspinlock_internal.h"
+
+/* Back off between attempts, so as not to flood the interconnect */
+#define HPSC_HWSPINLOCK_RELAX_NS	50
+
+struct hpsc_hwspinlock {
+	u32 *base;
+	u32 owner;
+	struct hwspinlock_device bank;
+};
+
+static struct hpsc_hwspinlock *to_hpsc_hwspinlock(struct hwspinlock *lock)
+{
+	return container_of(lock->bank, struct hpsc_hwspinlock, bank);
+}
+
+static int hpsc_hwspinlock_trylock(struct hwspinlock *lock)
+{
+	u32 *word = lock->priv;
+
+	return cmpxchg_relaxed(word, 0, to_hpsc_hwspinlock(lock)->owner) == 0;
+}
+
+static void hpsc_hwspinlock_unlock(struct hwspinlock *lock)
+{
+	u32 *word = lock->priv;
+
+	WRITE_ONCE(*word, 0);
+}
+
+static void hpsc_hwspinlock_relax(struct hwspinlock *lock)
+{
+	ndelay(HPSC_HWSPINLOCK_RELAX_NS);
+}
+
+static const struct hwspinlock_ops hpsc_hwspinlock_ops = {
+	.trylock = hpsc_hwspinlock_trylock,
+	.unlock = hpsc_hwspinlock_unlock,
+	.relax = hpsc_hwspinlock_relax,
+};
+
+static int hpsc_hwspinlock_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct hpsc_hwspinlock *hwspin;
+	struct device_node *np;
+	struct resource res;
+	int num_locks, i, ret;
+	u32 base_id = 0;
+	u32 owner;
+
+	np = of_parse_phandle(dev->of_node, "memory-region", 0);
+	if (!np) {
+		dev_err(dev, "no DT 'memory-region' property\n");
+		return -EINVAL;
+	}
+	ret = of_address_to_resource(np, 0, &res);
+	of_node_put(np);
+	if (ret) {
+		dev_err(dev, "no address for DT 'memory-region'\n");
+		return ret;
+	}
+
+	if (of_property_read_u32(dev->of_node, "hpsc,owner", &owner) ||
+	    !owner) {
+		dev_err(dev, "no (or zero) DT 'hpsc,owner' property\n");
+		return -EINVAL;
+	}
+	of_property_read_u32(dev->of_node, "hwlock-base-id", &base_id);
+
+	num_locks = resource_size(&res) / sizeof(u32);
+	hwspin = devm_kzalloc(dev, sizeof(*hwspin) +
+			      num_locks * sizeof(struct hwspinlock),
+			      GFP_KERNEL);
+	if (!hwspin)
+		return -ENOMEM;
+
+	/* Normal non-cacheable, for exclusives to reach the global monitor */
+	hwspin->base = devm_memremap(dev, res.start, resource_size(&res),
+				     MEMREMAP_WC);
+	if (IS_ERR(hwspin->base))
+		return PTR_ERR(hwspin->base);
+	hwspin->owner = owner;
+
+	for (i = 0; i < num_locks; i++)
+		hwspin->bank.lock[i].priv = &hwspin->base[i];
+
+	platform_set_drvdata(pdev, hwspin);
+
+	ret = hwspin_lock_register(&hwspin->bank, dev, &hpsc_hwspinlock_ops,
+				   base_id, num_locks);
+	if (ret) {
+		dev_err(dev, "failed to register locks: %d\n", ret);
+		return ret;
+	}
+
+	dev_info(dev, "%d locks at %pa, owner 0x%x\n", num_locks, &res.start,
+		 owner);
+	return 0;
+}
+
+static int hpsc_hwspinlock_remove(struct platform_device *pdev)
+{
+	struct hpsc_hwspinlock *hwspin = platform_get_drvdata(pdev);
+	int ret;
+
+	ret = hwspin_lock_unregister(&hwspin->bank);
+	if (ret)
+		dev_err(&pdev->dev, "%s failed: %d\n", __func__, ret);
+
+	return ret;
+}
+
+static const struct of_device_id hpsc_hwspinlock_ids[] = {
+	{ .compatible = "hpsc,hpsc-hwspinlock", },
+	{},
+};
+MODULE_DEVICE_TABLE(of, hpsc_hwspinlock_ids);
+
+static struct platform_driver hpsc_hwspinlock_driver = {
+	.probe = hpsc_hwspinlock_probe,
+	.remove = hpsc_hwspinlock_remove,
+	.driver = {
+		.name = "hpsc_hwspinlock",
+		.of_match_table = hpsc_hwspinlock_ids,
+	},
+};
+
+static int __init hpsc_hwspinlock_init(void)
+{
+	return platform_driver_register(&hpsc_hwspinlock_driver);
+}
+/* board init code might need to reserve hwspinlocks for predefined purposes */
+postcore_initcall(hpsc_hwspinlock_init);
+
+static void __exit hpsc_hwspinlock_exit(void)
+{
+	platform_driver_unregister(&hpsc_hwspinlock_driver);
+}
+module_exit(hpsc_hwspinlock_exit);
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("HPSC Chiplet hardware spinlock driver");
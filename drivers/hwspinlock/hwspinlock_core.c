@@ -105,11 +105,16 @@ int __hwspin_trylock(struct hwspinlock *hwlock, int mode, unsigned long *flags)
 	 * 3. Ensure that in_atomic/might_sleep checks catch potential
 	 *    problems with hwspinlock usage (e.g. scheduler checks like
 	 *    'scheduling while atomic' etc.)
+	 *
+	 * In HWLOCK_RAW mode, the caller serializes local users itself
+	 * (e.g. with a mutex) and may then sleep while holding the lock.
 	 */
 	if (mode == HWLOCK_IRQSTATE)
 		ret = spin_trylock_irqsave(&hwlock->lock, *flags);
 	else if (mode == HWLOCK_IRQ)
 		ret = spin_trylock_irq(&hwlock->lock);
+	else if (mode == HWLOCK_RAW)
+		ret = 1;
 	else
 		ret = spin_trylock(&hwlock->lock);
 
@@ -126,7 +131,7 @@ int __hwspin_trylock(struct hwspinlock *hwlock, int mode, unsigned long *flags)
 			spin_unlock_irqrestore(&hwlock->lock, *flags);
 		else if (mode == HWLOCK_IRQ)
 			spin_unlock_irq(&hwlock->lock);
-		else
+		else if (mode != HWLOCK_RAW)
 			spin_unlock(&hwlock->lock);
 
 		return -EBUSY;
@@ -253,7 +258,7 @@ void __hwspin_unlock(struct hwspinlock *hwlock, int mode, unsigned long *flags)
 		spin_unlock_irqrestore(&hwlock->lock, *flags);
 	else if (mode == HWLOCK_IRQ)
 		spin_unlock_irq(&hwlock->lock);
-	else
+	else if (mode != HWLOCK_RAW)
 		spin_unlock(&hwlock->lock);
 }
 EXPORT_SYMBOL_GPL(__hwspin_unlock);
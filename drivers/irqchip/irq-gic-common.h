@@ -38,4 +38,10 @@ void gic_enable_quirks(u32 iidr, const struct gic_quirk *quirks,
 
 void gic_set_kvm_info(const struct gic_kvm_info *info);
 
+#ifdef CONFIG_ARM_GIC_V3_BALANCE
+void gic_v3_balance_register(struct irq_domain *domain);
+#else
+static inline void gic_v3_balance_register(struct irq_domain *domain) { }
+#endif
+
 #endif /* _IRQ_GIC_COMMON_H */
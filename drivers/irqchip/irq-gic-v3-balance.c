@@ -0,0 +1,509 @@
+/*
+ * Cluster aware balancing of GICv3 SPIs
+ *
+ * All SPIs are routed to the boot CPU by default.  This periodically
+ * samples the per-IRQ counts from kstat_irqs(), keeps a decaying rate for
+ * each SPI and re-routes them (GICD_IROUTER, through irq_set_affinity())
+ * so that the interrupt load is spread according to the policy:
+ *
+ *  spread: each device goes to the least loaded cluster, and its IRQs to
+ *          the least loaded CPUs of that cluster.
+ *  pack:   devices fill the lowest numbered cluster until its CPUs carry
+ *          pack_limit IRQs/s each, and only then spill to the next one.
+ *  off:    routing is left alone.
+ *
+ * IRQs registered with the same dev_id belong to one device (for example
+ * the receive and acknowledge IRQs of a mailbox, or the queues of a NIC)
+ * and always share a cluster, so that the producer and consumer sides of
+ * the device's data stay in one L2.  Clusters come from the cpu-map in the
+ * device tree via the CPU topology.
+ *
+ * IRQs that must not move are left where they are, but their load is
+ * accounted on their CPU: IRQs that are not balanceable (IRQF_NOBALANCING,
+ * per-CPU, managed), IRQs whose affinity was set by someone else (a
+ * driver or /proc/irq), and IRQs whose action name contains one of the
+ * comma separated strings of the "pinned" parameter (the mailboxes by
+ * default, which are latency critical).
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt)	"GICv3 balance: " fmt
+
+#include <linux/cpumask.h>
+#include <linux/debugfs.h>
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/irqdesc.h>
+#include <linux/irqdomain.h>
+#include <linux/kernel_stat.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/string.h>
+#include <linux/topology.h>
+#include <linux/workqueue.h>
+
+#include "irq-gic-common.h"
+
+#ifdef MODULE_PARAM_PREFIX
+#undef MODULE_PARAM_PREFIX
+#endif
+#define MODULE_PARAM_PREFIX "gic_balance."
+
+#define GIC_BAL_SPI_FIRST	32
+#define GIC_BAL_SPI_LAST	1019
+
+enum gic_bal_policy {
+	GIC_BAL_OFF,
+	GIC_BAL_SPREAD,
+	GIC_BAL_PACK,
+};
+
+static const char * const gic_bal_policy_names[] = {
+	[GIC_BAL_OFF]		= "off",
+	[GIC_BAL_SPREAD]	= "spread",
+	[GIC_BAL_PACK]		= "pack",
+};
+
+static int policy = GIC_BAL_SPREAD;
+
+static int policy_set(const char *val, const struct kernel_param *kp)
+{
+	int i = sysfs_match_string(gic_bal_policy_names, val);
+
+	if (i < 0)
+		return i;
+	policy = i;
+	return 0;
+}
+
+static int policy_get(char *buffer, const struct kernel_param *kp)
+{
+	return sprintf(buffer, "%s\n", gic_bal_policy_names[policy]);
+}
+
+static const struct kernel_param_ops policy_ops = {
+	.set = policy_set,
+	.get = policy_get,
+};
+module_param_cb(policy, &policy_ops, NULL, 0644);
+MODULE_PARM_DESC(policy, "Balancing policy: off, spread or pack");
+
+static unsigned int interval_ms = 1000;
+
+static int interval_set(const char *val, const struct kernel_param *kp)
+{
+	unsigned int ms;
+	int ret = kstrtouint(val, 0, &ms);
+
+	if (ret)
+		return ret;
+	if (!ms)
+		return -EINVAL;
+	interval_ms = ms;
+	return 0;
+}
+
+static const struct kernel_param_ops interval_ops = {
+	.set = interval_set,
+	.get = param_get_uint,
+};
+module_param_cb(interval_ms, &interval_ops, &interval_ms, 0644);
+MODULE_PARM_DESC(interval_ms, "Sampling and rebalancing period, 100 at least in effect");
+
+static unsigned int pack_limit = 20000;
+module_param(pack_limit, uint, 0644);
+MODULE_PARM_DESC(pack_limit, "IRQs/s per CPU before pack spills a cluster");
+
+static char pinned[128] = "mailbox";
+module_param_string(pinned, pinned, sizeof(pinned), 0644);
+MODULE_PARM_DESC(pinned, "Comma separated IRQ names never moved");
+
+struct gic_bal_irq {
+	unsigned int	last;	/* kstat_irqs() at the previous sample */
+	unsigned int	rate;	/* decaying average, IRQs/s */
+	int		cpu;	/* effective target CPU */
+	int		set_cpu; /* CPU last routed to by us, -1 if none */
+	void		*dev_id;
+	bool		seen;
+	bool		pinned;
+};
+
+struct gic_bal_group {
+	void		*dev_id;
+	unsigned int	rate;
+	int		cluster;	/* current cluster of the first IRQ */
+};
+
+static struct irq_domain *gic_bal_domain;
+static struct gic_bal_irq *gic_bal_irqs;
+static unsigned int gic_bal_nr_irqs;
+static struct gic_bal_group *gic_bal_groups;
+static u64 *gic_bal_load;		/* per CPU, IRQs/s */
+static ktime_t gic_bal_stamp;		/* time of the previous sample */
+static unsigned long gic_bal_moves;
+static DEFINE_MUTEX(gic_bal_lock);
+
+static void gic_bal_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(gic_bal_work, gic_bal_work_fn);
+
+void __init gic_v3_balance_register(struct irq_domain *domain)
+{
+	gic_bal_domain = domain;
+}
+
+static bool gic_bal_name_pinned(const char *name)
+{
+	const char *p = pinned;
+	size_t len;
+
+	if (!name)
+		return false;
+
+	while (*p) {
+		len = strcspn(p, ",\n");
+		if (len) {
+			char tok[sizeof(pinned)];
+
+			memcpy(tok, p, len);
+			tok[len] = '\0';
+			if (strstr(name, tok))
+				return true;
+		}
+		p += len;
+		if (*p)
+			p++;
+	}
+
+	return false;
+}
+
+static int gic_bal_cluster(int cpu)
+{
+	return topology_physical_package_id(cpu);
+}
+
+static u64 gic_bal_cluster_load(int cluster, unsigned int *ncpus)
+{
+	u64 load = 0;
+	int cpu;
+
+	*ncpus = 0;
+	for_each_online_cpu(cpu) {
+		if (gic_bal_cluster(cpu) != cluster)
+			continue;
+		load += gic_bal_load[cpu];
+		(*ncpus)++;
+	}
+
+	return load;
+}
+
+/* Least loaded online CPU of @cluster, preferring @cur on ties within @slack */
+static int gic_bal_pick_cpu(int cluster, int cur, unsigned int slack)
+{
+	int cpu, best = -1;
+
+	for_each_online_cpu(cpu) {
+		if (gic_bal_cluster(cpu) != cluster)
+			continue;
+		if (best < 0 || gic_bal_load[cpu] < gic_bal_load[best])
+			best = cpu;
+	}
+
+	if (best >= 0 && cur >= 0 && cpu_online(cur) &&
+	    gic_bal_cluster(cur) == cluster &&
+	    gic_bal_load[cur] <= gic_bal_load[best] + slack)
+		return cur;
+
+	return best;
+}
+
+static int gic_bal_pick_cluster(struct gic_bal_group *grp)
+{
+	int cpu, cluster, best = -1;
+	u64 best_load = 0, load;
+	unsigned int n;
+
+	for_each_online_cpu(cpu) {
+		cluster = gic_bal_cluster(cpu);
+		/* visit each cluster once, at its first online CPU */
+		if (cpumask_first_and(topology_core_cpumask(cpu),
+				      cpu_online_mask) != cpu)
+			continue;
+
+		load = gic_bal_cluster_load(cluster, &n);
+		if (!n)
+			continue;
+
+		if (policy == GIC_BAL_PACK) {
+			if ((load + grp->rate) <= (u64)pack_limit * n)
+				return cluster;
+			/* nothing fits: fall back to the least loaded */
+		}
+
+		load = div_u64(load, n);
+		if (best < 0 || load < best_load) {
+			best = cluster;
+			best_load = load;
+		}
+	}
+
+	/* stay put unless the move actually takes load off the cluster */
+	if (policy == GIC_BAL_SPREAD && grp->cluster >= 0 && best >= 0 &&
+	    grp->cluster != best) {
+		load = gic_bal_cluster_load(grp->cluster, &n);
+		if (n && div_u64(load, n) <= best_load + grp->rate)
+			return grp->cluster;
+	}
+
+	return best;
+}
+
+static int gic_bal_group_cmp(const void *a, const void *b)
+{
+	const struct gic_bal_group *ga = a, *gb = b;
+
+	if (ga->rate != gb->rate)
+		return ga->rate > gb->rate ? -1 : 1;
+	return 0;
+}
+
+/* Sample all SPIs of the GIC, return the number of groups to place */
+static int gic_bal_sample(void)
+{
+	unsigned int irq, count, rate, ngroups = 0;
+	struct irq_desc *desc;
+	ktime_t now = ktime_get();
+	u64 elapsed_us;
+	int i;
+
+	/*
+	 * Rates are taken over the time actually elapsed, which differs from
+	 * interval_ms when it is below the requeue floor, was just changed, or
+	 * the work ran late.
+	 */
+	elapsed_us = max_t(s64, ktime_us_delta(now, gic_bal_stamp), 1);
+	gic_bal_stamp = now;
+
+	memset(gic_bal_load, 0, sizeof(*gic_bal_load) * nr_cpu_ids);
+
+	for_each_irq_desc(irq, desc) {
+		struct gic_bal_irq *bi;
+		struct cpumask *aff;
+		struct irq_data *d;
+		unsigned long flags;
+		const char *name;
+
+		if (irq >= gic_bal_nr_irqs)
+			break;
+
+		bi = &gic_bal_irqs[irq];
+		d = irq_desc_get_irq_data(desc);
+		if (d->domain != gic_bal_domain ||
+		    d->hwirq < GIC_BAL_SPI_FIRST || d->hwirq > GIC_BAL_SPI_LAST)
+			continue;
+
+		raw_spin_lock_irqsave(&desc->lock, flags);
+		if (!desc->action) {
+			raw_spin_unlock_irqrestore(&desc->lock, flags);
+			bi->seen = false;
+			continue;
+		}
+		bi->dev_id = desc->action->dev_id;
+		name = desc->action->name;
+		if (!bi->seen)
+			bi->set_cpu = -1;
+		aff = irq_data_get_affinity_mask(d);
+		bi->pinned = !irqd_can_balance(d) ||
+			     irqd_affinity_is_managed(d) ||
+			     (bi->set_cpu >= 0 ?
+			      !cpumask_equal(aff, cpumask_of(bi->set_cpu)) :
+			      !cpumask_subset(cpu_online_mask, aff)) ||
+			     gic_bal_name_pinned(name);
+		bi->cpu = cpumask_first(irq_data_get_effective_affinity_mask(d));
+		raw_spin_unlock_irqrestore(&desc->lock, flags);
+
+		count = kstat_irqs(irq);
+		if (!bi->seen) {
+			bi->seen = true;
+			bi->rate = 0;
+		} else {
+			rate = div64_u64((u64)(count - bi->last) * USEC_PER_SEC,
+					 elapsed_us);
+			bi->rate = (bi->rate * 3 + rate) / 4;
+		}
+		bi->last = count;
+
+		if (bi->cpu < nr_cpu_ids)
+			gic_bal_load[bi->cpu] += bi->rate;
+		else
+			bi->cpu = -1;
+
+		if (bi->pinned)
+			continue;
+
+		for (i = 0; i < ngroups; i++)
+			if (gic_bal_groups[i].dev_id == bi->dev_id)
+				break;
+		if (i == ngroups) {
+			gic_bal_groups[i].dev_id = bi->dev_id;
+			gic_bal_groups[i].rate = 0;
+			gic_bal_groups[i].cluster = bi->cpu >= 0 ?
+				gic_bal_cluster(bi->cpu) : -1;
+			ngroups++;
+		}
+		gic_bal_groups[i].rate += bi->rate;
+	}
+
+	return ngroups;
+}
+
+static void gic_bal_place(struct gic_bal_group *grp)
+{
+	struct irq_desc *desc;
+	unsigned int irq;
+	int cluster, cpu;
+
+	/* movable load is re-added as it is placed */
+	for_each_irq_desc(irq, desc) {
+		struct gic_bal_irq *bi;
+
+		if (irq >= gic_bal_nr_irqs)
+			break;
+		bi = &gic_bal_irqs[irq];
+		if (bi->seen && !bi->pinned && bi->dev_id == grp->dev_id &&
+		    bi->cpu >= 0)
+			gic_bal_load[bi->cpu] -= bi->rate;
+	}
+
+	cluster = gic_bal_pick_cluster(grp);
+	if (cluster < 0)
+		return;
+
+	for_each_irq_desc(irq, desc) {
+		struct gic_bal_irq *bi;
+
+		if (irq >= gic_bal_nr_irqs)
+			break;
+		bi = &gic_bal_irqs[irq];
+		if (!bi->seen || bi->pinned || bi->dev_id != grp->dev_id)
+			continue;
+
+		/* idle IRQs only move to follow their device's cluster */
+		if (!bi->rate && bi->cpu >= 0 &&
+		    gic_bal_cluster(bi->cpu) == cluster) {
+			gic_bal_load[bi->cpu] += bi->rate;
+			continue;
+		}
+
+		cpu = gic_bal_pick_cpu(cluster, bi->cpu, bi->rate);
+		if (cpu < 0)
+			continue;
+
+		if (cpu != bi->cpu && !irq_set_affinity(irq, cpumask_of(cpu))) {
+			pr_debug("IRQ %u: CPU%d -> CPU%d (%u/s)\n", irq,
+				 bi->cpu, cpu, bi->rate);
+			bi->cpu = cpu;
+			bi->set_cpu = cpu;
+			gic_bal_moves++;
+		}
+		if (bi->cpu >= 0)
+			gic_bal_load[bi->cpu] += bi->rate;
+	}
+}
+
+static void gic_bal_work_fn(struct work_struct *work)
+{
+	int i, ngroups;
+
+	mutex_lock(&gic_bal_lock);
+	irq_lock_sparse();
+
+	ngroups = gic_bal_sample();
+	if (policy != GIC_BAL_OFF) {
+		sort(gic_bal_groups, ngroups, sizeof(*gic_bal_groups),
+		     gic_bal_group_cmp, NULL);
+		for (i = 0; i < ngroups; i++)
+			if (gic_bal_groups[i].rate)
+				gic_bal_place(&gic_bal_groups[i]);
+	}
+
+	irq_unlock_sparse();
+	mutex_unlock(&gic_bal_lock);
+
+	queue_delayed_work(system_power_efficient_wq, &gic_bal_work,
+			   msecs_to_jiffies(max(interval_ms, 100U)));
+}
+
+static int gic_bal_show(struct seq_file *s, void *unused)
+{
+	unsigned int irq;
+	int cpu;
+
+	mutex_lock(&gic_bal_lock);
+	seq_printf(s, "policy %s moves %lu\n", gic_bal_policy_names[policy],
+		   gic_bal_moves);
+	for_each_online_cpu(cpu)
+		seq_printf(s, "cpu%d cluster %d load %llu\n", cpu,
+			   gic_bal_cluster(cpu), gic_bal_load[cpu]);
+	for (irq = 0; irq < gic_bal_nr_irqs; irq++) {
+		struct gic_bal_irq *bi = &gic_bal_irqs[irq];
+
+		if (!bi->seen)
+			continue;
+		seq_printf(s, "irq %u cpu %d rate %u%s\n", irq, bi->cpu,
+			   bi->rate, bi->pinned ? " pinned" : "");
+	}
+	mutex_unlock(&gic_bal_lock);
+
+	return 0;
+}
+
+static int gic_bal_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, gic_bal_show, NULL);
+}
+
+static const struct file_operations gic_bal_fops = {
+	.open		= gic_bal_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init gic_v3_balance_init(void)
+{
+	if (!gic_bal_domain || num_possible_cpus() < 2)
+		return 0;
+
+	gic_bal_nr_irqs = nr_irqs;
+	gic_bal_irqs = kcalloc(gic_bal_nr_irqs, sizeof(*gic_bal_irqs),
+			       GFP_KERNEL);
+	gic_bal_groups = kcalloc(gic_bal_nr_irqs, sizeof(*gic_bal_groups),
+				 GFP_KERNEL);
+	gic_bal_load = kcalloc(nr_cpu_ids, sizeof(*gic_bal_load), GFP_KERNEL);
+	if (!gic_bal_irqs || !gic_bal_groups || !gic_bal_load) {
+		kfree(gic_bal_irqs);
+		kfree(gic_bal_groups);
+		kfree(gic_bal_load);
+		return -ENOMEM;
+	}
+
+	debugfs_create_file("gic_balance", 0444, NULL, NULL, &gic_bal_fops);
+
+	queue_delayed_work(system_power_efficient_wq, &gic_bal_work,
+			   msecs_to_jiffies(max(interval_ms, 100U)));
+	pr_info("policy %s, interval %u ms\n", gic_bal_policy_names[policy],
+		interval_ms);
+
+	return 0;
+}
+late_initcall(gic_v3_balance_init);
@@ -1007,6 +1007,8 @@ static int __init gic_init_bases(void __iomem *dist_base,
 		goto out_free;
 	}
 
+	gic_v3_balance_register(gic_data.domain);
+
 	set_handle_irq(gic_handle_irq);
 
 	gic_update_vlpi_properties();
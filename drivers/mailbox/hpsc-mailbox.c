@@ -1,3 +1,4 @@
+#include <linux/bitmap.h>
 #include <linux/device.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
@@ -11,6 +12,7 @@
 #include <linux/of_irq.h>
 #include <linux/platform_device.h>
 #include <linux/spinlock.h>
+#include <linux/uio_driver.h>
 
 #define REG_CONFIG              0x00
 #define REG_EVENT_CAUSE         0x04
@@ -39,13 +41,27 @@
 #define HPSC_MBOX_DATA_REGS 16
 #define HPSC_MBOX_INTS 2
 #define HPSC_MBOX_INSTANCES 32
+// Each instance is exposed as two channels: index 'i' and, for loopback
+// testing within one subsystem, its peer end at 'i + HPSC_MBOX_INSTANCES'.
+// Both ends drive the same registers; the receiving and the sending client
+// of an instance may then be attached to different ends.
+#define HPSC_MBOX_CHANS (2 * HPSC_MBOX_INSTANCES)
 #define HPSC_MBOX_INSTANCE_REGION (REG_DATA + HPSC_MBOX_DATA_REGS * 4)
 
+// Channels are shared by several kernel producers (hpsc-msg, monitor,
+// userspace), so allow for deeper TX queues than the framework's default
+#define HPSC_MBOX_TXQ_LEN 64
+// Max messages sent on a channel per ACK interrupt, while the remote keeps
+// ACKing before we are done handling the previous ACK
+#define HPSC_MBOX_ACK_BUDGET 8
+
 #define DT_PROP_INTERRUPT_IDX_RCV "interrupt-idx-rcv"
 #define DT_PROP_INTERRUPT_IDX_ACK "interrupt-idx-ack"
+#define DT_PROP_UIO_INSTANCES "uio-instances"
 
 struct hpsc_mbox {
 	void __iomem *regs;
+	phys_addr_t regs_phys;
 	struct mbox_controller controller;
 	unsigned rcv_int_idx;
 	unsigned ack_int_idx;
@@ -63,11 +79,18 @@ struct hpsc_mbox_chan {
 	struct hpsc_mbox *mbox;
 	void __iomem *regs;
 	spinlock_t lock;
+	// Links (ends) whose clients take the rcv and ack events
+	struct mbox_chan *rcv_link;
+	struct mbox_chan *ack_link;
 	// Config from DT, stays constant
 	unsigned instance;
 	unsigned owner;
 	unsigned src;
 	unsigned dest;
+	// Set if the instance is exported through UIO instead of the mailbox
+	// API, and whether userspace has it open
+	struct uio_info *uio;
+	bool uio_open;
 };
 
 static struct hpsc_mbox *hpsc_mbox_link_mbox(struct mbox_chan *link)
@@ -75,6 +98,11 @@ static struct hpsc_mbox *hpsc_mbox_link_mbox(struct mbox_chan *link)
 	return container_of(link->mbox, struct hpsc_mbox, controller);
 }
 
+static bool hpsc_mbox_link_is_peer(struct mbox_chan *link)
+{
+	return link - link->mbox->chans >= HPSC_MBOX_INSTANCES;
+}
+
 static void hpsc_mbox_memcpy_toio(void __iomem *dest, void *src)
 {
 	int i;
@@ -124,6 +152,51 @@ static void hpsc_mbox_clear_event(struct hpsc_mbox_chan *chan, unsigned event)
 	writel(event, chan->regs + REG_EVENT_CLEAR);
 }
 
+#ifdef CONFIG_HPSC_MBOX_UIO
+// Instances may be handed to userspace as UIO devices: the application mmaps
+// the instance registers and reads/polls the UIO device file for interrupts,
+// without going through the mailbox API. In the ISR, the instance's
+// interrupts are masked and the event is left for the application to read
+// and clear; it then re-enables interrupts by writing 1 to the device file.
+//
+// Instances are not page aligned, so the mapping (see the map's 'offset' in
+// sysfs) also covers the other instances in the same page(s). An instance is
+// therefore only exported if all of those are exported too: a process must
+// not be able to reach the registers of instances left to the kernel.
+
+static u32 hpsc_mbox_uio_ints(struct hpsc_mbox_chan *chan)
+{
+	return HPSC_MBOX_INT_A(chan->mbox->rcv_int_idx) |
+	       HPSC_MBOX_INT_B(chan->mbox->ack_int_idx);
+}
+
+// Called with chan->lock held, returns true if the instance is exported
+static bool hpsc_mbox_uio_isr(struct hpsc_mbox_chan *chan, unsigned event,
+			      unsigned interrupt)
+{
+	u32 ie;
+
+	if (!chan->uio)
+		return false;
+
+	if (chan->uio_open && hpsc_mbox_is_subscribed(chan, event, interrupt)) {
+		dev_dbg(chan->mbox->controller.dev, "UIO %u instance %u\n",
+			event, chan->instance);
+		ie = readl(chan->regs + REG_INT_ENABLE);
+		writel(ie & ~hpsc_mbox_uio_ints(chan),
+		       chan->regs + REG_INT_ENABLE);
+		uio_event_notify(chan->uio);
+	}
+	return true;
+}
+#else
+static bool hpsc_mbox_uio_isr(struct hpsc_mbox_chan *chan, unsigned event,
+			      unsigned interrupt)
+{
+	return false;
+}
+#endif /* CONFIG_HPSC_MBOX_UIO */
+
 static irqreturn_t hpsc_mbox_isr(struct hpsc_mbox *mbox, unsigned event,
 				 unsigned interrupt)
 {
@@ -131,17 +204,21 @@ static irqreturn_t hpsc_mbox_isr(struct hpsc_mbox *mbox, unsigned event,
 	struct mbox_chan *link;
 	struct hpsc_mbox_chan *chan;
 	unsigned long flags;
-	int i;
+	int i, budget;
 
 	// Check all mailbox instances; could do better if we maintain another
 	// list of actually enabled mailboxes; could do even better if HW
 	// provides disambiguation information about (instance index).
-	for (i = 0; i < mbox->controller.num_chans; ++i) {
-		link = &mbox->controller.chans[i];
-		chan = link->con_priv;
+	for (i = 0; i < HPSC_MBOX_INSTANCES; ++i) {
+		chan = mbox->controller.chans[i].con_priv;
 		spin_lock_irqsave(&chan->lock, flags);
 
-		if (!hpsc_mbox_is_subscribed(chan, event, interrupt))
+		if (hpsc_mbox_uio_isr(chan, event, interrupt))
+			goto cont;
+
+		link = event == HPSC_MBOX_EVENT_A ? chan->rcv_link :
+						    chan->ack_link;
+		if (!link || !hpsc_mbox_is_subscribed(chan, event, interrupt))
 			goto cont;
 
 		dev_dbg(mbox->controller.dev, "ISR %u instance %u\n", event,
@@ -157,8 +234,17 @@ static irqreturn_t hpsc_mbox_isr(struct hpsc_mbox *mbox, unsigned event,
 			mbox_chan_received_data(link, data);
 			break;
 		case HPSC_MBOX_EVENT_B:
-			hpsc_mbox_clear_event(chan, event);
-			mbox_chan_txdone(link, /* status = OK */ 0);
+			// The framework sends the next queued message from
+			// mbox_chan_txdone(); if the remote already ACKed that
+			// one too, keep draining the queue here instead of
+			// taking another interrupt for each message.
+			budget = HPSC_MBOX_ACK_BUDGET;
+			do {
+				hpsc_mbox_clear_event(chan, event);
+				mbox_chan_txdone(link, /* status = OK */ 0);
+			} while (--budget && link->active_req &&
+				 hpsc_mbox_is_subscribed(chan, event,
+							 interrupt));
 			break;
 		}
 cont:
@@ -273,25 +359,47 @@ static int hpsc_mbox_startup(struct mbox_chan *link)
 	struct hpsc_mbox_chan *chan = link->con_priv;
 	u32 ie;
 	int ret;
+	unsigned long flags;
 	// conceivably, send and recv not mutually exclusive
 	bool is_recv = link->cl->rx_callback;
 	bool is_send = link->cl->tx_done;
+	bool is_peer = hpsc_mbox_link_is_peer(link);
+
+	// the two ends of an instance can't both take the same event
+	spin_lock_irqsave(&chan->lock, flags);
+	if ((is_recv && chan->rcv_link) || (is_send && chan->ack_link)) {
+		spin_unlock_irqrestore(&chan->lock, flags);
+		dev_err(mbox->controller.dev,
+			"instance %u: other end already %s\n", chan->instance,
+			is_recv && chan->rcv_link ? "receiving" : "sending");
+		return -EBUSY;
+	}
+	spin_unlock_irqrestore(&chan->lock, flags);
 
 	// Note: owner+dest is entirely orthogonal to direction.
 	// Note; owner+src+dest are entirely optional, may set both to zero in DT
 	// Note: owner/src/dest access is not enforced by HW, it can only
 	//       serve as a mild sanity check.
-	ret = hpsc_mbox_maybe_claim_owner(chan);
-	if (ret)
-		return ret;
-
-	// regardless of whether we're owner or not, check config
-	ret = hpsc_mbox_verify_config(chan, is_recv, is_send);
-	if (ret) {
-		hpsc_mbox_maybe_release_owner(chan);
-		return ret;
+	// Note: the peer end leaves ownership and config to the primary end.
+	if (!is_peer) {
+		ret = hpsc_mbox_maybe_claim_owner(chan);
+		if (ret)
+			return ret;
+
+		// regardless of whether we're owner or not, check config
+		ret = hpsc_mbox_verify_config(chan, is_recv, is_send);
+		if (ret) {
+			hpsc_mbox_maybe_release_owner(chan);
+			return ret;
+		}
 	}
 
+	spin_lock_irqsave(&chan->lock, flags);
+	if (is_recv)
+		chan->rcv_link = link;
+	if (is_send)
+		chan->ack_link = link;
+
 	// only enable interrupts if our client can handle them
 	// otherwise, another entity is expected to process the interrupts
 	ie = readl(chan->regs + REG_INT_ENABLE);
@@ -302,6 +410,7 @@ static int hpsc_mbox_startup(struct mbox_chan *link)
 	dev_dbg(mbox->controller.dev, "instance %u int_enable <- %08x (rcv)\n",
 		chan->instance, ie);
 	writel(ie, chan->regs + REG_INT_ENABLE);
+	spin_unlock_irqrestore(&chan->lock, flags);
 
 	return 0;
 }
@@ -315,14 +424,22 @@ static void hpsc_mbox_shutdown(struct mbox_chan *link)
 
 	spin_lock_irqsave(&chan->lock, flags);
 	// Could just rely on HW reset-on-release behavior, but for symmetry...
+	// Only drop the events of this end, the other one may still be open
 	ie = readl(chan->regs + REG_INT_ENABLE);
-	ie &= ~HPSC_MBOX_INT_A(mbox->rcv_int_idx);
-	ie &= ~HPSC_MBOX_INT_B(mbox->ack_int_idx);
+	if (chan->rcv_link == link) {
+		ie &= ~HPSC_MBOX_INT_A(mbox->rcv_int_idx);
+		chan->rcv_link = NULL;
+	}
+	if (chan->ack_link == link) {
+		ie &= ~HPSC_MBOX_INT_B(mbox->ack_int_idx);
+		chan->ack_link = NULL;
+	}
 	dev_dbg(mbox->controller.dev, "instance %u int_enable <- %08x (rcv)\n",
 		chan->instance, ie);
 	writel(ie, chan->regs + REG_INT_ENABLE);
 
-	hpsc_mbox_maybe_release_owner(chan);
+	if (!hpsc_mbox_link_is_peer(link))
+		hpsc_mbox_maybe_release_owner(chan);
 	spin_unlock_irqrestore(&chan->lock, flags);
 }
 
@@ -360,17 +477,26 @@ static struct mbox_chan *hpsc_mbox_of_xlate(struct mbox_controller *mbox,
 	struct mbox_chan *link;
 	struct hpsc_mbox_chan *chan;
 
-	if (sp->args[0] >= HPSC_MBOX_INSTANCES) {
+	if (sp->args[0] >= HPSC_MBOX_CHANS) {
 		dev_err(mbox->dev,
 			"mailbox index in DT node is %u, but must be < %u\n",
-			sp->args[0], HPSC_MBOX_INSTANCES);
+			sp->args[0], HPSC_MBOX_CHANS);
 		return ERR_PTR(-EINVAL);
 	}
 
 	link = &mbox->chans[sp->args[0]];
+	chan = (struct hpsc_mbox_chan *)link->con_priv;
+	if (chan->uio) {
+		dev_err(mbox->dev, "instance %u is exported through UIO\n",
+			chan->instance);
+		return ERR_PTR(-EBUSY);
+	}
+
+	// owner/src/dest of an instance come from its primary end only
+	if (hpsc_mbox_link_is_peer(link))
+		return link;
 
 	// Slightly not nice, since adding side-effects to an otherwise pure function
-	chan = (struct hpsc_mbox_chan *)link->con_priv;
 	chan->owner = sp->args[1];
 	chan->src = sp->args[2];
 	chan->dest = sp->args[3];
@@ -391,9 +517,213 @@ static void hpsc_mbox_chans_init(struct hpsc_mbox_chan *hpsc_chans,
 		spin_lock_init(&chan->lock);
 		chan->instance = i;
 		mbox_chans[i].con_priv = chan;
+		mbox_chans[i + HPSC_MBOX_INSTANCES].con_priv = chan;
+	}
+}
+
+#ifdef CONFIG_HPSC_MBOX_UIO
+static int hpsc_mbox_uio_irqcontrol(struct uio_info *info, s32 irq_on)
+{
+	struct hpsc_mbox_chan *chan = info->priv;
+	unsigned long flags;
+	u32 ie;
+
+	spin_lock_irqsave(&chan->lock, flags);
+	ie = readl(chan->regs + REG_INT_ENABLE);
+	if (irq_on)
+		ie |= hpsc_mbox_uio_ints(chan);
+	else
+		ie &= ~hpsc_mbox_uio_ints(chan);
+	writel(ie, chan->regs + REG_INT_ENABLE);
+	spin_unlock_irqrestore(&chan->lock, flags);
+
+	return 0;
+}
+
+// Only one process may own an instance; the owner/src/dest handshake is the
+// same as for the first client of a mailbox channel
+static int hpsc_mbox_uio_open(struct uio_info *info, struct inode *inode)
+{
+	struct hpsc_mbox_chan *chan = info->priv;
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&chan->lock, flags);
+	if (chan->uio_open) {
+		spin_unlock_irqrestore(&chan->lock, flags);
+		return -EBUSY;
+	}
+	chan->uio_open = true;
+	spin_unlock_irqrestore(&chan->lock, flags);
+
+	ret = hpsc_mbox_maybe_claim_owner(chan);
+	if (!ret) {
+		ret = hpsc_mbox_verify_config(chan, true, true);
+		if (ret)
+			hpsc_mbox_maybe_release_owner(chan);
+	}
+	if (ret) {
+		spin_lock_irqsave(&chan->lock, flags);
+		chan->uio_open = false;
+		spin_unlock_irqrestore(&chan->lock, flags);
+	}
+	// interrupts stay off until the application enables them
+	return ret;
+}
+
+static int hpsc_mbox_uio_release(struct uio_info *info, struct inode *inode)
+{
+	struct hpsc_mbox_chan *chan = info->priv;
+	unsigned long flags;
+	u32 ie;
+
+	spin_lock_irqsave(&chan->lock, flags);
+	ie = readl(chan->regs + REG_INT_ENABLE);
+	writel(ie & ~hpsc_mbox_uio_ints(chan), chan->regs + REG_INT_ENABLE);
+	hpsc_mbox_maybe_release_owner(chan);
+	chan->uio_open = false;
+	spin_unlock_irqrestore(&chan->lock, flags);
+
+	return 0;
+}
+
+static void hpsc_mbox_uio_remove(struct hpsc_mbox_chan *hpsc_chans,
+				 int num_chans)
+{
+	int i;
+	for (i = 0; i < num_chans; i++) {
+		if (hpsc_chans[i].uio) {
+			uio_unregister_device(hpsc_chans[i].uio);
+			hpsc_chans[i].uio = NULL;
+		}
 	}
 }
 
+// Whether the pages mapped for instance 'inst' only hold 'exported' instances
+static bool hpsc_mbox_uio_page_private(struct hpsc_mbox *mbox, unsigned inst,
+				       const unsigned long *exported)
+{
+	phys_addr_t addr = mbox->regs_phys + inst * HPSC_MBOX_INSTANCE_REGION;
+	phys_addr_t start = addr & PAGE_MASK;
+	phys_addr_t end = PAGE_ALIGN(addr + HPSC_MBOX_INSTANCE_REGION);
+	phys_addr_t other;
+	unsigned i;
+
+	for (i = 0; i < HPSC_MBOX_INSTANCES; i++) {
+		other = mbox->regs_phys + i * HPSC_MBOX_INSTANCE_REGION;
+		if (other < end && other + HPSC_MBOX_INSTANCE_REGION > start &&
+		    !test_bit(i, exported))
+			return false;
+	}
+	return true;
+}
+
+// Export the instances listed as <instance owner src dest> in DT, with the
+// same meaning as in the 'mboxes' of a client of this controller
+static int hpsc_mbox_uio_probe(struct device *dev, struct hpsc_mbox *mbox,
+			       struct hpsc_mbox_chan *hpsc_chans)
+{
+	DECLARE_BITMAP(exported, HPSC_MBOX_INSTANCES);
+	struct hpsc_mbox_chan *chan;
+	struct uio_info *info;
+	phys_addr_t addr;
+	u32 cells[4];
+	u32 inst;
+	int n, i, ret;
+
+	n = of_property_count_u32_elems(dev->of_node, DT_PROP_UIO_INSTANCES);
+	if (n <= 0)
+		return 0;
+	if (n % ARRAY_SIZE(cells)) {
+		dev_err(dev, "'%s' must list <instance owner src dest>\n",
+			DT_PROP_UIO_INSTANCES);
+		return -EINVAL;
+	}
+
+	bitmap_zero(exported, HPSC_MBOX_INSTANCES);
+	for (i = 0; i < n; i += ARRAY_SIZE(cells)) {
+		of_property_read_u32_index(dev->of_node, DT_PROP_UIO_INSTANCES,
+					   i, &inst);
+		if (inst >= HPSC_MBOX_INSTANCES || test_bit(inst, exported)) {
+			dev_err(dev, "invalid UIO instance: %u\n", inst);
+			return -EINVAL;
+		}
+		set_bit(inst, exported);
+	}
+
+	for (i = 0; i < n; i += ARRAY_SIZE(cells)) {
+		of_property_read_u32_index(dev->of_node, DT_PROP_UIO_INSTANCES,
+					   i, &cells[0]);
+		of_property_read_u32_index(dev->of_node, DT_PROP_UIO_INSTANCES,
+					   i + 1, &cells[1]);
+		of_property_read_u32_index(dev->of_node, DT_PROP_UIO_INSTANCES,
+					   i + 2, &cells[2]);
+		of_property_read_u32_index(dev->of_node, DT_PROP_UIO_INSTANCES,
+					   i + 3, &cells[3]);
+		if (!hpsc_mbox_uio_page_private(mbox, cells[0], exported)) {
+			dev_err(dev, "instance %u shares a page with instances left to the kernel, not exported through UIO\n",
+				cells[0]);
+			continue;
+		}
+
+		info = devm_kzalloc(dev, sizeof(*info), GFP_KERNEL);
+		if (!info) {
+			ret = -ENOMEM;
+			goto fail;
+		}
+
+		chan = &hpsc_chans[cells[0]];
+		chan->owner = cells[1];
+		chan->src = cells[2];
+		chan->dest = cells[3];
+
+		addr = mbox->regs_phys +
+			chan->instance * HPSC_MBOX_INSTANCE_REGION;
+		info->name = "hpsc-mbox";
+		info->version = "1";
+		info->mem[0].name = "instance";
+		info->mem[0].addr = addr & PAGE_MASK;
+		info->mem[0].offs = addr & ~PAGE_MASK;
+		info->mem[0].size = PAGE_ALIGN(info->mem[0].offs +
+					       HPSC_MBOX_INSTANCE_REGION);
+		info->mem[0].memtype = UIO_MEM_PHYS;
+		info->mem[0].internal_addr = chan->regs;
+		info->irq = UIO_IRQ_CUSTOM;
+		info->irqcontrol = hpsc_mbox_uio_irqcontrol;
+		info->open = hpsc_mbox_uio_open;
+		info->release = hpsc_mbox_uio_release;
+		info->priv = chan;
+		chan->uio = info;
+
+		ret = uio_register_device(dev, info);
+		if (ret) {
+			dev_err(dev, "Failed to register UIO for instance %u: %d\n",
+				chan->instance, ret);
+			chan->uio = NULL;
+			goto fail;
+		}
+		dev_info(dev, "instance %u exported through UIO\n",
+			 chan->instance);
+	}
+	return 0;
+
+fail:
+	hpsc_mbox_uio_remove(hpsc_chans, HPSC_MBOX_INSTANCES);
+	return ret;
+}
+#else
+static void hpsc_mbox_uio_remove(struct hpsc_mbox_chan *hpsc_chans,
+				 int num_chans)
+{
+}
+
+static int hpsc_mbox_uio_probe(struct device *dev, struct hpsc_mbox *mbox,
+			       struct hpsc_mbox_chan *hpsc_chans)
+{
+	return 0;
+}
+#endif /* CONFIG_HPSC_MBOX_UIO */
+
 static void hpsc_mbox_controller_init(struct mbox_controller *ctlr,
 				      struct device *dev,
 				      struct mbox_chan *chans, int num_chans)
@@ -403,6 +733,7 @@ static void hpsc_mbox_controller_init(struct mbox_controller *ctlr,
 	ctlr->chans = chans;
 	ctlr->num_chans = num_chans;
 	ctlr->txdone_irq = true;
+	ctlr->txq_len = HPSC_MBOX_TXQ_LEN;
 	ctlr->of_xlate = &hpsc_mbox_of_xlate;
 }
 
@@ -416,8 +747,7 @@ static int hpsc_mbox_probe(struct platform_device *pdev)
 	struct resource *iomem;
 
 	mbox = devm_kzalloc(dev, sizeof(*mbox), GFP_KERNEL);
-	chans = devm_kcalloc(dev, HPSC_MBOX_INSTANCES, sizeof(*chans),
-			     GFP_KERNEL);
+	chans = devm_kcalloc(dev, HPSC_MBOX_CHANS, sizeof(*chans), GFP_KERNEL);
 	hpsc_chans = devm_kcalloc(dev, HPSC_MBOX_INSTANCES, sizeof(*hpsc_chans),
 				  GFP_KERNEL);
 	if (!mbox || !chans || !hpsc_chans)
@@ -431,6 +761,7 @@ static int hpsc_mbox_probe(struct platform_device *pdev)
 		dev_err(&pdev->dev, "Failed to remap mailbox regs: %d\n", ret);
 		return ret;
 	}
+	mbox->regs_phys = iomem->start;
 
 	// Map all instances onto one pair of IRQs
 	//
@@ -483,10 +814,17 @@ static int hpsc_mbox_probe(struct platform_device *pdev)
 	// finally, register our controller with mbox API
 	hpsc_mbox_chans_init(hpsc_chans, HPSC_MBOX_INSTANCES, mbox, chans);
 	hpsc_mbox_controller_init(&mbox->controller, dev, chans,
-				  HPSC_MBOX_INSTANCES);
+				  HPSC_MBOX_CHANS);
+
+	// before the controller, so that no client can take these instances
+	ret = hpsc_mbox_uio_probe(dev, mbox, hpsc_chans);
+	if (ret)
+		return ret;
+
 	ret = mbox_controller_register(&mbox->controller);
 	if (ret) {
 		dev_err(&pdev->dev, "Failed to register controller: %d\n", ret);
+		hpsc_mbox_uio_remove(hpsc_chans, HPSC_MBOX_INSTANCES);
 		return ret;
 	}
 
@@ -500,6 +838,8 @@ static int hpsc_mbox_remove(struct platform_device *pdev)
 {
 	struct hpsc_mbox *mbox = platform_get_drvdata(pdev);
 	mbox_controller_unregister(&mbox->controller);
+	hpsc_mbox_uio_remove(mbox->controller.chans[0].con_priv,
+			     HPSC_MBOX_INSTANCES);
 	dev_info(&pdev->dev, "unregistered\n");
 	return 0;
 }
@@ -0,0 +1,645 @@
+/*
+ * HPSC mailbox benchmark client.
+ *
+ * Measures round-trip latency, ACK turnaround and sustained message rate of
+ * the HPSC mailbox in loopback, without any remote firmware: each lane pings
+ * over one instance and pongs back over another, with this driver acting as
+ * both the requester and the responder by attaching to the peer end of each
+ * instance (see hpsc-mailbox.c).
+ *
+ * Controlled through debugfs at /sys/kernel/debug/hpsc_mbox_bench/<dev>/:
+ *   lanes, size, count, window, timeout_ms	run parameters
+ *   run					write anything to run
+ *   results					latency percentiles and rates
+ */
+#include <linux/atomic.h>
+#include <linux/completion.h>
+#include <linux/debugfs.h>
+#include <linux/device.h>
+#include <linux/err.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/mailbox_client.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/of.h>
+#include <linux/platform_device.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/spinlock.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+
+#define HPSC_MBOX_DATA_REGS	16
+
+// Frame header, in 32-bit words; the rest of the frame is payload
+#define BENCH_HDR_SEQ		0
+#define BENCH_HDR_FRAG		1	// frag index | nfrags << 16
+#define BENCH_HDR_LAUNCH	2	// 64-bit ping launch time (ns)
+#define BENCH_HDR_SENT		4	// 64-bit frame send time (ns)
+#define BENCH_HDR_WORDS		6
+#define BENCH_PAYLOAD_BYTES	((HPSC_MBOX_DATA_REGS - BENCH_HDR_WORDS) * 4)
+
+#define BENCH_MAX_SIZE		512
+#define BENCH_MAX_FRAGS		DIV_ROUND_UP(BENCH_MAX_SIZE, BENCH_PAYLOAD_BYTES)
+#define BENCH_MAX_WINDOW	8
+#define BENCH_MAX_COUNT		(1 << 20)
+
+// Channels of a lane, in the order they are listed in 'mboxes'
+enum {
+	LANE_REQ_OUT,	// ping, instance P
+	LANE_RSP_IN,	// ping, peer end of instance P
+	LANE_RSP_OUT,	// pong, instance Q
+	LANE_REQ_IN,	// pong, peer end of instance Q
+	LANE_CHANS
+};
+
+typedef u32 bench_frame_t[HPSC_MBOX_DATA_REGS];
+
+struct hpsc_mbox_bench;
+
+struct bench_lane {
+	struct hpsc_mbox_bench *bench;
+	struct mbox_client cl[LANE_CHANS];
+	struct mbox_chan *chan[LANE_CHANS];
+	// Ping frames are reused two windows later, so that a frame is never
+	// rewritten before the framework has handed it back in tx_done
+	bench_frame_t *ping;
+	bench_frame_t *pong;
+	spinlock_t lock;
+	unsigned sent;		// pings launched
+	unsigned rsp_frag;	// next frag expected by the responder
+	unsigned rsp_pong;	// next pong slot
+};
+
+struct bench_stats {
+	u64 elapsed_ns;
+	unsigned msgs;
+	unsigned errors;
+	unsigned rtt_n;
+	u32 rtt[4];		// p50, p99, p999, max
+	unsigned ack_n;
+	u32 ack[4];
+};
+
+struct hpsc_mbox_bench {
+	struct device *dev;
+	struct bench_lane *lanes;
+	unsigned num_lanes;
+	struct dentry *dir;
+	struct mutex lock;	// serialises runs
+
+	// Run parameters
+	u32 cfg_lanes;
+	u32 cfg_size;
+	u32 cfg_count;
+	u32 cfg_window;
+	u32 cfg_timeout_ms;
+
+	// Run state, the parameters in effect and the samples
+	unsigned lanes_used;
+	unsigned count;
+	unsigned window;
+	unsigned nfrags;
+	bool running;
+	atomic_t inflight;	// pings launched, pong not yet received
+	atomic_t unacked;	// ping frames queued, tx_done not yet called
+	wait_queue_head_t ack_wq;
+	atomic_t done;
+	atomic_t errors;
+	u64 start_ns;
+	u64 end_ns;
+	struct completion complete;
+	u32 *rtt;
+	atomic_t rtt_n;
+	unsigned rtt_max;
+	u32 *ack;
+	atomic_t ack_n;
+	unsigned ack_max;
+
+	struct bench_stats stats;
+};
+
+static struct dentry *bench_debugfs_root;
+
+static void bench_put_ns(u32 *w, u64 ns)
+{
+	w[0] = lower_32_bits(ns);
+	w[1] = upper_32_bits(ns);
+}
+
+static u64 bench_get_ns(const u32 *w)
+{
+	return (u64)w[1] << 32 | w[0];
+}
+
+static void bench_sample(u32 *arr, atomic_t *n, unsigned max, u64 delta)
+{
+	unsigned i = atomic_inc_return(n) - 1;
+	if (i < max)
+		arr[i] = min_t(u64, delta, U32_MAX);
+}
+
+static void bench_fail(struct hpsc_mbox_bench *bench)
+{
+	atomic_inc(&bench->errors);
+	if (READ_ONCE(bench->running)) {
+		WRITE_ONCE(bench->running, false);
+		complete(&bench->complete);
+	}
+}
+
+// Queue the frames of the next ping of a lane, in one batch
+static void bench_launch(struct bench_lane *lane)
+{
+	struct hpsc_mbox_bench *bench = lane->bench;
+	void *msgs[BENCH_MAX_FRAGS];
+	bench_frame_t *frame;
+	unsigned long flags;
+	unsigned i, seq;
+	u64 now;
+	int ret;
+
+	spin_lock_irqsave(&lane->lock, flags);
+	if (lane->sent >= bench->count) {
+		spin_unlock_irqrestore(&lane->lock, flags);
+		return;
+	}
+	seq = lane->sent++;
+
+	now = ktime_get_ns();
+	frame = &lane->ping[(seq % (2 * bench->window)) * bench->nfrags];
+	for (i = 0; i < bench->nfrags; i++) {
+		frame[i][BENCH_HDR_SEQ] = seq;
+		frame[i][BENCH_HDR_FRAG] = i | bench->nfrags << 16;
+		bench_put_ns(&frame[i][BENCH_HDR_LAUNCH], now);
+		memset(&frame[i][BENCH_HDR_WORDS], seq, BENCH_PAYLOAD_BYTES);
+		msgs[i] = frame[i];
+	}
+	atomic_inc(&bench->inflight);
+	atomic_add(bench->nfrags, &bench->unacked);
+
+	ret = mbox_send_messages(lane->chan[LANE_REQ_OUT], msgs,
+				 bench->nfrags);
+	spin_unlock_irqrestore(&lane->lock, flags);
+
+	if (ret < 0) {
+		dev_err_ratelimited(bench->dev, "failed to send ping: %d\n",
+				    ret);
+		atomic_dec(&bench->inflight);
+		if (atomic_sub_and_test(bench->nfrags, &bench->unacked))
+			wake_up(&bench->ack_wq);
+		bench_fail(bench);
+	}
+}
+
+static void bench_req_tx_prepare(struct mbox_client *cl, void *msg)
+{
+	bench_put_ns(&((u32 *)msg)[BENCH_HDR_SENT], ktime_get_ns());
+}
+
+// The responder read a ping frame and ACKed it
+static void bench_req_tx_done(struct mbox_client *cl, void *msg, int r)
+{
+	struct bench_lane *lane = container_of(cl, struct bench_lane,
+					       cl[LANE_REQ_OUT]);
+	struct hpsc_mbox_bench *bench = lane->bench;
+	u32 *data = msg;
+
+	if (r) {
+		dev_err_ratelimited(bench->dev, "ping NACK: %d\n", r);
+		bench_fail(bench);
+	} else {
+		bench_sample(bench->ack, &bench->ack_n, bench->ack_max,
+			     ktime_get_ns() -
+			     bench_get_ns(&data[BENCH_HDR_SENT]));
+	}
+
+	// the sample is written before bench_run() may free the array
+	smp_mb__before_atomic();
+	if (atomic_dec_and_test(&bench->unacked))
+		wake_up(&bench->ack_wq);
+}
+
+// Responder: ACK each ping frame, pong once the last one arrived
+static void bench_rsp_rx(struct mbox_client *cl, void *msg)
+{
+	struct bench_lane *lane = container_of(cl, struct bench_lane,
+					       cl[LANE_RSP_IN]);
+	struct hpsc_mbox_bench *bench = lane->bench;
+	u32 *data = msg;
+	u32 *pong;
+	unsigned frag = data[BENCH_HDR_FRAG] & 0xffff;
+	unsigned nfrags = data[BENCH_HDR_FRAG] >> 16;
+	int ret;
+
+	mbox_send_message(lane->chan[LANE_RSP_IN], NULL);
+
+	if (frag != lane->rsp_frag || nfrags != bench->nfrags) {
+		dev_err_ratelimited(bench->dev,
+				    "ping %u: frag %u/%u, expected %u/%u\n",
+				    data[BENCH_HDR_SEQ], frag, nfrags,
+				    lane->rsp_frag, bench->nfrags);
+		lane->rsp_frag = 0;
+		bench_fail(bench);
+		return;
+	}
+	if (++lane->rsp_frag < nfrags)
+		return;
+	lane->rsp_frag = 0;
+
+	pong = lane->pong[lane->rsp_pong++ % bench->window];
+	memcpy(pong, data, BENCH_HDR_WORDS * sizeof(u32));
+	ret = mbox_send_message(lane->chan[LANE_RSP_OUT], pong);
+	if (ret < 0) {
+		dev_err_ratelimited(bench->dev, "failed to send pong: %d\n",
+				    ret);
+		bench_fail(bench);
+	}
+}
+
+static void bench_rsp_tx_done(struct mbox_client *cl, void *msg, int r)
+{
+	struct bench_lane *lane = container_of(cl, struct bench_lane,
+					       cl[LANE_RSP_OUT]);
+
+	if (r) {
+		dev_err_ratelimited(lane->bench->dev, "pong NACK: %d\n", r);
+		bench_fail(lane->bench);
+	}
+}
+
+// Requester: a ping came back, account for it and launch the next one
+static void bench_req_rx(struct mbox_client *cl, void *msg)
+{
+	struct bench_lane *lane = container_of(cl, struct bench_lane,
+					       cl[LANE_REQ_IN]);
+	struct hpsc_mbox_bench *bench = lane->bench;
+	u64 now = ktime_get_ns();
+	u32 *data = msg;
+
+	mbox_send_message(lane->chan[LANE_REQ_IN], NULL);
+
+	bench_sample(bench->rtt, &bench->rtt_n, bench->rtt_max,
+		     now - bench_get_ns(&data[BENCH_HDR_LAUNCH]));
+	smp_mb__before_atomic();
+	atomic_dec(&bench->inflight);
+
+	if (atomic_inc_return(&bench->done) ==
+	    bench->count * bench->lanes_used) {
+		bench->end_ns = now;
+		if (READ_ONCE(bench->running)) {
+			WRITE_ONCE(bench->running, false);
+			complete(&bench->complete);
+		}
+		return;
+	}
+	if (READ_ONCE(bench->running))
+		bench_launch(lane);
+}
+
+static int bench_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+	return x < y ? -1 : x > y;
+}
+
+static void bench_percentiles(u32 *arr, unsigned n, u32 *out)
+{
+	static const unsigned per_mille[] = { 500, 990, 999 };
+	int i;
+
+	memset(out, 0, 4 * sizeof(*out));
+	if (!n)
+		return;
+	sort(arr, n, sizeof(*arr), bench_cmp_u32, NULL);
+	for (i = 0; i < ARRAY_SIZE(per_mille); i++)
+		out[i] = arr[min_t(u64, n - 1, (u64)n * per_mille[i] / 1000)];
+	out[3] = arr[n - 1];
+}
+
+static int bench_run(struct hpsc_mbox_bench *bench)
+{
+	struct bench_stats *st = &bench->stats;
+	unsigned long timeout;
+	unsigned i, n;
+	int ret = 0;
+
+	if (!bench->cfg_lanes || bench->cfg_lanes > bench->num_lanes ||
+	    !bench->cfg_size || bench->cfg_size > BENCH_MAX_SIZE ||
+	    !bench->cfg_count || bench->cfg_count > BENCH_MAX_COUNT ||
+	    !bench->cfg_window || bench->cfg_window > BENCH_MAX_WINDOW)
+		return -EINVAL;
+
+	// Frames of an aborted run may still be owned by the framework, and
+	// their callbacks still write to the sample arrays
+	if (atomic_read(&bench->inflight) || atomic_read(&bench->unacked)) {
+		dev_err(bench->dev, "previous run still has pings in flight\n");
+		return -EBUSY;
+	}
+	smp_rmb();
+
+	bench->lanes_used = bench->cfg_lanes;
+	bench->count = bench->cfg_count;
+	bench->window = bench->cfg_window;
+	bench->nfrags = DIV_ROUND_UP(bench->cfg_size, BENCH_PAYLOAD_BYTES);
+
+	vfree(bench->rtt);
+	vfree(bench->ack);
+	bench->rtt_max = bench->count * bench->lanes_used;
+	bench->ack_max = bench->rtt_max * bench->nfrags;
+	bench->rtt = vmalloc(bench->rtt_max * sizeof(*bench->rtt));
+	bench->ack = vmalloc(bench->ack_max * sizeof(*bench->ack));
+	if (!bench->rtt || !bench->ack) {
+		ret = -ENOMEM;
+		goto out_free;
+	}
+
+	atomic_set(&bench->done, 0);
+	atomic_set(&bench->errors, 0);
+	atomic_set(&bench->rtt_n, 0);
+	atomic_set(&bench->ack_n, 0);
+	for (i = 0; i < bench->lanes_used; i++) {
+		bench->lanes[i].sent = 0;
+		bench->lanes[i].rsp_frag = 0;
+		bench->lanes[i].rsp_pong = 0;
+	}
+	reinit_completion(&bench->complete);
+	bench->end_ns = 0;
+
+	WRITE_ONCE(bench->running, true);
+	bench->start_ns = ktime_get_ns();
+	for (n = 0; n < bench->window; n++)
+		for (i = 0; i < bench->lanes_used; i++)
+			bench_launch(&bench->lanes[i]);
+
+	timeout = msecs_to_jiffies(bench->cfg_timeout_ms);
+	timeout = wait_for_completion_timeout(&bench->complete, timeout);
+	if (!timeout) {
+		dev_err(bench->dev, "run timed out: %d/%u pongs\n",
+			atomic_read(&bench->done),
+			bench->count * bench->lanes_used);
+		ret = -ETIMEDOUT;
+	}
+	WRITE_ONCE(bench->running, false);
+
+	// A pong can overtake the tx_done of its last ping frames
+	if (!ret && !wait_event_timeout(bench->ack_wq,
+					!atomic_read(&bench->unacked),
+					timeout)) {
+		dev_err(bench->dev, "run timed out: %d ping frames not ACKed\n",
+			atomic_read(&bench->unacked));
+		ret = -ETIMEDOUT;
+	}
+	smp_rmb();
+
+	memset(st, 0, sizeof(*st));
+	st->errors = atomic_read(&bench->errors);
+	if (!ret && st->errors)
+		ret = -EIO;
+	if (ret) {
+		// samples may still be written by late callbacks
+		return ret;
+	}
+
+	st->elapsed_ns = bench->end_ns - bench->start_ns;
+	st->msgs = bench->count * bench->lanes_used * bench->nfrags;
+	st->rtt_n = min_t(unsigned, atomic_read(&bench->rtt_n), bench->rtt_max);
+	st->ack_n = min_t(unsigned, atomic_read(&bench->ack_n), bench->ack_max);
+	bench_percentiles(bench->rtt, st->rtt_n, st->rtt);
+	bench_percentiles(bench->ack, st->ack_n, st->ack);
+	return 0;
+
+out_free:
+	vfree(bench->rtt);
+	vfree(bench->ack);
+	bench->rtt = NULL;
+	bench->ack = NULL;
+	return ret;
+}
+
+static ssize_t bench_run_write(struct file *filp, const char __user *userbuf,
+			       size_t count, loff_t *ppos)
+{
+	struct hpsc_mbox_bench *bench = filp->private_data;
+	int ret;
+
+	mutex_lock(&bench->lock);
+	ret = bench_run(bench);
+	mutex_unlock(&bench->lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations bench_run_fops = {
+	.write	= bench_run_write,
+	.open	= simple_open,
+	.llseek	= generic_file_llseek,
+};
+
+static int bench_results_show(struct seq_file *s, void *unused)
+{
+	struct hpsc_mbox_bench *bench = s->private;
+	struct bench_stats *st = &bench->stats;
+	u64 rate = 0;
+
+	mutex_lock(&bench->lock);
+	if (st->elapsed_ns)
+		rate = div64_u64((u64)st->msgs * NSEC_PER_SEC, st->elapsed_ns);
+
+	seq_printf(s, "lanes:      %u\n", bench->lanes_used);
+	seq_printf(s, "size:       %u (%u msgs per ping)\n", bench->cfg_size,
+		   bench->nfrags);
+	seq_printf(s, "window:     %u\n", bench->window);
+	seq_printf(s, "msgs:       %u in %llu ns\n", st->msgs, st->elapsed_ns);
+	seq_printf(s, "msgs/s:     %llu\n", rate);
+	seq_printf(s, "errors:     %u\n", st->errors);
+	seq_printf(s, "rtt_ns:     n %u p50 %u p99 %u p999 %u max %u\n",
+		   st->rtt_n, st->rtt[0], st->rtt[1], st->rtt[2], st->rtt[3]);
+	seq_printf(s, "ack_ns:     n %u p50 %u p99 %u p999 %u max %u\n",
+		   st->ack_n, st->ack[0], st->ack[1], st->ack[2], st->ack[3]);
+	mutex_unlock(&bench->lock);
+	return 0;
+}
+
+static int bench_results_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_results_show, inode->i_private);
+}
+
+static const struct file_operations bench_results_fops = {
+	.open		= bench_results_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int bench_lane_init(struct hpsc_mbox_bench *bench, unsigned idx)
+{
+	struct bench_lane *lane = &bench->lanes[idx];
+	struct mbox_client *cl;
+	int i, ret;
+
+	lane->bench = bench;
+	spin_lock_init(&lane->lock);
+	lane->ping = devm_kcalloc(bench->dev,
+				  2 * BENCH_MAX_WINDOW * BENCH_MAX_FRAGS,
+				  sizeof(*lane->ping), GFP_KERNEL);
+	lane->pong = devm_kcalloc(bench->dev, BENCH_MAX_WINDOW,
+				  sizeof(*lane->pong), GFP_KERNEL);
+	if (!lane->ping || !lane->pong)
+		return -ENOMEM;
+
+	for (i = 0; i < LANE_CHANS; i++) {
+		cl = &lane->cl[i];
+		cl->dev = bench->dev;
+		cl->tx_block = false;
+		cl->knows_txdone = false;
+		switch (i) {
+		case LANE_REQ_OUT:
+			cl->tx_prepare = bench_req_tx_prepare;
+			cl->tx_done = bench_req_tx_done;
+			break;
+		case LANE_RSP_IN:
+			cl->rx_callback = bench_rsp_rx;
+			break;
+		case LANE_RSP_OUT:
+			cl->tx_done = bench_rsp_tx_done;
+			break;
+		case LANE_REQ_IN:
+			cl->rx_callback = bench_req_rx;
+			break;
+		}
+		lane->chan[i] = mbox_request_channel(cl,
+						     idx * LANE_CHANS + i);
+		if (IS_ERR(lane->chan[i])) {
+			ret = PTR_ERR(lane->chan[i]);
+			lane->chan[i] = NULL;
+			if (ret != -EPROBE_DEFER)
+				dev_err(bench->dev,
+					"lane %u: failed to get channel %d: %d\n",
+					idx, i, ret);
+			return ret;
+		}
+	}
+	return 0;
+}
+
+static void bench_lanes_free(struct hpsc_mbox_bench *bench)
+{
+	unsigned i, j;
+
+	for (i = 0; i < bench->num_lanes; i++)
+		for (j = 0; j < LANE_CHANS; j++)
+			mbox_free_channel(bench->lanes[i].chan[j]);
+}
+
+static int hpsc_mbox_bench_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct hpsc_mbox_bench *bench;
+	int num_chans;
+	unsigned i;
+	int ret;
+
+	num_chans = of_count_phandle_with_args(dev->of_node, "mboxes",
+					       "#mbox-cells");
+	if (num_chans < LANE_CHANS || num_chans % LANE_CHANS) {
+		dev_err(dev, "'mboxes' must list %u channels per lane\n",
+			LANE_CHANS);
+		return -EINVAL;
+	}
+
+	bench = devm_kzalloc(dev, sizeof(*bench), GFP_KERNEL);
+	if (!bench)
+		return -ENOMEM;
+	bench->dev = dev;
+	bench->num_lanes = num_chans / LANE_CHANS;
+	bench->lanes = devm_kcalloc(dev, bench->num_lanes,
+				    sizeof(*bench->lanes), GFP_KERNEL);
+	if (!bench->lanes)
+		return -ENOMEM;
+	mutex_init(&bench->lock);
+	init_completion(&bench->complete);
+	init_waitqueue_head(&bench->ack_wq);
+	atomic_set(&bench->inflight, 0);
+	atomic_set(&bench->unacked, 0);
+
+	bench->cfg_lanes = bench->num_lanes;
+	bench->cfg_size = BENCH_PAYLOAD_BYTES;
+	bench->cfg_count = 10000;
+	bench->cfg_window = 1;
+	bench->cfg_timeout_ms = 10000;
+
+	for (i = 0; i < bench->num_lanes; i++) {
+		ret = bench_lane_init(bench, i);
+		if (ret) {
+			bench_lanes_free(bench);
+			return ret;
+		}
+	}
+
+	bench->dir = debugfs_create_dir(dev_name(dev), bench_debugfs_root);
+	debugfs_create_u32("lanes", 0600, bench->dir, &bench->cfg_lanes);
+	debugfs_create_u32("size", 0600, bench->dir, &bench->cfg_size);
+	debugfs_create_u32("count", 0600, bench->dir, &bench->cfg_count);
+	debugfs_create_u32("window", 0600, bench->dir, &bench->cfg_window);
+	debugfs_create_u32("timeout_ms", 0600, bench->dir,
+			   &bench->cfg_timeout_ms);
+	debugfs_create_file("run", 0200, bench->dir, bench, &bench_run_fops);
+	debugfs_create_file("results", 0400, bench->dir, bench,
+			    &bench_results_fops);
+
+	platform_set_drvdata(pdev, bench);
+	dev_info(dev, "registered: %u lanes\n", bench->num_lanes);
+	return 0;
+}
+
+static int hpsc_mbox_bench_remove(struct platform_device *pdev)
+{
+	struct hpsc_mbox_bench *bench = platform_get_drvdata(pdev);
+
+	debugfs_remove_recursive(bench->dir);
+	bench_lanes_free(bench);
+	vfree(bench->rtt);
+	vfree(bench->ack);
+	return 0;
+}
+
+static const struct of_device_id hpsc_mbox_bench_match[] = {
+	{ .compatible = "hpsc,hpsc-mbox-bench" },
+	{},
+};
+MODULE_DEVICE_TABLE(of, hpsc_mbox_bench_match);
+
+static struct platform_driver hpsc_mbox_bench_driver = {
+	.driver = {
+		.name = "hpsc_mbox_bench",
+		.of_match_table = hpsc_mbox_bench_match,
+	},
+	.probe  = hpsc_mbox_bench_probe,
+	.remove = hpsc_mbox_bench_remove,
+};
+
+static int __init hpsc_mbox_bench_init(void)
+{
+	int ret;
+
+	bench_debugfs_root = debugfs_create_dir("hpsc_mbox_bench", NULL);
+	ret = platform_driver_register(&hpsc_mbox_bench_driver);
+	if (ret)
+		debugfs_remove_recursive(bench_debugfs_root);
+	return ret;
+}
+
+static void __exit hpsc_mbox_bench_exit(void)
+{
+	platform_driver_unregister(&hpsc_mbox_bench_driver);
+	debugfs_remove_recursive(bench_debugfs_root);
+}
+module_init(hpsc_mbox_bench_init);
+module_exit(hpsc_mbox_bench_exit);
+
+MODULE_DESCRIPTION("HPSC Chiplet mailbox loopback benchmark");
+MODULE_LICENSE("GPL v2");
@@ -18,6 +18,7 @@
 #include <linux/module.h>
 #include <linux/device.h>
 #include <linux/bitops.h>
+#include <linux/log2.h>
 #include <linux/mailbox_client.h>
 #include <linux/mailbox_controller.h>
 
@@ -26,53 +27,104 @@
 static LIST_HEAD(mbox_cons);
 static DEFINE_MUTEX(con_mutex);
 
-static int add_to_rbuf(struct mbox_chan *chan, void *mssg)
+/*
+ * The TX queue of a channel is a bounded ring in which producers reserve
+ * slots by advancing 'txq_head' with cmpxchg and then publish each slot by
+ * bumping its sequence number, so any number of clients (and contexts) may
+ * queue concurrently without serialising on 'chan->lock'. Only the single
+ * consumer, which hands messages to the controller, runs under the lock.
+ */
+static int txq_add(struct mbox_chan *chan, void **mssgs, unsigned int n)
 {
-	int idx;
-	unsigned long flags;
+	struct mbox_txq_slot *slot;
+	unsigned long pos, seq;
+	unsigned int i;
+	long diff;
 
-	spin_lock_irqsave(&chan->lock, flags);
+	if (!n || n > chan->txq_mask + 1)
+		return -EINVAL;
 
-	/* See if there is any space left */
-	if (chan->msg_count == MBOX_TX_QUEUE_LEN) {
-		spin_unlock_irqrestore(&chan->lock, flags);
-		return -ENOBUFS;
+	pos = READ_ONCE(chan->txq_head);
+	for (;;) {
+		/*
+		 * Slots are released in order, so if the last one of the
+		 * batch is free for this lap, all the ones before it are.
+		 */
+		slot = &chan->txq[(pos + n - 1) & chan->txq_mask];
+		seq = smp_load_acquire(&slot->seq);
+		diff = (long)(seq - (pos + n - 1));
+		if (diff == 0) {
+			unsigned long old;
+
+			old = cmpxchg(&chan->txq_head, pos, pos + n);
+			if (old == pos)
+				break;
+			pos = old;
+		} else if (diff < 0) {
+			return -ENOBUFS;
+		} else {
+			pos = READ_ONCE(chan->txq_head);
+		}
 	}
 
-	idx = chan->msg_free;
-	chan->msg_data[idx] = mssg;
-	chan->msg_count++;
+	for (i = 0; i < n; i++) {
+		slot = &chan->txq[(pos + i) & chan->txq_mask];
+		slot->msg = mssgs[i];
+		smp_store_release(&slot->seq, pos + i + 1);
+	}
 
-	if (idx == MBOX_TX_QUEUE_LEN - 1)
-		chan->msg_free = 0;
-	else
-		chan->msg_free++;
+	return pos & chan->txq_mask;
+}
 
-	spin_unlock_irqrestore(&chan->lock, flags);
+/* Peek at the oldest published message. Called with chan->lock held. */
+static bool txq_peek(struct mbox_chan *chan, void **mssg)
+{
+	struct mbox_txq_slot *slot;
+
+	slot = &chan->txq[chan->txq_tail & chan->txq_mask];
+	if (smp_load_acquire(&slot->seq) != chan->txq_tail + 1)
+		return false;
 
-	return idx;
+	*mssg = slot->msg;
+	return true;
 }
 
-static void msg_submit(struct mbox_chan *chan)
+/* Release the slot txq_peek() looked at. Called with chan->lock held. */
+static void txq_pop(struct mbox_chan *chan)
 {
-	unsigned count, idx;
-	unsigned long flags;
-	void *data;
-	int err = -EBUSY;
+	struct mbox_txq_slot *slot;
 
-	spin_lock_irqsave(&chan->lock, flags);
+	slot = &chan->txq[chan->txq_tail & chan->txq_mask];
+	smp_store_release(&slot->seq, chan->txq_tail + chan->txq_mask + 1);
+	chan->txq_tail++;
+}
 
-	if (!chan->msg_count || chan->active_req)
-		goto exit;
+/**
+ * mbox_chan_txq_reset - Empty the TX queue of a channel
+ * @chan: Mailbox channel, not in use by any client.
+ *
+ * For controller drivers that hand out channels themselves, instead of
+ * through mbox_request_channel(). Called with chan->lock held.
+ */
+void mbox_chan_txq_reset(struct mbox_chan *chan)
+{
+	unsigned long i;
 
-	count = chan->msg_count;
-	idx = chan->msg_free;
-	if (idx >= count)
-		idx -= count;
-	else
-		idx += MBOX_TX_QUEUE_LEN - count;
+	for (i = 0; i <= chan->txq_mask; i++)
+		chan->txq[i].seq = i;
+	chan->txq_head = 0;
+	chan->txq_tail = 0;
+}
+EXPORT_SYMBOL_GPL(mbox_chan_txq_reset);
 
-	data = chan->msg_data[idx];
+/* Hand the next queued message to the controller. Called with chan->lock. */
+static int __msg_submit(struct mbox_chan *chan)
+{
+	void *data;
+	int err;
+
+	if (chan->active_req || !txq_peek(chan, &data))
+		return -EBUSY;
 
 	if (chan->cl->tx_prepare)
 		chan->cl->tx_prepare(chan->cl, data);
@@ -80,9 +132,28 @@ static void msg_submit(struct mbox_chan *chan)
 	err = chan->mbox->ops->send_data(chan, data);
 	if (!err) {
 		chan->active_req = data;
-		chan->msg_count--;
+		txq_pop(chan);
 	}
-exit:
+
+	return err;
+}
+
+static void msg_submit(struct mbox_chan *chan)
+{
+	unsigned long flags;
+	int err;
+
+	/*
+	 * Whoever completes the active request submits the next one; this
+	 * pairs with the barrier in tx_tick() so that either we see the
+	 * channel idle or tx_tick() sees our queued message.
+	 */
+	smp_mb();
+	if (READ_ONCE(chan->active_req))
+		return;
+
+	spin_lock_irqsave(&chan->lock, flags);
+	err = __msg_submit(chan);
 	spin_unlock_irqrestore(&chan->lock, flags);
 
 	if (!err && (chan->txdone_method & TXDONE_BY_POLL))
@@ -94,14 +165,18 @@ static void tx_tick(struct mbox_chan *chan, int r)
 {
 	unsigned long flags;
 	void *mssg;
+	int err;
 
+	/* Complete the active request and submit the next in one go */
 	spin_lock_irqsave(&chan->lock, flags);
 	mssg = chan->active_req;
 	chan->active_req = NULL;
+	smp_mb(); /* pairs with msg_submit() */
+	err = __msg_submit(chan);
 	spin_unlock_irqrestore(&chan->lock, flags);
 
-	/* Submit next message */
-	msg_submit(chan);
+	if (!err && (chan->txdone_method & TXDONE_BY_POLL))
+		hrtimer_start(&chan->mbox->poll_hrt, 0, HRTIMER_MODE_REL);
 
 	if (!mssg)
 		return;
@@ -224,6 +299,25 @@ bool mbox_client_peek_data(struct mbox_chan *chan)
 }
 EXPORT_SYMBOL_GPL(mbox_client_peek_data);
 
+static int mbox_wait_tx(struct mbox_chan *chan)
+{
+	unsigned long wait;
+	int ret;
+
+	if (!chan->cl->tx_tout) /* wait forever */
+		wait = msecs_to_jiffies(3600000);
+	else
+		wait = msecs_to_jiffies(chan->cl->tx_tout);
+
+	ret = wait_for_completion_timeout(&chan->tx_complete, wait);
+	if (ret == 0) {
+		tx_tick(chan, -ETIME);
+		return -ETIME;
+	}
+
+	return 0;
+}
+
 /**
  * mbox_send_message -	For client to submit a message to be
  *				sent to the remote.
@@ -242,7 +336,8 @@ EXPORT_SYMBOL_GPL(mbox_client_peek_data);
  * The pointer to message should be preserved until it is sent
  * over the chan, i.e, tx_done() is made.
  * This function could be called from atomic context as it simply
- * queues the data and returns a token against the request.
+ * queues the data and returns a token against the request. Queueing
+ * does not take the channel lock, so several producers may share a chan.
  *
  * Return: Non-negative integer for successful submission (non-blocking mode)
  *	or transmission over chan (blocking mode).
@@ -250,39 +345,74 @@ EXPORT_SYMBOL_GPL(mbox_client_peek_data);
  */
 int mbox_send_message(struct mbox_chan *chan, void *mssg)
 {
-	int t;
+	int t, ret;
 
 	if (!chan || !chan->cl)
 		return -EINVAL;
 
-	t = add_to_rbuf(chan, mssg);
+	t = txq_add(chan, &mssg, 1);
 	if (t < 0) {
-		dev_err(chan->mbox->dev, "Try increasing MBOX_TX_QUEUE_LEN\n");
+		dev_err_ratelimited(chan->mbox->dev, "TX queue full\n");
 		return t;
 	}
 
 	msg_submit(chan);
 
 	if (chan->cl->tx_block) {
-		unsigned long wait;
-		int ret;
-
-		if (!chan->cl->tx_tout) /* wait forever */
-			wait = msecs_to_jiffies(3600000);
-		else
-			wait = msecs_to_jiffies(chan->cl->tx_tout);
-
-		ret = wait_for_completion_timeout(&chan->tx_complete, wait);
-		if (ret == 0) {
-			t = -ETIME;
-			tx_tick(chan, t);
-		}
+		ret = mbox_wait_tx(chan);
+		if (ret)
+			t = ret;
 	}
 
 	return t;
 }
 EXPORT_SYMBOL_GPL(mbox_send_message);
 
+/**
+ * mbox_send_messages -	For client to submit several messages at once.
+ * @chan: Mailbox channel assigned to this client.
+ * @mssgs: Array of client specific messages typecasted.
+ * @n: Number of messages in @mssgs.
+ *
+ * Like mbox_send_message(), but the messages are queued back to back with
+ * a single reservation, so they are sent in order without messages from
+ * other producers in between, and the controller is kicked only once.
+ * Either all or none of the messages are queued. In blocking mode, the
+ * call returns once all of them were transmitted or on the first timeout.
+ *
+ * Return: Number of messages queued (non-blocking mode) or transmitted
+ *	(blocking mode). Negative value denotes failure.
+ */
+int mbox_send_messages(struct mbox_chan *chan, void **mssgs, unsigned int n)
+{
+	unsigned int i;
+	int t, ret;
+
+	if (!chan || !chan->cl)
+		return -EINVAL;
+
+	t = txq_add(chan, mssgs, n);
+	if (t < 0) {
+		if (t == -ENOBUFS)
+			dev_err_ratelimited(chan->mbox->dev,
+					    "TX queue full\n");
+		return t;
+	}
+
+	msg_submit(chan);
+
+	if (chan->cl->tx_block) {
+		for (i = 0; i < n; i++) {
+			ret = mbox_wait_tx(chan);
+			if (ret)
+				return i ? i : ret;
+		}
+	}
+
+	return n;
+}
+EXPORT_SYMBOL_GPL(mbox_send_messages);
+
 /**
  * mbox_request_channel - Request a mailbox channel.
  * @cl: Identity of the client requesting the channel.
@@ -344,8 +474,7 @@ struct mbox_chan *mbox_request_channel(struct mbox_client *cl, int index)
 	}
 
 	spin_lock_irqsave(&chan->lock, flags);
-	chan->msg_free = 0;
-	chan->msg_count = 0;
+	mbox_chan_txq_reset(chan);
 	chan->active_req = NULL;
 	chan->cl = cl;
 	init_completion(&chan->tx_complete);
@@ -446,6 +575,7 @@ of_mbox_index_xlate(struct mbox_controller *mbox,
  */
 int mbox_controller_register(struct mbox_controller *mbox)
 {
+	unsigned long txq_len;
 	int i, txdone;
 
 	/* Sanity check */
@@ -471,12 +601,21 @@ int mbox_controller_register(struct mbox_controller *mbox)
 		mbox->poll_hrt.function = txdone_hrtimer;
 	}
 
+	txq_len = roundup_pow_of_two(mbox->txq_len ?: MBOX_TX_QUEUE_LEN);
+	mbox->txq_slots = kcalloc(mbox->num_chans * txq_len,
+				  sizeof(*mbox->txq_slots), GFP_KERNEL);
+	if (!mbox->txq_slots)
+		return -ENOMEM;
+
 	for (i = 0; i < mbox->num_chans; i++) {
 		struct mbox_chan *chan = &mbox->chans[i];
 
 		chan->cl = NULL;
 		chan->mbox = mbox;
 		chan->txdone_method = txdone;
+		chan->txq = &mbox->txq_slots[i * txq_len];
+		chan->txq_mask = txq_len - 1;
+		mbox_chan_txq_reset(chan);
 		spin_lock_init(&chan->lock);
 	}
 
@@ -513,5 +652,8 @@ void mbox_controller_unregister(struct mbox_controller *mbox)
 		hrtimer_cancel(&mbox->poll_hrt);
 
 	mutex_unlock(&con_mutex);
+
+	kfree(mbox->txq_slots);
+	mbox->txq_slots = NULL;
 }
 EXPORT_SYMBOL_GPL(mbox_controller_unregister);
@@ -259,8 +259,7 @@ struct mbox_chan *pcc_mbox_request_channel(struct mbox_client *cl,
 	}
 
 	spin_lock_irqsave(&chan->lock, flags);
-	chan->msg_free = 0;
-	chan->msg_count = 0;
+	mbox_chan_txq_reset(chan);
 	chan->active_req = NULL;
 	chan->cl = cl;
 	init_completion(&chan->tx_complete);
@@ -0,0 +1,230 @@
+/*
+ * ARM PL35X SMC NVRAM persistent memory provider
+ *
+ * Registers a libnvdimm bus with a single pmem region covering an NVRAM
+ * chip behind the SMC SRAM interface, so that the generic pmem driver
+ * exposes it as /dev/pmemN (DAX capable) and it can be mmap'ed directly.
+ *
+ * The SMC timings for the chip are programmed by the pl35x-smc driver,
+ * which also creates the platform device this driver binds to.  When the
+ * node has a calibration scratch range ("hpsc,smc-calib-scratch", at the
+ * start or end of each of its "arm,sram-chip-nmbr" chips), that driver
+ * overwrites it while calibrating, so one region is registered per chip
+ * with the scratch range left out.
+ *
+ * Write ordering: the pmem driver writes with memcpy_flushcache(), which
+ * cleans the data cache to the point of persistence, and then calls
+ * nvdimm_flush() on REQ_FLUSH/REQ_FUA and on DAX fsync.  What that flush
+ * has to do depends on the SRAM interface write mode (arm,sram-wr-sync):
+ *
+ *  - synchronous writes: the SMC returns the AXI write response only once
+ *    the memory cycle has completed, so a barrier that waits for all
+ *    outstanding writes is sufficient.
+ *  - asynchronous writes: the SMC acknowledges a write as soon as it is
+ *    queued, so after the barrier each chip is read back; the SMC does not
+ *    service a read until earlier writes to the same chip have drained.
+ *    The word read back is the first of the chip's calibration scratch
+ *    range, which is outside the pmem regions and can therefore be mapped
+ *    as Device memory: a cacheable read could be served by a (speculative)
+ *    cache refill and prove nothing.  This mode thus needs a scratch range.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/io.h>
+#include <linux/kernel.h>
+#include <linux/libnvdimm.h>
+#include <linux/module.h>
+#include <linux/of.h>
+#include <linux/platform_device.h>
+
+struct pl35x_smc_pmem {
+	struct nvdimm_bus_descriptor bus_desc;
+	struct nvdimm_bus *bus;
+	void __iomem **drain;	/* per region, async mode only */
+};
+
+static const struct attribute_group *pl35x_smc_pmem_bus_attribute_groups[] = {
+	&nvdimm_bus_attribute_group,
+	NULL,
+};
+
+static const struct attribute_group *pl35x_smc_pmem_region_attribute_groups[] = {
+	&nd_region_attribute_group,
+	&nd_device_attribute_group,
+	NULL,
+};
+
+static void pl35x_smc_pmem_flush_sync(struct nd_region *nd_region)
+{
+	/* wait for the write responses of everything issued so far */
+	wmb();
+}
+
+static void pl35x_smc_pmem_flush_async(struct nd_region *nd_region)
+{
+	void __iomem *drain = *(void __iomem **)
+				nd_region_provider_data(nd_region);
+
+	/* the data was cleaned to the PoP by the pmem driver already */
+	wmb();
+	/* reads are not reordered ahead of queued writes to the same chip */
+	readl(drain);
+}
+
+/*
+ * Split @res into @chip_nmbr chips and leave out the scratch range of
+ * each, whose address goes to @scratch, or describe @res as a single
+ * region if there is no scratch range.  Returns the number of regions
+ * filled in, 0 meaning a single region without scratch, or a negative
+ * errno.
+ */
+static int pl35x_smc_pmem_regions(struct device *dev, struct resource *res,
+				  struct resource *regions,
+				  phys_addr_t *scratch, u32 chip_nmbr)
+{
+	resource_size_t chip_size, chip;
+	u32 range[2];
+	u32 i;
+
+	if (of_property_read_u32_array(dev->of_node, "hpsc,smc-calib-scratch",
+				       range, ARRAY_SIZE(range))) {
+		regions[0] = *res;
+		return 0;
+	}
+
+	chip_size = resource_size(res);
+	do_div(chip_size, chip_nmbr);
+	if (!range[1] || (u64)range[0] + range[1] > chip_size ||
+	    (range[0] && range[0] + range[1] != chip_size)) {
+		dev_err(dev, "calibration scratch must be at the start or end of each chip\n");
+		return -EINVAL;
+	}
+
+	for (i = 0; i < chip_nmbr; i++) {
+		chip = res->start + i * chip_size;
+		scratch[i] = chip + range[0];
+		regions[i] = *res;
+		if (range[0]) {
+			regions[i].start = chip;
+			regions[i].end = chip + range[0] - 1;
+		} else {
+			regions[i].start = chip + range[1];
+			regions[i].end = chip + chip_size - 1;
+		}
+	}
+
+	return chip_nmbr;
+}
+
+static int pl35x_smc_pmem_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct pl35x_smc_pmem *pmem;
+	struct nd_region_desc ndr_desc;
+	struct resource *res, *regions;
+	phys_addr_t *scratch;
+	u32 wr_sync, chip_nmbr;
+	int nr_regions, i;
+
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	if (!res)
+		return -ENODEV;
+
+	pmem = devm_kzalloc(dev, sizeof(*pmem), GFP_KERNEL);
+	if (!pmem)
+		return -ENOMEM;
+
+	/* same default as the SMC driver uses when programming the chip */
+	if (of_property_read_u32(dev->of_node, "arm,sram-wr-sync", &wr_sync))
+		wr_sync = 1;
+
+	if (of_property_read_u32(dev->of_node, "arm,sram-chip-nmbr",
+				 &chip_nmbr) || !chip_nmbr)
+		chip_nmbr = 1;
+
+	regions = devm_kcalloc(dev, chip_nmbr, sizeof(*regions), GFP_KERNEL);
+	scratch = devm_kcalloc(dev, chip_nmbr, sizeof(*scratch), GFP_KERNEL);
+	pmem->drain = devm_kcalloc(dev, chip_nmbr, sizeof(*pmem->drain),
+				   GFP_KERNEL);
+	if (!regions || !scratch || !pmem->drain)
+		return -ENOMEM;
+
+	nr_regions = pl35x_smc_pmem_regions(dev, res, regions, scratch,
+					    chip_nmbr);
+	if (nr_regions < 0)
+		return nr_regions;
+	if (!nr_regions) {
+		if (!wr_sync) {
+			dev_err(dev, "asynchronous writes need hpsc,smc-calib-scratch to drain the chips\n");
+			return -EINVAL;
+		}
+		nr_regions = 1;
+	}
+
+	for (i = 0; i < nr_regions && !wr_sync; i++) {
+		pmem->drain[i] = devm_ioremap(dev, scratch[i], sizeof(u32));
+		if (!pmem->drain[i])
+			return -ENOMEM;
+	}
+
+	pmem->bus_desc.attr_groups = pl35x_smc_pmem_bus_attribute_groups;
+	pmem->bus_desc.provider_name = "pl35x-smc";
+	pmem->bus_desc.module = THIS_MODULE;
+	pmem->bus = nvdimm_bus_register(dev, &pmem->bus_desc);
+	if (!pmem->bus)
+		return -ENXIO;
+	platform_set_drvdata(pdev, pmem);
+
+	for (i = 0; i < nr_regions; i++) {
+		memset(&ndr_desc, 0, sizeof(ndr_desc));
+		ndr_desc.res = &regions[i];
+		ndr_desc.attr_groups = pl35x_smc_pmem_region_attribute_groups;
+		ndr_desc.numa_node = dev_to_node(dev);
+		ndr_desc.provider_data = &pmem->drain[i];
+		ndr_desc.flush = wr_sync ? pl35x_smc_pmem_flush_sync :
+					   pl35x_smc_pmem_flush_async;
+		set_bit(ND_REGION_PAGEMAP, &ndr_desc.flags);
+		if (!nvdimm_pmem_region_create(pmem->bus, &ndr_desc)) {
+			dev_err(dev, "failed to register %pR as persistent memory\n",
+				&regions[i]);
+			nvdimm_bus_unregister(pmem->bus);
+			return -ENXIO;
+		}
+
+		dev_info(dev, "%pR registered as persistent memory (%s writes)\n",
+			 &regions[i], wr_sync ? "synchronous" : "asynchronous");
+	}
+
+	return 0;
+}
+
+static int pl35x_smc_pmem_remove(struct platform_device *pdev)
+{
+	struct pl35x_smc_pmem *pmem = platform_get_drvdata(pdev);
+
+	nvdimm_bus_unregister(pmem->bus);
+	return 0;
+}
+
+static const struct of_device_id pl35x_smc_pmem_of_match[] = {
+	{ .compatible = "hpsc,smc-nvram-pmem" },
+	{ },
+};
+MODULE_DEVICE_TABLE(of, pl35x_smc_pmem_of_match);
+
+static struct platform_driver pl35x_smc_pmem_driver = {
+	.probe		= pl35x_smc_pmem_probe,
+	.remove		= pl35x_smc_pmem_remove,
+	.driver		= {
+		.name	= "pl35x-smc-pmem",
+		.of_match_table = pl35x_smc_pmem_of_match,
+	},
+};
+
+module_platform_driver(pl35x_smc_pmem_driver);
+
+MODULE_DESCRIPTION("ARM PL35X SMC NVRAM persistent memory provider");
+MODULE_LICENSE("GPL v2");
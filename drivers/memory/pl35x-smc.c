@@ -21,8 +21,12 @@
 #include <linux/kernel.h>
 #include <linux/memory/pl35x-smc.h>
 #include <linux/module.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/of_address.h>
 #include <linux/of_platform.h>
 #include <linux/platform_device.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
 
 /* Register definitions */
@@ -105,14 +109,65 @@
 #define PL35X_SMC_MW_16_BIT	0b01
 #define PL35X_SMC_MW_32_BIT	0b10
 
+/* SRAM/NOR timing calibration */
+#define PL35X_SMC_CALIB_MAX_SCRATCH	SZ_64K
+#define PL35X_SMC_CALIB_PASSES		4	/* pattern test repeats per step */
+#define PL35X_SMC_BW_MIN_NS		(10 * NSEC_PER_MSEC)
+
+static bool calibrate;
+module_param(calibrate, bool, 0444);
+MODULE_PARM_DESC(calibrate, "Calibrate SRAM/NOR cycle timings at probe");
+
+static unsigned int calib_guard = 1;
+module_param(calib_guard, uint, 0644);
+MODULE_PARM_DESC(calib_guard, "Cycles added to each calibrated timing");
+
+/**
+ * struct pl35x_smc_sram - SRAM interface configuration
+ * @node:		SRAM/NOR device node, NULL if not calibrated
+ * @t:			Programmed cycle timings, t0 (t_rc) .. t6 (t_rr)
+ * @t_dt:		Cycle timings from the device tree
+ * @opmode:		Programmed opmode register value
+ * @cre:		Direct command set_cre bit
+ * @ext_addr_bits:	Direct command address bits
+ * @chip_nmbr:		Number of chip selects to update
+ * @writable:		SRAM (pattern tested) rather than NOR (read compared)
+ * @scratch:		Mappings of the calibration scratch range, one per chip
+ * @scratch_size:	Size of the scratch range of each chip in bytes
+ * @save:		Scratch contents of all chips, restored after calibration
+ * @buf:		Bounce buffer for bandwidth measurement
+ * @rd_bw:		Measured read bandwidth in KiB/s
+ * @wr_bw:		Measured write bandwidth in KiB/s
+ * @lock:		Serializes calibration runs
+ */
+struct pl35x_smc_sram {
+	struct device_node	*node;
+	u32			t[7];
+	u32			t_dt[7];
+	u32			opmode;
+	u32			cre;
+	u32			ext_addr_bits;
+	u32			chip_nmbr;
+	bool			writable;
+	void __iomem		**scratch;
+	u32			scratch_size;
+	u32			*save;
+	u32			*buf;
+	u64			rd_bw;
+	u64			wr_bw;
+	struct mutex		lock;
+};
+
 /**
  * struct pl35x_smc_data - Private smc driver structure
  * @devclk:		Pointer to the peripheral clock
  * @aperclk:		Pointer to the APER clock
+ * @sram:		SRAM interface selected for calibration
  */
 struct pl35x_smc_data {
 	struct clk		*memclk;
 	struct clk		*aclk;
+	struct pl35x_smc_sram	sram;
 };
 
 /* SMC virtual register base */
@@ -358,19 +413,68 @@ static int __maybe_unused pl35x_smc_resume(struct device *dev)
 static SIMPLE_DEV_PM_OPS(pl35x_smc_dev_pm_ops, pl35x_smc_suspend,
 			 pl35x_smc_resume);
 
+static const u32 pl35x_smc_cycles_mask[] = {
+	PL35X_SMC_SET_CYCLES_T0_MASK, PL35X_SMC_SET_CYCLES_T1_MASK,
+	PL35X_SMC_SET_CYCLES_T2_MASK, PL35X_SMC_SET_CYCLES_T3_MASK,
+	PL35X_SMC_SET_CYCLES_T4_MASK, PL35X_SMC_SET_CYCLES_T5_MASK,
+	PL35X_SMC_SET_CYCLES_T6_MASK,
+};
+
+static const u32 pl35x_smc_cycles_shift[] = {
+	PL35X_SMC_SET_CYCLES_T0_SHIFT, PL35X_SMC_SET_CYCLES_T1_SHIFT,
+	PL35X_SMC_SET_CYCLES_T2_SHIFT, PL35X_SMC_SET_CYCLES_T3_SHIFT,
+	PL35X_SMC_SET_CYCLES_T4_SHIFT, PL35X_SMC_SET_CYCLES_T5_SHIFT,
+	PL35X_SMC_SET_CYCLES_T6_SHIFT,
+};
+
+/**
+ * pl35x_smc_sram_update - Program opmode and cycles of an SRAM interface
+ * @sram:	Interface configuration to apply to all its chip selects
+ */
+static void pl35x_smc_sram_update(struct pl35x_smc_sram *sram)
+{
+	u32 cycles = 0, cmd;
+	int i;
+
+	pr_debug("%s: writes 0x%x @ 0x%x(offset)\n",  __func__, sram->opmode,
+		 PL35X_SMC_SET_OPMODE_OFFS);
+	writel(sram->opmode, pl35x_smc_base + PL35X_SMC_SET_OPMODE_OFFS);
+
+	for (i = 0; i < ARRAY_SIZE(sram->t); i++)
+		cycles |= (sram->t[i] & pl35x_smc_cycles_mask[i]) <<
+				pl35x_smc_cycles_shift[i];
+
+	pr_debug("%s: writes 0x%x @ 0x%x(offset)\n", __func__, cycles,
+		 PL35X_SMC_SET_CYCLES_OFFS);
+	writel(cycles, pl35x_smc_base + PL35X_SMC_SET_CYCLES_OFFS);
+
+	for (i = 0; i < sram->chip_nmbr ; i++) {
+		cmd = (sram->cre << PL35X_SMC_DC_CMD_set_cre_SHIFT) |
+			 (i << PL35X_SMC_DC_CMD_chip_nmbr_SHIFT) |
+			 (PL35X_SMC_CMD_TYPE_UpdateRegs <<
+				PL35X_SMC_DC_CMD_cmd_type_SHIFT) |
+			 (sram->ext_addr_bits << PL35X_SMC_DC_CMD_addr_SHIFT);
+
+		pr_debug("%s: writes 0x%x @ 0x%x(offset)\n", __func__, cmd,
+			 PL35X_SMC_DIRECT_CMD_OFFS);
+		writel(cmd, pl35x_smc_base + PL35X_SMC_DIRECT_CMD_OFFS);
+	}
+}
+
 /**
- * pl35x_smc_init_sram_interface - Initialize the NAND interface
+ * pl35x_smc_init_sram_interface - Initialize the SRAM interface
  * @pdev:	Pointer to the platform_device struct
- * @nand_node:	Pointer to the pl35x_nand device_node struct
+ * @sram_node:	Pointer to the SRAM/NOR device_node struct
+ * @sram:	Filled in with the programmed interface configuration
  */
 static void pl35x_smc_init_sram_interface(struct platform_device *pdev,
-				       struct device_node *sram_node)
+				       struct device_node *sram_node,
+				       struct pl35x_smc_sram *sram)
 {
 	u32 t_rc, t_wc, t_rea, t_wp, t_clr, t_ar, t_rr;
 	u32 t_adv, t_wr_sync, t_rd_sync, t_mw;
 	u32 cre, ext_addr_bits, chip_nmbr;
-	u32 opmode, cycles, cmd;
-	int err, i;
+	int err;
 
 	/* sram-cycle-<X> property is refer to the SRAM timing
 	 * mapping between dts and the SRAM timing
@@ -466,39 +570,24 @@ static void pl35x_smc_init_sram_interface(struct platform_device *pdev,
 	}
 
 	/* set OPMODE */
-	opmode = (t_adv << PL35X_OPMODE_SET_ADV_SHIFT) |
-		 (t_rd_sync << PL35X_OPMODE_RD_SYNC_SHIFT) |
-		 (t_wr_sync << PL35X_OPMODE_WR_SYNC_SHIFT) |
-		 (t_mw << PL35X_OPMODE_SET_MW_SHIFT);
-
-	pr_debug("%s: writes 0x%x @ 0x%x(offset)\n",  __func__, opmode,
-		 PL35X_SMC_SET_OPMODE_OFFS);
-	writel(opmode, pl35x_smc_base + PL35X_SMC_SET_OPMODE_OFFS);
-
-	/* set cycles */
-	cycles	= (t_rc   & PL35X_SMC_SET_CYCLES_T0_MASK) |
-		  (t_wc  << PL35X_SMC_SET_CYCLES_T1_SHIFT) |
-		  (t_rea << PL35X_SMC_SET_CYCLES_T2_SHIFT) |
-		  (t_wp  << PL35X_SMC_SET_CYCLES_T3_SHIFT) |
-		  (t_clr << PL35X_SMC_SET_CYCLES_T4_SHIFT) |
-		  (t_ar  << PL35X_SMC_SET_CYCLES_T5_SHIFT) |
-		  (t_rr  << PL35X_SMC_SET_CYCLES_T6_SHIFT);
-
-	pr_debug("%s: writes 0x%x @ 0x%x(offset)\n", __func__, cycles,
-		 PL35X_SMC_SET_CYCLES_OFFS);
-        writel(cycles, pl35x_smc_base + PL35X_SMC_SET_CYCLES_OFFS);
-
-	for (i = 0; i < chip_nmbr ; i++) {
-		cmd = (cre << PL35X_SMC_DC_CMD_set_cre_SHIFT) |
-			 (i << PL35X_SMC_DC_CMD_chip_nmbr_SHIFT) |
-			 (PL35X_SMC_CMD_TYPE_UpdateRegs <<
-				PL35X_SMC_DC_CMD_cmd_type_SHIFT) |
-			 (ext_addr_bits << PL35X_SMC_DC_CMD_addr_SHIFT);
-
-		pr_debug("%s: writes 0x%x @ 0x%x(offset)\n", __func__, cmd,
-			 PL35X_SMC_DIRECT_CMD_OFFS);
-		writel(cmd, pl35x_smc_base + PL35X_SMC_DIRECT_CMD_OFFS);
-	}
+	sram->opmode = (t_adv << PL35X_OPMODE_SET_ADV_SHIFT) |
+		       (t_rd_sync << PL35X_OPMODE_RD_SYNC_SHIFT) |
+		       (t_wr_sync << PL35X_OPMODE_WR_SYNC_SHIFT) |
+		       (t_mw << PL35X_OPMODE_SET_MW_SHIFT);
+
+	sram->t_dt[0] = t_rc;
+	sram->t_dt[1] = t_wc;
+	sram->t_dt[2] = t_rea;
+	sram->t_dt[3] = t_wp;
+	sram->t_dt[4] = t_clr;
+	sram->t_dt[5] = t_ar;
+	sram->t_dt[6] = t_rr;
+	memcpy(sram->t, sram->t_dt, sizeof(sram->t));
+	sram->cre = cre;
+	sram->ext_addr_bits = ext_addr_bits;
+	sram->chip_nmbr = chip_nmbr;
+
+	pl35x_smc_sram_update(sram);
 }
 
 /**
@@ -611,6 +700,358 @@ static void pl35x_smc_init_nand_interface(struct platform_device *pdev,
 			pl35x_smc_base + PL35X_SMC_ECC_MEMCMD2_OFFS);
 }
 
+/*
+ * SRAM/NOR timing calibration
+ *
+ * Starting from the device tree timings, each of t0..t5 is lowered one
+ * cycle at a time for as long as a data integrity test over the scratch
+ * range keeps passing.  The fastest passing value plus calib_guard cycles
+ * (never slower than the device tree value) is kept.  SRAM is tested with
+ * write/read-back patterns; NOR is read-only here, so reads are compared
+ * against the contents captured at the device tree timings and the write
+ * timings (t1, t3) are left alone.  The timings are shared by all chip
+ * selects of the interface, so the scratch range is tested in every chip.
+ * The scratch contents are saved before and restored after the run, and
+ * the read/write bandwidth of the scratch range is measured with the
+ * resulting timings.
+ */
+#define PL35X_SMC_PATTERNS	8
+
+static const u32 pl35x_smc_calib_min[] = { 1, 1, 1, 1, 0, 0 };
+static const bool pl35x_smc_calib_wr[] = { false, true, false, true,
+					    false, false };
+
+static u32 pl35x_smc_pattern(int p, u32 i)
+{
+	switch (p) {
+	case 0:
+		return 0;
+	case 1:
+		return ~0;
+	case 2:
+		return 0x55555555;
+	case 3:
+		return 0xaaaaaaaa;
+	case 4:
+		return BIT(i % 32);	/* walking one */
+	case 5:
+		return ~BIT(i % 32);	/* walking zero */
+	case 6:
+		return i << 2;		/* own address */
+	default:
+		return ~(i << 2);
+	}
+}
+
+/**
+ * pl35x_smc_sram_check - Data integrity test of the scratch range
+ * @sram:	Interface under test, with the timings to test applied
+ * Return: 0 if the test passed on every chip, -EIO otherwise.
+ */
+static int pl35x_smc_sram_check(struct pl35x_smc_sram *sram)
+{
+	u32 words = sram->scratch_size / sizeof(u32);
+	void __iomem *scratch;
+	u32 *save;
+	int pass, p;
+	u32 c, i;
+
+	for (c = 0; c < sram->chip_nmbr; c++) {
+		scratch = sram->scratch[c];
+		save = sram->save + c * words;
+
+		for (pass = 0; pass < PL35X_SMC_CALIB_PASSES; pass++) {
+			if (!sram->writable) {
+				for (i = 0; i < words; i++)
+					if (readl(scratch + (i << 2)) !=
+					    save[i])
+						return -EIO;
+				continue;
+			}
+
+			for (p = 0; p < PL35X_SMC_PATTERNS; p++) {
+				for (i = 0; i < words; i++)
+					writel(pl35x_smc_pattern(p, i),
+					       scratch + (i << 2));
+				for (i = 0; i < words; i++)
+					if (readl(scratch + (i << 2)) !=
+					    pl35x_smc_pattern(p, i))
+						return -EIO;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static u64 pl35x_smc_kibps(u64 bytes, u64 ns)
+{
+	return ns ? div64_u64(bytes * NSEC_PER_SEC, ns) >> 10 : 0;
+}
+
+/**
+ * pl35x_smc_sram_measure - Measure bandwidth of the scratch range
+ * @sram:	Interface to measure, scratch contents of chip 0 are clobbered
+ */
+static void pl35x_smc_sram_measure(struct pl35x_smc_sram *sram)
+{
+	u64 bytes = 0, ns;
+	ktime_t start;
+
+	start = ktime_get();
+	do {
+		memcpy_fromio(sram->buf, sram->scratch[0], sram->scratch_size);
+		bytes += sram->scratch_size;
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	} while (ns < PL35X_SMC_BW_MIN_NS);
+	sram->rd_bw = pl35x_smc_kibps(bytes, ns);
+
+	if (!sram->writable)
+		return;
+
+	bytes = 0;
+	start = ktime_get();
+	do {
+		memcpy_toio(sram->scratch[0], sram->buf, sram->scratch_size);
+		/* wait for the posted writes to reach the memory */
+		readl(sram->scratch[0]);
+		bytes += sram->scratch_size;
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	} while (ns < PL35X_SMC_BW_MIN_NS);
+	sram->wr_bw = pl35x_smc_kibps(bytes, ns);
+}
+
+/**
+ * pl35x_smc_sram_calibrate - Find the fastest safe cycle timings
+ * @dev:	SMC device, for messages
+ * @sram:	Interface to calibrate
+ * Return: 0 on success or negative errno, the timings are unchanged on error.
+ */
+static int pl35x_smc_sram_calibrate(struct device *dev,
+				    struct pl35x_smc_sram *sram)
+{
+	u32 orig[ARRAY_SIZE(sram->t)];
+	int k;
+
+	memcpy(orig, sram->t, sizeof(orig));
+
+	if (pl35x_smc_sram_check(sram)) {
+		dev_err(dev, "calibration: scratch test fails at current timings\n");
+		return -EIO;
+	}
+
+	for (k = 0; k < ARRAY_SIZE(pl35x_smc_calib_min); k++) {
+		if (pl35x_smc_calib_wr[k] && !sram->writable)
+			continue;
+
+		while (sram->t[k] > pl35x_smc_calib_min[k]) {
+			sram->t[k]--;
+			pl35x_smc_sram_update(sram);
+			if (pl35x_smc_sram_check(sram)) {
+				sram->t[k]++;
+				pl35x_smc_sram_update(sram);
+				break;
+			}
+		}
+	}
+
+	for (k = 0; k < ARRAY_SIZE(pl35x_smc_calib_min); k++)
+		sram->t[k] = min3(sram->t[k] + calib_guard, sram->t_dt[k],
+				  pl35x_smc_cycles_mask[k]);
+	pl35x_smc_sram_update(sram);
+
+	if (pl35x_smc_sram_check(sram)) {
+		dev_err(dev, "calibration: guard banded timings fail, reverting\n");
+		memcpy(sram->t, orig, sizeof(orig));
+		pl35x_smc_sram_update(sram);
+		return -EIO;
+	}
+
+	dev_info(dev, "calibrated %pOF: t0..t6 = %u %u %u %u %u %u %u\n",
+		 sram->node, sram->t[0], sram->t[1], sram->t[2], sram->t[3],
+		 sram->t[4], sram->t[5], sram->t[6]);
+
+	return 0;
+}
+
+/**
+ * pl35x_smc_sram_run - Optionally calibrate, then measure bandwidth
+ * @dev:	SMC device
+ * @sram:	Interface with a scratch range
+ * @calib:	Calibrate the timings before measuring
+ * Return: 0 on success or negative errno from the calibration.
+ */
+static int pl35x_smc_sram_run(struct device *dev, struct pl35x_smc_sram *sram,
+			      bool calib)
+{
+	u32 words = sram->scratch_size / sizeof(u32);
+	int err = 0;
+	u32 c;
+
+	mutex_lock(&sram->lock);
+	for (c = 0; c < sram->chip_nmbr; c++)
+		memcpy_fromio(sram->save + c * words, sram->scratch[c],
+			      sram->scratch_size);
+	if (calib)
+		err = pl35x_smc_sram_calibrate(dev, sram);
+	pl35x_smc_sram_measure(sram);
+	if (sram->writable)
+		for (c = 0; c < sram->chip_nmbr; c++)
+			memcpy_toio(sram->scratch[c], sram->save + c * words,
+				    sram->scratch_size);
+	mutex_unlock(&sram->lock);
+
+	return err;
+}
+
+static ssize_t sram_cycles_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct pl35x_smc_data *pl35x_smc = dev_get_drvdata(dev);
+	struct pl35x_smc_sram *sram = &pl35x_smc->sram;
+
+	return sprintf(buf, "%u %u %u %u %u %u %u\n", sram->t[0], sram->t[1],
+		       sram->t[2], sram->t[3], sram->t[4], sram->t[5],
+		       sram->t[6]);
+}
+static DEVICE_ATTR_RO(sram_cycles);
+
+static ssize_t sram_read_bandwidth_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	struct pl35x_smc_data *pl35x_smc = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%llu\n", pl35x_smc->sram.rd_bw);
+}
+static DEVICE_ATTR_RO(sram_read_bandwidth);
+
+static ssize_t sram_write_bandwidth_show(struct device *dev,
+					 struct device_attribute *attr,
+					 char *buf)
+{
+	struct pl35x_smc_data *pl35x_smc = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%llu\n", pl35x_smc->sram.wr_bw);
+}
+static DEVICE_ATTR_RO(sram_write_bandwidth);
+
+/*
+ * Writing 1 calibrates and re-measures, writing 0 only re-measures.  The
+ * memory must not be in use, so this is refused while a driver is bound
+ * to it.
+ */
+static ssize_t sram_calibrate_store(struct device *dev,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	struct pl35x_smc_data *pl35x_smc = dev_get_drvdata(dev);
+	struct pl35x_smc_sram *sram = &pl35x_smc->sram;
+	struct platform_device *child;
+	bool calib;
+	int err;
+
+	err = kstrtobool(buf, &calib);
+	if (err)
+		return err;
+
+	child = of_find_device_by_node(sram->node);
+	if (child) {
+		err = child->dev.driver ? -EBUSY : 0;
+		put_device(&child->dev);
+		if (err)
+			return err;
+	}
+
+	err = pl35x_smc_sram_run(dev, sram, calib);
+
+	return err ? err : count;
+}
+static DEVICE_ATTR_WO(sram_calibrate);
+
+static struct attribute *pl35x_smc_sram_attrs[] = {
+	&dev_attr_sram_cycles.attr,
+	&dev_attr_sram_read_bandwidth.attr,
+	&dev_attr_sram_write_bandwidth.attr,
+	&dev_attr_sram_calibrate.attr,
+	NULL,
+};
+
+static const struct attribute_group pl35x_smc_sram_group = {
+	.attrs = pl35x_smc_sram_attrs,
+};
+
+/**
+ * pl35x_smc_sram_calib_init - Set up calibration of an SRAM interface
+ * @pdev:	Pointer to the platform_device struct
+ * @sram:	Interface, initialized by pl35x_smc_init_sram_interface()
+ * @writable:	SRAM (true) or NOR flash (false)
+ * Return: 0 on success or negative errno.
+ *
+ * The scratch range is given by "hpsc,smc-calib-scratch" = <offset size>
+ * relative to the start of each chip; the first "reg" entry of the memory
+ * node is split evenly between its "arm,sram-chip-nmbr" chips.  The range
+ * is excluded from the persistent memory exported by pl35x-smc-pmem.
+ *
+ * Bandwidth is only measured here when calibrating at probe, since the
+ * memory may already hold data that a concurrent user must not see
+ * clobbered; otherwise it is measured on demand through sram_calibrate.
+ */
+static int pl35x_smc_sram_calib_init(struct platform_device *pdev,
+				     struct pl35x_smc_sram *sram,
+				     bool writable)
+{
+	struct device *dev = &pdev->dev;
+	struct resource res;
+	resource_size_t chip_size;
+	u32 range[2];
+	u32 c;
+	int err;
+
+	err = of_property_read_u32_array(sram->node, "hpsc,smc-calib-scratch",
+					 range, ARRAY_SIZE(range));
+	if (err)
+		return err;
+
+	err = of_address_to_resource(sram->node, 0, &res);
+	if (err)
+		return err;
+
+	if (!sram->chip_nmbr)
+		return -EINVAL;
+	chip_size = resource_size(&res);
+	do_div(chip_size, sram->chip_nmbr);
+	if (!range[1] || range[1] > PL35X_SMC_CALIB_MAX_SCRATCH ||
+	    !IS_ALIGNED(range[0] | range[1], sizeof(u32)) ||
+	    (u64)range[0] + range[1] > chip_size) {
+		dev_err(dev, "invalid calibration scratch range in %pOF\n",
+			sram->node);
+		return -EINVAL;
+	}
+
+	sram->writable = writable;
+	sram->scratch_size = range[1];
+	sram->scratch = devm_kcalloc(dev, sram->chip_nmbr,
+				     sizeof(*sram->scratch), GFP_KERNEL);
+	sram->save = devm_kmalloc_array(dev, sram->chip_nmbr, range[1],
+					GFP_KERNEL);
+	sram->buf = devm_kmalloc(dev, range[1], GFP_KERNEL);
+	if (!sram->scratch || !sram->save || !sram->buf)
+		return -ENOMEM;
+	for (c = 0; c < sram->chip_nmbr; c++) {
+		sram->scratch[c] = devm_ioremap(dev, res.start + c * chip_size +
+						range[0], range[1]);
+		if (!sram->scratch[c])
+			return -ENOMEM;
+	}
+	mutex_init(&sram->lock);
+
+	if (calibrate)
+		pl35x_smc_sram_run(dev, sram, true);
+
+	return devm_device_add_group(dev, &pl35x_smc_sram_group);
+}
+
 static const struct of_device_id matches_nor[] = {
 	{ .compatible = "cfi-flash" },
 	{}
@@ -626,6 +1067,46 @@ static const struct of_device_id matches_sram[] = {
 	{}
 };
 
+/* NVRAM chips on the SRAM interface exported as persistent memory */
+static const struct of_device_id matches_pmem[] = {
+	{ .compatible = "hpsc,smc-nvram-pmem" },
+	{}
+};
+
+/**
+ * pl35x_smc_setup_sram - Initialize an SRAM/NOR interface
+ * @pdev:	Pointer to the platform_device struct
+ * @child:	SRAM/NOR device node
+ * @writable:	SRAM (true) or NOR flash (false)
+ *
+ * The first interface with a calibration scratch range is kept for
+ * calibration and bandwidth reporting.
+ */
+static void pl35x_smc_setup_sram(struct platform_device *pdev,
+				 struct device_node *child, bool writable)
+{
+	struct pl35x_smc_data *pl35x_smc = platform_get_drvdata(pdev);
+	struct pl35x_smc_sram *sram = &pl35x_smc->sram;
+	struct pl35x_smc_sram other;
+	int err;
+
+	if (sram->node ||
+	    !of_property_read_bool(child, "hpsc,smc-calib-scratch")) {
+		pl35x_smc_init_sram_interface(pdev, child, &other);
+		return;
+	}
+
+	pl35x_smc_init_sram_interface(pdev, child, sram);
+	sram->node = of_node_get(child);
+	err = pl35x_smc_sram_calib_init(pdev, sram, writable);
+	if (err) {
+		dev_warn(&pdev->dev, "no timing calibration for %pOF: %d\n",
+			 child, err);
+		of_node_put(sram->node);
+		sram->node = NULL;
+	}
+}
+
 static int pl35x_smc_probe(struct platform_device *pdev)
 {
 	struct pl35x_smc_data *pl35x_smc;
@@ -692,7 +1173,7 @@ static int pl35x_smc_probe(struct platform_device *pdev)
 
 		if (of_match_node(matches_nor, child)) {
 			static int counts;
-			pl35x_smc_init_sram_interface(pdev, child);
+			pl35x_smc_setup_sram(pdev, child, false);
 			if (!matches) {
 				matches = matches_nor;
 			} else {
@@ -705,8 +1186,14 @@ static int pl35x_smc_probe(struct platform_device *pdev)
 			counts++;
 		}
 
-		if (of_match_node(matches_sram, child)) {
-			pl35x_smc_init_sram_interface(pdev, child);
+		if (of_match_node(matches_sram, child) ||
+		    of_match_node(matches_pmem, child)) {
+			pl35x_smc_setup_sram(pdev, child, true);
+			if (of_match_node(matches_pmem, child) &&
+			    !of_platform_device_create(child, NULL, &pdev->dev))
+				dev_err(&pdev->dev,
+					"failed to create pmem device for %pOF\n",
+					child);
 		}
 	}
 
@@ -716,6 +1203,7 @@ static int pl35x_smc_probe(struct platform_device *pdev)
 	return 0;
 
 out_clk_disable:
+	of_node_put(pl35x_smc->sram.node);
 	clk_disable_unprepare(pl35x_smc->memclk);
 out_clk_dis_aper:
 	clk_disable_unprepare(pl35x_smc->aclk);
@@ -727,6 +1215,7 @@ static int pl35x_smc_remove(struct platform_device *pdev)
 {
 	struct pl35x_smc_data *pl35x_smc = platform_get_drvdata(pdev);
 
+	of_node_put(pl35x_smc->sram.node);
 	clk_disable_unprepare(pl35x_smc->memclk);
 	clk_disable_unprepare(pl35x_smc->aclk);
 
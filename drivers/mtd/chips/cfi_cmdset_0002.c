@@ -44,12 +44,18 @@
 
 #define MAX_WORD_RETRIES 3
 
+/* Write buffers programmed per chip acquisition, see do_write_buffers() */
+#define CFI_AMDSTD_WRITE_BATCH 8
+
 #define SST49LF004B	        0x0060
 #define SST49LF040B	        0x0050
 #define SST49LF008A		0x005a
 #define AT49BV6416		0x00d6
 
 static int cfi_amdstd_read (struct mtd_info *, loff_t, size_t, size_t *, u_char *);
+static int cfi_amdstd_point(struct mtd_info *, loff_t, size_t, size_t *,
+			    void **, resource_size_t *);
+static int cfi_amdstd_unpoint(struct mtd_info *, loff_t, size_t);
 static int cfi_amdstd_write_words(struct mtd_info *, loff_t, size_t, size_t *, const u_char *);
 static int cfi_amdstd_write_buffers(struct mtd_info *, loff_t, size_t, size_t *, const u_char *);
 static int cfi_amdstd_erase_chip(struct mtd_info *, struct erase_info *);
@@ -202,6 +208,19 @@ static void fixup_amd_bootblock(struct mtd_info *mtd)
 }
 #endif
 
+/*
+ * Linear maps can be pointed at directly, which lets read-mostly images
+ * (firmware, XIP capable filesystems) be executed or mapped in place.
+ */
+static void fixup_use_point(struct mtd_info *mtd)
+{
+	struct map_info *map = mtd->priv;
+	if (!mtd->_point && map_is_linear(map)) {
+		mtd->_point   = cfi_amdstd_point;
+		mtd->_unpoint = cfi_amdstd_unpoint;
+	}
+}
+
 static void fixup_use_write_buffers(struct mtd_info *mtd)
 {
 	struct map_info *map = mtd->priv;
@@ -403,6 +422,7 @@ static struct cfi_fixup cfi_fixup_table[] = {
 #if !FORCE_WORD_WRITE
 	{ CFI_MFR_ANY, CFI_ID_ANY, fixup_use_write_buffers },
 #endif
+	{ CFI_MFR_ANY, CFI_ID_ANY, fixup_use_point },
 	{ 0, 0, NULL }
 };
 static struct cfi_fixup jedec_fixup_table[] = {
@@ -865,7 +885,8 @@ static int get_chip(struct map_info *map, struct flchip *chip, unsigned long adr
 
 	case FL_POINT:
 		/* Only if there's no operation suspended... */
-		if (mode == FL_READY && chip->oldstate == FL_READY)
+		if ((mode == FL_READY || mode == FL_POINT) &&
+		    chip->oldstate == FL_READY)
 			return 0;
 
 	default:
@@ -1104,6 +1125,134 @@ do {  \
 
 #endif
 
+static int do_point_onechip(struct map_info *map, struct flchip *chip,
+			    loff_t adr, size_t len)
+{
+	unsigned long cmd_addr;
+	struct cfi_private *cfi = map->fldrv_priv;
+	int ret = 0;
+
+	adr += chip->start;
+
+	/* Ensure cmd read/writes are aligned. */
+	cmd_addr = adr & ~(map_bankwidth(map)-1);
+
+	mutex_lock(&chip->mutex);
+
+	ret = get_chip(map, chip, cmd_addr, FL_POINT);
+
+	if (!ret) {
+		if (chip->state != FL_POINT && chip->state != FL_READY)
+			map_write(map, CMD(0xf0), cmd_addr);
+
+		chip->state = FL_POINT;
+		chip->ref_point_counter++;
+	}
+	mutex_unlock(&chip->mutex);
+
+	return ret;
+}
+
+static int cfi_amdstd_point(struct mtd_info *mtd, loff_t from, size_t len,
+			    size_t *retlen, void **virt, resource_size_t *phys)
+{
+	struct map_info *map = mtd->priv;
+	struct cfi_private *cfi = map->fldrv_priv;
+	unsigned long ofs, last_end = 0;
+	int chipnum;
+	int ret = 0;
+
+	if (!map->virt)
+		return -EINVAL;
+
+	/* Now lock the chip(s) to POINT state */
+
+	/* ofs: offset within the first chip that the first read should start */
+	chipnum = (from >> cfi->chipshift);
+	ofs = from - (chipnum << cfi->chipshift);
+
+	*virt = map->virt + cfi->chips[chipnum].start + ofs;
+	if (phys)
+		*phys = map->phys + cfi->chips[chipnum].start + ofs;
+
+	while (len) {
+		unsigned long thislen;
+
+		if (chipnum >= cfi->numchips)
+			break;
+
+		/* We cannot point across chips that are virtually disjoint */
+		if (!last_end)
+			last_end = cfi->chips[chipnum].start;
+		else if (cfi->chips[chipnum].start != last_end)
+			break;
+
+		if ((len + ofs -1) >> cfi->chipshift)
+			thislen = (1<<cfi->chipshift) - ofs;
+		else
+			thislen = len;
+
+		ret = do_point_onechip(map, &cfi->chips[chipnum], ofs, thislen);
+		if (ret)
+			break;
+
+		*retlen += thislen;
+		len -= thislen;
+
+		ofs = 0;
+		last_end += 1 << cfi->chipshift;
+		chipnum++;
+	}
+	return 0;
+}
+
+static int cfi_amdstd_unpoint(struct mtd_info *mtd, loff_t from, size_t len)
+{
+	struct map_info *map = mtd->priv;
+	struct cfi_private *cfi = map->fldrv_priv;
+	unsigned long ofs;
+	int chipnum, err = 0;
+
+	/* Now unlock the chip(s) POINT state */
+
+	/* ofs: offset within the first chip that the first read should start */
+	chipnum = (from >> cfi->chipshift);
+	ofs = from - (chipnum <<  cfi->chipshift);
+
+	while (len && !err) {
+		unsigned long thislen;
+		struct flchip *chip;
+
+		chip = &cfi->chips[chipnum];
+		if (chipnum >= cfi->numchips)
+			break;
+
+		if ((len + ofs -1) >> cfi->chipshift)
+			thislen = (1<<cfi->chipshift) - ofs;
+		else
+			thislen = len;
+
+		mutex_lock(&chip->mutex);
+		if (chip->state == FL_POINT) {
+			chip->ref_point_counter--;
+			if(chip->ref_point_counter == 0)
+				chip->state = FL_READY;
+		} else {
+			printk(KERN_ERR "%s: Error: unpoint called on non pointed region\n", map->name);
+			err = -EINVAL;
+		}
+
+		put_chip(map, chip, chip->start);
+		mutex_unlock(&chip->mutex);
+
+		len -= thislen;
+		ofs = 0;
+		chipnum++;
+	}
+
+	return err;
+}
+
 static inline int do_read_onechip(struct map_info *map, struct flchip *chip, loff_t adr, size_t len, u_char *buf)
 {
 	unsigned long cmd_addr;
@@ -1789,6 +1938,9 @@ static int cfi_amdstd_write_words(struct mtd_info *mtd, loff_t to, size_t len,
 
 
 /*
+ * Program one write buffer.  The caller holds chip->mutex and has the chip
+ * in a writable state through get_chip(); the chip is left in FL_READY.
+ *
  * FIXME: interleaved mode not tested, and probably not supported!
  */
 static int __xipram do_write_buffer(struct map_info *map, struct flchip *chip,
@@ -1803,21 +1955,16 @@ static int __xipram do_write_buffer(struct map_info *map, struct flchip *chip,
 	 */
 	unsigned long uWriteTimeout =
 				usecs_to_jiffies(chip->buffer_write_time_max);
+	int max_words = (cfi_interleave(cfi) << cfi->cfiq->MaxBufWriteSize) /
+			map_bankwidth(map);
 	int ret = -EIO;
 	unsigned long cmd_adr;
-	int z, words;
+	int z, words, poll;
 	map_word datum;
 
 	adr += chip->start;
 	cmd_adr = adr;
 
-	mutex_lock(&chip->mutex);
-	ret = get_chip(map, chip, adr, FL_WRITING);
-	if (ret) {
-		mutex_unlock(&chip->mutex);
-		return ret;
-	}
-
 	datum = map_word_load(map, buf);
 
 	pr_debug("MTD %s(): WRITE 0x%.8lx(0x%.8lx)\n",
@@ -1855,9 +2002,16 @@ static int __xipram do_write_buffer(struct map_info *map, struct flchip *chip,
 	map_write(map, CMD(0x29), cmd_adr);
 	chip->state = FL_WRITING;
 
+	/*
+	 * Polling the status costs two bus reads on the slow external bus
+	 * and a mutex round trip, so don't start before the typical program
+	 * time of this many words has elapsed, then poll in 1/8 steps of it.
+	 */
+	poll = DIV_ROUND_UP(chip->buffer_write_time * words, max(max_words, 1));
 	INVALIDATE_CACHE_UDELAY(map, chip,
 				adr, map_bankwidth(map),
-				chip->word_write_time);
+				poll);
+	poll = max(poll >> 3, 1);
 
 	timeo = jiffies + uWriteTimeout;
 
@@ -1885,7 +2039,7 @@ static int __xipram do_write_buffer(struct map_info *map, struct flchip *chip,
 		}
 
 		/* Latency issues. Drop the lock, wait a while and retry */
-		UDELAY(map, chip, adr, 1);
+		UDELAY(map, chip, adr, poll);
 	}
 
 	/*
@@ -1912,19 +2066,66 @@ static int __xipram do_write_buffer(struct map_info *map, struct flchip *chip,
  op_done:
 	chip->state = FL_READY;
 	DISABLE_VPP(map);
-	put_chip(map, chip, adr);
-	mutex_unlock(&chip->mutex);
 
 	return ret;
 }
 
+/*
+ * Program a run of write buffers within one chip.  Up to
+ * CFI_AMDSTD_WRITE_BATCH buffers are programmed per get_chip()/put_chip()
+ * pair: when an erase is in progress on the chip this suspends and resumes
+ * it once per batch rather than once per buffer, so the erase still makes
+ * progress while the writer runs, without paying the suspend latency for
+ * every buffer.  Returns the number of bytes written or a negative errno.
+ */
+static int do_write_buffers(struct map_info *map, struct flchip *chip,
+			    unsigned long ofs, const u_char *buf, int len)
+{
+	struct cfi_private *cfi = map->fldrv_priv;
+	int wbufsize = cfi_interleave(cfi) << cfi->cfiq->MaxBufWriteSize;
+	int done = 0, batch, ret;
+
+	while (done < len) {
+		mutex_lock(&chip->mutex);
+		ret = get_chip(map, chip, chip->start + ofs, FL_WRITING);
+		if (ret) {
+			mutex_unlock(&chip->mutex);
+			return ret;
+		}
+
+		for (batch = 0; batch < CFI_AMDSTD_WRITE_BATCH && done < len;
+		     batch++) {
+			/* We must not cross write block boundaries */
+			int size = wbufsize - (ofs & (wbufsize-1));
+
+			if (size > len - done)
+				size = len - done;
+
+			ret = do_write_buffer(map, chip, ofs, buf, size);
+			if (ret) {
+				put_chip(map, chip, chip->start + ofs);
+				mutex_unlock(&chip->mutex);
+				return ret;
+			}
+
+			ofs += size;
+			buf += size;
+			done += size;
+		}
+
+		put_chip(map, chip, chip->start + ofs);
+		mutex_unlock(&chip->mutex);
+	}
+
+	return done;
+}
+
 
 static int cfi_amdstd_write_buffers(struct mtd_info *mtd, loff_t to, size_t len,
 				    size_t *retlen, const u_char *buf)
 {
 	struct map_info *map = mtd->priv;
 	struct cfi_private *cfi = map->fldrv_priv;
-	int wbufsize = cfi_interleave(cfi) << cfi->cfiq->MaxBufWriteSize;
 	int ret = 0;
 	int chipnum;
 	unsigned long ofs;
@@ -1955,17 +2156,15 @@ static int cfi_amdstd_write_buffers(struct mtd_info *mtd, loff_t to, size_t len,
 
 	/* Write buffer is worth it only if more than one word to write... */
 	while (len >= map_bankwidth(map) * 2) {
-		/* We must not cross write block boundaries */
-		int size = wbufsize - (ofs & (wbufsize-1));
+		/* Whole bus words, up to the end of this chip */
+		size_t size = len - (len % map_bankwidth(map));
 
-		if (size > len)
-			size = len;
-		if (size % map_bankwidth(map))
-			size -= size % map_bankwidth(map);
+		if (size > (1UL << cfi->chipshift) - ofs)
+			size = (1UL << cfi->chipshift) - ofs;
 
-		ret = do_write_buffer(map, &cfi->chips[chipnum],
-				      ofs, buf, size);
-		if (ret)
+		ret = do_write_buffers(map, &cfi->chips[chipnum],
+				       ofs, buf, size);
+		if (ret < 0)
 			return ret;
 
 		ofs += size;
@@ -0,0 +1,333 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * Test image update throughput of a MTD device: every eraseblock is erased
+ * and then rewritten, as a firmware update does.  The update is timed
+ * once with erase and write strictly in turn, and once with the erase of
+ * the next eraseblock running in the background while the current one is
+ * written, which NOR chips supporting program during erase suspend can
+ * overlap.  Both images are read back and verified.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/init.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/err.h>
+#include <linux/mtd/mtd.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/random.h>
+#include <linux/completion.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+
+#include "mtd_test.h"
+
+static int dev = -EINVAL;
+module_param(dev, int, S_IRUGO);
+MODULE_PARM_DESC(dev, "MTD device number to use");
+
+static int count;
+module_param(count, int, S_IRUGO);
+MODULE_PARM_DESC(count, "Maximum number of eraseblocks to use "
+			"(0 means use all)");
+
+static int chunk;
+module_param(chunk, int, S_IRUGO);
+MODULE_PARM_DESC(chunk, "Size of each write in bytes "
+			"(0 means one eraseblock)");
+
+static struct mtd_info *mtd;
+static unsigned char *image;
+static unsigned char *readbuf;
+static unsigned char *bbt;
+
+static int ebcnt;
+static int goodebcnt;
+static ktime_t start, finish;
+
+/* Background erase of one eraseblock */
+struct update_erase {
+	struct work_struct work;
+	struct completion done;
+	int ebnum;
+	int err;
+};
+
+static void update_erase_work(struct work_struct *work)
+{
+	struct update_erase *ue = container_of(work, struct update_erase,
+					       work);
+
+	ue->err = mtdtest_erase_eraseblock(mtd, ue->ebnum);
+	complete(&ue->done);
+}
+
+static void update_erase_start(struct update_erase *ue, int ebnum)
+{
+	ue->ebnum = ebnum;
+	ue->err = 0;
+	reinit_completion(&ue->done);
+	queue_work(system_unbound_wq, &ue->work);
+}
+
+static int update_erase_wait(struct update_erase *ue)
+{
+	wait_for_completion(&ue->done);
+	return ue->err;
+}
+
+static int write_eraseblock(int ebnum)
+{
+	loff_t addr = (loff_t)ebnum * mtd->erasesize;
+	unsigned char *buf = image + (size_t)ebnum * mtd->erasesize;
+	size_t done, len;
+	int err;
+
+	for (done = 0; done < mtd->erasesize; done += len) {
+		len = min_t(size_t, chunk, mtd->erasesize - done);
+		err = mtdtest_write(mtd, addr + done, len, buf + done);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static int verify_image(void)
+{
+	int i, err;
+
+	for (i = 0; i < ebcnt; ++i) {
+		if (bbt[i])
+			continue;
+		err = mtdtest_read(mtd, (loff_t)i * mtd->erasesize,
+				   mtd->erasesize, readbuf);
+		if (err)
+			return err;
+		if (memcmp(readbuf, image + (size_t)i * mtd->erasesize,
+			   mtd->erasesize)) {
+			pr_err("error: verify failed at EB %d\n", i);
+			return -EIO;
+		}
+
+		err = mtdtest_relax();
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static inline void start_timing(void)
+{
+	start = ktime_get();
+}
+
+static inline void stop_timing(void)
+{
+	finish = ktime_get();
+}
+
+static long calc_speed(void)
+{
+	uint64_t k;
+	long ms;
+
+	ms = ktime_ms_delta(finish, start);
+	if (ms == 0)
+		return 0;
+	k = (uint64_t)goodebcnt * (mtd->erasesize / 1024) * 1000;
+	do_div(k, ms);
+	return k;
+}
+
+/* Erase, then write, one eraseblock after the other */
+static int update_serial(void)
+{
+	int i, err;
+
+	for (i = 0; i < ebcnt; ++i) {
+		if (bbt[i])
+			continue;
+		err = mtdtest_erase_eraseblock(mtd, i);
+		if (err)
+			return err;
+		err = write_eraseblock(i);
+		if (err)
+			return err;
+
+		err = mtdtest_relax();
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static int next_good(int i)
+{
+	while (i < ebcnt && bbt[i])
+		i++;
+	return i;
+}
+
+/* Write one eraseblock while the next good one is erased in the background */
+static int update_pipelined(void)
+{
+	struct update_erase ue;
+	int i, next, err;
+
+	INIT_WORK_ONSTACK(&ue.work, update_erase_work);
+	init_completion(&ue.done);
+
+	i = next_good(0);
+	if (i >= ebcnt)
+		return 0;
+	update_erase_start(&ue, i);
+
+	for (; i < ebcnt; i = next) {
+		err = update_erase_wait(&ue);
+		if (err)
+			break;
+
+		next = next_good(i + 1);
+		if (next < ebcnt)
+			update_erase_start(&ue, next);
+
+		err = write_eraseblock(i);
+		if (!err)
+			err = mtdtest_relax();
+		if (err) {
+			if (next < ebcnt)
+				update_erase_wait(&ue);
+			break;
+		}
+	}
+
+	destroy_work_on_stack(&ue.work);
+	return err;
+}
+
+static int __init mtd_updatetest_init(void)
+{
+	int err, i;
+	long speed;
+	uint64_t tmp;
+
+	printk(KERN_INFO "\n");
+	printk(KERN_INFO "=================================================\n");
+
+	if (dev < 0) {
+		pr_info("Please specify a valid mtd-device via module parameter\n");
+		pr_crit("CAREFUL: This test wipes all data on the specified MTD device!\n");
+		return -EINVAL;
+	}
+
+	if (count)
+		pr_info("MTD device: %d    count: %d\n", dev, count);
+	else
+		pr_info("MTD device: %d\n", dev);
+
+	mtd = get_mtd_device(NULL, dev);
+	if (IS_ERR(mtd)) {
+		err = PTR_ERR(mtd);
+		pr_err("error: cannot get MTD device\n");
+		return err;
+	}
+
+	tmp = mtd->size;
+	do_div(tmp, mtd->erasesize);
+	ebcnt = tmp;
+	if (count > 0 && count < ebcnt)
+		ebcnt = count;
+
+	if (chunk <= 0 || chunk > mtd->erasesize)
+		chunk = mtd->erasesize;
+	chunk -= chunk % mtd->writesize;
+	if (!chunk)
+		chunk = mtd->writesize;
+
+	pr_info("MTD device size %llu, eraseblock size %u, write size %u, "
+	       "count of eraseblocks %u, write chunk %d\n",
+	       (unsigned long long)mtd->size, mtd->erasesize,
+	       mtd->writesize, ebcnt, chunk);
+
+	err = -ENOMEM;
+	image = vmalloc((size_t)ebcnt * mtd->erasesize);
+	if (!image)
+		goto out;
+	readbuf = kmalloc(mtd->erasesize, GFP_KERNEL);
+	if (!readbuf)
+		goto out;
+
+	bbt = kzalloc(ebcnt, GFP_KERNEL);
+	if (!bbt)
+		goto out;
+	err = mtdtest_scan_for_bad_eraseblocks(mtd, bbt, 0, ebcnt);
+	if (err)
+		goto out;
+	for (i = 0; i < ebcnt; i++) {
+		if (!bbt[i])
+			goodebcnt++;
+	}
+
+	pr_info("testing serial erase+write update speed\n");
+	prandom_bytes(image, (size_t)ebcnt * mtd->erasesize);
+	start_timing();
+	err = update_serial();
+	if (err)
+		goto out;
+	stop_timing();
+	speed = calc_speed();
+	pr_info("serial update speed is %ld KiB/s\n", speed);
+
+	err = verify_image();
+	if (err)
+		goto out;
+
+	pr_info("testing pipelined erase+write update speed\n");
+	prandom_bytes(image, (size_t)ebcnt * mtd->erasesize);
+	start_timing();
+	err = update_pipelined();
+	if (err)
+		goto out;
+	stop_timing();
+	speed = calc_speed();
+	pr_info("pipelined update speed is %ld KiB/s\n", speed);
+
+	err = verify_image();
+	if (err)
+		goto out;
+
+	pr_info("finished\n");
+out:
+	vfree(image);
+	kfree(readbuf);
+	kfree(bbt);
+	put_mtd_device(mtd);
+	if (err)
+		pr_info("error %d occurred\n", err);
+	printk(KERN_INFO "=================================================\n");
+	return err;
+}
+module_init(mtd_updatetest_init);
+
+static void __exit mtd_updatetest_exit(void)
+{
+	return;
+}
+module_exit(mtd_updatetest_exit);
+
+MODULE_DESCRIPTION("Update throughput test module");
+MODULE_LICENSE("GPL");
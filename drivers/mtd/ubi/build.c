@@ -84,6 +84,11 @@ static bool fm_autoconvert;
 static bool fm_debug;
 #endif
 
+/* Background wear-leveling and scrubbing budget, see 'ubi_thread()' */
+static int wl_rate;
+static int wl_burst = 8;
+static int wl_defer_depth;
+
 /* Slab cache for wear-leveling entries */
 struct kmem_cache *ubi_wl_entry_slab;
 
@@ -127,6 +132,9 @@ struct class ubi_class = {
 
 static ssize_t dev_attribute_show(struct device *dev,
 				  struct device_attribute *attr, char *buf);
+static ssize_t dev_attribute_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count);
 
 /* UBI device attributes (correspond to files in '/<sysfs>/class/ubi/ubiX') */
 static struct device_attribute dev_eraseblock_size =
@@ -153,6 +161,21 @@ static struct device_attribute dev_mtd_num =
 	__ATTR(mtd_num, S_IRUGO, dev_attribute_show, NULL);
 static struct device_attribute dev_ro_mode =
 	__ATTR(ro_mode, S_IRUGO, dev_attribute_show, NULL);
+static struct device_attribute dev_wl_rate =
+	__ATTR(wl_rate, S_IRUGO | S_IWUSR, dev_attribute_show,
+	       dev_attribute_store);
+static struct device_attribute dev_wl_burst =
+	__ATTR(wl_burst, S_IRUGO | S_IWUSR, dev_attribute_show,
+	       dev_attribute_store);
+static struct device_attribute dev_wl_defer_depth =
+	__ATTR(wl_defer_depth, S_IRUGO | S_IWUSR, dev_attribute_show,
+	       dev_attribute_store);
+static struct device_attribute dev_wl_moves =
+	__ATTR(wl_moves, S_IRUGO, dev_attribute_show, NULL);
+static struct device_attribute dev_wl_throttled =
+	__ATTR(wl_throttled, S_IRUGO, dev_attribute_show, NULL);
+static struct device_attribute dev_wl_deferred =
+	__ATTR(wl_deferred, S_IRUGO, dev_attribute_show, NULL);
 
 /**
  * ubi_volume_notify - send a volume change notification.
@@ -391,6 +414,18 @@ static ssize_t dev_attribute_show(struct device *dev,
 		ret = sprintf(buf, "%d\n", ubi->mtd->index);
 	else if (attr == &dev_ro_mode)
 		ret = sprintf(buf, "%d\n", ubi->ro_mode);
+	else if (attr == &dev_wl_rate)
+		ret = sprintf(buf, "%d\n", ubi->wl_rate);
+	else if (attr == &dev_wl_burst)
+		ret = sprintf(buf, "%d\n", ubi->wl_burst);
+	else if (attr == &dev_wl_defer_depth)
+		ret = sprintf(buf, "%d\n", ubi->wl_defer_depth);
+	else if (attr == &dev_wl_moves)
+		ret = sprintf(buf, "%lu\n", ubi->wl_bg_moves);
+	else if (attr == &dev_wl_throttled)
+		ret = sprintf(buf, "%lu\n", ubi->wl_throttled);
+	else if (attr == &dev_wl_deferred)
+		ret = sprintf(buf, "%lu\n", ubi->wl_deferred);
 	else
 		ret = -EINVAL;
 
@@ -398,6 +433,40 @@ static ssize_t dev_attribute_show(struct device *dev,
 	return ret;
 }
 
+static ssize_t dev_attribute_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	int val, err;
+	struct ubi_device *ubi;
+
+	err = kstrtoint(buf, 0, &val);
+	if (err)
+		return err;
+
+	/* See the comment in 'dev_attribute_show()' */
+	ubi = container_of(dev, struct ubi_device, dev);
+	ubi = ubi_get_device(ubi->ubi_num);
+	if (!ubi)
+		return -ENODEV;
+
+	if (attr == &dev_wl_rate && val >= 0 && val <= UBI_WL_MAX_RATE)
+		WRITE_ONCE(ubi->wl_rate, val);
+	else if (attr == &dev_wl_burst && val >= 1 && val <= UBI_WL_MAX_BURST)
+		WRITE_ONCE(ubi->wl_burst, val);
+	else if (attr == &dev_wl_defer_depth && val >= 0)
+		WRITE_ONCE(ubi->wl_defer_depth, val);
+	else
+		err = -EINVAL;
+
+	/* Let the background thread re-evaluate a held back move */
+	if (!err && ubi->bgt_thread)
+		wake_up_process(ubi->bgt_thread);
+
+	ubi_put_device(ubi);
+	return err ? err : count;
+}
+
 static struct attribute *ubi_dev_attrs[] = {
 	&dev_eraseblock_size.attr,
 	&dev_avail_eraseblocks.attr,
@@ -411,6 +480,12 @@ static struct attribute *ubi_dev_attrs[] = {
 	&dev_bgt_enabled.attr,
 	&dev_mtd_num.attr,
 	&dev_ro_mode.attr,
+	&dev_wl_rate.attr,
+	&dev_wl_burst.attr,
+	&dev_wl_defer_depth.attr,
+	&dev_wl_moves.attr,
+	&dev_wl_throttled.attr,
+	&dev_wl_deferred.attr,
 	NULL
 };
 ATTRIBUTE_GROUPS(ubi_dev);
@@ -879,6 +954,9 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num,
 	ubi->ubi_num = ubi_num;
 	ubi->vid_hdr_offset = vid_hdr_offset;
 	ubi->autoresize_vol_id = -1;
+	ubi->wl_rate = clamp(wl_rate, 0, UBI_WL_MAX_RATE);
+	ubi->wl_burst = clamp(wl_burst, 1, UBI_WL_MAX_BURST);
+	ubi->wl_defer_depth = max(wl_defer_depth, 0);
 
 #ifdef CONFIG_MTD_UBI_FASTMAP
 	ubi->fm_pool.used = ubi->fm_pool.size = 0;
@@ -1429,6 +1507,12 @@ MODULE_PARM_DESC(mtd, "MTD devices to attach. Parameter format: mtd=<name|num|pa
 		      "Example 3: mtd=/dev/mtd1,0,25 - attach MTD device /dev/mtd1 using default VID header offset and reserve 25*nand_size_in_blocks/1024 erase blocks for bad block handling.\n"
 		      "Example 4: mtd=/dev/mtd1,0,0,5 - attach MTD device /dev/mtd1 to UBI 5 and using default values for the other fields.\n"
 		      "\t(e.g. if the NAND *chipset* has 4096 PEB, 100 will be reserved for this UBI device).");
+module_param(wl_rate, int, 0644);
+MODULE_PARM_DESC(wl_rate, "Default limit of background wear-leveling and scrubbing moves per second (default: 0, no limit).");
+module_param(wl_burst, int, 0644);
+MODULE_PARM_DESC(wl_burst, "Default number of background moves which may be done back to back (default: 8).");
+module_param(wl_defer_depth, int, 0644);
+MODULE_PARM_DESC(wl_defer_depth, "Default number of in-flight LEB operations at which background moves are deferred (default: 0, never).");
 #ifdef CONFIG_MTD_UBI_FASTMAP
 module_param(fm_autoconvert, bool, 0644);
 MODULE_PARM_DESC(fm_autoconvert, "Set this parameter to enable fastmap automatically on images without a fastmap.");
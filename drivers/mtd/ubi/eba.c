@@ -315,6 +315,7 @@ static struct ubi_ltree_entry *ltree_add_entry(struct ubi_device *ubi,
 		rb_insert_color(&le->rb, &ubi->ltree);
 	}
 	le->users += 1;
+	ubi->ltree_users += 1;
 	spin_unlock(&ubi->ltree_lock);
 
 	kfree(le_free);
@@ -354,6 +355,7 @@ static void leb_read_unlock(struct ubi_device *ubi, int vol_id, int lnum)
 	spin_lock(&ubi->ltree_lock);
 	le = ltree_lookup(ubi, vol_id, lnum);
 	le->users -= 1;
+	ubi->ltree_users -= 1;
 	ubi_assert(le->users >= 0);
 	up_read(&le->mutex);
 	if (le->users == 0) {
@@ -407,6 +409,7 @@ static int leb_write_trylock(struct ubi_device *ubi, int vol_id, int lnum)
 	/* Contention, cancel */
 	spin_lock(&ubi->ltree_lock);
 	le->users -= 1;
+	ubi->ltree_users -= 1;
 	ubi_assert(le->users >= 0);
 	if (le->users == 0) {
 		rb_erase(&le->rb, &ubi->ltree);
@@ -430,6 +433,7 @@ static void leb_write_unlock(struct ubi_device *ubi, int vol_id, int lnum)
 	spin_lock(&ubi->ltree_lock);
 	le = ltree_lookup(ubi, vol_id, lnum);
 	le->users -= 1;
+	ubi->ltree_users -= 1;
 	ubi_assert(le->users >= 0);
 	up_write(&le->mutex);
 	if (le->users == 0) {
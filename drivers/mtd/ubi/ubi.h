@@ -85,6 +85,10 @@ void ubi_err(const struct ubi_device *ubi, const char *fmt, ...);
  */
 #define UBI_PROT_QUEUE_LEN 10
 
+/* Upper limits of the background wear-leveling move rate and burst */
+#define UBI_WL_MAX_RATE 10000
+#define UBI_WL_MAX_BURST 1000
+
 /* The volume ID/LEB number/erase counter is unknown */
 #define UBI_UNKNOWN -1
 
@@ -476,8 +480,10 @@ struct ubi_debug_info {
  * @mean_ec: current mean erase counter value
  *
  * @global_sqnum: global sequence number
- * @ltree_lock: protects the lock tree and @global_sqnum
+ * @ltree_lock: protects the lock tree, @ltree_users and @global_sqnum
  * @ltree: the lock tree
+ * @ltree_users: count of LEB lock holders and waiters, i.e. the depth of the
+ *		 EBA I/O queue
  * @alc_mutex: serializes "atomic LEB change" operations
  *
  * @fm_disabled: non-zero if fastmap is disabled (default)
@@ -520,6 +526,18 @@ struct ubi_debug_info {
  * @bgt_thread: background thread description object
  * @thread_enabled: if the background thread is enabled
  * @bgt_name: background thread name
+ * @wl_rate: wear-leveling and scrubbing moves per second the background thread
+ *	     may start (%0 means no limit)
+ * @wl_burst: how many moves the background thread may start back to back
+ * @wl_defer_depth: background moves are deferred while @ltree_users is at
+ *		    least this (%0 means never)
+ * @wl_tokens: background move budget, in 1/HZ of a move
+ * @wl_refill: when @wl_tokens was last refilled (jiffies)
+ * @wl_defer_start: when the pending move was first deferred (jiffies)
+ * @wl_deferring: if a background move is being deferred
+ * @wl_bg_moves: count of moves started by the background thread
+ * @wl_throttled: count of times a move waited for the budget
+ * @wl_deferred: count of times a move was deferred to foreground I/O
  *
  * @flash_size: underlying MTD device size (in bytes)
  * @peb_count: count of physical eraseblocks on the MTD device
@@ -587,6 +605,7 @@ struct ubi_device {
 	unsigned long long global_sqnum;
 	spinlock_t ltree_lock;
 	struct rb_root ltree;
+	int ltree_users;
 	struct mutex alc_mutex;
 
 	/* Fastmap stuff */
@@ -623,6 +642,16 @@ struct ubi_device {
 	struct task_struct *bgt_thread;
 	int thread_enabled;
 	char bgt_name[sizeof(UBI_BGT_NAME_PATTERN)+2];
+	int wl_rate;
+	int wl_burst;
+	int wl_defer_depth;
+	int wl_tokens;
+	unsigned long wl_refill;
+	unsigned long wl_defer_start;
+	int wl_deferring;
+	unsigned long wl_bg_moves;
+	unsigned long wl_throttled;
+	unsigned long wl_deferred;
 
 	/* I/O sub-system's stuff */
 	long long flash_size;
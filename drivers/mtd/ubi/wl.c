@@ -47,6 +47,13 @@
  * in a physical eraseblock, it has to be moved. Technically this is the same
  * as moving it for wear-leveling reasons.
  *
+ * Moves started by the background thread share the flash with foreground I/O,
+ * so they may be budgeted. A token bucket limits them to @ubi->wl_rate moves
+ * per second with bursts of up to @ubi->wl_burst moves, and they are deferred
+ * while at least @ubi->wl_defer_depth LEB operations are in flight. A held
+ * back move does not block the erase works queued behind it. Moves done
+ * synchronously on behalf of a user waiting for a free PEB are never held back.
+ *
  * As it was said, for the UBI sub-system all physical eraseblocks are either
  * "free" or "used". Free eraseblock are kept in the @wl->free RB-tree, while
  * used eraseblocks are kept in @wl->used, @wl->erroneous, or @wl->scrub
@@ -135,6 +142,14 @@
  */
 #define WL_MAX_FAILURES 32
 
+/*
+ * How often the background thread re-checks the foreground I/O queue depth
+ * while a move is deferred, and for how long a move may be deferred at most
+ * before it is started anyway.
+ */
+#define WL_DEFER_POLL msecs_to_jiffies(10)
+#define WL_MAX_DEFER msecs_to_jiffies(2000)
+
 static int self_check_ec(struct ubi_device *ubi, int pnum, int ec);
 static int self_check_in_wl_tree(const struct ubi_device *ubi,
 				 struct ubi_wl_entry *e, struct rb_root *root);
@@ -191,16 +206,76 @@ static void wl_entry_destroy(struct ubi_device *ubi, struct ubi_wl_entry *e)
 	kmem_cache_free(ubi_wl_entry_slab, e);
 }
 
+static int wear_leveling_worker(struct ubi_device *ubi, struct ubi_work *wrk,
+				int shutdown);
+
+/**
+ * wl_move_delay - check the background move budget.
+ * @ubi: UBI device description object
+ *
+ * This function is only called by the background thread. Returns zero if a
+ * wear-leveling or scrubbing move may be started now, and otherwise how many
+ * jiffies it has to be held back for.
+ */
+static long wl_move_delay(struct ubi_device *ubi)
+{
+	int rate = READ_ONCE(ubi->wl_rate);
+	int depth = READ_ONCE(ubi->wl_defer_depth);
+	unsigned long now = jiffies;
+
+	if (depth && READ_ONCE(ubi->ltree_users) >= depth) {
+		if (!ubi->wl_deferring) {
+			ubi->wl_deferring = 1;
+			ubi->wl_defer_start = now;
+			ubi->wl_deferred += 1;
+		}
+		if (time_before(now, ubi->wl_defer_start + WL_MAX_DEFER))
+			return WL_DEFER_POLL;
+	}
+
+	if (rate) {
+		u64 fill = (u64)(now - ubi->wl_refill) * rate;
+
+		ubi->wl_tokens = min_t(u64, ubi->wl_tokens + fill,
+				       READ_ONCE(ubi->wl_burst) * HZ);
+		ubi->wl_refill = now;
+		if (ubi->wl_tokens < HZ) {
+			ubi->wl_throttled += 1;
+			return DIV_ROUND_UP(HZ - ubi->wl_tokens, rate);
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * wl_move_charge - charge a background move to the budget.
+ * @ubi: UBI device description object
+ */
+static void wl_move_charge(struct ubi_device *ubi)
+{
+	ubi->wl_deferring = 0;
+	ubi->wl_bg_moves += 1;
+	ubi->wl_tokens = max(ubi->wl_tokens - HZ, 0);
+}
+
 /**
  * do_work - do one pending work.
  * @ubi: UBI device description object
+ * @bg: if called by the background thread
+ *
+ * If @bg is set and the move at the head of the queue is held back by the
+ * background move budget, the first pending work which is not a move is done
+ * instead.
  *
  * This function returns zero in case of success and a negative error code in
- * case of failure.
+ * case of failure. If only held back moves are pending, nothing is done and the
+ * number of jiffies to wait for is returned.
  */
-static int do_work(struct ubi_device *ubi)
+static int do_work(struct ubi_device *ubi, int bg)
 {
 	int err;
+	long delay;
 	struct ubi_work *wrk;
 
 	cond_resched();
@@ -220,6 +295,20 @@ static int do_work(struct ubi_device *ubi)
 	}
 
 	wrk = list_entry(ubi->works.next, struct ubi_work, list);
+	if (bg && wrk->func == wear_leveling_worker) {
+		delay = wl_move_delay(ubi);
+		if (delay) {
+			list_for_each_entry(wrk, &ubi->works, list)
+				if (wrk->func != wear_leveling_worker)
+					break;
+			if (&wrk->list == &ubi->works) {
+				spin_unlock(&ubi->wl_lock);
+				up_read(&ubi->work_sem);
+				return delay;
+			}
+		} else
+			wl_move_charge(ubi);
+	}
 	list_del(&wrk->list);
 	ubi->works_count -= 1;
 	ubi_assert(ubi->works_count >= 0);
@@ -1483,8 +1572,12 @@ int ubi_thread(void *u)
 		}
 		spin_unlock(&ubi->wl_lock);
 
-		err = do_work(ubi);
-		if (err) {
+		err = do_work(ubi, 1);
+		if (err > 0) {
+			/* Only moves held back by the budget are pending */
+			schedule_timeout_interruptible(err);
+			continue;
+		} else if (err) {
 			ubi_err(ubi, "%s: work failed with error code %d",
 				ubi->bgt_name, err);
 			if (failures++ > WL_MAX_FAILURES) {
@@ -1550,6 +1643,8 @@ int ubi_wl_init(struct ubi_device *ubi, struct ubi_attach_info *ai)
 	init_rwsem(&ubi->work_sem);
 	ubi->max_ec = ai->max_ec;
 	INIT_LIST_HEAD(&ubi->works);
+	ubi->wl_tokens = ubi->wl_burst * HZ;
+	ubi->wl_refill = jiffies;
 
 	sprintf(ubi->bgt_name, UBI_BGT_NAME_PATTERN, ubi->ubi_num);
 
@@ -1856,7 +1951,7 @@ static int produce_free_peb(struct ubi_device *ubi)
 		spin_unlock(&ubi->wl_lock);
 
 		dbg_wl("do one work synchronously");
-		err = do_work(ubi);
+		err = do_work(ubi, 0);
 
 		spin_lock(&ubi->wl_lock);
 		if (err)
@@ -84,6 +84,7 @@
 #define GEM_DMACFG		0x0010 /* DMA Configuration */
 #define GEM_PBUFRXCUT		0x0044 /* RX Partial Store and Forward */
 #define GEM_JML			0x0048 /* Jumbo Max Length */
+#define GEM_INTMOD		0x005C /* Interrupt Moderation */
 #define GEM_HRB			0x0080 /* Hash Bottom */
 #define GEM_HRT			0x0084 /* Hash Top */
 #define GEM_SA1B		0x0088 /* Specific1 Bottom */
@@ -170,6 +171,7 @@
 #define GEM_DCFG5		0x0290 /* Design Config 5 */
 #define GEM_DCFG6		0x0294 /* Design Config 6 */
 #define GEM_DCFG7		0x0298 /* Design Config 7 */
+#define GEM_DCFG8		0x029C /* Design Config 8 */
 #define GEM_TXBDCTRL	0x04cc /* TX Buffer Descriptor control register */
 #define GEM_RXBDCTRL	0x04d0 /* RX Buffer Descriptor control register */
 
@@ -177,6 +179,13 @@
 #define GEM_TBQP(hw_q)		(0x0440 + ((hw_q) << 2))
 #define GEM_TBQPH(hw_q)		(0x04C8)
 #define GEM_RBQP(hw_q)		(0x0480 + ((hw_q) << 2))
+#define GEM_RBQS(hw_q)		(0x04A0 + ((hw_q) << 2))
+#define GEM_RBQPH(hw_q)		(0x04D4)
+#define GEM_SCRT1(hw_q)		(0x0500 + ((hw_q) << 2))
+#define GEM_SCRT2(hw_q)		(0x0540 + ((hw_q) << 2))
+#define GEM_ETHT(hw_q)		(0x06E0 + ((hw_q) << 2))
+#define GEM_T2CMPW0(hw_q)	(0x0700 + ((hw_q) << 3))
+#define GEM_T2CMPW1(hw_q)	(0x0704 + ((hw_q) << 3))
 #define GEM_IER(hw_q)		(0x0600 + ((hw_q) << 2))
 #define GEM_IDR(hw_q)		(0x0620 + ((hw_q) << 2))
 #define GEM_IMR(hw_q)		(0x0640 + ((hw_q) << 2))
@@ -304,6 +313,14 @@
 #define GEM_ENCUTTHRU_OFFSET	31 /* Enable RX partial store and forward */
 #define GEM_ENCUTTHRU_SIZE	1
 
+/* Bitfields in INTMOD, delays in units of GEM_INTMOD_NSEC */
+#define GEM_RX_MOD_OFFSET	0 /* RX interrupt moderation */
+#define GEM_RX_MOD_SIZE		8
+#define GEM_TX_MOD_OFFSET	16 /* TX interrupt moderation */
+#define GEM_TX_MOD_SIZE		8
+
+#define GEM_INTMOD_NSEC		800
+
 /* Bitfields in NSR */
 #define MACB_NSR_LINK_OFFSET	0 /* pcs_link_state */
 #define MACB_NSR_LINK_SIZE	1
@@ -470,6 +487,95 @@
 #define GEM_DAW64_OFFSET			23
 #define GEM_DAW64_SIZE				1
 
+/* Bitfields in DCFG8. */
+#define GEM_T1SCR_OFFSET			24
+#define GEM_T1SCR_SIZE				8
+#define GEM_T2SCR_OFFSET			16
+#define GEM_T2SCR_SIZE				8
+#define GEM_SCR2ETH_OFFSET			8
+#define GEM_SCR2ETH_SIZE			8
+#define GEM_SCR2CMP_OFFSET			0
+#define GEM_SCR2CMP_SIZE			8
+
+/* Bitfields in SCRT1 (type 1 screeners: DS/TC and UDP port match) */
+#define GEM_SCRT1_QUEUE_OFFSET			0
+#define GEM_SCRT1_QUEUE_SIZE			4
+#define GEM_DSTC_OFFSET				4 /* IPv4 DS / IPv6 TC byte */
+#define GEM_DSTC_SIZE				8
+#define GEM_UDPPORT_OFFSET			12 /* UDP destination port */
+#define GEM_UDPPORT_SIZE			16
+#define GEM_DSTCEN_OFFSET			28
+#define GEM_DSTCEN_SIZE				1
+#define GEM_UDPPORTEN_OFFSET			29
+#define GEM_UDPPORTEN_SIZE			1
+
+/* Bitfields in SCRT2 (type 2 screeners: EtherType and compare regs) */
+#define GEM_QUEUE_OFFSET			0
+#define GEM_QUEUE_SIZE				4
+#define GEM_VLANPR_OFFSET			4
+#define GEM_VLANPR_SIZE				3
+#define GEM_VLANEN_OFFSET			8
+#define GEM_VLANEN_SIZE				1
+#define GEM_ETHT2IDX_OFFSET			9
+#define GEM_ETHT2IDX_SIZE			3
+#define GEM_ETHTEN_OFFSET			12
+#define GEM_ETHTEN_SIZE				1
+#define GEM_CMPA_OFFSET				13
+#define GEM_CMPA_SIZE				5
+#define GEM_CMPAEN_OFFSET			18
+#define GEM_CMPAEN_SIZE				1
+#define GEM_CMPB_OFFSET				19
+#define GEM_CMPB_SIZE				5
+#define GEM_CMPBEN_OFFSET			24
+#define GEM_CMPBEN_SIZE				1
+#define GEM_CMPC_OFFSET				25
+#define GEM_CMPC_SIZE				5
+#define GEM_CMPCEN_OFFSET			30
+#define GEM_CMPCEN_SIZE				1
+
+/* Bitfields in ETHT */
+#define GEM_ETHTCMP_OFFSET			0
+#define GEM_ETHTCMP_SIZE			16
+
+/* Bitfields in T2CMPW0 */
+#define GEM_T2CMP_OFFSET			16
+#define GEM_T2CMP_SIZE				16
+#define GEM_T2MASK_OFFSET			0
+#define GEM_T2MASK_SIZE				16
+
+/* Bitfields in T2CMPW1 */
+#define GEM_T2DISMSK_OFFSET			9
+#define GEM_T2DISMSK_SIZE			1
+#define GEM_T2CMPOFST_OFFSET			7
+#define GEM_T2CMPOFST_SIZE			2
+#define GEM_T2OFST_OFFSET			0
+#define GEM_T2OFST_SIZE				7
+
+/* Offset base for screener type 2 compare values (T2CMPOFST). The byte
+ * offset in T2OFST is applied after the selected point, e.g. an offset of 12
+ * from GEM_T2COMPOFST_ETYPE is the source address in an IPv4 header.
+ */
+#define GEM_T2COMPOFST_SOF			0
+#define GEM_T2COMPOFST_ETYPE			1
+#define GEM_T2COMPOFST_IPHDR			2
+#define GEM_T2COMPOFST_TCPUDP			3
+
+/* offset from EtherType to IP address */
+#define ETYPE_SRCIP_OFFSET			12
+#define ETYPE_DSTIP_OFFSET			16
+
+/* offset from IP header to port */
+#define IPHDR_SRCPORT_OFFSET			0
+#define IPHDR_DSTPORT_OFFSET			2
+
+/* Each 4-tuple flow uses one type 2 screener and three compare registers;
+ * the single EtherType register used (index 0) matches IPv4.
+ */
+#define SCRT2_ETHT				0
+#define GEM_IP4SRC_CMP(idx)			((idx) * 3)
+#define GEM_IP4DST_CMP(idx)			((idx) * 3 + 1)
+#define GEM_PORT_CMP(idx)			((idx) * 3 + 2)
+
 /* Bitfields in TISUBN */
 #define GEM_SUBNSINCR_OFFSET			0
 #define GEM_SUBNSINCR_SIZE			16
@@ -558,6 +664,7 @@
 #define MACB_CAPS_PCS				0x00000080
 #define MACB_CAPS_PARTIAL_STORE_FORWARD		0x00000100
 #define MACB_CAPS_WOL				0x00000200
+#define MACB_CAPS_INT_MODERATION		0x00000400
 #define MACB_CAPS_FIFO_MODE			0x10000000
 #define MACB_CAPS_GIGABIT_MODE_AVAILABLE	0x20000000
 #define MACB_CAPS_SG_DISABLED			0x40000000
@@ -601,6 +708,8 @@
 #define gem_writel(port, reg, value)	(port)->macb_reg_writel((port), GEM_##reg, (value))
 #define queue_readl(queue, reg)		(queue)->bp->macb_reg_readl((queue)->bp, (queue)->reg)
 #define queue_writel(queue, reg, value)	(queue)->bp->macb_reg_writel((queue)->bp, (queue)->reg, (value))
+#define gem_readl_n(port, reg, idx)		(port)->macb_reg_readl((port), GEM_##reg(idx))
+#define gem_writel_n(port, reg, idx, value)	(port)->macb_reg_writel((port), GEM_##reg(idx), (value))
 
 #define PTP_TS_BUFFER_SIZE		128 /* must be power of 2 */
 
@@ -940,11 +1049,13 @@ static const struct gem_statistic gem_statistics[] = {
 
 struct macb;
 
+struct macb_queue;
+
 struct macb_or_gem_ops {
 	int	(*mog_alloc_rx_buffers)(struct macb *bp);
 	void	(*mog_free_rx_buffers)(struct macb *bp);
 	void	(*mog_init_rings)(struct macb *bp);
-	int	(*mog_rx)(struct macb *bp, int budget);
+	int	(*mog_rx)(struct macb_queue *queue, int budget);
 };
 
 /* MACB-PTP interface: adapt to platform needs. */
@@ -971,6 +1082,39 @@ struct macb_config {
 	int	jumbo_max_len;
 };
 
+/* struct ethtool_rx_fs_item - RX flow steering rule
+ * @fs: flow specification as passed in by ethtool
+ * @t1_idx: type 1 screener used by the rule, or -1 for a type 2 screener
+ * @list: entry in macb->rx_fs_list, sorted by location
+ */
+struct ethtool_rx_fs_item {
+	struct ethtool_rx_flow_spec fs;
+	int t1_idx;
+	struct list_head list;
+};
+
+struct ethtool_rx_fs_list {
+	struct list_head list;
+	unsigned int count;
+};
+
+/* struct macb_rx_page - page backing one GEM RX buffer
+ * @page: page, or pages for jumbo buffers, holding headroom, frame data and
+ *	  room for the skb_shared_info of build_skb()
+ * @dma: mapping of the whole page, made once when the page is allocated
+ */
+struct macb_rx_page {
+	struct page	*page;
+	dma_addr_t	dma;
+};
+
+/* Software counters of the GEM RX page recycling */
+struct macb_rx_recycle_stats {
+	u64	hits;		/* buffer refilled from a recycled page */
+	u64	allocs;		/* buffer refilled with a newly mapped page */
+	u64	releases;	/* page dropped while the stack still held it */
+};
+
 struct tsu_incr {
 	u32 sub_ns;
 	u32 ns;
@@ -987,6 +1131,8 @@ struct macb_queue {
 	unsigned int		TBQP;
 	unsigned int		TBQPH;
 	unsigned int		RBQP;
+	unsigned int		RBQPH;
+	unsigned int		RBQS;
 
 	unsigned int		tx_head, tx_tail;
 	struct macb_dma_desc	*tx_ring;
@@ -994,6 +1140,21 @@ struct macb_queue {
 	dma_addr_t		tx_ring_dma;
 	struct work_struct	tx_error_task;
 
+	unsigned int		rx_tail;
+	unsigned int		rx_prepared_head;
+	struct macb_dma_desc	*rx_ring;
+	dma_addr_t		rx_ring_dma;
+	struct macb_rx_page	*rx_page;
+	void			*rx_buffers;
+	dma_addr_t		rx_buffers_dma;
+	struct napi_struct	napi;
+	unsigned long		rx_packets;	/* for adaptive moderation */
+
+	/* Pages handed up the stack, oldest at rx_recycle_tail */
+	struct macb_rx_page	*rx_recycle;
+	unsigned int		rx_recycle_head, rx_recycle_tail;
+	struct macb_rx_recycle_stats rx_recycle_stats;
+
 #ifdef CONFIG_MACB_USE_HWSTAMP
 	struct work_struct	tx_ts_task;
 	unsigned int		tx_ts_head, tx_ts_tail;
@@ -1009,13 +1170,10 @@ struct macb {
 	u32	(*macb_reg_readl)(struct macb *bp, int offset);
 	void	(*macb_reg_writel)(struct macb *bp, int offset, u32 value);
 
-	unsigned int		rx_tail;
-	unsigned int		rx_prepared_head;
-	struct macb_dma_desc	*rx_ring;
 	struct macb_dma_desc	*rx_ring_tieoff;
-	struct sk_buff		**rx_skbuff;
-	void			*rx_buffers;
 	size_t			rx_buffer_size;
+	unsigned int		rx_frag_size;
+	unsigned int		rx_page_order;
 
 	unsigned int		rx_ring_size;
 	unsigned int		tx_ring_size;
@@ -1032,15 +1190,12 @@ struct macb {
 	struct clk		*rx_clk;
 	struct clk		*tsu_clk;
 	struct net_device	*dev;
-	struct napi_struct	napi;
 	union {
 		struct macb_stats	macb;
 		struct gem_stats	gem;
 	}			hw_stats;
 
-	dma_addr_t		rx_ring_dma;
 	dma_addr_t		rx_ring_tieoff_dma;
-	dma_addr_t		rx_buffers_dma;
 
 	struct macb_or_gem_ops	macbgem_ops;
 
@@ -1084,6 +1239,24 @@ struct macb {
 	struct ptp_clock_info ptp_clock_info;
 	struct tsu_incr tsu_incr;
 	struct hwtstamp_config tstamp_config;
+
+	/* Interrupt moderation (ethtool -C). In adaptive mode the usecs
+	 * values are the ceilings and the programmed delays follow the
+	 * packet rate sampled every MACB_COAL_SAMPLE_MS.
+	 */
+	u32			rx_coalesce_usecs;
+	u32			tx_coalesce_usecs;
+	bool			adaptive_rx_coal;
+	bool			adaptive_tx_coal;
+	unsigned long		coal_stamp;
+	unsigned long		coal_last_rx;
+	unsigned long		coal_last_tx;
+
+	/* RX queue steering through the type 1/2 screeners (ethtool ntuple) */
+	struct ethtool_rx_fs_list rx_fs_list;
+	spinlock_t rx_fs_lock;
+	unsigned int max_tuples;
+	unsigned int num_t1_screeners;
 };
 
 #ifdef CONFIG_MACB_USE_HWSTAMP
@@ -42,6 +42,7 @@
 
 #define MACB_RX_BUFFER_SIZE	128
 #define RX_BUFFER_MULTIPLE	64  /* bytes */
+#define GEM_RX_HEADROOM		NET_SKB_PAD
 
 #define DEFAULT_RX_RING_SIZE	512 /* must be power of 2 */
 #define MIN_RX_RING_SIZE	64
@@ -55,6 +56,14 @@
 #define TX_RING_BYTES(bp)	(macb_dma_desc_get_size(bp)	\
 				 * (bp)->tx_ring_size)
 
+/* interrupt moderation: sampling period of the adaptive mode and the
+ * packet rate that buys one microsecond of delay
+ */
+#define MACB_COAL_SAMPLE_MS	100
+#define MACB_COAL_PPS_PER_USEC	2000
+#define GEM_INTMOD_MAX_USECS	((GENMASK(GEM_RX_MOD_SIZE - 1, 0) *	\
+				  GEM_INTMOD_NSEC) / NSEC_PER_USEC)
+
 /* level of occupied TX descriptors under which we wake up TX process */
 #define MACB_TX_WAKEUP_THRESH(bp)	(3 * (bp)->tx_ring_size / 4)
 
@@ -195,17 +204,18 @@ static unsigned int macb_rx_ring_wrap(struct macb *bp, unsigned int index)
 	return index & (bp->rx_ring_size - 1);
 }
 
-static struct macb_dma_desc *macb_rx_desc(struct macb *bp, unsigned int index)
+static struct macb_dma_desc *macb_rx_desc(struct macb_queue *queue,
+					  unsigned int index)
 {
-	index = macb_rx_ring_wrap(bp, index);
-	index = macb_adj_dma_desc_idx(bp, index);
-	return &bp->rx_ring[index];
+	index = macb_rx_ring_wrap(queue->bp, index);
+	index = macb_adj_dma_desc_idx(queue->bp, index);
+	return &queue->rx_ring[index];
 }
 
-static void *macb_rx_buffer(struct macb *bp, unsigned int index)
+static void *macb_rx_buffer(struct macb_queue *queue, unsigned int index)
 {
-	return bp->rx_buffers + bp->rx_buffer_size *
-	       macb_rx_ring_wrap(bp, index);
+	return queue->rx_buffers + queue->bp->rx_buffer_size *
+	       macb_rx_ring_wrap(queue->bp, index);
 }
 
 /* I/O accessors */
@@ -745,21 +755,6 @@ static void macb_set_addr(struct macb *bp, struct macb_dma_desc *desc, dma_addr_
 	desc->addr = lower_32_bits(addr);
 }
 
-static dma_addr_t macb_get_addr(struct macb *bp, struct macb_dma_desc *desc)
-{
-	dma_addr_t addr = 0;
-#ifdef CONFIG_ARCH_DMA_ADDR_T_64BIT
-	struct macb_dma_desc_64 *desc_64;
-
-	if (bp->hw_dma_cap & HW_DMA_CAP_64B) {
-		desc_64 = macb_64b_desc(bp, desc);
-		addr = ((u64)(desc_64->addrh) << 32);
-	}
-#endif
-	addr |= MACB_BF(RX_WADDR, MACB_BFEXT(RX_WADDR, desc->addr));
-	return addr;
-}
-
 static void macb_tx_error_task(struct work_struct *work)
 {
 	struct macb_queue	*queue = container_of(work, struct macb_queue,
@@ -856,6 +851,8 @@ static void macb_tx_error_task(struct work_struct *work)
 	/* Make TX ring reflect state of hardware */
 	queue->tx_head = 0;
 	queue->tx_tail = 0;
+	netdev_tx_reset_queue(netdev_get_tx_queue(bp->dev,
+						  queue - bp->queues));
 
 	/* Housework before enabling TX IRQ */
 	macb_writel(bp, TSR, macb_readl(bp, TSR));
@@ -868,6 +865,54 @@ static void macb_tx_error_task(struct work_struct *work)
 	spin_unlock_irqrestore(&bp->lock, flags);
 }
 
+static void gem_write_intmod(struct macb *bp, u32 rx_usecs, u32 tx_usecs)
+{
+	u32 rx = DIV_ROUND_UP(rx_usecs * NSEC_PER_USEC, GEM_INTMOD_NSEC);
+	u32 tx = DIV_ROUND_UP(tx_usecs * NSEC_PER_USEC, GEM_INTMOD_NSEC);
+
+	gem_writel(bp, INTMOD, GEM_BF(RX_MOD, min_t(u32, rx, 0xff)) |
+			       GEM_BF(TX_MOD, min_t(u32, tx, 0xff)));
+}
+
+/* Scale the moderation delays with the packet rate: no delay while the
+ * link is quiet, up to the configured ceilings under load. Called from RX
+ * NAPI and from TX completion, on any queue; whichever moves coal_stamp
+ * forward does the update.
+ */
+static void gem_adapt_coalesce(struct macb *bp)
+{
+	unsigned long stamp = READ_ONCE(bp->coal_stamp);
+	unsigned long now = jiffies;
+	unsigned long rx = 0, tx, elapsed;
+	u32 rx_usecs, tx_usecs;
+	unsigned int q;
+
+	if (!time_after(now, stamp + msecs_to_jiffies(MACB_COAL_SAMPLE_MS)))
+		return;
+	if (cmpxchg(&bp->coal_stamp, stamp, now) != stamp)
+		return;
+
+	for (q = 0; q < bp->num_queues; q++)
+		rx += READ_ONCE(bp->queues[q].rx_packets);
+	tx = READ_ONCE(bp->dev->stats.tx_packets);
+	elapsed = jiffies_to_msecs(now - stamp);
+
+	rx_usecs = bp->rx_coalesce_usecs;
+	if (bp->adaptive_rx_coal)
+		rx_usecs = min_t(unsigned long, rx_usecs,
+				 (rx - bp->coal_last_rx) * MSEC_PER_SEC /
+				 elapsed / MACB_COAL_PPS_PER_USEC);
+	tx_usecs = bp->tx_coalesce_usecs;
+	if (bp->adaptive_tx_coal)
+		tx_usecs = min_t(unsigned long, tx_usecs,
+				 (tx - bp->coal_last_tx) * MSEC_PER_SEC /
+				 elapsed / MACB_COAL_PPS_PER_USEC);
+
+	bp->coal_last_rx = rx;
+	bp->coal_last_tx = tx;
+	gem_write_intmod(bp, rx_usecs, tx_usecs);
+}
+
 static void macb_tx_interrupt(struct macb_queue *queue)
 {
 	unsigned int tail;
@@ -875,6 +920,7 @@ static void macb_tx_interrupt(struct macb_queue *queue)
 	u32 status;
 	struct macb *bp = queue->bp;
 	u16 queue_index = queue - bp->queues;
+	unsigned int packets = 0, bytes = 0;
 
 	status = macb_readl(bp, TSR);
 	macb_writel(bp, TSR, status);
@@ -923,6 +969,8 @@ static void macb_tx_interrupt(struct macb_queue *queue)
 					    skb->data);
 				bp->dev->stats.tx_packets++;
 				bp->dev->stats.tx_bytes += skb->len;
+				packets++;
+				bytes += skb->len;
 			}
 
 			/* Now we can safely release resources */
@@ -938,77 +986,163 @@ static void macb_tx_interrupt(struct macb_queue *queue)
 	}
 
 	queue->tx_tail = tail;
+	netdev_tx_completed_queue(netdev_get_tx_queue(bp->dev, queue_index),
+				  packets, bytes);
 	if (__netif_subqueue_stopped(bp->dev, queue_index) &&
 	    CIRC_CNT(queue->tx_head, queue->tx_tail,
 		     bp->tx_ring_size) <= MACB_TX_WAKEUP_THRESH(bp))
 		netif_wake_subqueue(bp->dev, queue_index);
+
+	/* TX-only traffic never enters RX NAPI */
+	if (bp->adaptive_rx_coal || bp->adaptive_tx_coal)
+		gem_adapt_coalesce(bp);
+}
+
+static void gem_rx_release_page(struct macb *bp, struct macb_rx_page *rx_page)
+{
+	dma_unmap_page_attrs(&bp->pdev->dev, rx_page->dma,
+			     PAGE_SIZE << bp->rx_page_order, DMA_FROM_DEVICE,
+			     DMA_ATTR_SKIP_CPU_SYNC);
+	put_page(rx_page->page);
+	rx_page->page = NULL;
+}
+
+/* Keep a reference on a page handed up the stack so that it can back a new
+ * RX buffer, still mapped, once the stack has released it.
+ */
+static void gem_rx_recycle_page(struct macb_queue *queue,
+				struct macb_rx_page *rx_page)
+{
+	struct macb *bp = queue->bp;
+	struct macb_rx_page *slot;
+
+	/* Emergency reserve pages go back to the allocator with the skb */
+	if (unlikely(page_is_pfmemalloc(rx_page->page))) {
+		dma_unmap_page_attrs(&bp->pdev->dev, rx_page->dma,
+				     PAGE_SIZE << bp->rx_page_order,
+				     DMA_FROM_DEVICE, DMA_ATTR_SKIP_CPU_SYNC);
+		rx_page->page = NULL;
+		return;
+	}
+
+	if (!CIRC_SPACE(queue->rx_recycle_head, queue->rx_recycle_tail,
+			bp->rx_ring_size)) {
+		slot = &queue->rx_recycle[macb_rx_ring_wrap(bp,
+						queue->rx_recycle_tail)];
+		gem_rx_release_page(bp, slot);
+		queue->rx_recycle_tail++;
+		queue->rx_recycle_stats.releases++;
+	}
+
+	page_ref_inc(rx_page->page);
+	queue->rx_recycle[macb_rx_ring_wrap(bp, queue->rx_recycle_head)] =
+		*rx_page;
+	queue->rx_recycle_head++;
+	rx_page->page = NULL;
 }
 
-static void gem_rx_refill(struct macb *bp)
+static int gem_rx_get_page(struct macb_queue *queue,
+			   struct macb_rx_page *rx_page)
+{
+	struct macb *bp = queue->bp;
+	struct macb_rx_page *slot;
+	struct page *page;
+	dma_addr_t paddr;
+
+	/* Reuse the oldest page once the stack has dropped its references */
+	if (CIRC_CNT(queue->rx_recycle_head, queue->rx_recycle_tail,
+		     bp->rx_ring_size)) {
+		slot = &queue->rx_recycle[macb_rx_ring_wrap(bp,
+						queue->rx_recycle_tail)];
+		if (page_ref_count(slot->page) == 1) {
+			*rx_page = *slot;
+			slot->page = NULL;
+			queue->rx_recycle_tail++;
+			queue->rx_recycle_stats.hits++;
+
+			dma_sync_single_range_for_device(&bp->pdev->dev,
+							 rx_page->dma,
+							 GEM_RX_HEADROOM,
+							 bp->rx_buffer_size,
+							 DMA_FROM_DEVICE);
+			return 0;
+		}
+	}
+
+	page = dev_alloc_pages(bp->rx_page_order);
+	if (unlikely(!page))
+		return -ENOMEM;
+
+	paddr = dma_map_page(&bp->pdev->dev, page, 0,
+			     PAGE_SIZE << bp->rx_page_order, DMA_FROM_DEVICE);
+	if (dma_mapping_error(&bp->pdev->dev, paddr)) {
+		__free_pages(page, bp->rx_page_order);
+		return -ENOMEM;
+	}
+
+	rx_page->page = page;
+	rx_page->dma = paddr;
+	queue->rx_recycle_stats.allocs++;
+
+	return 0;
+}
+
+static void gem_rx_refill(struct macb_queue *queue)
 {
 	unsigned int		entry;
-	struct sk_buff		*skb;
+	struct macb_rx_page	*rx_page;
 	dma_addr_t		paddr;
+	struct macb *bp = queue->bp;
 	struct macb_dma_desc *desc;
 
-	while (CIRC_SPACE(bp->rx_prepared_head, bp->rx_tail,
+	while (CIRC_SPACE(queue->rx_prepared_head, queue->rx_tail,
 			  bp->rx_ring_size) > 0) {
-		entry = macb_rx_ring_wrap(bp, bp->rx_prepared_head);
+		entry = macb_rx_ring_wrap(bp, queue->rx_prepared_head);
 
 		/* Make hw descriptor updates visible to CPU */
 		rmb();
 
-		bp->rx_prepared_head++;
-		desc = macb_rx_desc(bp, entry);
+		desc = macb_rx_desc(queue, entry);
+		rx_page = &queue->rx_page[entry];
 
-		if (!bp->rx_skbuff[entry]) {
-			/* allocate sk_buff for this free entry in ring */
-			skb = netdev_alloc_skb(bp->dev, bp->rx_buffer_size);
-			if (unlikely(!skb)) {
+		if (!rx_page->page) {
+			/* attach a page to this free entry in ring */
+			if (unlikely(gem_rx_get_page(queue, rx_page))) {
 				netdev_err(bp->dev,
-					   "Unable to allocate sk_buff\n");
+					   "Unable to allocate RX page\n");
 				break;
 			}
 
 			/* now fill corresponding descriptor entry */
-			paddr = dma_map_single(&bp->pdev->dev, skb->data,
-					       bp->rx_buffer_size,
-					       DMA_FROM_DEVICE);
-			if (dma_mapping_error(&bp->pdev->dev, paddr)) {
-				dev_kfree_skb(skb);
-				break;
-			}
-
-			bp->rx_skbuff[entry] = skb;
-
+			paddr = rx_page->dma + GEM_RX_HEADROOM;
 			if (entry == bp->rx_ring_size - 1)
 				paddr |= MACB_BIT(RX_WRAP);
 			macb_set_addr(bp, desc, paddr);
 			desc->ctrl = 0;
-
-			/* properly align Ethernet header */
-			skb_reserve(skb, NET_IP_ALIGN);
 		} else {
 			desc->addr &= ~MACB_BIT(RX_USED);
 			desc->ctrl = 0;
 		}
+
+		queue->rx_prepared_head++;
 	}
 
 	/* Make descriptor updates visible to hardware */
 	wmb();
 
-	netdev_vdbg(bp->dev, "rx ring: prepared head %d, tail %d\n",
-		    bp->rx_prepared_head, bp->rx_tail);
+	netdev_vdbg(bp->dev, "rx ring: queue: %u, prepared head %d, tail %d\n",
+		    (unsigned int)(queue - bp->queues),
+		    queue->rx_prepared_head, queue->rx_tail);
 }
 
 /* Mark DMA descriptors from begin up to and not including end as unused */
-static void discard_partial_frame(struct macb *bp, unsigned int begin,
+static void discard_partial_frame(struct macb_queue *queue, unsigned int begin,
 				  unsigned int end)
 {
 	unsigned int frag;
 
 	for (frag = begin; frag != end; frag++) {
-		struct macb_dma_desc *desc = macb_rx_desc(bp, frag);
+		struct macb_dma_desc *desc = macb_rx_desc(queue, frag);
 
 		desc->addr &= ~MACB_BIT(RX_USED);
 	}
@@ -1031,34 +1165,34 @@ static int macb_validate_hw_csum(struct sk_buff *skb)
 	return (pkt_csum != csum);
 }
 
-static int gem_rx(struct macb *bp, int budget)
+static int gem_rx(struct macb_queue *queue, int budget)
 {
+	struct macb		*bp = queue->bp;
 	unsigned int		len;
 	unsigned int		entry;
 	struct sk_buff		*skb;
 	struct macb_dma_desc	*desc;
+	struct macb_rx_page	*rx_page;
 	int			count = 0;
 
 	while (count < budget) {
 		u32 ctrl;
-		dma_addr_t addr;
 		bool rxused;
 
-		entry = macb_rx_ring_wrap(bp, bp->rx_tail);
+		entry = macb_rx_ring_wrap(bp, queue->rx_tail);
 
-		desc = macb_rx_desc(bp, entry);
+		desc = macb_rx_desc(queue, entry);
 
 		/* Make hw descriptor updates visible to CPU */
 		rmb();
 
 		rxused = (desc->addr & MACB_BIT(RX_USED)) ? true : false;
-		addr = macb_get_addr(bp, desc);
 		ctrl = desc->ctrl;
 
 		if (!rxused)
 			break;
 
-		bp->rx_tail++;
+		queue->rx_tail++;
 		count++;
 
 		if (!(ctrl & MACB_BIT(RX_SOF) && ctrl & MACB_BIT(RX_EOF))) {
@@ -1067,30 +1201,47 @@ static int gem_rx(struct macb *bp, int budget)
 			bp->dev->stats.rx_dropped++;
 			break;
 		}
-		skb = bp->rx_skbuff[entry];
-		if (unlikely(!skb)) {
+		rx_page = &queue->rx_page[entry];
+		if (unlikely(!rx_page->page)) {
 			netdev_err(bp->dev,
 				   "inconsistent Rx descriptor chain\n");
 			bp->dev->stats.rx_dropped++;
 			break;
 		}
-		/* now everything is ready for receiving packet */
-		bp->rx_skbuff[entry] = NULL;
 		len = ctrl & bp->rx_frm_len_mask;
 
-		netdev_vdbg(bp->dev, "gem_rx %u (len %u)\n", entry, len);
+		netdev_vdbg(bp->dev, "gem_rx q%u %u (len %u)\n",
+			    (unsigned int)(queue - bp->queues), entry, len);
+
+		/* Only the received bytes need to be made visible to the
+		 * CPU; the page stays mapped for its next use.
+		 */
+		dma_sync_single_range_for_cpu(&bp->pdev->dev, rx_page->dma,
+					      GEM_RX_HEADROOM,
+					      NET_IP_ALIGN + len,
+					      DMA_FROM_DEVICE);
 
+		skb = build_skb(page_address(rx_page->page), bp->rx_frag_size);
+		if (unlikely(!skb)) {
+			/* leave the page in place, refill rearms it */
+			bp->dev->stats.rx_dropped++;
+			continue;
+		}
+		skb_reserve(skb, GEM_RX_HEADROOM + NET_IP_ALIGN);
 		skb_put(skb, len);
-		dma_unmap_single(&bp->pdev->dev, addr,
-				 bp->rx_buffer_size, DMA_FROM_DEVICE);
+
+		/* now everything is ready for receiving packet */
+		gem_rx_recycle_page(queue, rx_page);
 
 		skb->protocol = eth_type_trans(skb, bp->dev);
+		skb_record_rx_queue(skb, queue - bp->queues);
 
 		/* Validate MAC fcs if RX checsum offload disabled */
 		if (!(bp->dev->features & NETIF_F_RXCSUM)) {
 			if (macb_validate_hw_csum(skb)) {
 				netdev_err(bp->dev, "incorrect FCS\n");
 				bp->dev->stats.rx_dropped++;
+				dev_kfree_skb_any(skb);
 				break;
 			}
 		}
@@ -1118,12 +1269,12 @@ static int gem_rx(struct macb *bp, int budget)
 		netif_receive_skb(skb);
 	}
 
-	gem_rx_refill(bp);
+	gem_rx_refill(queue);
 
 	return count;
 }
 
-static int macb_rx_frame(struct macb *bp, unsigned int first_frag,
+static int macb_rx_frame(struct macb_queue *queue, unsigned int first_frag,
 			 unsigned int last_frag)
 {
 	unsigned int len;
@@ -1131,8 +1282,9 @@ static int macb_rx_frame(struct macb *bp, unsigned int first_frag,
 	unsigned int offset;
 	struct sk_buff *skb;
 	struct macb_dma_desc *desc;
+	struct macb *bp = queue->bp;
 
-	desc = macb_rx_desc(bp, last_frag);
+	desc = macb_rx_desc(queue, last_frag);
 	len = desc->ctrl & bp->rx_frm_len_mask;
 
 	netdev_vdbg(bp->dev, "macb_rx_frame frags %u - %u (len %u)\n",
@@ -1151,7 +1303,7 @@ static int macb_rx_frame(struct macb *bp, unsigned int first_frag,
 	if (!skb) {
 		bp->dev->stats.rx_dropped++;
 		for (frag = first_frag; ; frag++) {
-			desc = macb_rx_desc(bp, frag);
+			desc = macb_rx_desc(queue, frag);
 			desc->addr &= ~MACB_BIT(RX_USED);
 			if (frag == last_frag)
 				break;
@@ -1179,10 +1331,10 @@ static int macb_rx_frame(struct macb *bp, unsigned int first_frag,
 			frag_len = len - offset;
 		}
 		skb_copy_to_linear_data_offset(skb, offset,
-					       macb_rx_buffer(bp, frag),
+					       macb_rx_buffer(queue, frag),
 					       frag_len);
 		offset += bp->rx_buffer_size;
-		desc = macb_rx_desc(bp, frag);
+		desc = macb_rx_desc(queue, frag);
 		desc->addr &= ~MACB_BIT(RX_USED);
 
 		if (frag == last_frag)
@@ -1217,32 +1369,34 @@ static int macb_rx_frame(struct macb *bp, unsigned int first_frag,
 	return 0;
 }
 
-static inline void macb_init_rx_ring(struct macb *bp)
+static inline void macb_init_rx_ring(struct macb_queue *queue)
 {
+	struct macb *bp = queue->bp;
 	dma_addr_t addr;
 	struct macb_dma_desc *desc = NULL;
 	int i;
 
-	addr = bp->rx_buffers_dma;
+	addr = queue->rx_buffers_dma;
 	for (i = 0; i < bp->rx_ring_size; i++) {
-		desc = macb_rx_desc(bp, i);
+		desc = macb_rx_desc(queue, i);
 		macb_set_addr(bp, desc, addr);
 		desc->ctrl = 0;
 		addr += bp->rx_buffer_size;
 	}
 	desc->addr |= MACB_BIT(RX_WRAP);
-	bp->rx_tail = 0;
+	queue->rx_tail = 0;
 }
 
-static int macb_rx(struct macb *bp, int budget)
+static int macb_rx(struct macb_queue *queue, int budget)
 {
+	struct macb *bp = queue->bp;
 	bool reset_rx_queue = false;
 	int received = 0;
 	unsigned int tail;
 	int first_frag = -1;
 
-	for (tail = bp->rx_tail; budget > 0; tail++) {
-		struct macb_dma_desc *desc = macb_rx_desc(bp, tail);
+	for (tail = queue->rx_tail; budget > 0; tail++) {
+		struct macb_dma_desc *desc = macb_rx_desc(queue, tail);
 		u32 ctrl;
 
 		/* Make hw descriptor updates visible to CPU */
@@ -1255,7 +1409,7 @@ static int macb_rx(struct macb *bp, int budget)
 
 		if (ctrl & MACB_BIT(RX_SOF)) {
 			if (first_frag != -1)
-				discard_partial_frame(bp, first_frag, tail);
+				discard_partial_frame(queue, first_frag, tail);
 			first_frag = tail;
 		}
 
@@ -1267,7 +1421,7 @@ static int macb_rx(struct macb *bp, int budget)
 				continue;
 			}
 
-			dropped = macb_rx_frame(bp, first_frag, tail);
+			dropped = macb_rx_frame(queue, first_frag, tail);
 			first_frag = -1;
 			if (unlikely(dropped < 0)) {
 				reset_rx_queue = true;
@@ -1291,8 +1445,8 @@ static int macb_rx(struct macb *bp, int budget)
 		ctrl = macb_readl(bp, NCR);
 		macb_writel(bp, NCR, ctrl & ~MACB_BIT(RE));
 
-		macb_init_rx_ring(bp);
-		macb_writel(bp, RBQP, bp->rx_ring_dma);
+		macb_init_rx_ring(queue);
+		queue_writel(queue, RBQP, queue->rx_ring_dma);
 
 		macb_writel(bp, NCR, ctrl | MACB_BIT(RE));
 
@@ -1301,16 +1455,17 @@ static int macb_rx(struct macb *bp, int budget)
 	}
 
 	if (first_frag != -1)
-		bp->rx_tail = first_frag;
+		queue->rx_tail = first_frag;
 	else
-		bp->rx_tail = tail;
+		queue->rx_tail = tail;
 
 	return received;
 }
 
 static int macb_poll(struct napi_struct *napi, int budget)
 {
-	struct macb *bp = container_of(napi, struct macb, napi);
+	struct macb_queue *queue = container_of(napi, struct macb_queue, napi);
+	struct macb *bp = queue->bp;
 	int work_done;
 	u32 status;
 
@@ -1319,10 +1474,14 @@ static int macb_poll(struct napi_struct *napi, int budget)
 
 	work_done = 0;
 
-	netdev_vdbg(bp->dev, "poll: status = %08lx, budget = %d\n",
+	netdev_vdbg(bp->dev, "poll: queue = %u, status = %08lx, budget = %d\n",
+		    (unsigned int)(queue - bp->queues),
 		    (unsigned long)status, budget);
 
-	work_done = bp->macbgem_ops.mog_rx(bp, budget);
+	work_done = bp->macbgem_ops.mog_rx(queue, budget);
+	queue->rx_packets += work_done;
+	if (bp->adaptive_rx_coal || bp->adaptive_tx_coal)
+		gem_adapt_coalesce(bp);
 	if (work_done < budget) {
 		napi_complete_done(napi, work_done);
 
@@ -1330,10 +1489,10 @@ static int macb_poll(struct napi_struct *napi, int budget)
 		status = macb_readl(bp, RSR);
 		if (status) {
 			if (bp->caps & MACB_CAPS_ISR_CLEAR_ON_WRITE)
-				macb_writel(bp, ISR, MACB_BIT(RCOMP));
+				queue_writel(queue, ISR, MACB_BIT(RCOMP));
 			napi_reschedule(napi);
 		} else {
-			macb_writel(bp, IER, MACB_RX_INT_FLAGS);
+			queue_writel(queue, IER, MACB_RX_INT_FLAGS);
 		}
 	}
 
@@ -1364,25 +1523,18 @@ static void macb_hresp_error_task(unsigned long data)
 
 	bp->macbgem_ops.mog_init_rings(bp);
 
-	macb_writel(bp, RBQP, lower_32_bits(bp->rx_ring_dma));
+	for (q = 0, queue = bp->queues; q < bp->num_queues; ++q, ++queue) {
+		queue_writel(queue, RBQP, lower_32_bits(queue->rx_ring_dma));
 #ifdef CONFIG_ARCH_DMA_ADDR_T_64BIT
-	if (bp->hw_dma_cap & HW_DMA_CAP_64B)
-		macb_writel(bp, RBQPH, upper_32_bits(bp->rx_ring_dma));
+		if (bp->hw_dma_cap & HW_DMA_CAP_64B)
+			queue_writel(queue, RBQPH,
+				     upper_32_bits(queue->rx_ring_dma));
 #endif
-	for (q = 0, queue = bp->queues; q < bp->num_queues; ++q, ++queue) {
 		queue_writel(queue, TBQP, lower_32_bits(queue->tx_ring_dma));
 #ifdef CONFIG_ARCH_DMA_ADDR_T_64BIT
 		if (bp->hw_dma_cap & HW_DMA_CAP_64B)
 			queue_writel(queue, TBQPH, upper_32_bits(queue->tx_ring_dma));
 #endif
-		/* We only use the first queue at the moment. Remaining
-		 * queues must be tied-off before we enable the receiver.
-		 *
-		 * See the documentation for receive_q1_ptr for more info.
-		 */
-		if (q)
-			queue_writel(queue, RBQP,
-				     lower_32_bits(bp->rx_ring_tieoff_dma));
 
 		/* Enable interrupts */
 		queue_writel(queue, IER,
@@ -1442,9 +1594,9 @@ static irqreturn_t macb_interrupt(int irq, void *dev_id)
 			if (bp->caps & MACB_CAPS_ISR_CLEAR_ON_WRITE)
 				queue_writel(queue, ISR, MACB_BIT(RCOMP));
 
-			if (napi_schedule_prep(&bp->napi)) {
+			if (napi_schedule_prep(&queue->napi)) {
 				netdev_vdbg(bp->dev, "scheduling RX softirq\n");
-				__napi_schedule(&bp->napi);
+				__napi_schedule(&queue->napi);
 			}
 		}
 
@@ -1704,6 +1856,10 @@ static netdev_features_t macb_features_check(struct sk_buff *skb,
 
 	/* Validate LSO compatibility */
 
+	/* only segmented frames are constrained */
+	if (!skb_is_gso(skb))
+		return features;
+
 	/* there is only one buffer */
 	if (!skb_is_nonlinear(skb))
 		return features;
@@ -1713,6 +1869,12 @@ static netdev_features_t macb_features_check(struct sk_buff *skb,
 	if (ip_hdr(skb)->protocol == IPPROTO_TCP)
 		hdrlen += tcp_hdrlen(skb);
 
+	/* The header descriptor is built from the linear part: let the
+	 * stack segment frames whose headers spill into the fragments.
+	 */
+	if (skb_headlen(skb) < hdrlen)
+		return features & ~MACB_NETIF_LSO;
+
 	/* For LSO:
 	 * When software supplies two or more payload buffers all payload buffers
 	 * apart from the last must be a multiple of 8 bytes in size.
@@ -1755,10 +1917,12 @@ static int macb_start_xmit(struct sk_buff *skb, struct net_device *dev)
 	u16 queue_index = skb_get_queue_mapping(skb);
 	struct macb *bp = netdev_priv(dev);
 	struct macb_queue *queue = &bp->queues[queue_index];
+	struct netdev_queue *txq = netdev_get_tx_queue(dev, queue_index);
 	unsigned long flags;
 	unsigned int desc_cnt, nr_frags, frag_size, f;
 	unsigned int hdrlen;
 	bool is_lso, is_udp = 0;
+	bool xmit_more = skb->xmit_more;
 
 	is_lso = (skb_shinfo(skb)->gso_size != 0);
 
@@ -1809,6 +1973,8 @@ static int macb_start_xmit(struct sk_buff *skb, struct net_device *dev)
 	if (CIRC_SPACE(queue->tx_head, queue->tx_tail,
 		       bp->tx_ring_size) < desc_cnt) {
 		netif_stop_subqueue(dev, queue_index);
+		/* Kick off frames whose doorbell was deferred by xmit_more */
+		macb_writel(bp, NCR, macb_readl(bp, NCR) | MACB_BIT(TSTART));
 		spin_unlock_irqrestore(&bp->lock, flags);
 		netdev_dbg(bp->dev, "tx_head = %u, tx_tail = %u\n",
 			   queue->tx_head, queue->tx_tail);
@@ -1817,25 +1983,30 @@ static int macb_start_xmit(struct sk_buff *skb, struct net_device *dev)
 
 	if (macb_clear_csum(skb)) {
 		dev_kfree_skb_any(skb);
-		goto unlock;
+		goto kick;
 	}
 
 	/* Map socket buffer for DMA transfer */
 	if (!macb_tx_map(bp, queue, skb, hdrlen)) {
 		dev_kfree_skb_any(skb);
-		goto unlock;
+		goto kick;
 	}
 
 	/* Make newly initialized descriptor visible to hardware */
 	wmb();
 	skb_tx_timestamp(skb);
-
-	macb_writel(bp, NCR, macb_readl(bp, NCR) | MACB_BIT(TSTART));
+	netdev_tx_sent_queue(txq, skb->len);
 
 	if (CIRC_SPACE(queue->tx_head, queue->tx_tail, bp->tx_ring_size) < 1)
 		netif_stop_subqueue(dev, queue_index);
 
-unlock:
+kick:
+	/* Ring the doorbell once for a burst of frames, and always when
+	 * the queue stops so that nothing is left waiting in the ring.
+	 */
+	if (!xmit_more || netif_xmit_stopped(txq))
+		macb_writel(bp, NCR, macb_readl(bp, NCR) | MACB_BIT(TSTART));
+
 	spin_unlock_irqrestore(&bp->lock, flags);
 
 	return NETDEV_TX_OK;
@@ -1855,6 +2026,14 @@ static void macb_init_rx_buffer_size(struct macb *bp, size_t size)
 			bp->rx_buffer_size =
 				roundup(bp->rx_buffer_size, RX_BUFFER_MULTIPLE);
 		}
+
+		/* Each buffer lives in its own page(s) with room in front
+		 * for the stack and behind for build_skb()'s shared info.
+		 */
+		bp->rx_frag_size =
+			SKB_DATA_ALIGN(GEM_RX_HEADROOM + bp->rx_buffer_size) +
+			SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
+		bp->rx_page_order = get_order(bp->rx_frag_size);
 	}
 
 	netdev_dbg(bp->dev, "mtu [%u] rx_buffer_size [%zu]\n",
@@ -1863,40 +2042,44 @@ static void macb_init_rx_buffer_size(struct macb *bp, size_t size)
 
 static void gem_free_rx_buffers(struct macb *bp)
 {
-	struct sk_buff		*skb;
-	struct macb_dma_desc	*desc;
-	dma_addr_t		addr;
+	struct macb_queue *queue;
+	unsigned int q;
 	int i;
 
-	if (!bp->rx_skbuff)
-		return;
-
-	for (i = 0; i < bp->rx_ring_size; i++) {
-		skb = bp->rx_skbuff[i];
+	for (q = 0, queue = bp->queues; q < bp->num_queues; ++q, ++queue) {
+		if (queue->rx_page) {
+			for (i = 0; i < bp->rx_ring_size; i++) {
+				if (queue->rx_page[i].page)
+					gem_rx_release_page(bp,
+							    &queue->rx_page[i]);
+			}
 
-		if (!skb)
-			continue;
+			kfree(queue->rx_page);
+			queue->rx_page = NULL;
+		}
 
-		desc = macb_rx_desc(bp, i);
-		addr = macb_get_addr(bp, desc);
+		if (queue->rx_recycle) {
+			while (queue->rx_recycle_tail != queue->rx_recycle_head) {
+				i = macb_rx_ring_wrap(bp, queue->rx_recycle_tail);
+				gem_rx_release_page(bp, &queue->rx_recycle[i]);
+				queue->rx_recycle_tail++;
+			}
 
-		dma_unmap_single(&bp->pdev->dev, addr, bp->rx_buffer_size,
-				 DMA_FROM_DEVICE);
-		dev_kfree_skb_any(skb);
-		skb = NULL;
+			kfree(queue->rx_recycle);
+			queue->rx_recycle = NULL;
+		}
 	}
-
-	kfree(bp->rx_skbuff);
-	bp->rx_skbuff = NULL;
 }
 
 static void macb_free_rx_buffers(struct macb *bp)
 {
-	if (bp->rx_buffers) {
+	struct macb_queue *queue = &bp->queues[0];
+
+	if (queue->rx_buffers) {
 		dma_free_coherent(&bp->pdev->dev,
 				  bp->rx_ring_size * bp->rx_buffer_size,
-				  bp->rx_buffers, bp->rx_buffers_dma);
-		bp->rx_buffers = NULL;
+				  queue->rx_buffers, queue->rx_buffers_dma);
+		queue->rx_buffers = NULL;
 	}
 }
 
@@ -1906,11 +2089,6 @@ static void macb_free_consistent(struct macb *bp)
 	unsigned int q;
 
 	bp->macbgem_ops.mog_free_rx_buffers(bp);
-	if (bp->rx_ring) {
-		dma_free_coherent(&bp->pdev->dev, RX_RING_BYTES(bp),
-				  bp->rx_ring, bp->rx_ring_dma);
-		bp->rx_ring = NULL;
-	}
 
 	if (bp->rx_ring_tieoff) {
 		dma_free_coherent(&bp->pdev->dev, macb_dma_desc_get_size(bp),
@@ -1926,37 +2104,54 @@ static void macb_free_consistent(struct macb *bp)
 					  queue->tx_ring, queue->tx_ring_dma);
 			queue->tx_ring = NULL;
 		}
+		if (queue->rx_ring) {
+			dma_free_coherent(&bp->pdev->dev, RX_RING_BYTES(bp),
+					  queue->rx_ring, queue->rx_ring_dma);
+			queue->rx_ring = NULL;
+		}
 	}
 }
 
 static int gem_alloc_rx_buffers(struct macb *bp)
 {
+	struct macb_queue *queue;
+	unsigned int q;
 	int size;
 
-	size = bp->rx_ring_size * sizeof(struct sk_buff *);
-	bp->rx_skbuff = kzalloc(size, GFP_KERNEL);
-	if (!bp->rx_skbuff)
-		return -ENOMEM;
-	else
+	for (q = 0, queue = bp->queues; q < bp->num_queues; ++q, ++queue) {
+		size = bp->rx_ring_size * sizeof(struct macb_rx_page);
+		queue->rx_page = kzalloc(size, GFP_KERNEL);
+		if (!queue->rx_page)
+			return -ENOMEM;
+
+		queue->rx_recycle = kzalloc(size, GFP_KERNEL);
+		if (!queue->rx_recycle)
+			return -ENOMEM;
+		queue->rx_recycle_head = 0;
+		queue->rx_recycle_tail = 0;
+
 		netdev_dbg(bp->dev,
-			   "Allocated %d RX struct sk_buff entries at %p\n",
-			   bp->rx_ring_size, bp->rx_skbuff);
+			   "Allocated %d RX page entries for queue %u at %p\n",
+			   bp->rx_ring_size, q, queue->rx_page);
+	}
 	return 0;
 }
 
 static int macb_alloc_rx_buffers(struct macb *bp)
 {
+	struct macb_queue *queue = &bp->queues[0];
 	int size;
 
 	size = bp->rx_ring_size * bp->rx_buffer_size;
-	bp->rx_buffers = dma_alloc_coherent(&bp->pdev->dev, size,
-					    &bp->rx_buffers_dma, GFP_KERNEL);
-	if (!bp->rx_buffers)
+	queue->rx_buffers = dma_alloc_coherent(&bp->pdev->dev, size,
+					       &queue->rx_buffers_dma,
+					       GFP_KERNEL);
+	if (!queue->rx_buffers)
 		return -ENOMEM;
 
 	netdev_dbg(bp->dev,
 		   "Allocated RX buffers of %d bytes at %08lx (mapped %p)\n",
-		   size, (unsigned long)bp->rx_buffers_dma, bp->rx_buffers);
+		   size, (unsigned long)queue->rx_buffers_dma, queue->rx_buffers);
 	return 0;
 }
 
@@ -1982,29 +2177,28 @@ static int macb_alloc_consistent(struct macb *bp)
 		queue->tx_skb = kmalloc(size, GFP_KERNEL);
 		if (!queue->tx_skb)
 			goto out_err;
-	}
 
-	size = RX_RING_BYTES(bp);
-	bp->rx_ring = dma_alloc_coherent(&bp->pdev->dev, size,
-					 &bp->rx_ring_dma, GFP_KERNEL);
-	if (!bp->rx_ring)
-		goto out_err;
+		size = RX_RING_BYTES(bp);
+		queue->rx_ring = dma_alloc_coherent(&bp->pdev->dev, size,
+						    &queue->rx_ring_dma,
+						    GFP_KERNEL);
+		if (!queue->rx_ring)
+			goto out_err;
+		netdev_dbg(bp->dev,
+			   "Allocated RX ring for queue %u of %d bytes at %08lx (mapped %p)\n",
+			   q, size, (unsigned long)queue->rx_ring_dma,
+			   queue->rx_ring);
+	}
 
-	/* If we have more than one queue, allocate a tie off descriptor
-	 * that will be used to disable unused RX queues.
+	/* Every RX queue now owns a ring; the tie off descriptor is only
+	 * used to park the receiver while waiting for a wake-on-LAN event.
 	 */
-	if (bp->num_queues > 1) {
-		bp->rx_ring_tieoff = dma_alloc_coherent(&bp->pdev->dev,
+	bp->rx_ring_tieoff = dma_alloc_coherent(&bp->pdev->dev,
 						macb_dma_desc_get_size(bp),
 						&bp->rx_ring_tieoff_dma,
 						GFP_KERNEL);
-		if (!bp->rx_ring_tieoff)
-			goto out_err;
-	}
-
-	netdev_dbg(bp->dev,
-		   "Allocated RX ring of %d bytes at %08lx (mapped %p)\n",
-		   size, (unsigned long)bp->rx_ring_dma, bp->rx_ring);
+	if (!bp->rx_ring_tieoff)
+		goto out_err;
 
 	if (bp->macbgem_ops.mog_alloc_rx_buffers(bp))
 		goto out_err;
@@ -2020,13 +2214,11 @@ static void macb_init_tieoff(struct macb *bp)
 {
 	struct macb_dma_desc *d = bp->rx_ring_tieoff;
 
-	if (bp->num_queues > 1) {
-		/* Setup a wrapping descriptor with no free slots
-		 * (WRAP and USED) to tie off/disable unused RX queues.
-		 */
-		macb_set_addr(bp, d, MACB_BIT(RX_WRAP) | MACB_BIT(RX_USED));
-		d->ctrl = 0;
-	}
+	/* Setup a wrapping descriptor with no free slots
+	 * (WRAP and USED) to tie off/disable the RX queues.
+	 */
+	macb_set_addr(bp, d, MACB_BIT(RX_WRAP) | MACB_BIT(RX_USED));
+	d->ctrl = 0;
 }
 
 static void gem_init_rings(struct macb *bp)
@@ -2045,12 +2237,14 @@ static void gem_init_rings(struct macb *bp)
 		desc->ctrl |= MACB_BIT(TX_WRAP);
 		queue->tx_head = 0;
 		queue->tx_tail = 0;
-	}
+		netdev_tx_reset_queue(netdev_get_tx_queue(bp->dev, q));
 
-	bp->rx_tail = 0;
-	bp->rx_prepared_head = 0;
+		queue->rx_tail = 0;
+		queue->rx_prepared_head = 0;
+
+		gem_rx_refill(queue);
+	}
 
-	gem_rx_refill(bp);
 	macb_init_tieoff(bp);
 }
 
@@ -2059,7 +2253,7 @@ static void macb_init_rings(struct macb *bp)
 	int i;
 	struct macb_dma_desc *desc = NULL;
 
-	macb_init_rx_ring(bp);
+	macb_init_rx_ring(&bp->queues[0]);
 
 	for (i = 0; i < bp->tx_ring_size; i++) {
 		desc = macb_tx_desc(&bp->queues[0], i);
@@ -2069,6 +2263,7 @@ static void macb_init_rings(struct macb *bp)
 	bp->queues[0].tx_head = 0;
 	bp->queues[0].tx_tail = 0;
 	desc->ctrl |= MACB_BIT(TX_WRAP);
+	netdev_tx_reset_queue(netdev_get_tx_queue(bp->dev, 0));
 
 	macb_init_tieoff(bp);
 }
@@ -2174,11 +2369,20 @@ static u32 macb_dbw(struct macb *bp)
  */
 static void macb_configure_dma(struct macb *bp)
 {
+	struct macb_queue *queue;
+	u32 buffer_size;
+	unsigned int q;
 	u32 dmacfg;
 
+	buffer_size = bp->rx_buffer_size / RX_BUFFER_MULTIPLE;
 	if (macb_is_gem(bp)) {
 		dmacfg = gem_readl(bp, DMACFG) & ~GEM_BF(RXBS, -1L);
-		dmacfg |= GEM_BF(RXBS, bp->rx_buffer_size / RX_BUFFER_MULTIPLE);
+		for (q = 0, queue = bp->queues; q < bp->num_queues; ++q, ++queue) {
+			if (q)
+				queue_writel(queue, RBQS, buffer_size);
+			else
+				dmacfg |= GEM_BF(RXBS, buffer_size);
+		}
 		if (bp->dma_burst_length)
 			dmacfg = GEM_BFINS(FBLDO, bp->dma_burst_length, dmacfg);
 		dmacfg |= GEM_BIT(TXPBMS) | GEM_BF(RXBMS, -1L);
@@ -2208,6 +2412,168 @@ static void macb_configure_dma(struct macb *bp)
 	}
 }
 
+/* Type 1 screeners match on the UDP destination port and optionally the
+ * IPv4 DS byte, which is all a UDP port steering rule needs.
+ */
+static void gem_prog_t1_screener(struct macb *bp,
+				 struct ethtool_rx_fs_item *item, bool enable)
+{
+	struct ethtool_tcpip4_spec *tp4sp_v = &item->fs.h_u.tcp_ip4_spec;
+	struct ethtool_tcpip4_spec *tp4sp_m = &item->fs.m_u.tcp_ip4_spec;
+	u32 t1_scr = 0;
+
+	t1_scr = GEM_BFINS(SCRT1_QUEUE, item->fs.ring_cookie & 0xF, t1_scr);
+	t1_scr = GEM_BFINS(UDPPORT, be16_to_cpu(tp4sp_v->pdst), t1_scr);
+	t1_scr = GEM_BFINS(UDPPORTEN, enable, t1_scr);
+	if (tp4sp_m->tos) {
+		t1_scr = GEM_BFINS(DSTC, tp4sp_v->tos, t1_scr);
+		t1_scr = GEM_BFINS(DSTCEN, enable, t1_scr);
+	}
+	gem_writel_n(bp, SCRT1, item->t1_idx, t1_scr);
+}
+
+static void gem_prog_cmp_regs(struct macb *bp, struct ethtool_rx_flow_spec *fs)
+{
+	struct ethtool_tcpip4_spec *tp4sp_v, *tp4sp_m;
+	u16 index = fs->location;
+	u32 w0, w1, t2_scr;
+	bool cmp_a = false;
+	bool cmp_b = false;
+	bool cmp_c = false;
+
+	tp4sp_v = &fs->h_u.tcp_ip4_spec;
+	tp4sp_m = &fs->m_u.tcp_ip4_spec;
+
+	/* ignore field if any masking set */
+	if (tp4sp_m->ip4src == 0xFFFFFFFF) {
+		/* 1st compare reg - IP source address */
+		w0 = 0;
+		w1 = 0;
+		w0 = tp4sp_v->ip4src;
+		w1 = GEM_BFINS(T2DISMSK, 1, w1); /* 32-bit compare */
+		w1 = GEM_BFINS(T2CMPOFST, GEM_T2COMPOFST_ETYPE, w1);
+		w1 = GEM_BFINS(T2OFST, ETYPE_SRCIP_OFFSET, w1);
+		gem_writel_n(bp, T2CMPW0, GEM_IP4SRC_CMP(index), w0);
+		gem_writel_n(bp, T2CMPW1, GEM_IP4SRC_CMP(index), w1);
+		cmp_a = true;
+	}
+
+	/* ignore field if any masking set */
+	if (tp4sp_m->ip4dst == 0xFFFFFFFF) {
+		/* 2nd compare reg - IP destination address */
+		w0 = 0;
+		w1 = 0;
+		w0 = tp4sp_v->ip4dst;
+		w1 = GEM_BFINS(T2DISMSK, 1, w1); /* 32-bit compare */
+		w1 = GEM_BFINS(T2CMPOFST, GEM_T2COMPOFST_ETYPE, w1);
+		w1 = GEM_BFINS(T2OFST, ETYPE_DSTIP_OFFSET, w1);
+		gem_writel_n(bp, T2CMPW0, GEM_IP4DST_CMP(index), w0);
+		gem_writel_n(bp, T2CMPW1, GEM_IP4DST_CMP(index), w1);
+		cmp_b = true;
+	}
+
+	/* ignore both port fields if masking set in both */
+	if ((tp4sp_m->psrc == 0xFFFF) || (tp4sp_m->pdst == 0xFFFF)) {
+		/* 3rd compare reg - source port, destination port */
+		w0 = 0;
+		w1 = 0;
+		w1 = GEM_BFINS(T2CMPOFST, GEM_T2COMPOFST_IPHDR, w1);
+		if (tp4sp_m->psrc == tp4sp_m->pdst) {
+			w0 = GEM_BFINS(T2MASK, tp4sp_v->psrc, w0);
+			w0 = GEM_BFINS(T2CMP, tp4sp_v->pdst, w0);
+			w1 = GEM_BFINS(T2DISMSK, 1, w1); /* 32-bit compare */
+			w1 = GEM_BFINS(T2OFST, IPHDR_SRCPORT_OFFSET, w1);
+		} else {
+			/* only one port definition */
+			w1 = GEM_BFINS(T2DISMSK, 0, w1); /* 16-bit compare */
+			w0 = GEM_BFINS(T2MASK, 0xFFFF, w0);
+			if (tp4sp_m->psrc == 0xFFFF) { /* src port */
+				w0 = GEM_BFINS(T2CMP, tp4sp_v->psrc, w0);
+				w1 = GEM_BFINS(T2OFST, IPHDR_SRCPORT_OFFSET, w1);
+			} else { /* dst port */
+				w0 = GEM_BFINS(T2CMP, tp4sp_v->pdst, w0);
+				w1 = GEM_BFINS(T2OFST, IPHDR_DSTPORT_OFFSET, w1);
+			}
+		}
+		gem_writel_n(bp, T2CMPW0, GEM_PORT_CMP(index), w0);
+		gem_writel_n(bp, T2CMPW1, GEM_PORT_CMP(index), w1);
+		cmp_c = true;
+	}
+
+	t2_scr = 0;
+	t2_scr = GEM_BFINS(QUEUE, (fs->ring_cookie) & 0xFF, t2_scr);
+	t2_scr = GEM_BFINS(ETHT2IDX, SCRT2_ETHT, t2_scr);
+	if (cmp_a)
+		t2_scr = GEM_BFINS(CMPA, GEM_IP4SRC_CMP(index), t2_scr);
+	if (cmp_b)
+		t2_scr = GEM_BFINS(CMPB, GEM_IP4DST_CMP(index), t2_scr);
+	if (cmp_c)
+		t2_scr = GEM_BFINS(CMPC, GEM_PORT_CMP(index), t2_scr);
+	gem_writel_n(bp, SCRT2, index, t2_scr);
+}
+
+/* Called with rx_fs_lock held */
+static void gem_enable_flow_filters(struct macb *bp, bool enable)
+{
+	struct ethtool_rx_fs_item *item;
+	u32 t2_scr;
+
+	list_for_each_entry(item, &bp->rx_fs_list.list, list) {
+		struct ethtool_rx_flow_spec *fs = &item->fs;
+		struct ethtool_tcpip4_spec *tp4sp_m;
+
+		if (item->t1_idx >= 0) {
+			gem_prog_t1_screener(bp, item, enable);
+			continue;
+		}
+
+		if (fs->location >= bp->max_tuples)
+			continue;
+
+		t2_scr = gem_readl_n(bp, SCRT2, fs->location);
+
+		/* enable/disable screener regs for the flow entry */
+		t2_scr = GEM_BFINS(ETHTEN, enable, t2_scr);
+
+		/* only enable fields with no masking */
+		tp4sp_m = &fs->m_u.tcp_ip4_spec;
+
+		if (enable && (tp4sp_m->ip4src == 0xFFFFFFFF))
+			t2_scr = GEM_BFINS(CMPAEN, 1, t2_scr);
+		else
+			t2_scr = GEM_BFINS(CMPAEN, 0, t2_scr);
+
+		if (enable && (tp4sp_m->ip4dst == 0xFFFFFFFF))
+			t2_scr = GEM_BFINS(CMPBEN, 1, t2_scr);
+		else
+			t2_scr = GEM_BFINS(CMPBEN, 0, t2_scr);
+
+		if (enable && ((tp4sp_m->psrc == 0xFFFF) ||
+			       (tp4sp_m->pdst == 0xFFFF)))
+			t2_scr = GEM_BFINS(CMPCEN, 1, t2_scr);
+		else
+			t2_scr = GEM_BFINS(CMPCEN, 0, t2_scr);
+
+		gem_writel_n(bp, SCRT2, fs->location, t2_scr);
+	}
+}
+
+/* Program the screeners again after the controller lost its state */
+static void gem_restore_flow_filters(struct macb *bp)
+{
+	struct ethtool_rx_fs_item *item;
+	unsigned long flags;
+
+	spin_lock_irqsave(&bp->rx_fs_lock, flags);
+	gem_writel_n(bp, ETHT, SCRT2_ETHT, GEM_BF(ETHTCMP, ETH_P_IP));
+	list_for_each_entry(item, &bp->rx_fs_list.list, list) {
+		if (item->t1_idx < 0)
+			gem_prog_cmp_regs(bp, &item->fs);
+	}
+	gem_enable_flow_filters(bp, !!(bp->dev->features & NETIF_F_NTUPLE));
+	spin_unlock_irqrestore(&bp->rx_fs_lock, flags);
+}
+
 static void macb_init_hw(struct macb *bp)
 {
 	struct macb_queue *queue;
@@ -2262,25 +2628,18 @@ static void macb_init_hw(struct macb *bp)
 	}
 
 	/* Initialize TX and RX buffers */
-	macb_writel(bp, RBQP, lower_32_bits(bp->rx_ring_dma));
+	for (q = 0, queue = bp->queues; q < bp->num_queues; ++q, ++queue) {
+		queue_writel(queue, RBQP, lower_32_bits(queue->rx_ring_dma));
 #ifdef CONFIG_ARCH_DMA_ADDR_T_64BIT
-	if (bp->hw_dma_cap & HW_DMA_CAP_64B)
-		macb_writel(bp, RBQPH, upper_32_bits(bp->rx_ring_dma));
+		if (bp->hw_dma_cap & HW_DMA_CAP_64B)
+			queue_writel(queue, RBQPH,
+				     upper_32_bits(queue->rx_ring_dma));
 #endif
-	for (q = 0, queue = bp->queues; q < bp->num_queues; ++q, ++queue) {
 		queue_writel(queue, TBQP, lower_32_bits(queue->tx_ring_dma));
 #ifdef CONFIG_ARCH_DMA_ADDR_T_64BIT
 		if (bp->hw_dma_cap & HW_DMA_CAP_64B)
 			queue_writel(queue, TBQPH, upper_32_bits(queue->tx_ring_dma));
 #endif
-		/* We only use the first queue at the moment. Remaining
-		 * queues must be tied-off before we enable the receiver.
-		 *
-		 * See the documentation for receive_q1_ptr for more info.
-		 */
-		if (q)
-			queue_writel(queue, RBQP,
-				     lower_32_bits(bp->rx_ring_tieoff_dma));
 
 		/* Enable interrupts */
 		queue_writel(queue, IER,
@@ -2294,6 +2653,18 @@ static void macb_init_hw(struct macb *bp)
 		gem_writel(bp, PCSCNTRL,
 			   gem_readl(bp, PCSCNTRL) | GEM_BIT(PCSAUTONEG));
 
+	if (bp->dev->hw_features & NETIF_F_NTUPLE)
+		gem_restore_flow_filters(bp);
+
+	if (bp->caps & MACB_CAPS_INT_MODERATION) {
+		bp->coal_stamp = jiffies;
+		if (bp->adaptive_rx_coal || bp->adaptive_tx_coal)
+			gem_write_intmod(bp, 0, 0);
+		else
+			gem_write_intmod(bp, bp->rx_coalesce_usecs,
+					 bp->tx_coalesce_usecs);
+	}
+
 	/* Enable TX and RX */
 	macb_writel(bp, NCR, MACB_BIT(RE) | MACB_BIT(TE) | MACB_BIT(MPE) |
 		    MACB_BIT(PTPUNI));
@@ -2422,6 +2793,8 @@ static int macb_open(struct net_device *dev)
 {
 	struct macb *bp = netdev_priv(dev);
 	size_t bufsz = dev->mtu + ETH_HLEN + ETH_FCS_LEN + NET_IP_ALIGN;
+	struct macb_queue *queue;
+	unsigned int q;
 	int err;
 
 	netdev_dbg(bp->dev, "open\n");
@@ -2447,7 +2820,15 @@ static int macb_open(struct net_device *dev)
 		return err;
 	}
 
-	napi_enable(&bp->napi);
+	/* Spread the queue interrupts, and with them the RX NAPI contexts,
+	 * over the CPUs closest to the controller.
+	 */
+	for (q = 0, queue = bp->queues; q < bp->num_queues; ++q, ++queue) {
+		napi_enable(&queue->napi);
+		irq_set_affinity_hint(queue->irq,
+				      cpumask_of(cpumask_local_spread(q,
+						 dev_to_node(&bp->pdev->dev))));
+	}
 
 	bp->macbgem_ops.mog_init_rings(bp);
 	macb_init_hw(bp);
@@ -2466,10 +2847,16 @@ static int macb_open(struct net_device *dev)
 static int macb_close(struct net_device *dev)
 {
 	struct macb *bp = netdev_priv(dev);
+	struct macb_queue *queue;
 	unsigned long flags;
+	unsigned int q;
 
 	netif_tx_stop_all_queues(dev);
-	napi_disable(&bp->napi);
+
+	for (q = 0, queue = bp->queues; q < bp->num_queues; ++q, ++queue) {
+		napi_disable(&queue->napi);
+		irq_set_affinity_hint(queue->irq, NULL);
+	}
 
 	if (bp->phy_dev)
 		phy_stop(bp->phy_dev);
@@ -2558,21 +2945,43 @@ static struct net_device_stats *gem_get_stats(struct macb *bp)
 	return nstat;
 }
 
+static const char gem_rx_recycle_strings[][ETH_GSTRING_LEN] = {
+	"rx_recycle_hits",
+	"rx_recycle_allocs",
+	"rx_recycle_releases",
+};
+
+#define GEM_RX_RECYCLE_STATS_LEN ARRAY_SIZE(gem_rx_recycle_strings)
+
 static void gem_get_ethtool_stats(struct net_device *dev,
 				  struct ethtool_stats *stats, u64 *data)
 {
+	struct macb_rx_recycle_stats recycle = { 0 };
+	struct macb_queue *queue;
 	struct macb *bp;
+	unsigned int q;
 
 	bp = netdev_priv(dev);
 	gem_update_stats(bp);
 	memcpy(data, &bp->ethtool_stats, sizeof(u64) * GEM_STATS_LEN);
+	data += GEM_STATS_LEN;
+
+	/* Updated from NAPI context only, a stale read is good enough */
+	for (q = 0, queue = bp->queues; q < bp->num_queues; ++q, ++queue) {
+		recycle.hits += queue->rx_recycle_stats.hits;
+		recycle.allocs += queue->rx_recycle_stats.allocs;
+		recycle.releases += queue->rx_recycle_stats.releases;
+	}
+	*data++ = recycle.hits;
+	*data++ = recycle.allocs;
+	*data++ = recycle.releases;
 }
 
 static int gem_get_sset_count(struct net_device *dev, int sset)
 {
 	switch (sset) {
 	case ETH_SS_STATS:
-		return GEM_STATS_LEN;
+		return GEM_STATS_LEN + GEM_RX_RECYCLE_STATS_LEN;
 	default:
 		return -EOPNOTSUPP;
 	}
@@ -2587,6 +2996,8 @@ static void gem_get_ethtool_strings(struct net_device *dev, u32 sset, u8 *p)
 		for (i = 0; i < GEM_STATS_LEN; i++, p += ETH_GSTRING_LEN)
 			memcpy(p, gem_statistics[i].stat_string,
 			       ETH_GSTRING_LEN);
+		memcpy(p, gem_rx_recycle_strings,
+		       sizeof(gem_rx_recycle_strings));
 		break;
 	}
 }
@@ -2727,6 +3138,55 @@ static int macb_set_ringparam(struct net_device *netdev,
 	return 0;
 }
 
+static int gem_get_coalesce(struct net_device *netdev,
+			    struct ethtool_coalesce *ec)
+{
+	struct macb *bp = netdev_priv(netdev);
+
+	if (!(bp->caps & MACB_CAPS_INT_MODERATION))
+		return -EOPNOTSUPP;
+
+	ec->rx_coalesce_usecs = bp->rx_coalesce_usecs;
+	ec->tx_coalesce_usecs = bp->tx_coalesce_usecs;
+	ec->use_adaptive_rx_coalesce = bp->adaptive_rx_coal;
+	ec->use_adaptive_tx_coalesce = bp->adaptive_tx_coal;
+
+	return 0;
+}
+
+static int gem_set_coalesce(struct net_device *netdev,
+			    struct ethtool_coalesce *ec)
+{
+	struct macb *bp = netdev_priv(netdev);
+
+	if (!(bp->caps & MACB_CAPS_INT_MODERATION))
+		return -EOPNOTSUPP;
+
+	if (ec->rx_coalesce_usecs > GEM_INTMOD_MAX_USECS ||
+	    ec->tx_coalesce_usecs > GEM_INTMOD_MAX_USECS)
+		return -EINVAL;
+
+	/* The hardware only counts time, not frames */
+	if (ec->rx_max_coalesced_frames || ec->tx_max_coalesced_frames)
+		return -EOPNOTSUPP;
+
+	bp->rx_coalesce_usecs = ec->rx_coalesce_usecs;
+	bp->tx_coalesce_usecs = ec->tx_coalesce_usecs;
+	bp->adaptive_rx_coal = !!ec->use_adaptive_rx_coalesce;
+	bp->adaptive_tx_coal = !!ec->use_adaptive_tx_coalesce;
+
+	if (netif_running(netdev)) {
+		if (bp->adaptive_rx_coal || bp->adaptive_tx_coal)
+			/* start low, the next samples raise the delays */
+			gem_write_intmod(bp, 0, 0);
+		else
+			gem_write_intmod(bp, bp->rx_coalesce_usecs,
+					 bp->tx_coalesce_usecs);
+	}
+
+	return 0;
+}
+
 #ifdef CONFIG_MACB_USE_HWSTAMP
 static unsigned int gem_get_tsu_rate(struct macb *bp)
 {
@@ -2802,6 +3262,249 @@ static int macb_get_ts_info(struct net_device *netdev,
 	return ethtool_op_get_ts_info(netdev, info);
 }
 
+/* A UDP rule that only matches the destination port (and optionally the
+ * DS byte) fits a type 1 screener and leaves the scarcer type 2 screeners
+ * and compare registers for full 4-tuple rules.
+ */
+static bool gem_flow_fits_t1(struct ethtool_rx_flow_spec *fs)
+{
+	struct ethtool_tcpip4_spec *tp4sp_m = &fs->m_u.tcp_ip4_spec;
+
+	return (fs->flow_type & ~FLOW_EXT) == UDP_V4_FLOW &&
+	       !tp4sp_m->ip4src && !tp4sp_m->ip4dst && !tp4sp_m->psrc &&
+	       tp4sp_m->pdst == 0xFFFF &&
+	       (!tp4sp_m->tos || tp4sp_m->tos == 0xFF);
+}
+
+/* Called with rx_fs_lock held */
+static int gem_get_free_t1_screener(struct macb *bp)
+{
+	struct ethtool_rx_fs_item *item;
+	unsigned long used = 0;
+	int idx;
+
+	list_for_each_entry(item, &bp->rx_fs_list.list, list) {
+		if (item->t1_idx >= 0)
+			__set_bit(item->t1_idx, &used);
+	}
+
+	idx = find_first_zero_bit(&used, bp->num_t1_screeners);
+	if (idx >= bp->num_t1_screeners)
+		return -1;
+
+	return idx;
+}
+
+static int gem_add_flow_filter(struct net_device *netdev,
+			       struct ethtool_rxnfc *cmd)
+{
+	struct macb *bp = netdev_priv(netdev);
+	struct ethtool_rx_flow_spec *fs = &cmd->fs;
+	struct ethtool_rx_fs_item *item, *newfs;
+	unsigned long flags;
+	int ret = -EINVAL;
+	bool added = false;
+
+	switch (fs->flow_type & ~FLOW_EXT) {
+	case TCP_V4_FLOW:
+	case UDP_V4_FLOW:
+	case SCTP_V4_FLOW:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	newfs = kmalloc(sizeof(*newfs), GFP_KERNEL);
+	if (!newfs)
+		return -ENOMEM;
+	memcpy(&newfs->fs, fs, sizeof(newfs->fs));
+
+	netdev_dbg(netdev,
+		   "Adding flow filter entry,type=%u,queue=%u,loc=%u,src=%08X,dst=%08X,ps=%u,pd=%u\n",
+		   fs->flow_type, (int)fs->ring_cookie, fs->location,
+		   htonl(fs->h_u.tcp_ip4_spec.ip4src),
+		   htonl(fs->h_u.tcp_ip4_spec.ip4dst),
+		   htons(fs->h_u.tcp_ip4_spec.psrc),
+		   htons(fs->h_u.tcp_ip4_spec.pdst));
+
+	spin_lock_irqsave(&bp->rx_fs_lock, flags);
+
+	newfs->t1_idx = -1;
+	if (gem_flow_fits_t1(fs))
+		newfs->t1_idx = gem_get_free_t1_screener(bp);
+	if (newfs->t1_idx < 0 && fs->location >= bp->max_tuples) {
+		netdev_err(netdev, "Rule not added: no screener for location %d\n",
+			   fs->location);
+		ret = -ENOSPC;
+		goto err;
+	}
+
+	/* find correct place to add in list */
+	list_for_each_entry(item, &bp->rx_fs_list.list, list) {
+		if (item->fs.location > newfs->fs.location) {
+			list_add_tail(&newfs->list, &item->list);
+			added = true;
+			break;
+		} else if (item->fs.location == fs->location) {
+			netdev_err(netdev, "Rule not added: location %d not free!\n",
+				   fs->location);
+			ret = -EBUSY;
+			goto err;
+		}
+	}
+	if (!added)
+		list_add_tail(&newfs->list, &bp->rx_fs_list.list);
+
+	if (newfs->t1_idx >= 0)
+		gem_prog_t1_screener(bp, newfs, false);
+	else
+		gem_prog_cmp_regs(bp, fs);
+	bp->rx_fs_list.count++;
+	/* enable filtering if NTUPLE on */
+	if (netdev->features & NETIF_F_NTUPLE)
+		gem_enable_flow_filters(bp, 1);
+
+	spin_unlock_irqrestore(&bp->rx_fs_lock, flags);
+	return 0;
+
+err:
+	spin_unlock_irqrestore(&bp->rx_fs_lock, flags);
+	kfree(newfs);
+	return ret;
+}
+
+static int gem_del_flow_filter(struct net_device *netdev,
+			       struct ethtool_rxnfc *cmd)
+{
+	struct macb *bp = netdev_priv(netdev);
+	struct ethtool_rx_fs_item *item;
+	struct ethtool_rx_flow_spec *fs;
+	unsigned long flags;
+
+	spin_lock_irqsave(&bp->rx_fs_lock, flags);
+
+	list_for_each_entry(item, &bp->rx_fs_list.list, list) {
+		if (item->fs.location == cmd->fs.location) {
+			/* disable screener regs for the flow entry */
+			fs = &item->fs;
+			netdev_dbg(netdev,
+				   "Deleting flow filter entry,type=%u,queue=%u,loc=%u,src=%08X,dst=%08X,ps=%u,pd=%u\n",
+				   fs->flow_type, (int)fs->ring_cookie,
+				   fs->location,
+				   htonl(fs->h_u.tcp_ip4_spec.ip4src),
+				   htonl(fs->h_u.tcp_ip4_spec.ip4dst),
+				   htons(fs->h_u.tcp_ip4_spec.psrc),
+				   htons(fs->h_u.tcp_ip4_spec.pdst));
+
+			if (item->t1_idx >= 0)
+				gem_writel_n(bp, SCRT1, item->t1_idx, 0);
+			else
+				gem_writel_n(bp, SCRT2, fs->location, 0);
+
+			list_del(&item->list);
+			bp->rx_fs_list.count--;
+			spin_unlock_irqrestore(&bp->rx_fs_lock, flags);
+			kfree(item);
+			return 0;
+		}
+	}
+
+	spin_unlock_irqrestore(&bp->rx_fs_lock, flags);
+	return -EINVAL;
+}
+
+static int gem_get_flow_entry(struct net_device *netdev,
+			      struct ethtool_rxnfc *cmd)
+{
+	struct macb *bp = netdev_priv(netdev);
+	struct ethtool_rx_fs_item *item;
+
+	list_for_each_entry(item, &bp->rx_fs_list.list, list) {
+		if (item->fs.location == cmd->fs.location) {
+			memcpy(&cmd->fs, &item->fs, sizeof(cmd->fs));
+			return 0;
+		}
+	}
+	return -EINVAL;
+}
+
+static int gem_get_all_flow_entries(struct net_device *netdev,
+				    struct ethtool_rxnfc *cmd, u32 *rule_locs)
+{
+	struct macb *bp = netdev_priv(netdev);
+	struct ethtool_rx_fs_item *item;
+	u32 cnt = 0;
+
+	list_for_each_entry(item, &bp->rx_fs_list.list, list) {
+		if (cnt == cmd->rule_cnt)
+			return -EMSGSIZE;
+		rule_locs[cnt] = item->fs.location;
+		cnt++;
+	}
+	cmd->data = bp->max_tuples + bp->num_t1_screeners;
+	cmd->rule_cnt = cnt;
+
+	return 0;
+}
+
+static int gem_get_rxnfc(struct net_device *netdev, struct ethtool_rxnfc *cmd,
+			 u32 *rule_locs)
+{
+	struct macb *bp = netdev_priv(netdev);
+	int ret = 0;
+
+	switch (cmd->cmd) {
+	case ETHTOOL_GRXRINGS:
+		cmd->data = bp->num_queues;
+		break;
+	case ETHTOOL_GRXCLSRLCNT:
+		cmd->rule_cnt = bp->rx_fs_list.count;
+		cmd->data = bp->max_tuples + bp->num_t1_screeners;
+		break;
+	case ETHTOOL_GRXCLSRULE:
+		ret = gem_get_flow_entry(netdev, cmd);
+		break;
+	case ETHTOOL_GRXCLSRLALL:
+		ret = gem_get_all_flow_entries(netdev, cmd, rule_locs);
+		break;
+	default:
+		netdev_err(netdev,
+			   "Command parameter %d is not supported\n", cmd->cmd);
+		ret = -EOPNOTSUPP;
+	}
+
+	return ret;
+}
+
+static int gem_set_rxnfc(struct net_device *netdev, struct ethtool_rxnfc *cmd)
+{
+	struct macb *bp = netdev_priv(netdev);
+	int ret;
+
+	if (!(netdev->hw_features & NETIF_F_NTUPLE))
+		return -EOPNOTSUPP;
+
+	switch (cmd->cmd) {
+	case ETHTOOL_SRXCLSRLINS:
+		if ((cmd->fs.location >= bp->max_tuples + bp->num_t1_screeners)
+				|| (cmd->fs.ring_cookie >= bp->num_queues)) {
+			ret = -EINVAL;
+			break;
+		}
+		ret = gem_add_flow_filter(netdev, cmd);
+		break;
+	case ETHTOOL_SRXCLSRLDEL:
+		ret = gem_del_flow_filter(netdev, cmd);
+		break;
+	default:
+		netdev_err(netdev,
+			   "Command parameter %d is not supported\n", cmd->cmd);
+		ret = -EOPNOTSUPP;
+	}
+
+	return ret;
+}
+
 static const struct ethtool_ops macb_ethtool_ops = {
 	.get_regs_len		= macb_get_regs_len,
 	.get_regs		= macb_get_regs,
@@ -2825,6 +3528,10 @@ static const struct ethtool_ops gem_ethtool_ops = {
 	.set_link_ksettings     = phy_ethtool_set_link_ksettings,
 	.get_ringparam		= macb_get_ringparam,
 	.set_ringparam		= macb_set_ringparam,
+	.get_rxnfc		= gem_get_rxnfc,
+	.set_rxnfc		= gem_set_rxnfc,
+	.get_coalesce		= gem_get_coalesce,
+	.set_coalesce		= gem_set_coalesce,
 };
 
 static int macb_ioctl(struct net_device *dev, struct ifreq *rq, int cmd)
@@ -2882,6 +3589,16 @@ static int macb_set_features(struct net_device *netdev,
 		gem_writel(bp, NCFGR, netcfg);
 	}
 
+	/* RX Flow Filters */
+	if ((changed & NETIF_F_NTUPLE) && macb_is_gem(bp)) {
+		bool turn_on = features & NETIF_F_NTUPLE;
+		unsigned long flags;
+
+		spin_lock_irqsave(&bp->rx_fs_lock, flags);
+		gem_enable_flow_filters(bp, turn_on);
+		spin_unlock_irqrestore(&bp->rx_fs_lock, flags);
+	}
+
 	return 0;
 }
 
@@ -2941,6 +3658,13 @@ static void macb_configure_caps(struct macb *bp,
 		dcfg = gem_readl(bp, DCFG2);
 		if ((dcfg & (GEM_BIT(RX_PKT_BUFF) | GEM_BIT(TX_PKT_BUFF))) == 0)
 			bp->caps |= MACB_CAPS_FIFO_MODE;
+		/* No design config bit tells about interrupt moderation,
+		 * older revisions simply ignore writes to the register.
+		 */
+		gem_writel(bp, INTMOD, GEM_BF(RX_MOD, 1));
+		if (GEM_BFEXT(RX_MOD, gem_readl(bp, INTMOD)) == 1)
+			bp->caps |= MACB_CAPS_INT_MODERATION;
+		gem_writel(bp, INTMOD, 0);
 #ifdef CONFIG_MACB_USE_HWSTAMP
 		if (gem_has_ptp(bp)) {
 			if (!GEM_BFEXT(TSU, gem_readl(bp, DCFG5)))
@@ -3130,6 +3854,11 @@ static int macb_init(struct platform_device *pdev)
 				queue->TBQPH = GEM_TBQPH(hw_q - 1);
 #endif
 			queue->RBQP = GEM_RBQP(hw_q - 1);
+			queue->RBQS = GEM_RBQS(hw_q - 1);
+#ifdef CONFIG_ARCH_DMA_ADDR_T_64BIT
+			if (bp->hw_dma_cap & HW_DMA_CAP_64B)
+				queue->RBQPH = GEM_RBQPH(hw_q - 1);
+#endif
 		} else {
 			/* queue0 uses legacy registers */
 			queue->ISR  = MACB_ISR;
@@ -3142,6 +3871,10 @@ static int macb_init(struct platform_device *pdev)
 				queue->TBQPH = MACB_TBQPH;
 #endif
 			queue->RBQP = MACB_RBQP;
+#ifdef CONFIG_ARCH_DMA_ADDR_T_64BIT
+			if (bp->hw_dma_cap & HW_DMA_CAP_64B)
+				queue->RBQPH = MACB_RBQPH;
+#endif
 		}
 
 		/* get irq: here we use the linux queue index, not the hardware
@@ -3160,11 +3893,11 @@ static int macb_init(struct platform_device *pdev)
 		}
 
 		INIT_WORK(&queue->tx_error_task, macb_tx_error_task);
+		netif_napi_add(dev, &queue->napi, macb_poll, 64);
 		q++;
 	}
 
 	dev->netdev_ops = &macb_netdev_ops;
-	netif_napi_add(dev, &bp->napi, macb_poll, 64);
 
 	/* setup appropriated routines according to adapter type */
 	if (macb_is_gem(bp)) {
@@ -3199,6 +3932,36 @@ static int macb_init(struct platform_device *pdev)
 		dev->hw_features &= ~NETIF_F_SG;
 	dev->features = dev->hw_features;
 
+	/* Check RX Flow Filters support.
+	 * Max Rx flows set by availability of screeners & compare regs:
+	 * each 4-tuple define requires 1 T2 screener reg + 3 compare regs
+	 */
+	INIT_LIST_HEAD(&bp->rx_fs_list.list);
+	spin_lock_init(&bp->rx_fs_lock);
+	if (macb_is_gem(bp) && bp->num_queues > 1) {
+		val = gem_readl(bp, DCFG8);
+		bp->max_tuples = min((GEM_BFEXT(SCR2CMP, val) / 3),
+				     GEM_BFEXT(T2SCR, val));
+		bp->num_t1_screeners = min_t(unsigned int,
+					     GEM_BFEXT(T1SCR, val),
+					     BITS_PER_LONG);
+		if (bp->max_tuples > 0) {
+			/* also needs one ethtype match to check IPv4 */
+			if (GEM_BFEXT(SCR2ETH, val) > 0) {
+				/* program this reg now */
+				gem_writel_n(bp, ETHT, SCRT2_ETHT,
+					     GEM_BF(ETHTCMP, ETH_P_IP));
+				/* Filtering is supported in hw but don't
+				 * enable it in kernel now
+				 */
+				dev->hw_features |= NETIF_F_NTUPLE;
+				bp->rx_fs_list.count = 0;
+			} else {
+				bp->max_tuples = 0;
+			}
+		}
+	}
+
 	if (!(bp->caps & MACB_CAPS_USRIO_DISABLED)) {
 		val = 0;
 		if (bp->phy_interface == PHY_INTERFACE_MODE_RGMII)
@@ -3240,34 +4003,35 @@ static int macb_init(struct platform_device *pdev)
 static int at91ether_start(struct net_device *dev)
 {
 	struct macb *lp = netdev_priv(dev);
+	struct macb_queue *q = &lp->queues[0];
 	struct macb_dma_desc *desc;
 	dma_addr_t addr;
 	u32 ctl;
 	int i;
 
-	lp->rx_ring = dma_alloc_coherent(&lp->pdev->dev,
-					 (AT91ETHER_MAX_RX_DESCR *
-					  macb_dma_desc_get_size(lp)),
-					 &lp->rx_ring_dma, GFP_KERNEL);
-	if (!lp->rx_ring)
+	q->rx_ring = dma_alloc_coherent(&lp->pdev->dev,
+					(AT91ETHER_MAX_RX_DESCR *
+					 macb_dma_desc_get_size(lp)),
+					&q->rx_ring_dma, GFP_KERNEL);
+	if (!q->rx_ring)
 		return -ENOMEM;
 
-	lp->rx_buffers = dma_alloc_coherent(&lp->pdev->dev,
-					    AT91ETHER_MAX_RX_DESCR *
-					    AT91ETHER_MAX_RBUFF_SZ,
-					    &lp->rx_buffers_dma, GFP_KERNEL);
-	if (!lp->rx_buffers) {
+	q->rx_buffers = dma_alloc_coherent(&lp->pdev->dev,
+					   AT91ETHER_MAX_RX_DESCR *
+					   AT91ETHER_MAX_RBUFF_SZ,
+					   &q->rx_buffers_dma, GFP_KERNEL);
+	if (!q->rx_buffers) {
 		dma_free_coherent(&lp->pdev->dev,
 				  AT91ETHER_MAX_RX_DESCR *
 				  macb_dma_desc_get_size(lp),
-				  lp->rx_ring, lp->rx_ring_dma);
-		lp->rx_ring = NULL;
+				  q->rx_ring, q->rx_ring_dma);
+		q->rx_ring = NULL;
 		return -ENOMEM;
 	}
 
-	addr = lp->rx_buffers_dma;
+	addr = q->rx_buffers_dma;
 	for (i = 0; i < AT91ETHER_MAX_RX_DESCR; i++) {
-		desc = macb_rx_desc(lp, i);
+		desc = macb_rx_desc(q, i);
 		macb_set_addr(lp, desc, addr);
 		desc->ctrl = 0;
 		addr += AT91ETHER_MAX_RBUFF_SZ;
@@ -3277,10 +4041,10 @@ static int at91ether_start(struct net_device *dev)
 	desc->addr |= MACB_BIT(RX_WRAP);
 
 	/* Reset buffer index */
-	lp->rx_tail = 0;
+	q->rx_tail = 0;
 
 	/* Program address of descriptor list in Rx Buffer Queue register */
-	macb_writel(lp, RBQP, lp->rx_ring_dma);
+	macb_writel(lp, RBQP, q->rx_ring_dma);
 
 	/* Enable Receive and Transmit */
 	ctl = macb_readl(lp, NCR);
@@ -3327,6 +4091,7 @@ static int at91ether_open(struct net_device *dev)
 static int at91ether_close(struct net_device *dev)
 {
 	struct macb *lp = netdev_priv(dev);
+	struct macb_queue *q = &lp->queues[0];
 	u32 ctl;
 
 	/* Disable Receiver and Transmitter */
@@ -3347,13 +4112,13 @@ static int at91ether_close(struct net_device *dev)
 	dma_free_coherent(&lp->pdev->dev,
 			  AT91ETHER_MAX_RX_DESCR *
 			  macb_dma_desc_get_size(lp),
-			  lp->rx_ring, lp->rx_ring_dma);
-	lp->rx_ring = NULL;
+			  q->rx_ring, q->rx_ring_dma);
+	q->rx_ring = NULL;
 
 	dma_free_coherent(&lp->pdev->dev,
 			  AT91ETHER_MAX_RX_DESCR * AT91ETHER_MAX_RBUFF_SZ,
-			  lp->rx_buffers, lp->rx_buffers_dma);
-	lp->rx_buffers = NULL;
+			  q->rx_buffers, q->rx_buffers_dma);
+	q->rx_buffers = NULL;
 
 	return 0;
 }
@@ -3397,14 +4162,15 @@ static int at91ether_start_xmit(struct sk_buff *skb, struct net_device *dev)
 static void at91ether_rx(struct net_device *dev)
 {
 	struct macb *lp = netdev_priv(dev);
+	struct macb_queue *q = &lp->queues[0];
 	struct macb_dma_desc *desc;
 	unsigned char *p_recv;
 	struct sk_buff *skb;
 	unsigned int pktlen;
 
-	desc = macb_rx_desc(lp, lp->rx_tail);
+	desc = macb_rx_desc(q, q->rx_tail);
 	while (desc->addr & MACB_BIT(RX_USED)) {
-		p_recv = lp->rx_buffers + lp->rx_tail * AT91ETHER_MAX_RBUFF_SZ;
+		p_recv = q->rx_buffers + q->rx_tail * AT91ETHER_MAX_RBUFF_SZ;
 		pktlen = MACB_BF(RX_FRMLEN, desc->ctrl);
 		skb = netdev_alloc_skb(dev, pktlen + 2);
 		if (skb) {
@@ -3426,12 +4192,12 @@ static void at91ether_rx(struct net_device *dev)
 		desc->addr &= ~MACB_BIT(RX_USED);
 
 		/* wrap after last buffer */
-		if (lp->rx_tail == AT91ETHER_MAX_RX_DESCR - 1)
-			lp->rx_tail = 0;
+		if (q->rx_tail == AT91ETHER_MAX_RX_DESCR - 1)
+			q->rx_tail = 0;
 		else
-			lp->rx_tail++;
+			q->rx_tail++;
 
-		desc = macb_rx_desc(lp, lp->rx_tail);
+		desc = macb_rx_desc(q, q->rx_tail);
 	}
 }
 
@@ -3539,6 +4305,8 @@ static int at91ether_init(struct platform_device *pdev)
 	int err;
 	u32 reg;
 
+	bp->queues[0].bp = bp;
+
 	dev->netdev_ops = &at91ether_netdev_ops;
 	dev->ethtool_ops = &macb_ethtool_ops;
 
@@ -3902,8 +4670,11 @@ static int __maybe_unused macb_suspend(struct device *dev)
 		ctrl = macb_readl(bp, NCR);
 		ctrl &= ~(MACB_BIT(TE) | MACB_BIT(RE));
 		macb_writel(bp, NCR, ctrl);
-		/* Tie off RXQ0 as well */
-		macb_writel(bp, RBQP, lower_32_bits(bp->rx_ring_tieoff_dma));
+		/* Tie off all RX queues */
+		for (q = 0, queue = bp->queues; q < bp->num_queues;
+		     ++q, ++queue)
+			queue_writel(queue, RBQP,
+				     lower_32_bits(bp->rx_ring_tieoff_dma));
 		ctrl = macb_readl(bp, NCR);
 		ctrl |= MACB_BIT(RE);
 		macb_writel(bp, NCR, ctrl);
@@ -3929,10 +4700,14 @@ static int __maybe_unused macb_suspend(struct device *dev)
 		spin_unlock_irqrestore(&bp->lock, flags);
 		enable_irq_wake(bp->queues[0].irq);
 		netif_device_detach(netdev);
-		napi_disable(&bp->napi);
+		for (q = 0, queue = bp->queues; q < bp->num_queues;
+		     ++q, ++queue)
+			napi_disable(&queue->napi);
 	} else {
 		netif_device_detach(netdev);
-		napi_disable(&bp->napi);
+		for (q = 0, queue = bp->queues; q < bp->num_queues;
+		     ++q, ++queue)
+			napi_disable(&queue->napi);
 		phy_stop(bp->phy_dev);
 		phy_suspend(bp->phy_dev);
 		spin_lock_irqsave(&bp->lock, flags);
@@ -3953,7 +4728,9 @@ static int __maybe_unused macb_resume(struct device *dev)
 	struct platform_device *pdev = to_platform_device(dev);
 	struct net_device *netdev = platform_get_drvdata(pdev);
 	struct macb *bp = netdev_priv(netdev);
+	struct macb_queue *queue = bp->queues;
 	unsigned long flags;
+	unsigned int q;
 
 	if (!netif_running(netdev))
 		return 0;
@@ -3970,11 +4747,15 @@ static int __maybe_unused macb_resume(struct device *dev)
 		disable_irq_wake(bp->queues[0].irq);
 		spin_unlock_irqrestore(&bp->lock, flags);
 		macb_writel(bp, NCR, MACB_BIT(MPE));
-		napi_enable(&bp->napi);
+		for (q = 0, queue = bp->queues; q < bp->num_queues;
+		     ++q, ++queue)
+			napi_enable(&queue->napi);
 		netif_carrier_on(netdev);
 	} else {
 		macb_writel(bp, NCR, MACB_BIT(MPE));
-		napi_enable(&bp->napi);
+		for (q = 0, queue = bp->queues; q < bp->num_queues;
+		     ++q, ++queue)
+			napi_enable(&queue->napi);
 		netif_carrier_on(netdev);
 		phy_resume(bp->phy_dev);
 		phy_start(bp->phy_dev);
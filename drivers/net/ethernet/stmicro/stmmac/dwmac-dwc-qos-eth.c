@@ -124,6 +124,69 @@ static int dwc_eth_dwmac_config_dt(struct platform_device *pdev,
 	return 0;
 }
 
+/**
+ * dwc_eth_dwmac_config_mtl - size the MTL queues from the HW feature register
+ * @pdev: platform device
+ * @plat_dat: platform data, already parsed by stmmac_probe_config_dt()
+ * @ioaddr: MAC register base, with the clocks already enabled
+ *
+ * Without snps,mtl-rx-config/snps,mtl-tx-config in the device tree the
+ * generic platform code falls back to a single RX and TX queue. In that case
+ * use as many queues as the core was synthesized with (bounded by the DMA
+ * channels and the CPUs), so that TX flows and RX NAPI contexts get spread.
+ */
+static void dwc_eth_dwmac_config_mtl(struct platform_device *pdev,
+				     struct plat_stmmacenet_data *plat_dat,
+				     void __iomem *ioaddr)
+{
+	struct device_node *np = pdev->dev.of_node;
+	u32 hw_cap, num_queues, prio;
+	u32 queue;
+
+	if (of_find_property(np, "snps,mtl-rx-config", NULL) ||
+	    of_find_property(np, "snps,mtl-tx-config", NULL))
+		return;
+
+	hw_cap = readl(ioaddr + GMAC_HW_FEATURE2);
+	num_queues = min3(((hw_cap & GMAC_HW_FEAT_RXQCNT) >> 0) + 1,
+			  ((hw_cap & GMAC_HW_FEAT_TXQCNT) >> 6) + 1,
+			  num_possible_cpus());
+	num_queues = min3(num_queues,
+			  ((hw_cap & GMAC_HW_FEAT_RXCHCNT) >> 12) + 1,
+			  ((hw_cap & GMAC_HW_FEAT_TXCHCNT) >> 18) + 1);
+	num_queues = min_t(u32, num_queues, MTL_MAX_RX_QUEUES);
+	if (num_queues <= 1)
+		return;
+
+	/* One DMA channel, and so one NAPI context, per queue pair */
+	plat_dat->rx_queues_to_use = num_queues;
+	plat_dat->tx_queues_to_use = num_queues;
+	plat_dat->rx_sched_algorithm = MTL_RX_ALGORITHM_SP;
+	plat_dat->tx_sched_algorithm = MTL_TX_ALGORITHM_WRR;
+
+	for (queue = 0; queue < num_queues; queue++) {
+		plat_dat->rx_queues_cfg[queue].mode_to_use = MTL_QUEUE_DCB;
+		plat_dat->rx_queues_cfg[queue].chan = queue;
+		plat_dat->rx_queues_cfg[queue].pkt_route = 0x0;
+
+		/**
+		 * The core has no RSS hash, so steer by VLAN user priority
+		 * instead: PCP values are dealt round-robin to the RX queues.
+		 * Untagged traffic stays on queue 0.
+		 */
+		plat_dat->rx_queues_cfg[queue].prio = 0;
+		for (prio = queue; prio < 8; prio += num_queues)
+			plat_dat->rx_queues_cfg[queue].prio |= BIT(prio);
+		plat_dat->rx_queues_cfg[queue].use_prio = true;
+
+		plat_dat->tx_queues_cfg[queue].mode_to_use = MTL_QUEUE_DCB;
+		plat_dat->tx_queues_cfg[queue].weight = 0x10;
+		plat_dat->tx_queues_cfg[queue].use_prio = false;
+	}
+
+	dev_info(&pdev->dev, "using %u RX/TX queues\n", num_queues);
+}
+
 static void *dwc_qos_probe(struct platform_device *pdev,
 			   struct plat_stmmacenet_data *plat_dat,
 			   struct stmmac_resources *stmmac_res)
@@ -463,6 +526,8 @@ static int dwc_eth_dwmac_probe(struct platform_device *pdev)
 	if (ret)
 		goto remove;
 
+	dwc_eth_dwmac_config_mtl(pdev, plat_dat, stmmac_res.addr);
+
 	ret = stmmac_dvr_probe(&pdev->dev, plat_dat, &stmmac_res);
 	if (ret)
 		goto remove;
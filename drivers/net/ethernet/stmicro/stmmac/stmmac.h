@@ -135,6 +135,17 @@ struct stmmac_priv {
 	u32 adv_ts;
 	int use_riwt;
 	int irq_wake;
+	struct bpf_prog *xdp_prog;
+
+	/* Adaptive interrupt moderation */
+	bool rx_coal_adaptive;
+	bool tx_coal_adaptive;
+	bool rx_riwt_off;
+	u32 rx_coal_level;
+	u32 tx_coal_level;
+	unsigned long coal_stamp;
+	unsigned long coal_last_rx;
+	unsigned long coal_last_tx;
 	spinlock_t ptp_lock;
 	void __iomem *mmcaddr;
 	void __iomem *ptpaddr;
@@ -151,6 +162,7 @@ int stmmac_mdio_unregister(struct net_device *ndev);
 int stmmac_mdio_register(struct net_device *ndev);
 int stmmac_mdio_reset(struct mii_bus *mii);
 void stmmac_set_ethtool_ops(struct net_device *netdev);
+void stmmac_coal_reset(struct stmmac_priv *priv);
 
 void stmmac_ptp_register(struct stmmac_priv *priv);
 void stmmac_ptp_unregister(struct stmmac_priv *priv);
@@ -90,6 +90,8 @@ static const struct stmmac_stats stmmac_gstrings_stats[] = {
 	STMMAC_STAT(threshold),
 	STMMAC_STAT(tx_pkt_n),
 	STMMAC_STAT(rx_pkt_n),
+	STMMAC_STAT(rx_xdp_drop),
+	STMMAC_STAT(rx_xdp_redirect),
 	STMMAC_STAT(normal_irq_n),
 	STMMAC_STAT(rx_normal_irq_n),
 	STMMAC_STAT(napi_poll),
@@ -727,6 +729,9 @@ static int stmmac_get_coalesce(struct net_device *dev,
 	if (priv->use_riwt)
 		ec->rx_coalesce_usecs = stmmac_riwt2usec(priv->rx_riwt, priv);
 
+	ec->use_adaptive_rx_coalesce = priv->rx_coal_adaptive;
+	ec->use_adaptive_tx_coalesce = priv->tx_coal_adaptive;
+
 	return 0;
 }
 
@@ -740,7 +745,6 @@ static int stmmac_set_coalesce(struct net_device *dev,
 	/* Check not supported parameters  */
 	if ((ec->rx_max_coalesced_frames) || (ec->rx_coalesce_usecs_irq) ||
 	    (ec->rx_max_coalesced_frames_irq) || (ec->tx_coalesce_usecs_irq) ||
-	    (ec->use_adaptive_rx_coalesce) || (ec->use_adaptive_tx_coalesce) ||
 	    (ec->pkt_rate_low) || (ec->rx_coalesce_usecs_low) ||
 	    (ec->rx_max_coalesced_frames_low) || (ec->tx_coalesce_usecs_high) ||
 	    (ec->tx_max_coalesced_frames_low) || (ec->pkt_rate_high) ||
@@ -769,12 +773,26 @@ static int stmmac_set_coalesce(struct net_device *dev,
 	else if (!priv->use_riwt)
 		return -EOPNOTSUPP;
 
+	/* The adaptive engine relies on the GMAC4 RX descriptors being fully
+	 * re-initialized on refill, to switch the per-frame interrupt.
+	 */
+	if ((ec->use_adaptive_rx_coalesce || ec->use_adaptive_tx_coalesce) &&
+	    (priv->synopsys_id < DWMAC_CORE_4_00))
+		return -EOPNOTSUPP;
+
 	/* Only copy relevant parameters, ignore all others. */
 	priv->tx_coal_frames = ec->tx_max_coalesced_frames;
 	priv->tx_coal_timer = ec->tx_coalesce_usecs;
 	priv->rx_riwt = rx_riwt;
 	priv->hw->dma->rx_watchdog(priv->ioaddr, priv->rx_riwt, rx_cnt);
 
+	/* (Re)start adaptation from the profiles matching the defaults, or
+	 * go back to the fixed values just programmed.
+	 */
+	priv->rx_coal_adaptive = ec->use_adaptive_rx_coalesce;
+	priv->tx_coal_adaptive = ec->use_adaptive_tx_coalesce;
+	stmmac_coal_reset(priv);
+
 	return 0;
 }
 
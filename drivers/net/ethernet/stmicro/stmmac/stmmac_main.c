@@ -39,6 +39,9 @@
 #include <linux/dma-mapping.h>
 #include <linux/slab.h>
 #include <linux/prefetch.h>
+#include <linux/bpf.h>
+#include <linux/bpf_trace.h>
+#include <linux/filter.h>
 #include <linux/pinctrl/consumer.h>
 #ifdef CONFIG_DEBUG_FS
 #include <linux/debugfs.h>
@@ -91,6 +94,11 @@ MODULE_PARM_DESC(buf_sz, "DMA buffer size");
 
 #define	STMMAC_RX_COPYBREAK	256
 
+/* RX buffer headroom when an XDP program is attached, so that the
+ * program sees XDP_PACKET_HEADROOM in front of the IP aligned frame.
+ */
+#define STMMAC_XDP_HEADROOM	(XDP_PACKET_HEADROOM + NET_IP_ALIGN)
+
 static const u32 default_msg_level = (NETIF_MSG_DRV | NETIF_MSG_PROBE |
 				      NETIF_MSG_LINK | NETIF_MSG_IFUP |
 				      NETIF_MSG_IFDOWN | NETIF_MSG_TIMER);
@@ -117,6 +125,28 @@ static void stmmac_exit_fs(struct net_device *dev);
 
 #define STMMAC_COAL_TIMER(x) (jiffies + usecs_to_jiffies(x))
 
+/* Adaptive interrupt moderation profiles, ordered by packet rate: at each
+ * sample the engine moves one step towards the first profile whose rate
+ * bound is not below the measured rate. A zero RIWT means an interrupt on
+ * every received frame (the RX watchdog is bypassed).
+ */
+struct stmmac_coal_profile {
+	u32 pkt_rate;	/* packets per second */
+	u32 rx_riwt;
+	u32 tx_frames;
+};
+
+static const struct stmmac_coal_profile stmmac_coal_profiles[] = {
+	{ 5000, 0, 1 },
+	{ 30000, MIN_DMA_RIWT, 8 },
+	{ 100000, 0x60, 32 },
+	{ 250000, 0xa0, STMMAC_TX_FRAMES },
+	{ UINT_MAX, MAX_DMA_RIWT, STMMAC_TX_MAX_FRAMES },
+};
+
+#define STMMAC_COAL_LEVELS	ARRAY_SIZE(stmmac_coal_profiles)
+#define STMMAC_COAL_SAMPLE_MS	100
+
 /**
  * stmmac_verify_args - verify the driver parameters.
  * Description: it checks the driver parameters and set a default in case of
@@ -1108,6 +1138,42 @@ static void stmmac_clear_descriptors(struct stmmac_priv *priv)
 		stmmac_clear_tx_descriptors(priv, queue);
 }
 
+/**
+ * stmmac_rx_alloc_skb - allocate an RX buffer
+ * @priv: driver private structure
+ * @flags: gfp flag
+ * Description: while an XDP program is attached, the skb head is always a
+ * page fragment with XDP headroom, so that XDP_REDIRECT can hand it over;
+ * a kmalloc'ed head (as __netdev_alloc_skb() may return for GFP_KERNEL)
+ * could not be redirected.
+ */
+static struct sk_buff *stmmac_rx_alloc_skb(struct stmmac_priv *priv,
+					   gfp_t flags)
+{
+	unsigned int size;
+	struct sk_buff *skb;
+	void *data;
+
+	if (!priv->xdp_prog)
+		return __netdev_alloc_skb_ip_align(priv->dev, priv->dma_buf_sz,
+						   flags);
+
+	size = SKB_DATA_ALIGN(STMMAC_XDP_HEADROOM + priv->dma_buf_sz) +
+	       SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
+	data = netdev_alloc_frag(size);
+	if (!data)
+		return NULL;
+
+	skb = build_skb(data, size);
+	if (!skb) {
+		skb_free_frag(data);
+		return NULL;
+	}
+	skb_reserve(skb, STMMAC_XDP_HEADROOM);
+	skb->dev = priv->dev;
+	return skb;
+}
+
 /**
  * stmmac_init_rx_buffers - init the RX descriptor buffer.
  * @priv: driver private structure
@@ -1124,7 +1190,7 @@ static int stmmac_init_rx_buffers(struct stmmac_priv *priv, struct dma_desc *p,
 	struct stmmac_rx_queue *rx_q = &priv->rx_queue[queue];
 	struct sk_buff *skb;
 
-	skb = __netdev_alloc_skb_ip_align(priv->dev, priv->dma_buf_sz, flags);
+	skb = stmmac_rx_alloc_skb(priv, flags);
 	if (!skb) {
 		netdev_err(priv->dev,
 			   "%s: Rx init fails; skb is NULL\n", __func__);
@@ -1799,9 +1865,11 @@ static void stmmac_tx_clean(struct stmmac_priv *priv, u32 queue)
 {
 	struct stmmac_tx_queue *tx_q = &priv->tx_queue[queue];
 	unsigned int bytes_compl = 0, pkts_compl = 0;
+	struct netdev_queue *txq = netdev_get_tx_queue(priv->dev, queue);
 	unsigned int entry;
 
-	netif_tx_lock(priv->dev);
+	/* Only this queue's xmit path races with us: don't freeze the others */
+	__netif_tx_lock_bh(txq);
 
 	priv->xstats.tx_clean++;
 
@@ -1870,23 +1938,21 @@ static void stmmac_tx_clean(struct stmmac_priv *priv, u32 queue)
 	}
 	tx_q->dirty_tx = entry;
 
-	netdev_tx_completed_queue(netdev_get_tx_queue(priv->dev, queue),
-				  pkts_compl, bytes_compl);
+	netdev_tx_completed_queue(txq, pkts_compl, bytes_compl);
 
-	if (unlikely(netif_tx_queue_stopped(netdev_get_tx_queue(priv->dev,
-								queue))) &&
+	if (unlikely(netif_tx_queue_stopped(txq)) &&
 	    stmmac_tx_avail(priv, queue) > STMMAC_TX_THRESH) {
 
 		netif_dbg(priv, tx_done, priv->dev,
 			  "%s: restart transmit\n", __func__);
-		netif_tx_wake_queue(netdev_get_tx_queue(priv->dev, queue));
+		netif_tx_wake_queue(txq);
 	}
 
 	if ((priv->eee_enabled) && (!priv->tx_path_in_lpi_mode)) {
 		stmmac_enable_eee_mode(priv);
 		mod_timer(&priv->eee_ctrl_timer, STMMAC_LPI_T(eee_timer));
 	}
-	netif_tx_unlock(priv->dev);
+	__netif_tx_unlock_bh(txq);
 }
 
 static inline void stmmac_enable_dma_irq(struct stmmac_priv *priv, u32 chan)
@@ -1970,19 +2036,29 @@ static void stmmac_set_dma_operation_mode(struct stmmac_priv *priv, u32 txmode,
  */
 static void stmmac_dma_interrupt(struct stmmac_priv *priv)
 {
+	u32 rx_channel_count = priv->plat->rx_queues_to_use;
 	u32 tx_channel_count = priv->plat->tx_queues_to_use;
+	u32 channel_count = max(rx_channel_count, tx_channel_count);
 	int status;
 	u32 chan;
 
-	for (chan = 0; chan < tx_channel_count; chan++) {
-		struct stmmac_rx_queue *rx_q = &priv->rx_queue[chan];
+	for (chan = 0; chan < channel_count; chan++) {
+		struct stmmac_rx_queue *rx_q;
 
 		status = priv->hw->dma->dma_interrupt(priv->ioaddr,
 						      &priv->xstats, chan);
 		if (likely((status & handle_rx)) || (status & handle_tx)) {
-			if (likely(napi_schedule_prep(&rx_q->napi))) {
-				stmmac_disable_dma_irq(priv, chan);
-				__napi_schedule(&rx_q->napi);
+			if (likely(chan < rx_channel_count)) {
+				rx_q = &priv->rx_queue[chan];
+				if (likely(napi_schedule_prep(&rx_q->napi))) {
+					stmmac_disable_dma_irq(priv, chan);
+					__napi_schedule(&rx_q->napi);
+				}
+			} else {
+				/* TX only channel: queue 0 polls all the TX
+				 * queues and never masks this channel.
+				 */
+				napi_schedule(&priv->rx_queue[0].napi);
 			}
 		}
 
@@ -2224,6 +2300,92 @@ static void stmmac_init_tx_coalesce(struct stmmac_priv *priv)
 	add_timer(&priv->txtimer);
 }
 
+/**
+ * stmmac_coal_reset - restart the adaptive interrupt moderation
+ * @priv: driver private structure
+ * Description: start from the profiles that match the static defaults
+ * (maximum RIWT, STMMAC_TX_FRAMES) and open a new sample period.
+ */
+void stmmac_coal_reset(struct stmmac_priv *priv)
+{
+	priv->rx_coal_level = STMMAC_COAL_LEVELS - 1;
+	priv->tx_coal_level = STMMAC_COAL_LEVELS - 2;
+	priv->rx_riwt_off = false;
+	priv->coal_last_rx = priv->xstats.rx_pkt_n;
+	priv->coal_last_tx = priv->xstats.tx_pkt_n;
+	priv->coal_stamp = jiffies;
+}
+
+static u32 stmmac_coal_step(u32 level, unsigned long rate)
+{
+	u32 target = 0;
+
+	while (target < STMMAC_COAL_LEVELS - 1 &&
+	       rate > stmmac_coal_profiles[target].pkt_rate)
+		target++;
+
+	/* one step per sample, to damp bursts */
+	if (target > level)
+		return level + 1;
+	if (target < level)
+		return level - 1;
+	return level;
+}
+
+/**
+ * stmmac_coal_adapt - adaptive interrupt moderation engine
+ * @priv: driver private structure
+ * Description: called on every NAPI poll; once per sample period, the
+ * first caller measures the RX and TX packet rates and picks the RIWT and
+ * the TX coalesce frame threshold from stmmac_coal_profiles.
+ */
+static void stmmac_coal_adapt(struct stmmac_priv *priv)
+{
+	unsigned long stamp = READ_ONCE(priv->coal_stamp);
+	unsigned long now = jiffies;
+	unsigned long rx_pkts, tx_pkts;
+	unsigned int elapsed;
+	u32 level;
+
+	if (likely(!priv->rx_coal_adaptive && !priv->tx_coal_adaptive))
+		return;
+
+	if (time_before(now, stamp + msecs_to_jiffies(STMMAC_COAL_SAMPLE_MS)))
+		return;
+
+	/* NAPI contexts of other queues may race us here */
+	if (cmpxchg(&priv->coal_stamp, stamp, now) != stamp)
+		return;
+
+	elapsed = jiffies_to_msecs(now - stamp) ? : 1;
+	rx_pkts = priv->xstats.rx_pkt_n - priv->coal_last_rx;
+	tx_pkts = priv->xstats.tx_pkt_n - priv->coal_last_tx;
+	priv->coal_last_rx = priv->xstats.rx_pkt_n;
+	priv->coal_last_tx = priv->xstats.tx_pkt_n;
+
+	if (priv->rx_coal_adaptive) {
+		level = stmmac_coal_step(priv->rx_coal_level,
+					 rx_pkts * MSEC_PER_SEC / elapsed);
+		if (level != priv->rx_coal_level) {
+			u32 riwt = stmmac_coal_profiles[level].rx_riwt;
+
+			priv->rx_coal_level = level;
+			/* takes effect as the RX descriptors get refilled */
+			priv->rx_riwt_off = !riwt;
+			priv->rx_riwt = riwt ? : MIN_DMA_RIWT;
+			priv->hw->dma->rx_watchdog(priv->ioaddr, priv->rx_riwt,
+						   priv->plat->rx_queues_to_use);
+		}
+	}
+
+	if (priv->tx_coal_adaptive) {
+		level = stmmac_coal_step(priv->tx_coal_level,
+					 tx_pkts * MSEC_PER_SEC / elapsed);
+		priv->tx_coal_level = level;
+		priv->tx_coal_frames = stmmac_coal_profiles[level].tx_frames;
+	}
+}
+
 static void stmmac_set_rings_length(struct stmmac_priv *priv)
 {
 	u32 rx_channels_count = priv->plat->rx_queues_to_use;
@@ -2586,6 +2748,7 @@ static int stmmac_open(struct net_device *dev)
 	}
 
 	stmmac_init_tx_coalesce(priv);
+	stmmac_coal_reset(priv);
 
 	if (dev->phydev)
 		phy_start(dev->phydev);
@@ -3213,7 +3376,7 @@ static inline void stmmac_rx_refill(struct stmmac_priv *priv, u32 queue)
 		if (likely(!rx_q->rx_skbuff[entry])) {
 			struct sk_buff *skb;
 
-			skb = netdev_alloc_skb_ip_align(priv->dev, bfsize);
+			skb = stmmac_rx_alloc_skb(priv, GFP_ATOMIC);
 			if (unlikely(!skb)) {
 				/* so for a while no zero-copy! */
 				rx_q->rx_zeroc_thresh = STMMAC_RX_THRESH;
@@ -3249,11 +3412,18 @@ static inline void stmmac_rx_refill(struct stmmac_priv *priv, u32 queue)
 
 			netif_dbg(priv, rx_status, priv->dev,
 				  "refill entry #%d\n", entry);
+		} else if (priv->synopsys_id >= DWMAC_CORE_4_00) {
+			/* Buffer kept in the ring (e.g. dropped by XDP): the
+			 * write-back descriptor format clobbered its address.
+			 */
+			p->des0 = cpu_to_le32(rx_q->rx_skbuff_dma[entry]);
+			p->des1 = 0;
 		}
 		dma_wmb();
 
 		if (unlikely(priv->synopsys_id >= DWMAC_CORE_4_00))
-			priv->hw->desc->init_rx_desc(p, priv->use_riwt, 0, 0);
+			priv->hw->desc->init_rx_desc(p, priv->use_riwt &&
+						     !priv->rx_riwt_off, 0, 0);
 		else
 			priv->hw->desc->set_rx_owner(p);
 
@@ -3264,6 +3434,70 @@ static inline void stmmac_rx_refill(struct stmmac_priv *priv, u32 queue)
 	rx_q->dirty_rx = entry;
 }
 
+/**
+ * stmmac_rx_xdp - run the XDP program on a received frame
+ * @priv: driver private structure
+ * @rx_q: RX queue
+ * @entry: ring entry holding the frame
+ * @prog: XDP program
+ * @frame_len: frame length, updated if the program moved the frame start
+ * Description: the program sees the frame in place, in the ring buffer.
+ * A dropped frame leaves its buffer in the ring, to be handed back to the
+ * DMA by stmmac_rx_refill() without any allocation. A redirected frame
+ * hands the page fragment of the buffer over to the target.
+ * Return: the XDP action; on XDP_PASS the skb path takes over the buffer.
+ */
+static u32 stmmac_rx_xdp(struct stmmac_priv *priv,
+			 struct stmmac_rx_queue *rx_q, unsigned int entry,
+			 struct bpf_prog *prog, int *frame_len)
+{
+	struct sk_buff *skb = rx_q->rx_skbuff[entry];
+	dma_addr_t dma = rx_q->rx_skbuff_dma[entry];
+	struct xdp_buff xdp;
+	u32 act;
+
+	dma_sync_single_for_cpu(priv->device, dma, *frame_len,
+				DMA_FROM_DEVICE);
+
+	xdp.data_hard_start = skb->head;
+	xdp.data = skb->data;
+	xdp.data_end = xdp.data + *frame_len;
+
+	act = bpf_prog_run_xdp(prog, &xdp);
+	switch (act) {
+	case XDP_PASS:
+		skb_reserve(skb, xdp.data - (void *)skb->data);
+		*frame_len = xdp.data_end - xdp.data;
+		return act;
+	case XDP_REDIRECT:
+		dma_unmap_single(priv->device, dma, priv->dma_buf_sz,
+				 DMA_FROM_DEVICE);
+		rx_q->rx_skbuff[entry] = NULL;
+		rx_q->rx_zeroc_thresh++;
+		if (!xdp_do_redirect(priv->dev, &xdp, prog)) {
+			/* the target owns the head fragment now */
+			kfree_skb_partial(skb, true);
+			priv->xstats.rx_xdp_redirect++;
+			return act;
+		}
+		trace_xdp_exception(priv->dev, prog, act);
+		dev_kfree_skb_any(skb);
+		priv->dev->stats.rx_dropped++;
+		return act;
+	default:
+		bpf_warn_invalid_xdp_action(act);
+		/* fall through */
+	case XDP_ABORTED:
+		trace_xdp_exception(priv->dev, prog, act);
+		/* fall through */
+	case XDP_DROP:
+		dma_sync_single_for_device(priv->device, dma, *frame_len,
+					   DMA_FROM_DEVICE);
+		priv->xstats.rx_xdp_drop++;
+		return XDP_DROP;
+	}
+}
+
 /**
  * stmmac_rx - manage the receive process
  * @priv: driver private structure
@@ -3277,9 +3511,14 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit, u32 queue)
 	struct stmmac_rx_queue *rx_q = &priv->rx_queue[queue];
 	unsigned int entry = rx_q->cur_rx;
 	int coe = priv->hw->rx_csum;
+	struct bpf_prog *xdp_prog;
+	bool xdp_redirect = false;
 	unsigned int next_entry;
 	unsigned int count = 0;
 
+	rcu_read_lock();
+	xdp_prog = READ_ONCE(priv->xdp_prog);
+
 	if (netif_msg_rx_status(priv)) {
 		void *rx_head;
 
@@ -3378,11 +3617,25 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit, u32 queue)
 						   frame_len, status);
 			}
 
+			if (xdp_prog && likely(rx_q->rx_skbuff[entry])) {
+				u32 act = stmmac_rx_xdp(priv, rx_q, entry,
+							xdp_prog, &frame_len);
+
+				if (act != XDP_PASS) {
+					if (act == XDP_REDIRECT)
+						xdp_redirect = true;
+					entry = next_entry;
+					continue;
+				}
+			}
+
 			/* The zero-copy is always used for all the sizes
 			 * in case of GMAC4 because it needs
 			 * to refill the used descriptors, always.
+			 * It is also used with XDP, which may have moved
+			 * the frame within the buffer.
 			 */
-			if (unlikely(!priv->plat->has_gmac4 &&
+			if (unlikely(!priv->plat->has_gmac4 && !xdp_prog &&
 				     ((frame_len < priv->rx_copybreak) ||
 				     stmmac_rx_threshold_count(rx_q)))) {
 				skb = netdev_alloc_skb_ip_align(priv->dev,
@@ -3454,6 +3707,10 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit, u32 queue)
 		entry = next_entry;
 	}
 
+	if (xdp_redirect)
+		xdp_do_flush_map();
+	rcu_read_unlock();
+
 	stmmac_rx_refill(priv, queue);
 
 	priv->xstats.rx_pkt_n += count;
@@ -3481,11 +3738,20 @@ static int stmmac_poll(struct napi_struct *napi, int budget)
 
 	priv->xstats.napi_poll++;
 
-	/* check all the queues */
-	for (queue = 0; queue < tx_count; queue++)
-		stmmac_tx_clean(priv, queue);
+	/* With one TX queue per RX queue, each DMA channel has its own NAPI
+	 * context: only reclaim the TX queue that shares the channel, so
+	 * that the contexts running on other CPUs don't contend for it.
+	 */
+	if (tx_count == priv->plat->rx_queues_to_use) {
+		stmmac_tx_clean(priv, chan);
+	} else {
+		/* check all the queues */
+		for (queue = 0; queue < tx_count; queue++)
+			stmmac_tx_clean(priv, queue);
+	}
 
 	work_done = stmmac_rx(priv, budget, rx_q->queue_index);
+	stmmac_coal_adapt(priv);
 	if (work_done < budget) {
 		napi_complete_done(napi, work_done);
 		stmmac_enable_dma_irq(priv, chan);
@@ -3548,6 +3814,12 @@ static int stmmac_change_mtu(struct net_device *dev, int new_mtu)
 		return -EBUSY;
 	}
 
+	if (priv->xdp_prog && new_mtu > ETH_DATA_LEN) {
+		netdev_err(priv->dev, "MTU > %d not supported with XDP\n",
+			   ETH_DATA_LEN);
+		return -EINVAL;
+	}
+
 	dev->mtu = new_mtu;
 
 	netdev_update_features(dev);
@@ -3938,6 +4210,61 @@ static void stmmac_exit_fs(struct net_device *dev)
 }
 #endif /* CONFIG_DEBUG_FS */
 
+static int stmmac_xdp_setup(struct net_device *dev, struct bpf_prog *prog)
+{
+	struct stmmac_priv *priv = netdev_priv(dev);
+	bool reset = !priv->xdp_prog != !prog && netif_running(dev);
+	struct bpf_prog *old_prog;
+	int ret = 0;
+
+	/* RX buffers must be single page fragments for XDP_REDIRECT */
+	if (prog && dev->mtu > ETH_DATA_LEN) {
+		netdev_err(dev, "MTU > %d not supported with XDP\n",
+			   ETH_DATA_LEN);
+		return -EOPNOTSUPP;
+	}
+
+	/* Attaching or detaching changes the RX buffer layout */
+	if (reset)
+		stmmac_release(dev);
+
+	old_prog = xchg(&priv->xdp_prog, prog);
+
+	if (reset) {
+		ret = stmmac_open(dev);
+		if (ret) {
+			netdev_err(dev, "failed to restart with%s XDP: %d\n",
+				   prog ? "" : "out", ret);
+			/* bring the device back up as it was */
+			xchg(&priv->xdp_prog, old_prog);
+			if (stmmac_open(dev))
+				netdev_err(dev, "failed to restart, bring it down and up again\n");
+			return ret;
+		}
+	}
+
+	if (old_prog)
+		bpf_prog_put(old_prog);
+
+	return 0;
+}
+
+static int stmmac_xdp(struct net_device *dev, struct netdev_xdp *xdp)
+{
+	struct stmmac_priv *priv = netdev_priv(dev);
+
+	switch (xdp->command) {
+	case XDP_SETUP_PROG:
+		return stmmac_xdp_setup(dev, xdp->prog);
+	case XDP_QUERY_PROG:
+		xdp->prog_attached = !!priv->xdp_prog;
+		xdp->prog_id = priv->xdp_prog ? priv->xdp_prog->aux->id : 0;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
 static const struct net_device_ops stmmac_netdev_ops = {
 	.ndo_open = stmmac_open,
 	.ndo_start_xmit = stmmac_xmit,
@@ -3952,6 +4279,7 @@ static const struct net_device_ops stmmac_netdev_ops = {
 	.ndo_poll_controller = stmmac_poll_controller,
 #endif
 	.ndo_set_mac_address = eth_mac_addr,
+	.ndo_xdp = stmmac_xdp,
 };
 
 /**
@@ -4140,6 +4468,17 @@ int stmmac_dvr_probe(struct device *device,
 	netif_set_real_num_rx_queues(ndev, priv->plat->rx_queues_to_use);
 	netif_set_real_num_tx_queues(ndev, priv->plat->tx_queues_to_use);
 
+	/* Spread the TX queues over the CPUs, so that senders on different
+	 * CPUs don't serialize on one queue lock.
+	 */
+	if (priv->plat->tx_queues_to_use > 1) {
+		for (queue = 0; queue < priv->plat->tx_queues_to_use; queue++)
+			netif_set_xps_queue(ndev,
+				cpumask_of(cpumask_local_spread(queue,
+						dev_to_node(device))),
+				queue);
+	}
+
 	ndev->netdev_ops = &stmmac_netdev_ops;
 
 	ndev->hw_features = NETIF_F_SG | NETIF_F_IP_CSUM | NETIF_F_IPV6_CSUM |
@@ -4277,6 +4616,8 @@ int stmmac_dvr_remove(struct device *dev)
 	    priv->hw->pcs != STMMAC_PCS_TBI &&
 	    priv->hw->pcs != STMMAC_PCS_RTBI)
 		stmmac_mdio_unregister(ndev);
+	if (priv->xdp_prog)
+		bpf_prog_put(priv->xdp_prog);
 	free_netdev(ndev);
 
 	return 0;
@@ -4408,6 +4749,7 @@ int stmmac_resume(struct device *dev)
 
 	stmmac_hw_setup(ndev, false);
 	stmmac_init_tx_coalesce(priv);
+	stmmac_coal_reset(priv);
 	stmmac_set_rx_mode(ndev);
 
 	stmmac_enable_all_queues(priv);
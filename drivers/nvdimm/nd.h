@@ -166,6 +166,7 @@ struct nd_region {
 	struct badblocks bb;
 	struct nd_interleave_set *nd_set;
 	struct nd_percpu_lane __percpu *lane;
+	void (*flush)(struct nd_region *nd_region);
 	struct nd_mapping mapping[0];
 };
 
@@ -0,0 +1,429 @@
+/*
+ * HPSC Chiplet remote processor driver
+ *
+ * Exposes the RTPS (or TRCH) subsystem to the remoteproc/rpmsg framework.
+ * The remote software image is loaded and released from reset by TRCH, so
+ * this driver never touches the remote's code memory. It only:
+ *
+ *  - declares a reserved shared memory region (from the device tree) as the
+ *    DMA pool of the rproc device, so that vrings and rpmsg buffers are
+ *    allocated where the remote can reach them (around the resource table,
+ *    which also lives there),
+ *  - publishes the resource table into the copy that the remote firmware
+ *    keeps in that shared memory region, and
+ *  - maps virtqueue kicks onto a pair of HPSC mailbox instances: one
+ *    outbound (HPPS -> remote) and one inbound (remote -> HPPS).
+ *
+ * The firmware file requested by the remoteproc core is only parsed for its
+ * resource table; its loadable segments are ignored.
+ */
+#include <linux/atomic.h>
+#include <linux/bitops.h>
+#include <linux/dma-mapping.h>
+#include <linux/err.h>
+#include <linux/io.h>
+#include <linux/kernel.h>
+#include <linux/mailbox_client.h>
+#include <linux/module.h>
+#include <linux/of.h>
+#include <linux/of_address.h>
+#include <linux/platform_device.h>
+#include <linux/remoteproc.h>
+#include <linux/workqueue.h>
+
+#include "remoteproc_internal.h"
+
+#define DT_MBOX_OUT	0
+#define DT_MBOX_IN	1
+#define DT_MBOX_COUNT	2
+
+#define HPSC_MBOX_MSG_LEN	64
+#define HPSC_RPROC_MAX_VQS	8
+
+/* Layout of the (64 byte) mailbox message that carries a kick */
+#define HPSC_RPROC_MSG_MAGIC	0x52505243 /* "RPRC" */
+#define HPSC_RPROC_MSG_W_MAGIC	0
+#define HPSC_RPROC_MSG_W_VQID	1
+
+struct hpsc_rproc {
+	struct rproc		*rproc;
+	struct device		*dev;
+
+	struct mbox_client	cl_out;
+	struct mbox_client	cl_in;
+	struct mbox_chan	*chan_out;
+	struct mbox_chan	*chan_in;
+
+	/* one static message per vring, valid until the controller sends it */
+	u32			kick_msg[HPSC_RPROC_MAX_VQS]
+					[HPSC_MBOX_MSG_LEN / sizeof(u32)];
+	/* a kick for the vring is queued, but not yet handed to the mailbox */
+	unsigned long		kick_pending;
+
+	struct work_struct	vq_work;
+
+	/* reserved shared memory: vrings, buffers, loaded resource table */
+	phys_addr_t		shm_pa;
+	size_t			shm_size;
+	void			*shm_va;
+
+	struct rproc_fw_ops	fw_ops;
+	const struct rproc_fw_ops *default_fw_ops;
+};
+
+static int hpsc_rproc_vq_notify_cb(int id, void *ptr, void *data)
+{
+	struct rproc *rproc = data;
+
+	rproc_vq_interrupt(rproc, id);
+	return 0;
+}
+
+static void hpsc_rproc_vq_work(struct work_struct *work)
+{
+	struct hpsc_rproc *hrproc = container_of(work, struct hpsc_rproc,
+						 vq_work);
+	struct rproc *rproc = hrproc->rproc;
+
+	// The remote may coalesce several kicks into one mailbox event, so
+	// don't trust the vqid in the message and poll all vrings instead:
+	// a vring with nothing pending returns right away.
+	idr_for_each(&rproc->notifyids, hpsc_rproc_vq_notify_cb, rproc);
+}
+
+static void hpsc_rproc_rx_callback(struct mbox_client *cl, void *msg)
+{
+	struct hpsc_rproc *hrproc = container_of(cl, struct hpsc_rproc, cl_in);
+
+	// tell the controller to issue the ACK so the remote may kick again
+	mbox_send_message(hrproc->chan_in, NULL);
+	// vring callbacks may sleep, and we're in the mailbox ISR
+	schedule_work(&hrproc->vq_work);
+}
+
+static void hpsc_rproc_tx_prepare(struct mbox_client *cl, void *msg)
+{
+	struct hpsc_rproc *hrproc = container_of(cl, struct hpsc_rproc,
+						 cl_out);
+	u32 *words = msg;
+
+	// The remote sees all vring updates made so far once this kick is
+	// written to the mailbox, so later updates need a kick of their own.
+	clear_bit(words[HPSC_RPROC_MSG_W_VQID], &hrproc->kick_pending);
+	smp_mb__after_atomic();
+}
+
+static void hpsc_rproc_tx_done(struct mbox_client *cl, void *msg, int r)
+{
+	struct hpsc_rproc *hrproc = container_of(cl, struct hpsc_rproc,
+						 cl_out);
+	u32 *words = msg;
+
+	if (r)
+		dev_dbg(hrproc->dev, "kick vq %u: got NACK: %d\n",
+			words[HPSC_RPROC_MSG_W_VQID], r);
+}
+
+static void hpsc_rproc_kick(struct rproc *rproc, int vqid)
+{
+	struct hpsc_rproc *hrproc = rproc->priv;
+	int ret;
+
+	if (vqid < 0 || vqid >= HPSC_RPROC_MAX_VQS) {
+		dev_err(hrproc->dev, "kick: invalid vq id: %d\n", vqid);
+		return;
+	}
+
+	// If a kick for this vring is still queued, the remote will see the
+	// new buffers when it handles that one: don't queue another.
+	if (test_and_set_bit(vqid, &hrproc->kick_pending))
+		return;
+
+	// make the vring updates visible before the remote is notified
+	wmb();
+	ret = mbox_send_message(hrproc->chan_out, hrproc->kick_msg[vqid]);
+	if (ret < 0) {
+		dev_err(hrproc->dev, "kick vq %d: failed to send: %d\n",
+			vqid, ret);
+		clear_bit(vqid, &hrproc->kick_pending);
+	}
+}
+
+static int hpsc_rproc_start(struct rproc *rproc)
+{
+	// TRCH has already released the remote from reset; it finds the vrings
+	// via the resource table, which the core has just copied into the
+	// shared memory.
+	dev_dbg(rproc->dev.parent, "start\n");
+	return 0;
+}
+
+static int hpsc_rproc_stop(struct rproc *rproc)
+{
+	struct hpsc_rproc *hrproc = rproc->priv;
+
+	// the remote keeps running (its lifecycle belongs to TRCH), but there
+	// is nobody to deliver its kicks to anymore
+	dev_dbg(rproc->dev.parent, "stop\n");
+	cancel_work_sync(&hrproc->vq_work);
+	return 0;
+}
+
+static void *hpsc_rproc_da_to_va(struct rproc *rproc, u64 da, int len)
+{
+	struct hpsc_rproc *hrproc = rproc->priv;
+
+	// device addresses are physical addresses in the HPSC Chiplet
+	if (len <= 0 || da < hrproc->shm_pa ||
+	    da + len > hrproc->shm_pa + hrproc->shm_size)
+		return NULL;
+	return hrproc->shm_va + (da - hrproc->shm_pa);
+}
+
+static const struct rproc_ops hpsc_rproc_ops = {
+	.start		= hpsc_rproc_start,
+	.stop		= hpsc_rproc_stop,
+	.kick		= hpsc_rproc_kick,
+	.da_to_va	= hpsc_rproc_da_to_va,
+};
+
+/*
+ * The loaded resource table lives in the shared memory region too: keep
+ * vrings and buffers from being allocated over it.
+ */
+static int hpsc_rproc_reserve_rsc_table(struct hpsc_rproc *hrproc,
+					const struct firmware *fw)
+{
+	const struct rproc_fw_ops *ops = hrproc->default_fw_ops;
+	struct resource_table *table;
+	dma_addr_t da, end;
+	void *va;
+	int tablesz;
+
+	if (!ops->find_rsc_table(hrproc->rproc, fw, &tablesz))
+		return 0; // no table, no vrings either
+	table = ops->find_loaded_rsc_table(hrproc->rproc, fw);
+	if (!table) {
+		dev_err(hrproc->dev, "loaded resource table not in shared memory\n");
+		return -EINVAL;
+	}
+
+	// page by page, since the pool hands out naturally aligned blocks
+	da = hrproc->shm_pa + ((void *)table - hrproc->shm_va);
+	end = da + tablesz;
+	for (da &= PAGE_MASK; da < end; da += PAGE_SIZE) {
+		va = dma_mark_declared_memory_occupied(hrproc->dev, da,
+						       PAGE_SIZE);
+		if (IS_ERR(va)) {
+			dev_err(hrproc->dev,
+				"failed to reserve resource table: %ld\n",
+				PTR_ERR(va));
+			return PTR_ERR(va);
+		}
+	}
+	return 0;
+}
+
+static int hpsc_rproc_fw_sanity_check(struct rproc *rproc,
+				      const struct firmware *fw)
+{
+	struct hpsc_rproc *hrproc = rproc->priv;
+	int ret;
+
+	ret = hrproc->default_fw_ops->sanity_check(rproc, fw);
+	if (ret)
+		return ret;
+
+	// This is the first hook of every boot. The core releases the declared
+	// memory of the parent device on each shutdown, so declare the shared
+	// memory region as the DMA pool here, before vrings are allocated.
+	ret = dma_declare_coherent_memory(hrproc->dev, hrproc->shm_pa,
+					  hrproc->shm_pa, hrproc->shm_size,
+					  DMA_MEMORY_EXCLUSIVE);
+	if (ret == -EBUSY)
+		return 0; // still declared, along with the table's pages
+	if (ret) {
+		dev_err(hrproc->dev, "failed to declare shared memory: %d\n",
+			ret);
+		return ret;
+	}
+
+	ret = hpsc_rproc_reserve_rsc_table(hrproc, fw);
+	if (ret)
+		dma_release_declared_memory(hrproc->dev);
+	return ret;
+}
+
+static int hpsc_rproc_fw_load(struct rproc *rproc, const struct firmware *fw)
+{
+	// the remote's image has been loaded by TRCH
+	return 0;
+}
+
+static int hpsc_rproc_mbox_open(struct hpsc_rproc *hrproc)
+{
+	struct device *dev = hrproc->dev;
+
+	hrproc->cl_out.dev = dev;
+	hrproc->cl_out.tx_prepare = hpsc_rproc_tx_prepare;
+	hrproc->cl_out.tx_done = hpsc_rproc_tx_done;
+	hrproc->cl_out.tx_block = false;
+	hrproc->cl_out.knows_txdone = false;
+	hrproc->chan_out = mbox_request_channel(&hrproc->cl_out, DT_MBOX_OUT);
+	if (IS_ERR(hrproc->chan_out)) {
+		dev_err(dev, "failed to request outbound mailbox\n");
+		return PTR_ERR(hrproc->chan_out);
+	}
+
+	// may receive a kick right away, so open after outbound is ready
+	hrproc->cl_in.dev = dev;
+	hrproc->cl_in.rx_callback = hpsc_rproc_rx_callback;
+	hrproc->cl_in.tx_block = false;
+	hrproc->cl_in.knows_txdone = false;
+	hrproc->chan_in = mbox_request_channel(&hrproc->cl_in, DT_MBOX_IN);
+	if (IS_ERR(hrproc->chan_in)) {
+		dev_err(dev, "failed to request inbound mailbox\n");
+		mbox_free_channel(hrproc->chan_out);
+		return PTR_ERR(hrproc->chan_in);
+	}
+	return 0;
+}
+
+static int hpsc_rproc_get_shm(struct hpsc_rproc *hrproc)
+{
+	struct device *dev = hrproc->dev;
+	struct device_node *np;
+	struct resource res;
+	int ret;
+
+	np = of_parse_phandle(dev->of_node, "memory-region", 0);
+	if (!np) {
+		dev_err(dev, "no 'memory-region' specified\n");
+		return -EINVAL;
+	}
+	ret = of_address_to_resource(np, 0, &res);
+	of_node_put(np);
+	if (ret) {
+		dev_err(dev, "failed to resolve 'memory-region'\n");
+		return ret;
+	}
+
+	hrproc->shm_pa = res.start;
+	hrproc->shm_size = resource_size(&res);
+	// this mapping is only used to access the loaded resource table
+	hrproc->shm_va = devm_memremap(dev, hrproc->shm_pa, hrproc->shm_size,
+				       MEMREMAP_WC);
+	if (IS_ERR(hrproc->shm_va)) {
+		dev_err(dev, "failed to map shared memory\n");
+		return PTR_ERR(hrproc->shm_va);
+	}
+	dev_info(dev, "shared memory: %pa, size 0x%zx\n", &hrproc->shm_pa,
+		 hrproc->shm_size);
+	return 0;
+}
+
+static int hpsc_rproc_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct hpsc_rproc *hrproc;
+	struct rproc *rproc;
+	const char *fw_name = NULL;
+	int num_chans;
+	int i;
+	int ret;
+
+	num_chans = of_count_phandle_with_args(dev->of_node, "mboxes",
+					       "#mbox-cells");
+	if (num_chans != DT_MBOX_COUNT) {
+		dev_err(dev, "Num instances in 'mboxes' property != %d: %d\n",
+			DT_MBOX_COUNT, num_chans);
+		return -EINVAL;
+	}
+
+	of_property_read_string(dev->of_node, "firmware-name", &fw_name);
+
+	rproc = rproc_alloc(dev, dev_name(dev), &hpsc_rproc_ops, fw_name,
+			    sizeof(*hrproc));
+	if (!rproc)
+		return -ENOMEM;
+
+	hrproc = rproc->priv;
+	hrproc->rproc = rproc;
+	hrproc->dev = dev;
+	INIT_WORK(&hrproc->vq_work, hpsc_rproc_vq_work);
+	for (i = 0; i < HPSC_RPROC_MAX_VQS; i++) {
+		hrproc->kick_msg[i][HPSC_RPROC_MSG_W_MAGIC] =
+			HPSC_RPROC_MSG_MAGIC;
+		hrproc->kick_msg[i][HPSC_RPROC_MSG_W_VQID] = i;
+	}
+	platform_set_drvdata(pdev, rproc);
+
+	ret = dma_set_coherent_mask(dev, DMA_BIT_MASK(32));
+	if (ret) {
+		dev_err(dev, "dma_set_coherent_mask: %d\n", ret);
+		goto free_rproc;
+	}
+
+	ret = hpsc_rproc_get_shm(hrproc);
+	if (ret)
+		goto free_rproc;
+
+	// parse the ELF for the resource table only, but don't load it
+	memcpy(&hrproc->fw_ops, rproc->fw_ops, sizeof(hrproc->fw_ops));
+	hrproc->fw_ops.sanity_check = hpsc_rproc_fw_sanity_check;
+	hrproc->fw_ops.load = hpsc_rproc_fw_load;
+	hrproc->default_fw_ops = rproc->fw_ops;
+	rproc->fw_ops = &hrproc->fw_ops;
+
+	ret = hpsc_rproc_mbox_open(hrproc);
+	if (ret)
+		goto free_rproc;
+
+	ret = rproc_add(rproc);
+	if (ret) {
+		dev_err(dev, "rproc registration failed: %d\n", ret);
+		goto free_mbox;
+	}
+	return 0;
+
+free_mbox:
+	mbox_free_channel(hrproc->chan_in);
+	mbox_free_channel(hrproc->chan_out);
+	cancel_work_sync(&hrproc->vq_work);
+free_rproc:
+	rproc_free(rproc);
+	return ret;
+}
+
+static int hpsc_rproc_remove(struct platform_device *pdev)
+{
+	struct rproc *rproc = platform_get_drvdata(pdev);
+	struct hpsc_rproc *hrproc = rproc->priv;
+
+	rproc_del(rproc);
+	mbox_free_channel(hrproc->chan_in);
+	mbox_free_channel(hrproc->chan_out);
+	cancel_work_sync(&hrproc->vq_work);
+	dma_release_declared_memory(&pdev->dev);
+	rproc_free(rproc);
+	return 0;
+}
+
+static const struct of_device_id hpsc_rproc_match[] = {
+	{ .compatible = "hpsc,hpsc-rproc" },
+	{},
+};
+MODULE_DEVICE_TABLE(of, hpsc_rproc_match);
+
+static struct platform_driver hpsc_rproc_driver = {
+	.driver = {
+		.name = "hpsc_rproc",
+		.of_match_table = hpsc_rproc_match,
+	},
+	.probe  = hpsc_rproc_probe,
+	.remove = hpsc_rproc_remove,
+};
+module_platform_driver(hpsc_rproc_driver);
+
+MODULE_DESCRIPTION("HPSC remote processor driver");
+MODULE_LICENSE("GPL v2");
@@ -4,6 +4,7 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/notifier.h>
+#include <linux/trace.h>
 #include "hpsc_msg.h"
 #include "hpsc_notif.h"
 
@@ -55,6 +56,7 @@ int hpsc_notif_recv(const void *msg, size_t sz)
 	// processing to send response (or new) messages before returning here.
 	pr_debug("hpsc-notif: receive\n");
 	BUG_ON(sz != HPSC_MSG_SIZE);
+	trace_hwlat_msg_event();
 	return hpsc_msg_process(msg, sz);
 }
 EXPORT_SYMBOL_GPL(hpsc_notif_recv);
@@ -66,6 +68,7 @@ int hpsc_notif_send(void *msg, size_t sz)
 	int ret;
 	pr_debug("hpsc-notif: send\n");
 	BUG_ON(sz != HPSC_MSG_SIZE);
+	trace_hwlat_msg_event();
 	for (i = 0; i <= retries; i++) {
 		ret = __atomic_notifier_call_chain(&notif_handlers, 0, msg, -1,
 						   &nr_calls);
@@ -1,27 +1,44 @@
 /*
  * HPSC shared memory module - provides device files to be mmap'd by userspace.
  * Memory regions should be reserved physical addresses with fixed size.
+ * The hardware spinlocks listed in a region's 'hwlocks' can be taken and
+ * released with ioctls on its device file (see uapi/linux/hpsc_shmem.h).
  */
 #include <linux/cdev.h>
+#include <linux/delay.h>
 #include <linux/device.h>
 #include <linux/err.h>
 #include <linux/fs.h>
+#include <linux/hpsc_shmem.h>
+#include <linux/hwspinlock.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/mm.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/of.h>
 #include <linux/of_address.h>
 #include <linux/platform_device.h>
+#include <linux/sched/signal.h>
+#include <linux/uaccess.h>
 
 #define SHMEM_DEVICE_NAME "hpsc_shmem"
 
+struct hpsc_shmem_hwlock {
+	struct hwspinlock *hwlock;
+	struct file *holder;	// file the lock was taken through, if taken
+};
+
 struct hpsc_shmem_dev {
 	struct device *dev;
 	resource_size_t paddr;
 	resource_size_t size;
 	int major_num;
 	struct cdev cdev;
+	// locks are taken in raw mode, so serialize local users here
+	struct mutex lock;
+	struct hpsc_shmem_hwlock *locks;
+	int num_locks;
 };
 
 // To support multiple instances, manage class at module init/exit
@@ -65,17 +82,147 @@ static int shmem_release(struct inode *inode, struct file *filp)
 {
 	struct hpsc_shmem_dev *tdev = container_of(inode->i_cdev,
 						   struct hpsc_shmem_dev, cdev);
+	int i;
 	dev_dbg(tdev->dev, "release\n");
+	// don't leave the other subsystems waiting on a dead process
+	mutex_lock(&tdev->lock);
+	for (i = 0; i < tdev->num_locks; i++) {
+		if (tdev->locks[i].holder == filp) {
+			dev_warn(tdev->dev, "release: dropping lock %d\n", i);
+			hwspin_unlock_raw(tdev->locks[i].hwlock);
+			tdev->locks[i].holder = NULL;
+		}
+	}
+	mutex_unlock(&tdev->lock);
 	filp->private_data = NULL;
 	return 0;
 }
 
+static int shmem_lock(struct hpsc_shmem_dev *tdev, struct file *filp,
+		      const struct hpsc_shmem_lock *req)
+{
+	unsigned long expire = jiffies + msecs_to_jiffies(req->timeout_ms);
+	struct hpsc_shmem_hwlock *l;
+	int ret;
+	if (req->index >= tdev->num_locks)
+		return -EINVAL;
+	l = &tdev->locks[req->index];
+	for (;;) {
+		mutex_lock(&tdev->lock);
+		if (l->holder == filp)
+			ret = -EDEADLK;
+		else if (l->holder)
+			ret = -EBUSY;
+		else
+			ret = hwspin_trylock_raw(l->hwlock);
+		if (!ret)
+			l->holder = filp;
+		mutex_unlock(&tdev->lock);
+
+		if (ret != -EBUSY)
+			return ret;
+		if (time_is_before_eq_jiffies(expire))
+			return req->timeout_ms ? -ETIMEDOUT : -EBUSY;
+		if (signal_pending(current))
+			return -EINTR;
+		// the holder may be another subsystem, don't hog the CPU
+		usleep_range(50, 100);
+	}
+}
+
+static int shmem_unlock(struct hpsc_shmem_dev *tdev, struct file *filp,
+			u32 index)
+{
+	struct hpsc_shmem_hwlock *l;
+	int ret = 0;
+	if (index >= tdev->num_locks)
+		return -EINVAL;
+	l = &tdev->locks[index];
+	mutex_lock(&tdev->lock);
+	if (l->holder == filp) {
+		hwspin_unlock_raw(l->hwlock);
+		l->holder = NULL;
+	} else {
+		ret = -EPERM;
+	}
+	mutex_unlock(&tdev->lock);
+	return ret;
+}
+
+static long shmem_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	struct hpsc_shmem_dev *tdev = filp->private_data;
+	void __user *argp = (void __user *)arg;
+	struct hpsc_shmem_lock req;
+	u32 index;
+	switch (cmd) {
+	case HPSC_SHMEM_IOC_NUM_LOCKS:
+		return put_user(tdev->num_locks, (u32 __user *)argp);
+	case HPSC_SHMEM_IOC_LOCK:
+		if (copy_from_user(&req, argp, sizeof(req)))
+			return -EFAULT;
+		return shmem_lock(tdev, filp, &req);
+	case HPSC_SHMEM_IOC_UNLOCK:
+		if (get_user(index, (u32 __user *)argp))
+			return -EFAULT;
+		return shmem_unlock(tdev, filp, index);
+	default:
+		return -ENOTTY;
+	}
+}
+
 static const struct file_operations shmem_fops = {
 	.mmap = shmem_mmap,
 	.open = shmem_open,
 	.release = shmem_release,
+	.unlocked_ioctl = shmem_ioctl,
 };
 
+static void hpsc_shmem_put_hwlocks(struct hpsc_shmem_dev *tdev)
+{
+	int i;
+	for (i = 0; i < tdev->num_locks; i++)
+		hwspin_lock_free(tdev->locks[i].hwlock);
+	tdev->num_locks = 0;
+}
+
+// Request the locks in the 'hwlocks' DT property, all for exclusive use here.
+// The locks are optional: the region is still usable without them, and the
+// lock provider may be disabled (in which case the lookup would defer
+// forever), so a failure only leaves the region with no locks.
+static int hpsc_shmem_get_hwlocks(struct hpsc_shmem_dev *tdev)
+{
+	struct device_node *np = tdev->dev->of_node;
+	struct hwspinlock *hwlock;
+	int n, i, id;
+	n = of_count_phandle_with_args(np, "hwlocks", "#hwlock-cells");
+	if (n <= 0)
+		return 0;
+	tdev->locks = devm_kcalloc(tdev->dev, n, sizeof(*tdev->locks),
+				   GFP_KERNEL);
+	if (!tdev->locks)
+		return -ENOMEM;
+	for (i = 0; i < n; i++) {
+		id = of_hwspin_lock_get_id(np, i);
+		if (id < 0) {
+			dev_warn(tdev->dev, "DT 'hwlocks' %d unavailable: %d, continuing without locks\n",
+				 i, id);
+			hpsc_shmem_put_hwlocks(tdev);
+			return 0;
+		}
+		hwlock = hwspin_lock_request_specific(id);
+		if (IS_ERR_OR_NULL(hwlock)) {
+			dev_warn(tdev->dev, "failed to request hwlock %d, continuing without locks\n",
+				 id);
+			hpsc_shmem_put_hwlocks(tdev);
+			return 0;
+		}
+		tdev->locks[i].hwlock = hwlock;
+		tdev->num_locks++;
+	}
+	return 0;
+}
+
 static int hpsc_shmem_parse_dt(struct hpsc_shmem_dev *tdev, const char **name)
 {
 	struct device_node *np;
@@ -115,17 +262,22 @@ static int hpsc_shmem_probe(struct platform_device *pdev)
 	if (!tdev)
 		return -ENOMEM;
 	tdev->dev = &pdev->dev;
+	mutex_init(&tdev->lock);
 	platform_set_drvdata(pdev, tdev);
 
 	ret = hpsc_shmem_parse_dt(tdev, &name);
 	if (ret)
 		return ret;
 
+	ret = hpsc_shmem_get_hwlocks(tdev);
+	if (ret)
+		return ret;
+
 	// create device file
 	ret = alloc_chrdev_region(&devno, 0, 1, SHMEM_DEVICE_NAME);
 	if (ret < 0) {
 		dev_err(tdev->dev, "alloc_chrdev_region failed\n");
-		return ret;
+		goto fail_chrdev;
 	}
 	tdev->major_num = MAJOR(devno);
 	cdev_init(&tdev->cdev, &shmem_fops);
@@ -142,13 +294,15 @@ static int hpsc_shmem_probe(struct platform_device *pdev)
 		goto fail_dev;
 	}
 
-	dev_info(tdev->dev, "registered paddr=0x%llx, size=0x%llx\n",
-		 tdev->paddr, tdev->size);
+	dev_info(tdev->dev, "registered paddr=0x%llx, size=0x%llx, locks=%d\n",
+		 tdev->paddr, tdev->size, tdev->num_locks);
 	return 0;
 fail_dev:
 	cdev_del(&tdev->cdev);
 fail_cdev:
 	unregister_chrdev_region(MKDEV(tdev->major_num, 0), 1);
+fail_chrdev:
+	hpsc_shmem_put_hwlocks(tdev);
 	return ret;
 }
 
@@ -160,6 +314,7 @@ static int hpsc_shmem_remove(struct platform_device *pdev)
 	device_destroy(class, MKDEV(tdev->major_num, 0));
 	cdev_del(&tdev->cdev);
 	unregister_chrdev_region(MKDEV(tdev->major_num, 0), 1);
+	hpsc_shmem_put_hwlocks(tdev);
 	return 0;
 }
 
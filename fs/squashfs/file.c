@@ -46,6 +46,7 @@
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/pagemap.h>
+#include <linux/mm_inline.h>
 #include <linux/mutex.h>
 
 #include "squashfs_fs.h"
@@ -497,7 +498,106 @@ static int squashfs_readpage(struct file *file, struct page *page)
 	return 0;
 }
 
+#ifdef CONFIG_SQUASHFS_READAHEAD_PARALLEL
+/*
+ * Release pages grabbed for a datablock which is not read ahead.  They
+ * are left in the page cache, not uptodate, and squashfs_readpage() reads
+ * them when they are accessed.
+ */
+static void squashfs_release_pages(struct page **page, int pages)
+{
+	int i;
+
+	for (i = 0; i < pages; i++) {
+		if (page[i] == NULL)
+			continue;
+		unlock_page(page[i]);
+		put_page(page[i]);
+	}
+}
+
+/*
+ * Read ahead the datablocks covered by @pages.  All the pages of each
+ * datablock are added to the page cache and locked, and the datablock is
+ * then handed over to squashfs_readahead_block(), which decompresses it
+ * asynchronously, concurrently with the following datablocks.  Fragments,
+ * sparse blocks and datablocks some pages of which are already in the page
+ * cache are left to squashfs_readpage().
+ */
+static int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned int nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_SHIFT;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	pgoff_t last = (i_size_read(inode) - 1) >> PAGE_SHIFT;
+	gfp_t gfp = readahead_gfp_mask(mapping);
+
+	while (!list_empty(pages)) {
+		struct page *page = lru_to_page(pages);
+		int index = page->index >> shift;
+		pgoff_t start = (pgoff_t) index << shift;
+		pgoff_t end = min(start | ((1 << shift) - 1), last);
+		int i, count = end - start + 1, missing = 0, bsize = 0;
+		struct page **block_page;
+		u64 block = 0;
+
+		block_page = kcalloc(count, sizeof(void *), GFP_KERNEL);
+		if (block_page == NULL)
+			break;
+
+		/* Take the pages of this datablock off the readahead list */
+		while (!list_empty(pages)) {
+			page = lru_to_page(pages);
+			if (page->index > end)
+				break;
+
+			list_del(&page->lru);
+			if (add_to_page_cache_lru(page, mapping, page->index,
+								gfp)) {
+				put_page(page);
+				continue;
+			}
+			block_page[page->index - start] = page;
+		}
+
+		/* And grab those which are not being read ahead */
+		for (i = 0; i < count; i++) {
+			if (block_page[i] == NULL)
+				block_page[i] = grab_cache_page_nowait(mapping,
+								start + i);
+			if (block_page[i] == NULL)
+				missing++;
+			else if (PageUptodate(block_page[i])) {
+				unlock_page(block_page[i]);
+				put_page(block_page[i]);
+				block_page[i] = NULL;
+				missing++;
+			}
+		}
+
+		if (!missing && (index < file_end ||
+		    squashfs_i(inode)->fragment_block == SQUASHFS_INVALID_BLK))
+			bsize = read_blocklist(inode, index, &block);
+
+		if (bsize <= 0) {
+			squashfs_release_pages(block_page, count);
+			kfree(block_page);
+			continue;
+		}
+
+		squashfs_readahead_block(inode->i_sb, block_page, count, block,
+								bsize);
+	}
+
+	return 0;
+}
+#endif
 
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+#ifdef CONFIG_SQUASHFS_READAHEAD_PARALLEL
+	.readpages = squashfs_readpages,
+#endif
 };
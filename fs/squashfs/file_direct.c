@@ -13,6 +13,7 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -174,3 +175,113 @@ static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
 	squashfs_cache_put(buffer);
 	return res;
 }
+
+#ifdef CONFIG_SQUASHFS_READAHEAD_PARALLEL
+/*
+ * Parallel readahead.  Each datablock covered by a readahead window is
+ * decompressed by its own work item on an unbound workqueue, so consecutive
+ * datablocks are decompressed concurrently on different CPUs.  The work item
+ * decompresses straight into the locked page cache pages covering the
+ * datablock, which the reader waits on as for any asynchronous read.
+ *
+ * The pages stay locked until the work item is done with the super block,
+ * which keeps the inode, and therefore the super block, alive.
+ */
+struct squashfs_readahead {
+	struct work_struct	work;
+	struct super_block	*sb;
+	struct page		**page;
+	int			pages;
+	u64			block;
+	int			bsize;
+};
+
+static struct workqueue_struct *squashfs_read_wq;
+
+static void squashfs_readahead_work(struct work_struct *work)
+{
+	struct squashfs_readahead *ra = container_of(work,
+					struct squashfs_readahead, work);
+	struct squashfs_page_actor *actor;
+	int i, bytes, res = -ENOMEM;
+	void *pageaddr;
+
+	actor = squashfs_page_actor_init_special(ra->page, ra->pages, 0);
+	if (actor) {
+		res = squashfs_read_data(ra->sb, ra->block, ra->bsize, NULL,
+								actor);
+		kfree(actor);
+	}
+
+	if (res < 0)
+		ERROR("Unable to read page, block %llx, size %x\n", ra->block,
+			ra->bsize);
+	else {
+		/* Last page may have trailing bytes not filled */
+		bytes = res % PAGE_SIZE;
+		if (bytes) {
+			pageaddr = kmap_atomic(ra->page[ra->pages - 1]);
+			memset(pageaddr + bytes, 0, PAGE_SIZE - bytes);
+			kunmap_atomic(pageaddr);
+		}
+	}
+
+	/*
+	 * Pages which failed are left not uptodate, the reader then falls
+	 * back to squashfs_readpage() for them.
+	 */
+	for (i = 0; i < ra->pages; i++) {
+		flush_dcache_page(ra->page[i]);
+		if (res < 0)
+			SetPageError(ra->page[i]);
+		else
+			SetPageUptodate(ra->page[i]);
+		unlock_page(ra->page[i]);
+		put_page(ra->page[i]);
+	}
+
+	kfree(ra->page);
+	kfree(ra);
+}
+
+/*
+ * Decompress datablock @block of compressed size @bsize into the @pages
+ * locked page cache pages @page asynchronously.  Takes over the page
+ * references and locks, and the @page array itself.
+ */
+void squashfs_readahead_block(struct super_block *sb, struct page **page,
+	int pages, u64 block, int bsize)
+{
+	struct squashfs_readahead *ra = kmalloc(sizeof(*ra), GFP_KERNEL);
+	int i;
+
+	if (ra == NULL) {
+		/* Leave the pages to squashfs_readpage() */
+		for (i = 0; i < pages; i++) {
+			unlock_page(page[i]);
+			put_page(page[i]);
+		}
+		kfree(page);
+		return;
+	}
+
+	INIT_WORK(&ra->work, squashfs_readahead_work);
+	ra->sb = sb;
+	ra->page = page;
+	ra->pages = pages;
+	ra->block = block;
+	ra->bsize = bsize;
+	queue_work(squashfs_read_wq, &ra->work);
+}
+
+int __init squashfs_readahead_init(void)
+{
+	squashfs_read_wq = alloc_workqueue("squashfs_read", WQ_UNBOUND, 0);
+	return squashfs_read_wq ? 0 : -ENOMEM;
+}
+
+void squashfs_readahead_destroy(void)
+{
+	destroy_workqueue(squashfs_read_wq);
+}
+#endif
@@ -73,6 +73,23 @@ void squashfs_copy_cache(struct page *, struct squashfs_cache_entry *, int,
 /* file_xxx.c */
 extern int squashfs_readpage_block(struct page *, u64, int);
 
+/* file_direct.c */
+#ifdef CONFIG_SQUASHFS_READAHEAD_PARALLEL
+extern int squashfs_readahead_init(void);
+extern void squashfs_readahead_destroy(void);
+extern void squashfs_readahead_block(struct super_block *, struct page **,
+				int, u64, int);
+#else
+static inline int squashfs_readahead_init(void)
+{
+	return 0;
+}
+
+static inline void squashfs_readahead_destroy(void)
+{
+}
+#endif
+
 /* id.c */
 extern int squashfs_get_id(struct super_block *, unsigned int, unsigned int *);
 extern __le64 *squashfs_read_id_index_table(struct super_block *, u64, u64,
@@ -444,8 +444,15 @@ static int __init init_squashfs_fs(void)
 	if (err)
 		return err;
 
+	err = squashfs_readahead_init();
+	if (err) {
+		destroy_inodecache();
+		return err;
+	}
+
 	err = register_filesystem(&squashfs_fs_type);
 	if (err) {
+		squashfs_readahead_destroy();
 		destroy_inodecache();
 		return err;
 	}
@@ -459,6 +466,7 @@ static int __init init_squashfs_fs(void)
 static void __exit exit_squashfs_fs(void)
 {
 	unregister_filesystem(&squashfs_fs_type);
+	squashfs_readahead_destroy();
 	destroy_inodecache();
 }
 
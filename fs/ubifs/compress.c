@@ -28,6 +28,9 @@
  */
 
 #include <linux/crypto.h>
+#include <linux/ktime.h>
+#include <linux/vmalloc.h>
+#include <linux/zstd.h>
 #include "ubifs.h"
 
 /* Fake description object for the "none" compressor */
@@ -71,9 +74,178 @@ static struct ubifs_compressor zlib_compr = {
 };
 #endif
 
+#ifdef CONFIG_UBIFS_FS_LZ4
+static DEFINE_MUTEX(lz4_mutex);
+
+static struct ubifs_compressor lz4_compr = {
+	.compr_type = UBIFS_COMPR_LZ4,
+	.comp_mutex = &lz4_mutex,
+	.name = "lz4",
+	.capi_name = "lz4",
+};
+#else
+static struct ubifs_compressor lz4_compr = {
+	.compr_type = UBIFS_COMPR_LZ4,
+	.name = "lz4",
+};
+#endif
+
+#ifdef CONFIG_UBIFS_FS_ZSTD
+/*
+ * There is no cryptoapi zstd compressor, so UBIFS drives the zstd library
+ * directly. Data nodes carry at most %UBIFS_BLOCK_SIZE bytes, so a single
+ * compression and a single decompression context sized for one block are
+ * enough, each serialized by its mutex.
+ */
+#define UBIFS_ZSTD_LEVEL 3
+
+static DEFINE_MUTEX(zstd_comp_mutex);
+static DEFINE_MUTEX(zstd_decomp_mutex);
+static void *zstd_cwksp;
+static void *zstd_dwksp;
+static ZSTD_CCtx *zstd_cctx;
+static ZSTD_DCtx *zstd_dctx;
+
+static void zstd_exit(void)
+{
+	vfree(zstd_cwksp);
+	vfree(zstd_dwksp);
+	zstd_cwksp = zstd_dwksp = NULL;
+}
+
+static int zstd_init(void)
+{
+	ZSTD_parameters params;
+	size_t csize, dsize;
+
+	params = ZSTD_getParams(UBIFS_ZSTD_LEVEL, UBIFS_BLOCK_SIZE, 0);
+	csize = ZSTD_CCtxWorkspaceBound(params.cParams);
+	dsize = ZSTD_DCtxWorkspaceBound();
+
+	zstd_cwksp = vmalloc(csize);
+	zstd_dwksp = vmalloc(dsize);
+	if (!zstd_cwksp || !zstd_dwksp)
+		goto out_free;
+
+	zstd_cctx = ZSTD_initCCtx(zstd_cwksp, csize);
+	zstd_dctx = ZSTD_initDCtx(zstd_dwksp, dsize);
+	if (!zstd_cctx || !zstd_dctx)
+		goto out_free;
+
+	return 0;
+
+out_free:
+	zstd_exit();
+	return -ENOMEM;
+}
+
+static int zstd_compress(const void *in_buf, int in_len, void *out_buf,
+			 int *out_len)
+{
+	ZSTD_parameters params;
+	size_t ret;
+
+	params = ZSTD_getParams(UBIFS_ZSTD_LEVEL, in_len, 0);
+	ret = ZSTD_compressCCtx(zstd_cctx, out_buf, *out_len, in_buf, in_len,
+				params);
+	if (ZSTD_isError(ret))
+		return -EINVAL;
+
+	*out_len = ret;
+	return 0;
+}
+
+static int zstd_decompress(const void *in_buf, int in_len, void *out_buf,
+			   int *out_len)
+{
+	size_t ret;
+
+	ret = ZSTD_decompressDCtx(zstd_dctx, out_buf, *out_len, in_buf, in_len);
+	if (ZSTD_isError(ret))
+		return -EINVAL;
+
+	*out_len = ret;
+	return 0;
+}
+
+static struct ubifs_compressor zstd_compr = {
+	.compr_type = UBIFS_COMPR_ZSTD,
+	.comp_mutex = &zstd_comp_mutex,
+	.decomp_mutex = &zstd_decomp_mutex,
+	.name = "zstd",
+	.init = zstd_init,
+	.exit = zstd_exit,
+	.compress = zstd_compress,
+	.decompress = zstd_decompress,
+};
+#else
+static struct ubifs_compressor zstd_compr = {
+	.compr_type = UBIFS_COMPR_ZSTD,
+	.name = "zstd",
+};
+#endif
+
 /* All UBIFS compressors */
 struct ubifs_compressor *ubifs_compressors[UBIFS_COMPR_TYPES_CNT];
 
+/**
+ * compr_compress - compress data with a compressor.
+ * @compr: compressor description object
+ * @in_buf: data to compress
+ * @in_len: length of the data to compress
+ * @out_buf: output buffer
+ * @out_len: output buffer length on enter, compressed data length on exit
+ *
+ * Returns zero in case of success and a negative error code in case of
+ * failure.
+ */
+static int compr_compress(struct ubifs_compressor *compr, const void *in_buf,
+			  int in_len, void *out_buf, int *out_len)
+{
+	int err;
+
+	if (compr->comp_mutex)
+		mutex_lock(compr->comp_mutex);
+	if (compr->compress)
+		err = compr->compress(in_buf, in_len, out_buf, out_len);
+	else
+		err = crypto_comp_compress(compr->cc, in_buf, in_len, out_buf,
+					   (unsigned int *)out_len);
+	if (compr->comp_mutex)
+		mutex_unlock(compr->comp_mutex);
+
+	return err;
+}
+
+/**
+ * compr_decompress - decompress data with a compressor.
+ * @compr: compressor description object
+ * @in_buf: data to decompress
+ * @in_len: length of the data to decompress
+ * @out_buf: output buffer
+ * @out_len: output buffer length on enter, decompressed data length on exit
+ *
+ * Returns zero in case of success and a negative error code in case of
+ * failure.
+ */
+static int compr_decompress(struct ubifs_compressor *compr, const void *in_buf,
+			    int in_len, void *out_buf, int *out_len)
+{
+	int err;
+
+	if (compr->decomp_mutex)
+		mutex_lock(compr->decomp_mutex);
+	if (compr->decompress)
+		err = compr->decompress(in_buf, in_len, out_buf, out_len);
+	else
+		err = crypto_comp_decompress(compr->cc, in_buf, in_len,
+					     out_buf, (unsigned int *)out_len);
+	if (compr->decomp_mutex)
+		mutex_unlock(compr->decomp_mutex);
+
+	return err;
+}
+
 /**
  * ubifs_compress - compress data.
  * @in_buf: data to compress
@@ -105,12 +277,7 @@ void ubifs_compress(const struct ubifs_info *c, const void *in_buf,
 	if (in_len < UBIFS_MIN_COMPR_LEN)
 		goto no_compr;
 
-	if (compr->comp_mutex)
-		mutex_lock(compr->comp_mutex);
-	err = crypto_comp_compress(compr->cc, in_buf, in_len, out_buf,
-				   (unsigned int *)out_len);
-	if (compr->comp_mutex)
-		mutex_unlock(compr->comp_mutex);
+	err = compr_compress(compr, in_buf, in_len, out_buf, out_len);
 	if (unlikely(err)) {
 		ubifs_warn(c, "cannot compress %d bytes, compressor %s, error %d, leave data uncompressed",
 			   in_len, compr->name, err);
@@ -157,7 +324,7 @@ int ubifs_decompress(const struct ubifs_info *c, const void *in_buf,
 
 	compr = ubifs_compressors[compr_type];
 
-	if (unlikely(!compr->capi_name)) {
+	if (unlikely(!ubifs_compr_present(compr_type))) {
 		ubifs_err(c, "%s compression is not compiled in", compr->name);
 		return -EINVAL;
 	}
@@ -168,12 +335,7 @@ int ubifs_decompress(const struct ubifs_info *c, const void *in_buf,
 		return 0;
 	}
 
-	if (compr->decomp_mutex)
-		mutex_lock(compr->decomp_mutex);
-	err = crypto_comp_decompress(compr->cc, in_buf, in_len, out_buf,
-				     (unsigned int *)out_len);
-	if (compr->decomp_mutex)
-		mutex_unlock(compr->decomp_mutex);
+	err = compr_decompress(compr, in_buf, in_len, out_buf, out_len);
 	if (err)
 		ubifs_err(c, "cannot decompress %d bytes, compressor %s, error %d",
 			  in_len, compr->name, err);
@@ -181,6 +343,103 @@ int ubifs_decompress(const struct ubifs_info *c, const void *in_buf,
 	return err;
 }
 
+/**
+ * ubifs_compr_type - get compressor type by its name.
+ * @name: compressor name
+ *
+ * This function returns the compressor type, or %-EINVAL if there is no
+ * compressor called @name. Note, the compressor may be not compiled in.
+ */
+int ubifs_compr_type(const char *name)
+{
+	int i;
+
+	for (i = 0; i < UBIFS_COMPR_TYPES_CNT; i++)
+		if (!strcmp(name, ubifs_compressors[i]->name))
+			return i;
+
+	return -EINVAL;
+}
+
+/**
+ * ubifs_compr_bench - measure a compressor on sample data.
+ * @compr_type: type of compressor to measure
+ * @data: sample data
+ * @len: length of the sample data
+ * @res: the results are returned here
+ *
+ * This function feeds @data to the compressor in %UBIFS_BLOCK_SIZE blocks,
+ * the way UBIFS writes file data, and decompresses and verifies every block
+ * which UBIFS would store compressed. @res->node_bytes is the size of the
+ * data nodes UBIFS would write, which is what ends up programmed to flash.
+ * Returns zero in case of success and a negative error code in case of
+ * failure.
+ */
+int ubifs_compr_bench(int compr_type, const void *data, int len,
+		      struct ubifs_compr_bench *res)
+{
+	int off, err = 0;
+	void *cbuf, *dbuf;
+	struct ubifs_compressor *compr = ubifs_compressors[compr_type];
+
+	memset(res, 0, sizeof(struct ubifs_compr_bench));
+	if (!ubifs_compr_present(compr_type))
+		return -ENOENT;
+
+	cbuf = kmalloc(UBIFS_BLOCK_SIZE * WORST_COMPR_FACTOR, GFP_KERNEL);
+	dbuf = kmalloc(UBIFS_BLOCK_SIZE, GFP_KERNEL);
+	if (!cbuf || !dbuf) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	for (off = 0; off < len; off += UBIFS_BLOCK_SIZE) {
+		int blen = min_t(int, len - off, UBIFS_BLOCK_SIZE);
+		int clen = UBIFS_BLOCK_SIZE * WORST_COMPR_FACTOR;
+		int dlen = UBIFS_BLOCK_SIZE;
+		int stored = blen;
+		u64 start;
+
+		res->blocks += 1;
+		res->in_bytes += blen;
+
+		if (compr_type != UBIFS_COMPR_NONE &&
+		    blen >= UBIFS_MIN_COMPR_LEN) {
+			start = ktime_get_ns();
+			err = compr_compress(compr, data + off, blen, cbuf,
+					     &clen);
+			res->compr_ns += ktime_get_ns() - start;
+			if (err)
+				break;
+		} else
+			clen = blen;
+
+		/* The same rule as in 'ubifs_compress()' */
+		if (blen - clen >= UBIFS_MIN_COMPRESS_DIFF) {
+			start = ktime_get_ns();
+			err = compr_decompress(compr, cbuf, clen, dbuf, &dlen);
+			res->decompr_ns += ktime_get_ns() - start;
+			if (err)
+				break;
+			if (dlen != blen || memcmp(dbuf, data + off, blen)) {
+				err = -EBADMSG;
+				break;
+			}
+
+			stored = clen;
+			res->compr_blocks += 1;
+		}
+
+		res->node_bytes += ALIGN(UBIFS_DATA_NODE_SZ + stored, 8);
+		cond_resched();
+	}
+
+out:
+	kfree(cbuf);
+	kfree(dbuf);
+	return err;
+}
+
 /**
  * compr_init - initialize a compressor.
  * @compr: compressor description object
@@ -190,7 +449,15 @@ int ubifs_decompress(const struct ubifs_info *c, const void *in_buf,
  */
 static int __init compr_init(struct ubifs_compressor *compr)
 {
-	if (compr->capi_name) {
+	if (compr->init) {
+		int err = compr->init();
+
+		if (err) {
+			pr_err("UBIFS error (pid %d): cannot initialize compressor %s, error %d",
+			       current->pid, compr->name, err);
+			return err;
+		}
+	} else if (compr->capi_name) {
 		compr->cc = crypto_alloc_comp(compr->capi_name, 0, 0);
 		if (IS_ERR(compr->cc)) {
 			pr_err("UBIFS error (pid %d): cannot initialize compressor %s, error %ld",
@@ -209,7 +476,9 @@ static int __init compr_init(struct ubifs_compressor *compr)
  */
 static void compr_exit(struct ubifs_compressor *compr)
 {
-	if (compr->capi_name)
+	if (compr->exit)
+		compr->exit();
+	else if (compr->capi_name)
 		crypto_free_comp(compr->cc);
 	return;
 }
@@ -232,9 +501,21 @@ int __init ubifs_compressors_init(void)
 	if (err)
 		goto out_lzo;
 
+	err = compr_init(&zstd_compr);
+	if (err)
+		goto out_zlib;
+
+	err = compr_init(&lz4_compr);
+	if (err)
+		goto out_zstd;
+
 	ubifs_compressors[UBIFS_COMPR_NONE] = &none_compr;
 	return 0;
 
+out_zstd:
+	compr_exit(&zstd_compr);
+out_zlib:
+	compr_exit(&zlib_compr);
 out_lzo:
 	compr_exit(&lzo_compr);
 	return err;
@@ -247,4 +528,6 @@ void ubifs_compressors_exit(void)
 {
 	compr_exit(&lzo_compr);
 	compr_exit(&zlib_compr);
+	compr_exit(&zstd_compr);
+	compr_exit(&lz4_compr);
 }
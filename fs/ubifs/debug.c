@@ -33,6 +33,7 @@
 #include <linux/uaccess.h>
 #include <linux/random.h>
 #include <linux/ctype.h>
+#include <linux/vmalloc.h>
 #include "ubifs.h"
 
 static DEFINE_SPINLOCK(dbg_lock);
@@ -2996,6 +2997,125 @@ static const struct file_operations dfs_global_fops = {
 	.llseek = no_llseek,
 };
 
+/*
+ * The "compr_bench" file compares the compressors on sample data: the data
+ * written to the file is compressed by every compiled in compressor when the
+ * file is read, and the amount of data node bytes UBIFS would write to flash
+ * and the compression and decompression throughput are reported.
+ */
+#define COMPR_BENCH_MAX_DATA (4 * 1024 * 1024)
+
+static DEFINE_MUTEX(compr_bench_mutex);
+static void *compr_bench_data;
+static int compr_bench_len;
+static char *compr_bench_out;
+static int compr_bench_out_len;
+
+static unsigned long long compr_bench_mbps(long long bytes, u64 ns)
+{
+	return ns ? div64_u64(bytes * 1000, ns) : 0;
+}
+
+static int compr_bench_run(void)
+{
+	int i, err, n;
+	struct ubifs_compr_bench res;
+
+	if (!compr_bench_len)
+		return -ENODATA;
+
+	if (!compr_bench_out) {
+		compr_bench_out = kmalloc(PAGE_SIZE, GFP_KERNEL);
+		if (!compr_bench_out)
+			return -ENOMEM;
+	}
+
+	n = scnprintf(compr_bench_out, PAGE_SIZE,
+		      "%-6s %10s %10s %6s %8s %8s %8s\n", "compr", "in_bytes",
+		      "node_bytes", "ratio%", "cblocks", "wr_MB/s", "rd_MB/s");
+	for (i = 0; i < UBIFS_COMPR_TYPES_CNT; i++) {
+		if (!ubifs_compr_present(i))
+			continue;
+
+		err = ubifs_compr_bench(i, compr_bench_data, compr_bench_len,
+					&res);
+		if (err) {
+			n += scnprintf(compr_bench_out + n, PAGE_SIZE - n,
+				       "%-6s error %d\n", ubifs_compr_name(i),
+				       err);
+			continue;
+		}
+
+		n += scnprintf(compr_bench_out + n, PAGE_SIZE - n,
+			       "%-6s %10lld %10lld %6lld %8d %8llu %8llu\n",
+			       ubifs_compr_name(i), res.in_bytes,
+			       res.node_bytes,
+			       div64_s64(res.node_bytes * 100, res.in_bytes),
+			       res.compr_blocks,
+			       compr_bench_mbps(res.in_bytes, res.compr_ns),
+			       compr_bench_mbps(res.in_bytes, res.decompr_ns));
+	}
+
+	compr_bench_out_len = n;
+	return 0;
+}
+
+static ssize_t dfs_compr_bench_read(struct file *file, char __user *u,
+				    size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&compr_bench_mutex);
+	if (*ppos == 0) {
+		ret = compr_bench_run();
+		if (ret)
+			goto out;
+	}
+
+	ret = simple_read_from_buffer(u, count, ppos, compr_bench_out,
+				      compr_bench_out_len);
+out:
+	mutex_unlock(&compr_bench_mutex);
+	return ret;
+}
+
+static ssize_t dfs_compr_bench_write(struct file *file, const char __user *u,
+				     size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	if (*ppos >= COMPR_BENCH_MAX_DATA)
+		return -EFBIG;
+
+	mutex_lock(&compr_bench_mutex);
+	if (!compr_bench_data) {
+		compr_bench_data = vmalloc(COMPR_BENCH_MAX_DATA);
+		if (!compr_bench_data) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	/* Writing from the beginning replaces the sample data */
+	if (*ppos == 0)
+		compr_bench_len = 0;
+
+	ret = simple_write_to_buffer(compr_bench_data, COMPR_BENCH_MAX_DATA,
+				     ppos, u, count);
+	if (ret > 0)
+		compr_bench_len = max_t(int, compr_bench_len, *ppos);
+out:
+	mutex_unlock(&compr_bench_mutex);
+	return ret;
+}
+
+static const struct file_operations dfs_compr_bench_fops = {
+	.read = dfs_compr_bench_read,
+	.write = dfs_compr_bench_write,
+	.owner = THIS_MODULE,
+	.llseek = no_llseek,
+};
+
 /**
  * dbg_debugfs_init - initialize debugfs file-system.
  *
@@ -3061,6 +3181,12 @@ int dbg_debugfs_init(void)
 		goto out_remove;
 	dfs_tst_rcvry = dent;
 
+	fname = "compr_bench";
+	dent = debugfs_create_file(fname, S_IRUSR | S_IWUSR, dfs_rootdir, NULL,
+				   &dfs_compr_bench_fops);
+	if (IS_ERR_OR_NULL(dent))
+		goto out_remove;
+
 	return 0;
 
 out_remove:
@@ -3079,6 +3205,8 @@ void dbg_debugfs_exit(void)
 {
 	if (IS_ENABLED(CONFIG_DEBUG_FS))
 		debugfs_remove_recursive(dfs_rootdir);
+	vfree(compr_bench_data);
+	kfree(compr_bench_out);
 }
 
 /**
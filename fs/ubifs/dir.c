@@ -75,6 +75,35 @@ static int inherit_flags(const struct inode *dir, umode_t mode)
 	return flags;
 }
 
+/**
+ * inherit_compr - pick the compressor of a new inode.
+ * @c: UBIFS file-system description object
+ * @dir: parent inode
+ * @mode: new inode mode flags
+ *
+ * This is a helper function for 'ubifs_new_inode()'. Directories do not have
+ * data, so their compressor type is %UBIFS_COMPR_NONE unless a compressor was
+ * chosen for them with the %UBIFS_XATTR_COMPR extended attribute. Regular
+ * files and sub-directories inherit that choice, otherwise regular files use
+ * the default compressor.
+ *
+ * This function returns the compressor type of the new inode.
+ */
+static int inherit_compr(const struct ubifs_info *c, const struct inode *dir,
+			 umode_t mode)
+{
+	int compr_type = UBIFS_COMPR_NONE;
+
+	if (S_ISDIR(dir->i_mode))
+		compr_type = ubifs_inode(dir)->compr_type;
+
+	if (S_ISREG(mode) && compr_type == UBIFS_COMPR_NONE)
+		return c->default_compr;
+	if (S_ISREG(mode) || S_ISDIR(mode))
+		return compr_type;
+	return UBIFS_COMPR_NONE;
+}
+
 /**
  * ubifs_new_inode - allocate new UBIFS inode object.
  * @c: UBIFS file-system description object
@@ -151,10 +180,7 @@ struct inode *ubifs_new_inode(struct ubifs_info *c, struct inode *dir,
 
 	ui->flags = inherit_flags(dir, mode);
 	ubifs_set_inode_flags(inode);
-	if (S_ISREG(mode))
-		ui->compr_type = c->default_compr;
-	else
-		ui->compr_type = UBIFS_COMPR_NONE;
+	ui->compr_type = inherit_compr(c, dir, mode);
 	ui->synced_i_size = 0;
 
 	spin_lock(&c->cnt_lock);
@@ -112,7 +112,8 @@ static inline struct ubifs_inode *ubifs_inode(const struct inode *inode)
 static inline int ubifs_compr_present(int compr_type)
 {
 	ubifs_assert(compr_type >= 0 && compr_type < UBIFS_COMPR_TYPES_CNT);
-	return !!ubifs_compressors[compr_type]->capi_name;
+	return ubifs_compressors[compr_type]->capi_name ||
+	       ubifs_compressors[compr_type]->compress;
 }
 
 /**
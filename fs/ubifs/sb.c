@@ -639,6 +639,7 @@ int ubifs_read_superblock(struct ubifs_info *c)
 	c->space_fixup = !!(sup_flags & UBIFS_FLG_SPACE_FIXUP);
 	c->double_hash = !!(sup_flags & UBIFS_FLG_DOUBLE_HASH);
 	c->encrypted = !!(sup_flags & UBIFS_FLG_ENCRYPTION);
+	c->ext_compr = !!(sup_flags & UBIFS_FLG_EXT_COMPR);
 
 	if ((sup_flags & ~UBIFS_FLG_MASK) != 0) {
 		ubifs_err(c, "Unknown feature flags found: %#x",
@@ -872,3 +873,44 @@ int ubifs_enable_encryption(struct ubifs_info *c)
 
 	return err;
 }
+
+/**
+ * ubifs_enable_ext_compr - mark the file-system as using newer compressors.
+ * @c: UBIFS file-system description object
+ * @compr_type: compressor about to be used
+ *
+ * Data compressed with %UBIFS_COMPR_ZSTD or %UBIFS_COMPR_LZ4 cannot be read
+ * by kernels which predate these compressors, so before the first use of
+ * either, this function sets %UBIFS_FLG_EXT_COMPR in the superblock. Older
+ * kernels refuse to mount a file-system with an unknown superblock flag.
+ * Returns zero in case of success and a negative error code in case of
+ * failure.
+ */
+int ubifs_enable_ext_compr(struct ubifs_info *c, int compr_type)
+{
+	int err;
+	struct ubifs_sb_node *sup;
+
+	if (c->ext_compr || (compr_type != UBIFS_COMPR_ZSTD &&
+			     compr_type != UBIFS_COMPR_LZ4))
+		return 0;
+
+	if (c->ro_mount || c->ro_media)
+		return -EROFS;
+
+	sup = ubifs_read_sb_node(c);
+	if (IS_ERR(sup))
+		return PTR_ERR(sup);
+
+	sup->flags |= cpu_to_le32(UBIFS_FLG_EXT_COMPR);
+
+	err = ubifs_write_sb_node(c, sup);
+	if (!err) {
+		c->ext_compr = 1;
+		ubifs_msg(c, "%s compression enabled, older kernels will not mount this file-system",
+			  ubifs_compr_name(compr_type));
+	}
+	kfree(sup);
+
+	return err;
+}
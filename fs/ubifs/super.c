@@ -1028,20 +1028,17 @@ static int ubifs_parse_options(struct ubifs_info *c, char *options,
 		case Opt_override_compr:
 		{
 			char *name = match_strdup(&args[0]);
+			int compr_type;
 
 			if (!name)
 				return -ENOMEM;
-			if (!strcmp(name, "none"))
-				c->mount_opts.compr_type = UBIFS_COMPR_NONE;
-			else if (!strcmp(name, "lzo"))
-				c->mount_opts.compr_type = UBIFS_COMPR_LZO;
-			else if (!strcmp(name, "zlib"))
-				c->mount_opts.compr_type = UBIFS_COMPR_ZLIB;
-			else {
+			compr_type = ubifs_compr_type(name);
+			if (compr_type < 0) {
 				ubifs_err(c, "unknown compressor \"%s\"", name); //FIXME: is c ready?
 				kfree(name);
 				return -EINVAL;
 			}
+			c->mount_opts.compr_type = compr_type;
 			kfree(name);
 			c->mount_opts.override_compr = 1;
 			c->default_compr = c->mount_opts.compr_type;
@@ -1299,6 +1296,12 @@ static int mount_ubifs(struct ubifs_info *c)
 			goto out_lpt;
 	}
 
+	if (!c->ro_mount) {
+		err = ubifs_enable_ext_compr(c, c->default_compr);
+		if (err)
+			goto out_lpt;
+	}
+
 	if (!c->ro_mount && !c->need_recovery) {
 		/*
 		 * Set the "dirty" flag so that if we reboot uncleanly we
@@ -1872,6 +1875,13 @@ static int ubifs_remount_fs(struct super_block *sb, int *flags, char *data)
 		ubifs_remount_ro(c);
 	}
 
+	/* the default compressor may have changed, or the media become R/W */
+	if (!c->ro_mount) {
+		err = ubifs_enable_ext_compr(c, c->default_compr);
+		if (err)
+			return err;
+	}
+
 	if (c->bulk_read == 1)
 		bu_init(c);
 	else {
@@ -2244,12 +2254,12 @@ static int __init ubifs_init(void)
 	BUILD_BUG_ON(UBIFS_REF_NODE_SZ != 64);
 
 	/*
-	 * We use 2 bit wide bit-fields to store compression type, which should
+	 * We use 3 bit wide bit-fields to store compression type, which should
 	 * be amended if more compressors are added. The bit-fields are:
 	 * @compr_type in 'struct ubifs_inode', @default_compr in
 	 * 'struct ubifs_info' and @compr_type in 'struct ubifs_mount_opts'.
 	 */
-	BUILD_BUG_ON(UBIFS_COMPR_TYPES_CNT > 4);
+	BUILD_BUG_ON(UBIFS_COMPR_TYPES_CNT > 8);
 
 	/*
 	 * We require that PAGE_SIZE is greater-than-or-equal-to
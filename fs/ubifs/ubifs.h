@@ -124,6 +124,9 @@
 /* How much an extended attribute adds to the host inode */
 #define CALC_XATTR_BYTES(data_len) ALIGN(UBIFS_INO_NODE_SZ + (data_len) + 1, 8)
 
+/* Extended attribute which selects the compressor of an inode */
+#define UBIFS_XATTR_COMPR "ubifs.compression"
+
 /*
  * Znodes which were not touched for 'OLD_ZNODE_AGE' seconds are considered
  * "old", and znode which were touched last 'YOUNG_ZNODE_AGE' seconds ago are
@@ -398,7 +401,7 @@ struct ubifs_inode {
 	unsigned int dirty:1;
 	unsigned int xattr:1;
 	unsigned int bulk_read:1;
-	unsigned int compr_type:2;
+	unsigned int compr_type:3;
 	struct mutex ui_mutex;
 	spinlock_t ui_lock;
 	loff_t synced_i_size;
@@ -816,6 +819,10 @@ struct ubifs_node_range {
  * @decomp_mutex: mutex used during decompression
  * @name: compressor name
  * @capi_name: cryptoapi compressor name
+ * @init: initialize a compressor which is not provided by the cryptoapi
+ * @exit: de-initialize it
+ * @compress: compress with it
+ * @decompress: decompress with it
  */
 struct ubifs_compressor {
 	int compr_type;
@@ -824,6 +831,30 @@ struct ubifs_compressor {
 	struct mutex *decomp_mutex;
 	const char *name;
 	const char *capi_name;
+	int (*init)(void);
+	void (*exit)(void);
+	int (*compress)(const void *in_buf, int in_len, void *out_buf,
+			int *out_len);
+	int (*decompress)(const void *in_buf, int in_len, void *out_buf,
+			  int *out_len);
+};
+
+/**
+ * struct ubifs_compr_bench - compressor benchmark results.
+ * @in_bytes: amount of data fed to the compressor
+ * @node_bytes: size of the data nodes UBIFS would write for that data
+ * @compr_blocks: how many blocks ended up compressed
+ * @blocks: how many blocks were fed to the compressor
+ * @compr_ns: time spent compressing
+ * @decompr_ns: time spent decompressing
+ */
+struct ubifs_compr_bench {
+	long long in_bytes;
+	long long node_bytes;
+	int compr_blocks;
+	int blocks;
+	u64 compr_ns;
+	u64 decompr_ns;
 };
 
 /**
@@ -929,7 +960,7 @@ struct ubifs_mount_opts {
 	unsigned int bulk_read:2;
 	unsigned int chk_data_crc:2;
 	unsigned int override_compr:1;
-	unsigned int compr_type:2;
+	unsigned int compr_type:3;
 };
 
 /**
@@ -1011,6 +1042,8 @@ struct ubifs_debug_info;
  * @space_fixup: flag indicating that free space in LEBs needs to be cleaned up
  * @double_hash: flag indicating that we can do lookups by hash
  * @encrypted: flag indicating that this file system contains encrypted files
+ * @ext_compr: flag indicating that this file system may contain zstd or LZ4
+ *             compressed data
  * @no_chk_data_crc: do not check CRCs when reading data nodes (except during
  *                   recovery)
  * @bulk_read: enable bulk-reads
@@ -1254,9 +1287,10 @@ struct ubifs_info {
 	unsigned int space_fixup:1;
 	unsigned int double_hash:1;
 	unsigned int encrypted:1;
+	unsigned int ext_compr:1;
 	unsigned int no_chk_data_crc:1;
 	unsigned int bulk_read:1;
-	unsigned int default_compr:2;
+	unsigned int default_compr:3;
 	unsigned int rw_incompat:1;
 
 	struct mutex tnc_mutex;
@@ -1654,6 +1688,7 @@ struct ubifs_sb_node *ubifs_read_sb_node(struct ubifs_info *c);
 int ubifs_write_sb_node(struct ubifs_info *c, struct ubifs_sb_node *sup);
 int ubifs_fixup_free_space(struct ubifs_info *c);
 int ubifs_enable_encryption(struct ubifs_info *c);
+int ubifs_enable_ext_compr(struct ubifs_info *c, int compr_type);
 
 /* replay.c */
 int ubifs_validate_entry(struct ubifs_info *c,
@@ -1804,6 +1839,9 @@ void ubifs_compress(const struct ubifs_info *c, const void *in_buf, int in_len,
 		    void *out_buf, int *out_len, int *compr_type);
 int ubifs_decompress(const struct ubifs_info *c, const void *buf, int len,
 		     void *out, int *out_len, int compr_type);
+int ubifs_compr_type(const char *name);
+int ubifs_compr_bench(int compr_type, const void *data, int len,
+		      struct ubifs_compr_bench *res);
 
 #include "debug.h"
 #include "misc.h"
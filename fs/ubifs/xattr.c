@@ -53,6 +53,11 @@
  * tnc.c).
  *
  * ACL support is not implemented.
+ *
+ * The %UBIFS_XATTR_COMPR extended attribute is special: it has no xentry, but
+ * reads and sets the compressor type of the inode. Setting it on a directory
+ * selects the compressor for the regular files and directories created in it
+ * later. Removing it restores the default compressor.
  */
 
 #include "ubifs.h"
@@ -650,6 +655,96 @@ static int xattr_set(const struct xattr_handler *handler,
 		return ubifs_xattr_remove(inode, name);
 }
 
+static int xattr_compr_get(const struct xattr_handler *handler,
+			   struct dentry *dentry, struct inode *inode,
+			   const char *name, void *buffer, size_t size)
+{
+	struct ubifs_inode *ui = ubifs_inode(inode);
+	const char *compr_name;
+	int len;
+
+	if (!S_ISREG(inode->i_mode) && !S_ISDIR(inode->i_mode))
+		return -ENODATA;
+	if (S_ISDIR(inode->i_mode) && ui->compr_type == UBIFS_COMPR_NONE)
+		return -ENODATA;
+
+	compr_name = ubifs_compr_name(ui->compr_type);
+	len = strlen(compr_name);
+	if (buffer) {
+		if (size < len)
+			return -ERANGE;
+		memcpy(buffer, compr_name, len);
+	}
+
+	return len;
+}
+
+static int xattr_compr_set(const struct xattr_handler *handler,
+			   struct dentry *dentry, struct inode *inode,
+			   const char *name, const void *value,
+			   size_t size, int flags)
+{
+	struct ubifs_info *c = inode->i_sb->s_fs_info;
+	struct ubifs_inode *ui = ubifs_inode(inode);
+	struct ubifs_budget_req req = { .dirtied_ino = 1,
+					.dirtied_ino_d = ui->data_len };
+	char compr_name[16];
+	int compr_type, release, err;
+
+	dbg_gen("compressor of ino %lu ('%pd'), size %zd", inode->i_ino,
+		dentry, size);
+
+	if (!S_ISREG(inode->i_mode) && !S_ISDIR(inode->i_mode))
+		return -EINVAL;
+	if (!inode_owner_or_capable(inode))
+		return -EPERM;
+
+	if (value) {
+		if (size >= sizeof(compr_name))
+			return -EINVAL;
+		memcpy(compr_name, value, size);
+		compr_name[size] = '\0';
+
+		compr_type = ubifs_compr_type(compr_name);
+		if (compr_type < 0)
+			return -EINVAL;
+		if (!ubifs_compr_present(compr_type))
+			return -EOPNOTSUPP;
+	} else if (S_ISDIR(inode->i_mode))
+		compr_type = UBIFS_COMPR_NONE;
+	else
+		compr_type = c->default_compr;
+
+	err = ubifs_enable_ext_compr(c, compr_type);
+	if (err)
+		return err;
+
+	err = ubifs_budget_space(c, &req);
+	if (err)
+		return err;
+
+	mutex_lock(&ui->ui_mutex);
+	ui->compr_type = compr_type;
+	if (compr_type != UBIFS_COMPR_NONE)
+		ui->flags |= UBIFS_COMPR_FL;
+	inode->i_ctime = current_time(inode);
+	release = ui->dirty;
+	mark_inode_dirty_sync(inode);
+	mutex_unlock(&ui->ui_mutex);
+
+	if (release)
+		ubifs_release_budget(c, &req);
+	if (IS_SYNC(inode))
+		err = write_inode_now(inode, 1);
+	return err;
+}
+
+static const struct xattr_handler ubifs_compr_xattr_handler = {
+	.name = UBIFS_XATTR_COMPR,
+	.get = xattr_compr_get,
+	.set = xattr_compr_set,
+};
+
 static const struct xattr_handler ubifs_user_xattr_handler = {
 	.prefix = XATTR_USER_PREFIX,
 	.get = xattr_get,
@@ -671,6 +766,7 @@ static const struct xattr_handler ubifs_security_xattr_handler = {
 #endif
 
 const struct xattr_handler *ubifs_xattr_handlers[] = {
+	&ubifs_compr_xattr_handler,
 	&ubifs_user_xattr_handler,
 	&ubifs_trusted_xattr_handler,
 #ifdef CONFIG_UBIFS_FS_SECURITY
@@ -66,6 +66,8 @@ struct mbox_chan_ops {
  *			no interrupt rises. Ignored if 'txdone_irq' is set.
  * @txpoll_period:	If 'txdone_poll' is in effect, the API polls for
  *			last TX's status after these many millisecs
+ * @txq_len:		Depth of the TX queue of each channel, rounded up to
+ *			a power of 2. MBOX_TX_QUEUE_LEN if left 0.
  * @of_xlate:		Controller driver specific mapping of channel via DT
  * @poll_hrt:		API private. hrtimer used to poll for TXDONE on all
  *			channels.
@@ -79,28 +81,38 @@ struct mbox_controller {
 	bool txdone_irq;
 	bool txdone_poll;
 	unsigned txpoll_period;
+	unsigned txq_len;
 	struct mbox_chan *(*of_xlate)(struct mbox_controller *mbox,
 				      const struct of_phandle_args *sp);
 	/* Internal to API */
 	struct hrtimer poll_hrt;
 	struct list_head node;
+	struct mbox_txq_slot *txq_slots;
 };
 
 /*
- * The length of circular buffer for queuing messages from a client.
- * 'msg_count' tracks the number of buffered messages while 'msg_free'
- * is the index where the next message would be buffered.
- * We shouldn't need it too big because every transfer is interrupt
+ * The default length of the queue of messages waiting to be sent on a
+ * channel. We shouldn't need it too big because every transfer is interrupt
  * triggered and if we have lots of data to transfer, the interrupt
  * latencies are going to be the bottleneck, not the buffer length.
  * Besides, mbox_send_message could be called from atomic context and
  * the client could also queue another message from the notifier 'tx_done'
- * of the last transfer done.
- * REVISIT: If too many platforms see the "Try increasing MBOX_TX_QUEUE_LEN"
- * print, it needs to be taken from config option or somesuch.
+ * of the last transfer done. Controllers whose channels are shared by many
+ * producers may ask for a deeper queue through 'txq_len'.
  */
 #define MBOX_TX_QUEUE_LEN	20
 
+/**
+ * struct mbox_txq_slot - API private. Entry of a channel's TX queue
+ * @seq:		Queue position the slot is ready for: free for
+ *			position 'seq', holds the message of position 'seq - 1'
+ * @msg:		Queued message
+ */
+struct mbox_txq_slot {
+	unsigned long seq;
+	void *msg;
+};
+
 /**
  * struct mbox_chan - s/w representation of a communication chan
  * @mbox:		Pointer to the parent/provider of this channel
@@ -108,9 +120,12 @@ struct mbox_controller {
  * @cl:			Pointer to the current owner of this channel
  * @tx_complete:	Transmission completion
  * @active_req:		Currently active request hook
- * @msg_count:		No. of mssg currently queued
- * @msg_free:		Index of next available mssg slot
- * @msg_data:		Hook for data packet
+ * @txq:		Slots of the TX queue, filled by any number of
+ *			producers without taking 'lock'
+ * @txq_mask:		Number of slots in 'txq' minus one
+ * @txq_head:		Queue position of the next message to be queued
+ * @txq_tail:		Queue position of the next message to be sent,
+ *			protected by 'lock'
  * @lock:		Serialise access to the channel
  * @con_priv:		Hook for controller driver to attach private data
  */
@@ -120,8 +135,10 @@ struct mbox_chan {
 	struct mbox_client *cl;
 	struct completion tx_complete;
 	void *active_req;
-	unsigned msg_count, msg_free;
-	void *msg_data[MBOX_TX_QUEUE_LEN];
+	struct mbox_txq_slot *txq;
+	unsigned long txq_mask;
+	unsigned long txq_head ____cacheline_aligned_in_smp;
+	unsigned long txq_tail ____cacheline_aligned_in_smp;
 	spinlock_t lock; /* Serialise access to the channel */
 	void *con_priv;
 };
@@ -130,5 +147,6 @@ int mbox_controller_register(struct mbox_controller *mbox); /* can sleep */
 void mbox_controller_unregister(struct mbox_controller *mbox); /* can sleep */
 void mbox_chan_received_data(struct mbox_chan *chan, void *data); /* atomic */
 void mbox_chan_txdone(struct mbox_chan *chan, int r); /* atomic */
+void mbox_chan_txq_reset(struct mbox_chan *chan); /* atomic */
 
 #endif /* __MAILBOX_CONTROLLER_H */
@@ -196,6 +196,23 @@ struct sched_domain_topology_level {
 
 extern void set_sched_topology(struct sched_domain_topology_level *tl);
 
+/*
+ * Power cost of a cluster, used for cluster packing: the power one CPU
+ * draws when fully busy at each capacity state (OPP), in ascending order
+ * of capacity, and the power the cluster draws when powered up with all
+ * its CPUs idle, i.e. what powering the cluster down saves.
+ */
+struct sched_cap_state {
+	unsigned long cap;		/* compute capacity, 0..1024 */
+	unsigned long power;		/* busy power, uW */
+};
+
+struct sched_cluster_energy {
+	unsigned long idle_power;	/* uW */
+	int nr_cap_states;
+	struct sched_cap_state *cap_states;
+};
+
 #ifdef CONFIG_SCHED_DEBUG
 # define SD_INIT_NAME(type)		.name = #type
 #else
@@ -2,6 +2,8 @@
 #ifndef _LINUX_TRACE_H
 #define _LINUX_TRACE_H
 
+#include <linux/types.h>
+
 #ifdef CONFIG_TRACING
 /*
  * The trace export - an export of Ftrace output. The trace_export
@@ -26,4 +28,18 @@ int unregister_ftrace_export(struct trace_export *export);
 
 #endif	/* CONFIG_TRACING */
 
+#ifdef CONFIG_HWLAT_TRACER
+/*
+ * Sources the hwlat tracer correlates latency gaps with in its multi-CPU
+ * (hpsc) mode: firmware message traffic, and a per-CPU reference counter
+ * that does not depend on the clock being sampled.  The reference counter
+ * is read on the local CPU with interrupts disabled.
+ */
+void trace_hwlat_msg_event(void);
+void trace_hwlat_set_ref_clock(u64 (*read)(void));
+#else
+static inline void trace_hwlat_msg_event(void) { }
+static inline void trace_hwlat_set_ref_clock(u64 (*read)(void)) { }
+#endif	/* CONFIG_HWLAT_TRACER */
+
 #endif	/* _LINUX_TRACE_H */
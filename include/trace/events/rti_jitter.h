@@ -0,0 +1,43 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM rti_jitter
+
+#if !defined(_TRACE_RTI_JITTER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_RTI_JITTER_H
+
+#include <linux/tracepoint.h>
+
+/**
+ * rti_jitter_sample - one interval timer event seen by the jitter monitor
+ * @cpu: CPU the timer belongs to
+ * @latency: ns from the timer expiry, by the timer's own counter, to the
+ *	     callback
+ * @period_err: sched_clock() time since the previous event minus the
+ *		nominal period, in ns
+ */
+TRACE_EVENT(rti_jitter_sample,
+
+	TP_PROTO(int cpu, u64 latency, s64 period_err),
+
+	TP_ARGS(cpu, latency, period_err),
+
+	TP_STRUCT__entry(
+		__field(	int,	cpu		)
+		__field(	u64,	latency		)
+		__field(	s64,	period_err	)
+	),
+
+	TP_fast_assign(
+		__entry->cpu		= cpu;
+		__entry->latency	= latency;
+		__entry->period_err	= period_err;
+	),
+
+	TP_printk("cpu=%d latency=%llu ns period_err=%lld ns",
+		  __entry->cpu, __entry->latency, __entry->period_err)
+);
+
+#endif /* _TRACE_RTI_JITTER_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
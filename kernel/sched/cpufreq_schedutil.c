@@ -254,6 +254,36 @@ static bool sugov_cpu_is_busy(struct sugov_cpu *sg_cpu)
 static inline bool sugov_cpu_is_busy(struct sugov_cpu *sg_cpu) { return false; }
 #endif /* CONFIG_NO_HZ_COMMON */
 
+/*
+ * The scheduler passes SCHED_CPUFREQ_IDLE when the last task of a cluster
+ * went to sleep.  If no CPU of the policy has anything left to run, go to
+ * the lowest frequency right away instead of waiting for the blocked
+ * utilization to decay, which lets the cluster power down sooner.
+ */
+static bool sugov_update_idle(struct sugov_policy *sg_policy, u64 time,
+			      unsigned int flags)
+{
+	struct cpufreq_policy *policy = sg_policy->policy;
+	unsigned int j;
+
+	if (!(flags & SCHED_CPUFREQ_IDLE))
+		return false;
+
+	for_each_cpu(j, policy->cpus) {
+		if (cpu_rq(j)->nr_running)
+			return false;
+	}
+
+	if (sg_policy->work_in_progress ||
+	    (policy->fast_switch_enabled && !cpufreq_can_do_remote_dvfs(policy)))
+		return true;
+
+	sg_policy->cached_raw_freq = 0;
+	sugov_update_commit(sg_policy, time,
+			    cpufreq_driver_resolve_freq(policy, policy->min));
+	return true;
+}
+
 static void sugov_update_single(struct update_util_data *hook, u64 time,
 				unsigned int flags)
 {
@@ -267,6 +297,9 @@ static void sugov_update_single(struct update_util_data *hook, u64 time,
 	sugov_set_iowait_boost(sg_cpu, time, flags);
 	sg_cpu->last_update = time;
 
+	if (sugov_update_idle(sg_policy, time, flags))
+		return;
+
 	if (!sugov_should_update_freq(sg_policy, time))
 		return;
 
@@ -348,7 +381,8 @@ static void sugov_update_shared(struct update_util_data *hook, u64 time,
 	sugov_set_iowait_boost(sg_cpu, time, flags);
 	sg_cpu->last_update = time;
 
-	if (sugov_should_update_freq(sg_policy, time)) {
+	if (!sugov_update_idle(sg_policy, time, flags) &&
+	    sugov_should_update_freq(sg_policy, time)) {
 		if (flags & SCHED_CPUFREQ_RT_DL)
 			next_f = sg_policy->policy->cpuinfo.max_freq;
 		else
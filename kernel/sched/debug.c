@@ -191,6 +191,11 @@ static __init int sched_init_debug(void)
 	debugfs_create_bool("sched_debug", 0644, NULL,
 			&sched_debug_enabled);
 
+#ifdef CONFIG_SCHED_CLUSTER_PACK
+	debugfs_create_u32("sched_cluster_pack_pct", 0644, NULL,
+			   &sysctl_sched_cluster_pack_pct);
+#endif
+
 	return 0;
 }
 late_initcall(sched_init_debug);
@@ -132,6 +132,17 @@ unsigned int sysctl_sched_cfs_bandwidth_slice		= 5000UL;
  */
 unsigned int capacity_margin				= 1280;
 
+#ifdef CONFIG_SCHED_CLUSTER_PACK
+/*
+ * Utilization, in percent of its capacity, up to which small tasks are
+ * packed onto a cluster that is already running, rather than woken up on
+ * an idle one.
+ *
+ * (default: 60%)
+ */
+const_debug unsigned int sysctl_sched_cluster_pack_pct	= 60;
+#endif
+
 static inline void update_load_add(struct load_weight *lw, unsigned long inc)
 {
 	lw->weight += inc;
@@ -4927,6 +4938,44 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 
 static void set_next_buddy(struct sched_entity *se);
 
+#ifdef CONFIG_SCHED_CLUSTER_PACK
+/* No CPU of @cpu's cluster (LLC domain) has anything to run */
+static bool cluster_idle(int cpu)
+{
+	struct sched_domain *sd;
+	bool idle = true;
+	int i;
+
+	rcu_read_lock();
+	sd = rcu_dereference(per_cpu(sd_llc, cpu));
+	if (sd) {
+		for_each_cpu(i, sched_domain_span(sd)) {
+			if (cpu_rq(i)->nr_running) {
+				idle = false;
+				break;
+			}
+		}
+	}
+	rcu_read_unlock();
+
+	return idle;
+}
+
+/*
+ * Let schedutil drop the frequency of a cluster whose last task went to
+ * sleep, rather than wait for the blocked utilization of its CPUs to
+ * decay, so that it can power down.
+ */
+static inline void cluster_pack_update(struct rq *rq)
+{
+	if (sched_feat(CLUSTER_PACK) && !rq->nr_running &&
+	    cluster_idle(cpu_of(rq)))
+		cpufreq_update_util(rq, SCHED_CPUFREQ_IDLE);
+}
+#else
+static inline void cluster_pack_update(struct rq *rq) { }
+#endif
+
 /*
  * The dequeue_task method is called before nr_running is
  * decreased. We remove the task from the rbtree and
@@ -4981,6 +5030,9 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	if (!se)
 		sub_nr_running(rq, 1);
 
+	/* Only when a task goes to sleep here, not on migrations */
+	if (task_sleep && rq == this_rq())
+		cluster_pack_update(rq);
 	hrtick_update(rq);
 }
 
@@ -5925,6 +5977,168 @@ static int wake_cap(struct task_struct *p, int cpu, int prev_cpu)
 	return min_cap * 1024 < task_util(p) * capacity_margin;
 }
 
+#ifdef CONFIG_SCHED_CLUSTER_PACK
+/*
+ * Cluster packing
+ *
+ * When the clusters of a part can be powered down as a whole, spreading a
+ * light load over all of them keeps every cluster (and its L2) powered up
+ * for little gain.  Small tasks are instead placed on a cluster that is
+ * running already, as long as its utilization stays below
+ * sysctl_sched_cluster_pack_pct of its capacity and, if the architecture
+ * provides cluster power costs, as long as running the task there costs
+ * less energy than waking up an idle cluster for it.  The load balancer
+ * does not pull tasks from such a cluster into an idle one, see
+ * cluster_pack_balanced().
+ *
+ * The clusters are the groups of the domain right above the LLC domain.
+ */
+struct cluster_pack_stats {
+	unsigned long util;		/* sum over the cluster, without p */
+	unsigned long max_util;		/* of its busiest CPU */
+	unsigned long capacity;
+	bool awake;			/* runs anything, or is us */
+	int cpu;			/* where p fits best, -1 if nowhere */
+	unsigned long cpu_util;
+	bool cpu_idle;
+};
+
+static void cluster_pack_stats(struct sched_group *sg, struct task_struct *p,
+			       int prev_cpu, struct cluster_pack_stats *cs)
+{
+	unsigned long task = task_util(p), util;
+	int i;
+
+	memset(cs, 0, sizeof(*cs));
+	cs->cpu = -1;
+
+	for_each_cpu(i, sched_group_span(sg)) {
+		util = cpu_util_wake(i, p);
+		cs->util += util;
+		cs->max_util = max(cs->max_util, util);
+		cs->capacity += capacity_of(i);
+		if (cpu_rq(i)->nr_running || i == smp_processor_id())
+			cs->awake = true;
+
+		if (!cpumask_test_cpu(i, &p->cpus_allowed) ||
+		    (util + task) * capacity_margin >
+		    capacity_orig_of(i) * SCHED_CAPACITY_SCALE)
+			continue;
+
+		/* prev_cpu if it is idle, then any idle CPU, then the least used */
+		if (idle_cpu(i)) {
+			if (i == prev_cpu || !cs->cpu_idle) {
+				cs->cpu = i;
+				cs->cpu_util = util;
+				cs->cpu_idle = true;
+			}
+		} else if (!cs->cpu_idle && (cs->cpu == -1 || util < cs->cpu_util)) {
+			cs->cpu = i;
+			cs->cpu_util = util;
+		}
+	}
+}
+
+/*
+ * Power of a cluster whose CPUs run @util in total at the lowest capacity
+ * state that fits its busiest CPU, @max_util; 0 if it can power down.
+ */
+static unsigned long cluster_power(const struct sched_cluster_energy *e,
+				   unsigned long util, unsigned long max_util)
+{
+	const struct sched_cap_state *cs;
+	int i;
+
+	if (!util)
+		return 0;
+
+	for (i = 0; i < e->nr_cap_states - 1; i++) {
+		if (max_util * capacity_margin <=
+		    e->cap_states[i].cap * SCHED_CAPACITY_SCALE)
+			break;
+	}
+	cs = &e->cap_states[i];
+
+	return e->idle_power + cs->power * util / max(cs->cap, 1UL);
+}
+
+static int select_packed_cpu(struct task_struct *p, int prev_cpu)
+{
+	const struct sched_cluster_energy *e, *pack_e = NULL;
+	unsigned long task, wake_power = ULONG_MAX;
+	struct cluster_pack_stats cs, pack = { .cpu = -1 };
+	struct sched_domain *sd;
+	struct sched_group *sg;
+	bool wake_known = true;
+
+	if (!sched_feat(CLUSTER_PACK))
+		return -1;
+
+	sd = rcu_dereference(per_cpu(sd_llc, prev_cpu));
+	if (!sd || !sd->parent || (sd->parent->flags & SD_NUMA) ||
+	    !(sd->parent->flags & SD_LOAD_BALANCE))
+		return -1;
+	sd = sd->parent;
+
+	/* Only small tasks: a quarter of a CPU */
+	sync_entity_load_avg(&p->se);
+	task = task_util(p);
+	if (task * 4 > capacity_orig_of(prev_cpu))
+		return -1;
+
+	sg = sd->groups;
+	do {
+		if (!cpumask_intersects(sched_group_span(sg), &p->cpus_allowed))
+			continue;
+
+		cluster_pack_stats(sg, p, prev_cpu, &cs);
+		e = arch_cluster_energy(group_first_cpu(sg));
+
+		/* Cheapest idle cluster to wake up instead */
+		if (!cs.awake) {
+			if (e)
+				wake_power = min(wake_power,
+						 cluster_power(e, task, task));
+			else
+				wake_known = false;
+			continue;
+		}
+
+		if (cs.cpu == -1 ||
+		    (cs.util + task) * 100 >
+		    cs.capacity * sysctl_sched_cluster_pack_pct)
+			continue;
+
+		/* Fill the busiest cluster first, so the others can drain */
+		if (pack.cpu == -1 || cs.util > pack.util ||
+		    (cs.util == pack.util && cs.cpu == prev_cpu)) {
+			pack = cs;
+			pack_e = e;
+		}
+	} while (sg = sg->next, sg != sd->groups);
+
+	if (pack.cpu == -1)
+		return -1;
+
+	if (pack_e && wake_known && wake_power != ULONG_MAX) {
+		unsigned long before, after;
+
+		before = cluster_power(pack_e, pack.util, pack.max_util);
+		after = cluster_power(pack_e, pack.util + task,
+				      max(pack.max_util, pack.cpu_util + task));
+		if (after - before > wake_power)
+			return -1;
+	}
+
+	return pack.cpu;
+}
+#else
+static inline int select_packed_cpu(struct task_struct *p, int prev_cpu)
+{
+	return -1;
+}
+#endif
+
 /*
  * select_task_rq_fair: Select target runqueue for the waking task in domains
  * that have the 'sd_flag' flag set. In practice, this is SD_BALANCE_WAKE,
@@ -5953,6 +6167,14 @@ select_task_rq_fair(struct task_struct *p, int prev_cpu, int sd_flag, int wake_f
 	}
 
 	rcu_read_lock();
+	/* Only wakeups: a forked task has no utilization to pack yet */
+	if (sd_flag & SD_BALANCE_WAKE) {
+		new_cpu = select_packed_cpu(p, prev_cpu);
+		if (new_cpu >= 0)
+			goto unlock;
+		new_cpu = prev_cpu;
+	}
+
 	for_each_domain(cpu, tmp) {
 		if (!(tmp->flags & SD_LOAD_BALANCE))
 			break;
@@ -6021,6 +6243,7 @@ select_task_rq_fair(struct task_struct *p, int prev_cpu, int sd_flag, int wake_f
 		}
 		/* while loop will break here if sd == NULL */
 	}
+unlock:
 	rcu_read_unlock();
 
 	return new_cpu;
@@ -7827,6 +8050,40 @@ static inline void calculate_imbalance(struct lb_env *env, struct sd_lb_stats *s
 		return fix_small_imbalance(env, sds);
 }
 
+#ifdef CONFIG_SCHED_CLUSTER_PACK
+/*
+ * Between clusters, don't wake up an idle cluster to take tasks that
+ * select_packed_cpu() has packed onto another one, unless that cluster
+ * has grown past the packing threshold or is overloaded.
+ */
+static bool cluster_pack_balanced(struct lb_env *env, struct sd_lb_stats *sds)
+{
+	struct sg_lb_stats *local = &sds->local_stat;
+	struct sg_lb_stats *busiest = &sds->busiest_stat;
+	struct sched_domain *child = env->sd->child;
+
+	if (!sched_feat(CLUSTER_PACK))
+		return false;
+
+	if (!child || !(child->flags & SD_SHARE_PKG_RESOURCES) ||
+	    (env->sd->flags & (SD_SHARE_PKG_RESOURCES | SD_NUMA)))
+		return false;
+
+	if (local->sum_nr_running ||
+	    busiest->group_type >= group_imbalanced)
+		return false;
+
+	return busiest->group_util * 100 <=
+	       busiest->group_capacity * sysctl_sched_cluster_pack_pct;
+}
+#else
+static inline bool cluster_pack_balanced(struct lb_env *env,
+					 struct sd_lb_stats *sds)
+{
+	return false;
+}
+#endif
+
 /******* find_busiest_group() helpers end here *********************/
 
 /**
@@ -7863,6 +8120,10 @@ static struct sched_group *find_busiest_group(struct lb_env *env)
 	if (!sds.busiest || busiest->sum_nr_running == 0)
 		goto out_balanced;
 
+	/* Keep small tasks packed on their cluster */
+	if (cluster_pack_balanced(env, &sds))
+		goto out_balanced;
+
 	/* XXX broken for overlapping NUMA groups */
 	sds.avg_load = (SCHED_CAPACITY_SCALE * sds.total_load)
 						/ sds.total_capacity;
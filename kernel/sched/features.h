@@ -85,3 +85,11 @@ SCHED_FEAT(ATTACH_AGE_LOAD, true)
 SCHED_FEAT(WA_IDLE, true)
 SCHED_FEAT(WA_WEIGHT, true)
 SCHED_FEAT(WA_BIAS, true)
+
+#ifdef CONFIG_SCHED_CLUSTER_PACK
+/*
+ * Pack small tasks onto running clusters so that idle clusters can power
+ * down, see select_packed_cpu().
+ */
+SCHED_FEAT(CLUSTER_PACK, true)
+#endif
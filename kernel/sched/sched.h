@@ -1619,6 +1619,9 @@ extern void check_preempt_curr(struct rq *rq, struct task_struct *p, int flags);
 extern const_debug unsigned int sysctl_sched_time_avg;
 extern const_debug unsigned int sysctl_sched_nr_migrate;
 extern const_debug unsigned int sysctl_sched_migration_cost;
+#ifdef CONFIG_SCHED_CLUSTER_PACK
+extern const_debug unsigned int sysctl_sched_cluster_pack_pct;
+#endif
 
 static inline u64 sched_avg_period(void)
 {
@@ -1674,6 +1677,14 @@ unsigned long arch_scale_cpu_capacity(struct sched_domain *sd, int cpu)
 }
 #endif
 
+#ifndef arch_cluster_energy
+static __always_inline
+const struct sched_cluster_energy *arch_cluster_energy(int cpu)
+{
+	return NULL;
+}
+#endif
+
 static inline void sched_rt_avg_update(struct rq *rq, u64 rt_delta)
 {
 	rq->rt_avg += rt_delta * arch_scale_freq_capacity(NULL, cpu_of(rq));
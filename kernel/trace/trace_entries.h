@@ -354,16 +354,24 @@ FTRACE_ENTRY(hwlat, hwlat_entry,
 		__field_desc(	long,	timestamp,	tv_nsec		)
 		__field(	unsigned int,		nmi_count	)
 		__field(	unsigned int,		seqnum		)
+		__field(	unsigned int,		cpu		)
+		__field(	unsigned int,		cpus		)
+		__field(	unsigned int,		msg_count	)
+		__field(	u64,			ref_duration	)
 	),
 
-	F_printk("cnt:%u\tts:%010llu.%010lu\tinner:%llu\touter:%llunmi-ts:%llu\tnmi-count:%u\n",
+	F_printk("cnt:%u\tts:%010llu.%010lu\tinner:%llu\touter:%llunmi-ts:%llu\tnmi-count:%u\tcpu:%u\tcpus:%u\tmsgs:%u\tref:%llu\n",
 		 __entry->seqnum,
 		 __entry->tv_sec,
 		 __entry->tv_nsec,
 		 __entry->duration,
 		 __entry->outer_duration,
 		 __entry->nmi_total_ts,
-		 __entry->nmi_count),
+		 __entry->nmi_count,
+		 __entry->cpu,
+		 __entry->cpus,
+		 __entry->msg_count,
+		 __entry->ref_duration),
 
 	FILTER_OTHER
 );
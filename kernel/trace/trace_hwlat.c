@@ -25,6 +25,17 @@
  * we do it by hogging all of the CPU(s) for configurable timer intervals,
  * sampling the built-in CPU timer, looking for discontiguous readings.
  *
+ * In "hpsc" mode (see the "mode" file), one thread per CPU in the tracing
+ * cpumask samples all of them in parallel, so that a stall of every CPU at
+ * once (e.g. the chiplet's TRCH or the interconnect holding the cluster)
+ * can be told apart from one of a single CPU (e.g. EL3 firmware on that
+ * CPU).  Each gap is also timed with a per-CPU reference counter, when a
+ * driver provides one (the RTI timers), and matched against firmware
+ * message (hpsc-msg) traffic seen around it; the results are recorded in
+ * the trace and in the hpsc_histogram file.  A sampling CPU has interrupts
+ * off, so it could never see a message arrive: the CPUs that handle message
+ * interrupts stop sampling as soon as they have handled one.
+ *
  * WARNING: This implementation necessarily introduces latencies. Therefore,
  *          you should NEVER use this tracer while running in a production
  *          environment requiring any kind of low-latency performance
@@ -45,6 +56,8 @@
 #include <linux/cpumask.h>
 #include <linux/delay.h>
 #include <linux/sched/clock.h>
+#include <linux/seq_file.h>
+#include <linux/trace.h>
 #include "trace.h"
 
 static struct trace_array	*hwlat_trace;
@@ -55,6 +68,11 @@ static struct trace_array	*hwlat_trace;
 #define DEFAULT_SAMPLE_WINDOW	1000000			/* 1s */
 #define DEFAULT_SAMPLE_WIDTH	500000			/* 0.5s */
 #define DEFAULT_LAT_THRESHOLD	10			/* 10us */
+#define DEFAULT_HPSC_SLACK	100			/* 100us */
+
+#define HPSC_MAX_GAPS		16	/* per CPU and window */
+#define HPSC_MSG_EVENTS		64	/* recent message timestamps */
+#define HPSC_BUCKETS		16	/* log2(us) */
 
 /* sampling thread*/
 static struct task_struct *hwlat_kthread;
@@ -85,6 +103,21 @@ struct hwlat_sample {
 	u64			nmi_total_ts;	/* Total time spent in NMIs */
 	struct timespec64	timestamp;	/* wall time */
 	int			nmi_count;	/* # NMIs during this sample */
+	int			cpu;		/* CPU the gap was seen on */
+	int			cpus;		/* # CPUs with the gap (hpsc) */
+	int			msg_count;	/* # messages around it (hpsc) */
+	u64			ref_duration;	/* by the reference clock (hpsc) */
+};
+
+enum hwlat_mode {
+	MODE_ROUND_ROBIN,
+	MODE_HPSC,
+	MODE_MAX
+};
+
+static const char * const hwlat_mode_names[] = {
+	[MODE_ROUND_ROBIN]	= "round-robin",
+	[MODE_HPSC]		= "hpsc",
 };
 
 /* keep the global state somewhere. */
@@ -97,11 +130,19 @@ static struct hwlat_data {
 	u64	sample_window;		/* total sampling window (on+off) */
 	u64	sample_width;		/* active sampling portion of window */
 
+	u64	hpsc_slack;		/* us around a gap to match messages */
+	enum hwlat_mode	mode;		/* takes effect at the next start */
+
 } hwlat_data = {
 	.sample_window		= DEFAULT_SAMPLE_WINDOW,
 	.sample_width		= DEFAULT_SAMPLE_WIDTH,
+	.hpsc_slack		= DEFAULT_HPSC_SLACK,
+	.mode			= MODE_ROUND_ROBIN,
 };
 
+/* mode of the running sampling threads */
+static enum hwlat_mode hwlat_run_mode;
+
 static void trace_hwlat_sample(struct hwlat_sample *sample)
 {
 	struct trace_array *tr = hwlat_trace;
@@ -126,6 +167,10 @@ static void trace_hwlat_sample(struct hwlat_sample *sample)
 	entry->timestamp		= sample->timestamp;
 	entry->nmi_total_ts		= sample->nmi_total_ts;
 	entry->nmi_count		= sample->nmi_count;
+	entry->cpu			= sample->cpu;
+	entry->cpus			= sample->cpus;
+	entry->msg_count		= sample->msg_count;
+	entry->ref_duration		= sample->ref_duration;
 
 	if (!call_filter_check_discard(call, entry, buffer, event))
 		trace_buffer_unlock_commit_nostack(buffer, event);
@@ -253,6 +298,10 @@ static int get_sample(void)
 		ktime_get_real_ts64(&s.timestamp);
 		s.nmi_total_ts = nmi_total_ts;
 		s.nmi_count = nmi_count;
+		s.cpu = smp_processor_id();
+		s.cpus = 0;
+		s.msg_count = 0;
+		s.ref_duration = 0;
 		trace_hwlat_sample(&s);
 
 		/* Keep a running maximum ever recorded hardware latency */
@@ -303,6 +352,327 @@ static void move_to_next_cpu(void)
 	disable_migrate = true;
 }
 
+/*
+ * hpsc mode: each CPU runs its own sampling thread; every window, the main
+ * thread releases all of them at once, waits for them to finish and then
+ * correlates the gaps they recorded.
+ */
+struct hwlat_gap {
+	u64			start;		/* trace clock, ns */
+	u64			end;
+	u64			ref;		/* reference clock delta */
+};
+
+struct hwlat_hpsc_cpu {
+	struct task_struct	*kthread;
+	unsigned long		gen;		/* last hpsc_gen sampled */
+	u64			start;		/* of the sample, trace clock */
+	u64			end;
+	u64			ref_start;	/* of the sample, reference clock */
+	u64			ref_end;
+	int			nr_gaps;
+	int			dropped;	/* gaps beyond HPSC_MAX_GAPS */
+	struct hwlat_gap	gaps[HPSC_MAX_GAPS];
+};
+
+static DEFINE_PER_CPU(struct hwlat_hpsc_cpu, hwlat_hpsc_cpu);
+static struct cpumask hpsc_cpus;		/* CPUs with a sampling thread */
+static DECLARE_WAIT_QUEUE_HEAD(hpsc_wq);
+static unsigned long hpsc_gen;			/* bumped to start a sample */
+static atomic_t hpsc_pending;
+static DECLARE_COMPLETION(hpsc_done);
+
+/* Per-CPU reference clock, provided by a timer driver */
+static u64 (*hwlat_ref_read)(void);
+
+void trace_hwlat_set_ref_clock(u64 (*read)(void))
+{
+	WRITE_ONCE(hwlat_ref_read, read);
+}
+EXPORT_SYMBOL_GPL(trace_hwlat_set_ref_clock);
+
+/* Timestamps of recent firmware messages, only kept in hpsc mode */
+static bool hpsc_msg_enabled;
+static atomic_t hpsc_msg_head;
+static u64 hpsc_msg_ts[HPSC_MSG_EVENTS];
+static struct cpumask hpsc_msg_cpus;		/* CPUs left out of sampling */
+
+void trace_hwlat_msg_event(void)
+{
+	unsigned int i;
+
+	if (!READ_ONCE(hpsc_msg_enabled))
+		return;
+
+	i = atomic_inc_return(&hpsc_msg_head);
+	WRITE_ONCE(hpsc_msg_ts[i % HPSC_MSG_EVENTS], time_get());
+	cpumask_set_cpu(raw_smp_processor_id(), &hpsc_msg_cpus);
+}
+EXPORT_SYMBOL_GPL(trace_hwlat_msg_event);
+
+/* Gaps by log2 duration in us: per CPU, seen by several CPUs, with messages */
+static DEFINE_PER_CPU(u64 [HPSC_BUCKETS], hpsc_hist);
+static u64 hpsc_hist_multi[HPSC_BUCKETS];
+static u64 hpsc_hist_msg[HPSC_BUCKETS];
+static u64 hpsc_dropped;
+
+static void hpsc_hist_reset(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu(hpsc_hist, cpu), 0, sizeof(hpsc_hist));
+	memset(hpsc_hist_multi, 0, sizeof(hpsc_hist_multi));
+	memset(hpsc_hist_msg, 0, sizeof(hpsc_hist_msg));
+	hpsc_dropped = 0;
+}
+
+/*
+ * get_sample_hpsc - record every gap above the threshold on this CPU
+ *
+ * Unlike get_sample(), which only keeps the largest gap, all gaps are kept
+ * with their timestamps, for correlation with the other CPUs. Called with
+ * interrupts disabled.
+ */
+static void get_sample_hpsc(struct hwlat_hpsc_cpu *hc)
+{
+	u64 (*ref_read)(void) = READ_ONCE(hwlat_ref_read);
+	u64 width = hwlat_data.sample_width * NSEC_PER_USEC;
+	u64 thresh = tracing_thresh;
+	time_type start, last, now;
+	u64 ref = 0, last_ref;
+	struct hwlat_gap *gap;
+
+	hc->nr_gaps = 0;
+	hc->dropped = 0;
+
+	start = time_get();
+	last_ref = ref_read ? ref_read() : 0;
+	hc->ref_start = last_ref;
+	last = start;
+
+	do {
+		now = time_get();
+		if (ref_read)
+			ref = ref_read();
+
+		if (time_sub(now, last) > thresh) {
+			if (hc->nr_gaps < HPSC_MAX_GAPS) {
+				gap = &hc->gaps[hc->nr_gaps++];
+				gap->start = last;
+				gap->end = now;
+				gap->ref = ref - last_ref;
+			} else {
+				hc->dropped++;
+			}
+		}
+		last = now;
+		last_ref = ref;
+
+	} while (time_sub(now, start) <= width);
+
+	hc->start = start;
+	hc->end = now;
+	hc->ref_end = ref;
+}
+
+static int hpsc_kthread_fn(void *data)
+{
+	struct hwlat_hpsc_cpu *hc = data;
+
+	while (!kthread_should_stop()) {
+		wait_event(hpsc_wq, READ_ONCE(hpsc_gen) != hc->gen ||
+				    kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+		hc->gen = READ_ONCE(hpsc_gen);
+
+		if (cpumask_test_cpu(smp_processor_id(), &hpsc_msg_cpus)) {
+			/* keep interrupts on for the messages */
+			hc->nr_gaps = 0;
+			hc->dropped = 0;
+		} else {
+			local_irq_disable();
+			get_sample_hpsc(hc);
+			local_irq_enable();
+		}
+
+		if (atomic_dec_and_test(&hpsc_pending))
+			complete(&hpsc_done);
+	}
+
+	return 0;
+}
+
+static int hpsc_count_msgs(u64 start, u64 end)
+{
+	u64 slack = hwlat_data.hpsc_slack * NSEC_PER_USEC;
+	int i, count = 0;
+	u64 ts;
+
+	start = start > slack ? start - slack : 0;
+	end += slack;
+	for (i = 0; i < HPSC_MSG_EVENTS; i++) {
+		ts = READ_ONCE(hpsc_msg_ts[i]);
+		if (ts && ts >= start && ts <= end)
+			count++;
+	}
+	return count;
+}
+
+static int hpsc_count_cpus(int cpu, struct hwlat_gap *gap)
+{
+	struct hwlat_hpsc_cpu *hc;
+	int other, i, count = 1;
+
+	for_each_cpu(other, &hpsc_cpus) {
+		if (other == cpu)
+			continue;
+		hc = per_cpu_ptr(&hwlat_hpsc_cpu, other);
+		for (i = 0; i < hc->nr_gaps; i++) {
+			if (hc->gaps[i].start < gap->end &&
+			    hc->gaps[i].end > gap->start) {
+				count++;
+				break;
+			}
+		}
+	}
+	return count;
+}
+
+/* Trace the gaps of the last sample, and account them in the histogram */
+static void hpsc_correlate(void)
+{
+	struct trace_array *tr = hwlat_trace;
+	struct hwlat_hpsc_cpu *hc;
+	struct hwlat_sample s;
+	struct hwlat_gap *gap;
+	u64 now_real, now, ref_width;
+	int cpu, i, bucket;
+
+	now_real = ktime_get_real_ns();
+	now = time_get();
+
+	for_each_cpu(cpu, &hpsc_cpus) {
+		hc = per_cpu_ptr(&hwlat_hpsc_cpu, cpu);
+		hpsc_dropped += hc->dropped;
+		ref_width = hc->ref_end - hc->ref_start;
+
+		for (i = 0; i < hc->nr_gaps; i++) {
+			gap = &hc->gaps[i];
+
+			memset(&s, 0, sizeof(s));
+			hwlat_data.count++;
+			s.seqnum = hwlat_data.count;
+			s.duration = time_to_us(time_sub(gap->end, gap->start));
+			s.timestamp = ns_to_timespec64(now_real -
+						       (now - gap->start));
+			s.cpu = cpu;
+			s.cpus = hpsc_count_cpus(cpu, gap);
+			s.msg_count = hpsc_count_msgs(gap->start, gap->end);
+			/* scale the reference ticks by the sample's own rate */
+			if (ref_width)
+				s.ref_duration = time_to_us(div64_u64(gap->ref *
+						time_sub(hc->end, hc->start),
+						ref_width));
+			trace_hwlat_sample(&s);
+
+			bucket = s.duration ? ilog2(s.duration) : 0;
+			bucket = min(bucket, HPSC_BUCKETS - 1);
+			per_cpu(hpsc_hist, cpu)[bucket]++;
+			if (s.cpus > 1)
+				hpsc_hist_multi[bucket]++;
+			if (s.msg_count)
+				hpsc_hist_msg[bucket]++;
+
+			if (s.duration > tr->max_latency)
+				tr->max_latency = s.duration;
+		}
+	}
+}
+
+/* Run one sample on all CPUs in parallel */
+static void hpsc_sample(void)
+{
+	unsigned long timeout;
+
+	mutex_lock(&hwlat_data.lock);
+	/* the sample itself plus a second for the threads to get scheduled */
+	timeout = usecs_to_jiffies(hwlat_data.sample_width) + HZ;
+	mutex_unlock(&hwlat_data.lock);
+
+	/*
+	 * After a timeout, the threads of the previous window must all be
+	 * done before the next one starts: a late one would otherwise count
+	 * against, and sample, the new window.
+	 */
+	if (atomic_read(&hpsc_pending) &&
+	    !wait_for_completion_timeout(&hpsc_done, timeout))
+		return;
+
+	reinit_completion(&hpsc_done);
+	atomic_set(&hpsc_pending, cpumask_weight(&hpsc_cpus));
+	WRITE_ONCE(hpsc_gen, hpsc_gen + 1);
+	wake_up_all(&hpsc_wq);
+
+	if (!wait_for_completion_timeout(&hpsc_done, timeout)) {
+		/* some results may still be incomplete, skip this window */
+		pr_warn_once(BANNER "sampling threads did not finish in time\n");
+		return;
+	}
+
+	hpsc_correlate();
+}
+
+static void stop_hpsc_kthreads(void)
+{
+	struct hwlat_hpsc_cpu *hc;
+	int cpu;
+
+	WRITE_ONCE(hpsc_msg_enabled, false);
+	for_each_cpu(cpu, &hpsc_cpus) {
+		hc = per_cpu_ptr(&hwlat_hpsc_cpu, cpu);
+		kthread_stop(hc->kthread);
+		hc->kthread = NULL;
+	}
+	cpumask_clear(&hpsc_cpus);
+}
+
+static int start_hpsc_kthreads(void)
+{
+	struct hwlat_hpsc_cpu *hc;
+	struct task_struct *kthread;
+	struct cpumask mask;
+	int cpu;
+
+	get_online_cpus();
+	cpumask_and(&mask, cpu_online_mask, tracing_buffer_mask);
+	put_online_cpus();
+
+	for_each_cpu(cpu, &mask) {
+		hc = per_cpu_ptr(&hwlat_hpsc_cpu, cpu);
+		kthread = kthread_create_on_cpu(hpsc_kthread_fn, hc, cpu,
+						"hwlatd/%u");
+		if (IS_ERR(kthread)) {
+			pr_err(BANNER "could not start sampling thread on CPU%d\n",
+			       cpu);
+			stop_hpsc_kthreads();
+			return -ENOMEM;
+		}
+		hc->kthread = kthread;
+		/* only samples started after this one are waited for */
+		hc->gen = hpsc_gen;
+		cpumask_set_cpu(cpu, &hpsc_cpus);
+		wake_up_process(kthread);
+	}
+
+	memset(hpsc_msg_ts, 0, sizeof(hpsc_msg_ts));
+	cpumask_clear(&hpsc_msg_cpus);
+	atomic_set(&hpsc_pending, 0);
+	WRITE_ONCE(hpsc_msg_enabled, true);
+	return 0;
+}
+
 /*
  * kthread_fn - The CPU time sampling/hardware latency detection kernel thread
  *
@@ -319,11 +689,15 @@ static int kthread_fn(void *data)
 
 	while (!kthread_should_stop()) {
 
-		move_to_next_cpu();
+		if (hwlat_run_mode == MODE_HPSC) {
+			hpsc_sample();
+		} else {
+			move_to_next_cpu();
 
-		local_irq_disable();
-		get_sample();
-		local_irq_enable();
+			local_irq_disable();
+			get_sample();
+			local_irq_enable();
+		}
 
 		mutex_lock(&hwlat_data.lock);
 		interval = hwlat_data.sample_window - hwlat_data.sample_width;
@@ -353,6 +727,17 @@ static int start_kthread(struct trace_array *tr)
 	struct cpumask *current_mask = &save_cpumask;
 	struct task_struct *kthread;
 	int next_cpu;
+	int err;
+
+	mutex_lock(&hwlat_data.lock);
+	hwlat_run_mode = hwlat_data.mode;
+	mutex_unlock(&hwlat_data.lock);
+
+	if (hwlat_run_mode == MODE_HPSC) {
+		err = start_hpsc_kthreads();
+		if (err)
+			return err;
+	}
 
 	/* Just pick the first CPU on first iteration */
 	current_mask = &save_cpumask;
@@ -364,6 +749,8 @@ static int start_kthread(struct trace_array *tr)
 	kthread = kthread_create(kthread_fn, NULL, "hwlatd");
 	if (IS_ERR(kthread)) {
 		pr_err(BANNER "could not start sampling thread\n");
+		if (hwlat_run_mode == MODE_HPSC)
+			stop_hpsc_kthreads();
 		return -ENOMEM;
 	}
 
@@ -389,6 +776,10 @@ static void stop_kthread(void)
 		return;
 	kthread_stop(hwlat_kthread);
 	hwlat_kthread = NULL;
+
+	/* The main thread no longer waits for them */
+	if (hwlat_run_mode == MODE_HPSC)
+		stop_hpsc_kthreads();
 }
 
 /*
@@ -500,6 +891,110 @@ hwlat_window_write(struct file *filp, const char __user *ubuf,
 	return cnt;
 }
 
+/**
+ * hwlat_slack_write - Write function for "hpsc_slack" entry
+ * @filp: The active open file structure
+ * @ubuf: The user buffer that contains the value to write
+ * @cnt: The maximum number of bytes to write to "file"
+ * @ppos: The current position in @file
+ *
+ * In hpsc mode, firmware messages sent or received up to this many us
+ * before or after a gap are counted as concurrent with it.
+ */
+static ssize_t
+hwlat_slack_write(struct file *filp, const char __user *ubuf,
+		  size_t cnt, loff_t *ppos)
+{
+	u64 val;
+	int err;
+
+	err = kstrtoull_from_user(ubuf, cnt, 10, &val);
+	if (err)
+		return err;
+
+	mutex_lock(&hwlat_data.lock);
+	hwlat_data.hpsc_slack = val;
+	mutex_unlock(&hwlat_data.lock);
+
+	return cnt;
+}
+
+static ssize_t hwlat_mode_read(struct file *filp, char __user *ubuf,
+			       size_t cnt, loff_t *ppos)
+{
+	char buf[64];
+	int i, len = 0;
+
+	for (i = 0; i < MODE_MAX; i++)
+		len += snprintf(buf + len, sizeof(buf) - len,
+				i == hwlat_data.mode ? "[%s] " : "%s ",
+				hwlat_mode_names[i]);
+	buf[len - 1] = '\n';
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, len);
+}
+
+/**
+ * hwlat_mode_write - Write function for "mode" entry
+ * @filp: The active open file structure
+ * @ubuf: The user buffer that contains the value to write
+ * @cnt: The maximum number of bytes to write to "file"
+ * @ppos: The current position in @file
+ *
+ * Selects between sampling one CPU at a time ("round-robin") and all CPUs
+ * at once ("hpsc"). The new mode is used the next time the tracer starts.
+ */
+static ssize_t hwlat_mode_write(struct file *filp, const char __user *ubuf,
+				size_t cnt, loff_t *ppos)
+{
+	char buf[64];
+	int mode;
+
+	if (cnt >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, ubuf, cnt))
+		return -EFAULT;
+	buf[cnt] = 0;
+
+	mode = match_string(hwlat_mode_names, MODE_MAX, strim(buf));
+	if (mode < 0)
+		return mode;
+
+	mutex_lock(&hwlat_data.lock);
+	hwlat_data.mode = mode;
+	mutex_unlock(&hwlat_data.lock);
+
+	*ppos += cnt;
+	return cnt;
+}
+
+static int hwlat_hist_show(struct seq_file *m, void *v)
+{
+	int cpu, i;
+
+	seq_puts(m, "# us    ");
+	for_each_possible_cpu(cpu)
+		seq_printf(m, " %8s%-3d", "CPU", cpu);
+	seq_printf(m, " %11s %11s\n", "multi-cpu", "with-msgs");
+
+	for (i = 0; i < HPSC_BUCKETS; i++) {
+		seq_printf(m, "%-8lu", 1UL << i);
+		for_each_possible_cpu(cpu)
+			seq_printf(m, " %11llu", per_cpu(hpsc_hist, cpu)[i]);
+		seq_printf(m, " %11llu %11llu\n", hpsc_hist_multi[i],
+			   hpsc_hist_msg[i]);
+	}
+	seq_printf(m, "# dropped %llu\n", hpsc_dropped);
+
+	return 0;
+}
+
+static int hwlat_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hwlat_hist_show, NULL);
+}
+
 static const struct file_operations width_fops = {
 	.open		= tracing_open_generic,
 	.read		= hwlat_read,
@@ -512,13 +1007,33 @@ static const struct file_operations window_fops = {
 	.write		= hwlat_window_write,
 };
 
+static const struct file_operations slack_fops = {
+	.open		= tracing_open_generic,
+	.read		= hwlat_read,
+	.write		= hwlat_slack_write,
+};
+
+static const struct file_operations mode_fops = {
+	.open		= tracing_open_generic,
+	.read		= hwlat_mode_read,
+	.write		= hwlat_mode_write,
+};
+
+static const struct file_operations hist_fops = {
+	.open		= hwlat_hist_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 /**
  * init_tracefs - A function to initialize the tracefs interface files
  *
  * This function creates entries in tracefs for "hwlat_detector".
  * It creates the hwlat_detector directory in the tracing directory,
  * and within that directory is the count, width and window files to
- * change and view those values.
+ * change and view those values, as well as the mode, hpsc_slack and
+ * hpsc_histogram files of the hpsc mode.
  */
 static int init_tracefs(void)
 {
@@ -547,6 +1062,17 @@ static int init_tracefs(void)
 	if (!hwlat_sample_width)
 		goto err;
 
+	if (!tracefs_create_file("hpsc_slack", 0644, top_dir,
+				 &hwlat_data.hpsc_slack, &slack_fops))
+		goto err;
+
+	if (!tracefs_create_file("mode", 0644, top_dir, NULL, &mode_fops))
+		goto err;
+
+	if (!tracefs_create_file("hpsc_histogram", 0444, top_dir, NULL,
+				 &hist_fops))
+		goto err;
+
 	return 0;
 
  err:
@@ -581,6 +1107,7 @@ static int hwlat_tracer_init(struct trace_array *tr)
 	disable_migrate = false;
 	hwlat_data.count = 0;
 	tr->max_latency = 0;
+	hpsc_hist_reset();
 	save_tracing_thresh = tracing_thresh;
 
 	/* tracing_thresh is in nsecs, we speak in usecs */
@@ -1189,6 +1189,15 @@ trace_hwlat_print(struct trace_iterator *iter, int flags,
 				 field->nmi_count);
 	}
 
+	/* Only the multi-CPU (hpsc) mode correlates across CPUs */
+	if (field->cpus) {
+		trace_seq_printf(s, " cpu:%u cpus:%u msgs:%u",
+				 field->cpu, field->cpus, field->msg_count);
+		if (field->ref_duration)
+			trace_seq_printf(s, " ref(us):%llu",
+					 field->ref_duration);
+	}
+
 	trace_seq_putc(s, '\n');
 
 	return trace_handle_return(s);
@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _TOOLS_ASM_ALTERNATIVE_H
+#define _TOOLS_ASM_ALTERNATIVE_H
+
+/*
+ * Nothing patches the alternatives in user-space: assemble the default
+ * sequence in place (none, for alternative_else_nop_endif) and set the
+ * replacement aside where nothing jumps to it.
+ */
+
+.macro alternative_if cap
+	.pushsection .altinstr_replacement, "ax"
+.endm
+
+.macro alternative_else_nop_endif
+	.popsection
+.endm
+
+#endif /* _TOOLS_ASM_ALTERNATIVE_H */
@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _TOOLS_ASM_ASSEMBLER_H
+#define _TOOLS_ASM_ASSEMBLER_H
+
+/*
+ * Just what arch/arm64/lib/{memcpy,memset,copy_page,clear_page}.S need,
+ * so we can build them for perf bench:
+ */
+
+#ifndef ENTRY
+#define ENTRY(name)			\
+	.globl	name;			\
+	.align	2;			\
+name:
+#endif
+
+#ifndef ENDPROC
+#define ENDPROC(name)			\
+	.type	name, %function;	\
+	.size	name, . - name
+#endif
+
+#define ENDPIPROC(x)			\
+	.globl	__pi_##x;		\
+	.type 	__pi_##x, %function;	\
+	.set	__pi_##x, x;		\
+	.size	__pi_##x, . - x;	\
+	ENDPROC(x)
+
+#endif /* _TOOLS_ASM_ASSEMBLER_H */
@@ -0,0 +1,8 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _TOOLS_ASM_CACHE_H
+#define _TOOLS_ASM_CACHE_H
+
+#define L1_CACHE_SHIFT		7
+#define L1_CACHE_BYTES		(1 << L1_CACHE_SHIFT)
+
+#endif /* _TOOLS_ASM_CACHE_H */
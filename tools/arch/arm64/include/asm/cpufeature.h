@@ -0,0 +1,8 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _TOOLS_ASM_CPUFEATURE_H
+#define _TOOLS_ASM_CPUFEATURE_H
+
+/* Only named by the alternatives, which are not patched in user-space */
+#define ARM64_HAS_NO_HW_PREFETCH		8
+
+#endif /* _TOOLS_ASM_CPUFEATURE_H */
@@ -0,0 +1,11 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _TOOLS_ASM_PAGE_H
+#define _TOOLS_ASM_PAGE_H
+
+#include <linux/const.h>
+
+/* The kernel page size, which is what copy_page() and clear_page() assume */
+#define PAGE_SHIFT		12
+#define PAGE_SIZE		(_AC(1, UL) << PAGE_SHIFT)
+
+#endif /* _TOOLS_ASM_PAGE_H */
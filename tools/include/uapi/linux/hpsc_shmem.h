@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * HPSC shared memory device files (/dev/hpsc_shmem!<region>)
+ *
+ * Besides mmap, a region's device file gives access to the hardware
+ * spinlocks that guard the region (its 'hwlocks' in DT), shared with the
+ * other HPSC Chiplet subsystems. A lock is held by the open file that took
+ * it, until unlocked or until the file is closed.
+ */
+#ifndef _UAPI_LINUX_HPSC_SHMEM_H
+#define _UAPI_LINUX_HPSC_SHMEM_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/**
+ * struct hpsc_shmem_lock - argument of HPSC_SHMEM_IOC_LOCK
+ * @index: the lock, by its position in the region's 'hwlocks'
+ * @timeout_ms: how long to retry while the lock is taken, 0 to try once
+ */
+struct hpsc_shmem_lock {
+	__u32 index;
+	__u32 timeout_ms;
+};
+
+#define HPSC_SHMEM_IOC_MAGIC		0xB6
+
+/* Number of locks of the region */
+#define HPSC_SHMEM_IOC_NUM_LOCKS	_IOR(HPSC_SHMEM_IOC_MAGIC, 0, __u32)
+/* Take a lock: -EBUSY if taken (-ETIMEDOUT with a timeout) */
+#define HPSC_SHMEM_IOC_LOCK		_IOW(HPSC_SHMEM_IOC_MAGIC, 1, \
+					     struct hpsc_shmem_lock)
+/* Release a lock taken through this file, by index */
+#define HPSC_SHMEM_IOC_UNLOCK		_IOW(HPSC_SHMEM_IOC_MAGIC, 2, __u32)
+
+#endif /* _UAPI_LINUX_HPSC_SHMEM_H */
@@ -37,6 +37,9 @@ int bench_futex_wake_parallel(int argc, const char **argv);
 int bench_futex_requeue(int argc, const char **argv);
 /* pi futexes */
 int bench_futex_lock_pi(int argc, const char **argv);
+int bench_hpsc_mbox(int argc, const char **argv);
+int bench_hpsc_shmem(int argc, const char **argv);
+int bench_hpsc_interval(int argc, const char **argv);
 
 #define BENCH_FORMAT_DEFAULT_STR	"default"
 #define BENCH_FORMAT_DEFAULT		0
@@ -0,0 +1,458 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * hpsc.c
+ *
+ * Benchmarks for the inter-processor communication of the HPSC Chiplet,
+ * through the device files its drivers provide to user-space:
+ *
+ *  mbox:     messages/s and round trip time through a mailbox instance in
+ *            loopback, i.e. with both of its ends opened by this process
+ *            (see the peer ends in the device tree, index + 32)
+ *  shmem:    read/write bandwidth of an mmap'd shared memory region, and
+ *            the rate of its hardware spinlock operations
+ *  interval: latency from the expiry of an interval timer to the return
+ *            of poll() on its device file, by the timer's own counter
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/stat.h"
+#include <subcmd/parse-options.h>
+#include "../builtin.h"
+#include "bench.h"
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/hpsc_shmem.h>
+#include <linux/time64.h>
+
+/* The size of a mailbox message, i.e. of the instance's data registers */
+#define MBOX_MSG_LEN		64
+
+static unsigned int nr_loops = 1000;
+
+static double timeval2usec(struct timeval *tv)
+{
+	return (double)tv->tv_sec * USEC_PER_SEC + (double)tv->tv_usec;
+}
+
+static u64 timespec2nsec(struct timespec *ts)
+{
+	return (u64)ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static u64 now_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return timespec2nsec(&ts);
+}
+
+static void wait_pollin(int fd, const char *path)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+	while (poll(&pfd, 1, -1) < 0)
+		if (errno != EINTR)
+			err(EXIT_FAILURE, "poll: %s", path);
+	if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+		errx(EXIT_FAILURE, "poll: %s: error event", path);
+}
+
+/* mbox */
+
+static const char *mbox_tx_path = "/dev/mbox/2/mbox0";
+static const char *mbox_rx_path = "/dev/mbox/2/mbox1";
+
+static const struct option mbox_options[] = {
+	OPT_STRING('t', "tx", &mbox_tx_path, "path",
+		   "Mailbox to send from (default: /dev/mbox/2/mbox0)"),
+	OPT_STRING('r', "rx", &mbox_rx_path, "path",
+		   "Other end of the same instance, to receive from (default: /dev/mbox/2/mbox1)"),
+	OPT_UINTEGER('l', "nr_loops", &nr_loops,
+		     "Specify the number of messages to send (default: 1000)"),
+	OPT_END()
+};
+
+static const char * const bench_hpsc_mbox_usage[] = {
+	"perf bench hpsc mbox <options>",
+	NULL
+};
+
+int bench_hpsc_mbox(int argc, const char **argv)
+{
+	u8 msg[MBOX_MSG_LEN], rcv[MBOX_MSG_LEN];
+	struct timeval start, stop, diff;
+	struct stats rtt_stats;
+	unsigned int i;
+	int tx, rx, rc;
+	double usecs;
+	u64 t0;
+
+	argc = parse_options(argc, argv, mbox_options, bench_hpsc_mbox_usage, 0);
+	if (argc)
+		usage_with_options(bench_hpsc_mbox_usage, mbox_options);
+
+	/*
+	 * read-only makes an incoming end, the outgoing one is read for ACKs;
+	 * a missing device fails this benchmark only, not 'perf bench all'
+	 */
+	rx = open(mbox_rx_path, O_RDONLY);
+	if (rx < 0) {
+		warn("open: %s", mbox_rx_path);
+		return 1;
+	}
+	tx = open(mbox_tx_path, O_RDWR);
+	if (tx < 0) {
+		warn("open: %s", mbox_tx_path);
+		close(rx);
+		return 1;
+	}
+
+	init_stats(&rtt_stats);
+	memset(msg, 0, sizeof(msg));
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < nr_loops; i++) {
+		memcpy(msg, &i, sizeof(i));
+
+		t0 = now_nsec();
+		if (write(tx, msg, sizeof(msg)) != sizeof(msg))
+			err(EXIT_FAILURE, "write: %s", mbox_tx_path);
+
+		/* reading the message is what ACKs it */
+		wait_pollin(rx, mbox_rx_path);
+		if (read(rx, rcv, sizeof(rcv)) != sizeof(rcv))
+			err(EXIT_FAILURE, "read: %s", mbox_rx_path);
+
+		wait_pollin(tx, mbox_tx_path);
+		if (read(tx, &rc, sizeof(rc)) != sizeof(rc))
+			err(EXIT_FAILURE, "read: %s", mbox_tx_path);
+		update_stats(&rtt_stats, now_nsec() - t0);
+
+		if (rc)
+			errx(EXIT_FAILURE, "message %u: NACK: %d", i, rc);
+		if (memcmp(msg, rcv, sizeof(msg)))
+			errx(EXIT_FAILURE, "message %u: received corrupted", i);
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	usecs = timeval2usec(&diff);
+
+	close(tx);
+	close(rx);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Sent %u messages from %s to %s\n\n",
+		       nr_loops, mbox_tx_path, mbox_rx_path);
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec, (unsigned long)(diff.tv_usec / USEC_PER_MSEC));
+		printf(" %14lf msgs/sec\n", nr_loops / (usecs / USEC_PER_SEC));
+		printf(" %14lf usecs round trip (avg)\n",
+		       avg_stats(&rtt_stats) / NSEC_PER_USEC);
+		printf(" %14lf usecs round trip (max)\n",
+		       (double)rtt_stats.max / NSEC_PER_USEC);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n", nr_loops / (usecs / USEC_PER_SEC));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
+
+/* shmem */
+
+static const char *shmem_path = "/dev/hpsc_shmem/region2";
+static const char *shmem_size_str = "1MB";
+
+static const struct option shmem_options[] = {
+	OPT_STRING('p', "path", &shmem_path, "path",
+		   "Shared memory region (default: /dev/hpsc_shmem/region2)"),
+	OPT_STRING('s', "size", &shmem_size_str, "1MB",
+		   "Specify the size to map, at most that of the region. "
+		   "Available units: B, KB, MB, GB and TB (case insensitive)"),
+	OPT_UINTEGER('l', "nr_loops", &nr_loops,
+		     "Specify the number of loops to run (default: 1000)"),
+	OPT_END()
+};
+
+static const char * const bench_hpsc_shmem_usage[] = {
+	"perf bench hpsc shmem <options>",
+	NULL
+};
+
+static double shmem_bandwidth(void *dst, const void *src, size_t size)
+{
+	struct timeval start, stop, diff;
+	unsigned int i;
+
+	/* Fault the mappings in, not to measure that */
+	memcpy(dst, src, size);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < nr_loops; i++)
+		memcpy(dst, src, size);
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	return (double)size * nr_loops / (timeval2usec(&diff) / USEC_PER_SEC);
+}
+
+/* Returns lock + unlock pairs per second, 0 if the region has no lock */
+static double shmem_lock_rate(int fd)
+{
+	/* the other subsystems may hold it now and then */
+	struct hpsc_shmem_lock lock = { .index = 0, .timeout_ms = 100 };
+	struct timeval start, stop, diff;
+	unsigned int i;
+	__u32 nr_locks;
+
+	if (ioctl(fd, HPSC_SHMEM_IOC_NUM_LOCKS, &nr_locks) < 0) {
+		if (errno == ENOTTY)
+			return 0;
+		err(EXIT_FAILURE, "ioctl: %s", shmem_path);
+	}
+	if (!nr_locks)
+		return 0;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < nr_loops; i++) {
+		if (ioctl(fd, HPSC_SHMEM_IOC_LOCK, &lock) < 0)
+			err(EXIT_FAILURE, "lock: %s", shmem_path);
+		if (ioctl(fd, HPSC_SHMEM_IOC_UNLOCK, &lock.index) < 0)
+			err(EXIT_FAILURE, "unlock: %s", shmem_path);
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	return nr_loops / (timeval2usec(&diff) / USEC_PER_SEC);
+}
+
+int bench_hpsc_shmem(int argc, const char **argv)
+{
+	double read_bps, write_bps, lock_rate;
+	void *region, *buf;
+	size_t size;
+	int fd;
+
+	argc = parse_options(argc, argv, shmem_options, bench_hpsc_shmem_usage, 0);
+	if (argc)
+		usage_with_options(bench_hpsc_shmem_usage, shmem_options);
+
+	size = (size_t)perf_atoll((char *)shmem_size_str);
+	if ((s64)size <= 0) {
+		fprintf(stderr, "Invalid size:%s\n", shmem_size_str);
+		return 1;
+	}
+
+	fd = open(shmem_path, O_RDWR);
+	if (fd < 0) {
+		warn("open: %s", shmem_path);
+		return 1;
+	}
+	region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (region == MAP_FAILED) {
+		warn("mmap: %s", shmem_path);
+		close(fd);
+		return 1;
+	}
+	buf = zalloc(size);
+	if (!buf)
+		err(EXIT_FAILURE, "zalloc");
+
+	write_bps = shmem_bandwidth(region, buf, size);
+	read_bps = shmem_bandwidth(buf, region, size);
+	lock_rate = shmem_lock_rate(fd);
+
+	free(buf);
+	munmap(region, size);
+	close(fd);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Copying %s to and from %s %u times\n\n",
+		       shmem_size_str, shmem_path, nr_loops);
+		printf(" %14lf MB/sec write\n", write_bps / 1024 / 1024);
+		printf(" %14lf MB/sec read\n", read_bps / 1024 / 1024);
+		if (lock_rate)
+			printf(" %14lf lock+unlock/sec\n", lock_rate);
+		else
+			printf(" %14s lock+unlock/sec (no hwlocks)\n", "-");
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf %lf %lf\n", write_bps, read_bps, lock_rate);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
+
+/* interval */
+
+/* Counter rate measurement, if not given */
+#define INTERVAL_RATE_MS	20
+
+static const char *interval_path = "/dev/rti_timer";
+static int interval_cpu;
+static unsigned int interval_period_us = 1000;
+static u64 interval_hz;
+
+static const struct option interval_options[] = {
+	OPT_STRING('p', "path", &interval_path, "path",
+		   "Timer device files, less the CPU number (default: /dev/rti_timer)"),
+	OPT_INTEGER('C', "cpu", &interval_cpu,
+		    "CPU to run on, whose timer to use (default: 0)"),
+	OPT_UINTEGER('P', "period", &interval_period_us,
+		     "Timer period in usecs (default: 1000)"),
+	OPT_U64('F', "freq", &interval_hz,
+		"Counter rate in Hz (default: measured)"),
+	OPT_UINTEGER('l', "nr_loops", &nr_loops,
+		     "Specify the number of timer events to wait for (default: 1000)"),
+	OPT_END()
+};
+
+static const char * const bench_hpsc_interval_usage[] = {
+	"perf bench hpsc interval <options>",
+	NULL
+};
+
+static u64 interval_read(int fd, const char *path)
+{
+	u64 count;
+
+	if (pread(fd, &count, sizeof(count), 0) != sizeof(count))
+		err(EXIT_FAILURE, "read: %s", path);
+	return count;
+}
+
+static u64 interval_measure_rate(int fd, const char *path)
+{
+	u64 c0, c1, t0, t1;
+
+	t0 = now_nsec();
+	c0 = interval_read(fd, path);
+	usleep(INTERVAL_RATE_MS * USEC_PER_MSEC);
+	c1 = interval_read(fd, path);
+	t1 = now_nsec();
+
+	return (c1 - c0) * NSEC_PER_SEC / (t1 - t0);
+}
+
+int bench_hpsc_interval(int argc, const char **argv)
+{
+	u64 period, count, lat, events, prev_events = 0, missed = 0;
+	struct stats lat_stats;
+	cpu_set_t cpus;
+	unsigned int i;
+	char path[PATH_MAX];
+	int fd;
+
+	argc = parse_options(argc, argv, interval_options,
+			     bench_hpsc_interval_usage, 0);
+	if (argc)
+		usage_with_options(bench_hpsc_interval_usage, interval_options);
+
+	/* A per-CPU timer can only be accessed from its CPU */
+	CPU_ZERO(&cpus);
+	CPU_SET(interval_cpu, &cpus);
+	if (sched_setaffinity(0, sizeof(cpus), &cpus)) {
+		warn("sched_setaffinity: CPU %d", interval_cpu);
+		return 1;
+	}
+
+	snprintf(path, sizeof(path), "%s%d", interval_path, interval_cpu);
+	fd = open(path, O_RDWR);
+	if (fd < 0) {
+		warn("open: %s", path);
+		return 1;
+	}
+
+	if (!interval_hz)
+		interval_hz = interval_measure_rate(fd, path);
+	if (!interval_hz)
+		errx(EXIT_FAILURE, "%s: counter does not advance", path);
+	period = interval_hz * interval_period_us / USEC_PER_SEC;
+	if (!period)
+		errx(EXIT_FAILURE, "period shorter than a counter tick");
+
+	if (pwrite(fd, &period, sizeof(period), 0) != sizeof(period))
+		err(EXIT_FAILURE, "write: %s", path);
+
+	/*
+	 * The counter counts up and the timer fires every time it crosses a
+	 * multiple of the period, so the counter modulo the period is the time
+	 * since the expiry.  The first event may be stale, from before the
+	 * period was set, so skip it.
+	 */
+	init_stats(&lat_stats);
+	wait_pollin(fd, path);
+	for (i = 0; i < nr_loops; i++) {
+		wait_pollin(fd, path);
+		count = interval_read(fd, path);
+
+		events = count / period;
+		if (prev_events && events > prev_events + 1)
+			missed += events - prev_events - 1;
+		prev_events = events;
+
+		lat = (count % period) * NSEC_PER_SEC / interval_hz;
+		update_stats(&lat_stats, lat);
+	}
+
+	close(fd);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Waited for %u events of %s every %u usecs (%" PRIu64 " Hz counter)\n\n",
+		       nr_loops, path, interval_period_us, interval_hz);
+		printf(" %14lf usecs latency (avg)\n",
+		       avg_stats(&lat_stats) / NSEC_PER_USEC);
+		printf(" %14lf usecs latency (max)\n",
+		       (double)lat_stats.max / NSEC_PER_USEC);
+		printf(" %14lf usecs latency (stddev)\n",
+		       stddev_stats(&lat_stats) / NSEC_PER_USEC);
+		printf(" %14" PRIu64 " events missed\n", missed);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n", avg_stats(&lat_stats) / NSEC_PER_USEC);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
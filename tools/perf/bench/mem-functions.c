@@ -267,6 +267,40 @@ static double do_memcpy_gettimeofday(const struct function *r, size_t size, void
 	return (double)(((double)size * nr_loops) / timeval2double(&tv_diff));
 }
 
+#ifdef HAVE_ARCH_ARM64_SUPPORT
+/* What copy_page() and clear_page() take as a page, see asm/page.h */
+#define ARM64_PAGE_SIZE		4096UL
+
+/*
+ * copy_page() and clear_page() work on whole, aligned pages: do the part
+ * of the buffer up to the first page boundary of dst and whatever is left
+ * after the last whole page with the generic functions.
+ */
+static size_t arm64_page_head(const void *dst, size_t size)
+{
+	size_t head = -(unsigned long)dst & (ARM64_PAGE_SIZE - 1);
+
+	return head < size ? head : size;
+}
+
+void *memcpy_arm64_stnp(void *dst, const void *src, size_t size)
+{
+	size_t head = arm64_page_head(dst, size);
+	char *d = dst + head;
+	const char *s = src + head;
+
+	__memcpy(dst, src, head);
+	for (size -= head; size >= ARM64_PAGE_SIZE; size -= ARM64_PAGE_SIZE) {
+		copy_page(d, s);
+		d += ARM64_PAGE_SIZE;
+		s += ARM64_PAGE_SIZE;
+	}
+	__memcpy(d, s, size);
+
+	return dst;
+}
+#endif
+
 struct function memcpy_functions[] = {
 	{ .name		= "default",
 	  .desc		= "Default memcpy() provided by glibc",
@@ -276,6 +310,12 @@ struct function memcpy_functions[] = {
 # define MEMCPY_FN(_fn, _name, _desc) {.name = _name, .desc = _desc, .fn.memcpy = _fn},
 # include "mem-memcpy-x86-64-asm-def.h"
 # undef MEMCPY_FN
+#endif
+
+#ifdef HAVE_ARCH_ARM64_SUPPORT
+# define MEMCPY_FN(_fn, _name, _desc) {.name = _name, .desc = _desc, .fn.memcpy = _fn},
+# include "mem-memcpy-arm64-asm-def.h"
+# undef MEMCPY_FN
 #endif
 
 	{ .name = NULL, }
@@ -341,6 +381,31 @@ static double do_memset_gettimeofday(const struct function *r, size_t size, void
 	return (double)(((double)size * nr_loops) / timeval2double(&tv_diff));
 }
 
+#ifdef HAVE_ARCH_ARM64_SUPPORT
+/* DCZID_EL0.DZP: dc zva is prohibited, e.g. by a hypervisor */
+#define DCZID_EL0_DZP		(1 << 4)
+
+void *memset_arm64_dc_zva(void *dst, int c __maybe_unused, size_t size)
+{
+	size_t head = arm64_page_head(dst, size);
+	unsigned long dczid;
+	char *d = dst + head;
+
+	asm volatile("mrs %0, dczid_el0" : "=r" (dczid));
+	if (dczid & DCZID_EL0_DZP)
+		return __memset(dst, 0, size);
+
+	__memset(dst, 0, head);
+	for (size -= head; size >= ARM64_PAGE_SIZE; size -= ARM64_PAGE_SIZE) {
+		clear_page(d);
+		d += ARM64_PAGE_SIZE;
+	}
+	__memset(d, 0, size);
+
+	return dst;
+}
+#endif
+
 static const char * const bench_mem_memset_usage[] = {
 	"perf bench mem memset <options>",
 	NULL
@@ -355,6 +420,12 @@ static const struct function memset_functions[] = {
 # define MEMSET_FN(_fn, _name, _desc) { .name = _name, .desc = _desc, .fn.memset = _fn },
 # include "mem-memset-x86-64-asm-def.h"
 # undef MEMSET_FN
+#endif
+
+#ifdef HAVE_ARCH_ARM64_SUPPORT
+# define MEMSET_FN(_fn, _name, _desc) { .name = _name, .desc = _desc, .fn.memset = _fn },
+# include "mem-memset-arm64-asm-def.h"
+# undef MEMSET_FN
 #endif
 
 	{ .name = NULL, }
@@ -11,3 +11,15 @@
 
 #endif
 
+#ifdef HAVE_ARCH_ARM64_SUPPORT
+
+#define MEMCPY_FN(fn, name, desc)		\
+	void *fn(void *, const void *, size_t);
+
+#include "mem-memcpy-arm64-asm-def.h"
+
+#undef MEMCPY_FN
+
+void copy_page(void *to, const void *from);
+
+#endif
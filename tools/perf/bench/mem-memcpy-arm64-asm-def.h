@@ -0,0 +1,9 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+MEMCPY_FN(__memcpy,
+	"arm64-ldp-stp",
+	"ldp/stp-based (cacheable) memcpy() in arch/arm64/lib/memcpy.S")
+
+MEMCPY_FN(memcpy_arm64_stnp,
+	"arm64-stnp",
+	"stnp-based (non-temporal) copy_page() in arch/arm64/lib/copy_page.S")
@@ -11,3 +11,15 @@
 
 #endif
 
+#ifdef HAVE_ARCH_ARM64_SUPPORT
+
+#define MEMSET_FN(fn, name, desc)		\
+	void *fn(void *, int, size_t);
+
+#include "mem-memset-arm64-asm-def.h"
+
+#undef MEMSET_FN
+
+void clear_page(void *to);
+
+#endif
@@ -0,0 +1,9 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+MEMSET_FN(__memset,
+	"arm64-stp",
+	"stp-based memset() in arch/arm64/lib/memset.S")
+
+MEMSET_FN(memset_arm64_dc_zva,
+	"arm64-dc-zva",
+	"dc zva-based clear_page() in arch/arm64/lib/clear_page.S (zeroes, whatever the value)")
@@ -14,6 +14,7 @@
  *  mem   ... memory access performance
  *  numa  ... NUMA scheduling and MM performance
  *  futex ... Futex performance
+ *  hpsc  ... HPSC Chiplet IPC performance
  */
 #include "perf.h"
 #include "util/util.h"
@@ -67,6 +68,16 @@ static struct bench futex_benchmarks[] = {
 	{ NULL,		NULL,						NULL			}
 };
 
+#ifdef HAVE_ARCH_ARM64_SUPPORT
+static struct bench hpsc_benchmarks[] = {
+	{ "mbox",	"Benchmark for a mailbox in loopback",		bench_hpsc_mbox		},
+	{ "shmem",	"Benchmark for a shared memory region",		bench_hpsc_shmem	},
+	{ "interval",	"Benchmark for interval timer event latency",	bench_hpsc_interval	},
+	{ "all",	"Run all HPSC benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+#endif
+
 struct collection {
 	const char	*name;
 	const char	*summary;
@@ -80,6 +91,9 @@ static struct collection collections[] = {
 	{ "numa",	"NUMA scheduling and MM benchmarks",		numa_benchmarks		},
 #endif
 	{"futex",       "Futex stressing benchmarks",                   futex_benchmarks        },
+#ifdef HAVE_ARCH_ARM64_SUPPORT
+	{ "hpsc",	"HPSC Chiplet IPC benchmarks",			hpsc_benchmarks		},
+#endif
 	{ "all",	"All benchmarks",				NULL			},
 	{ NULL,		NULL,						NULL			}
 };
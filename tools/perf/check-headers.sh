@@ -13,6 +13,8 @@ include/uapi/linux/vhost.h
 include/uapi/sound/asound.h
 include/linux/hash.h
 include/uapi/linux/hw_breakpoint.h
+include/uapi/linux/const.h
+include/uapi/linux/hpsc_shmem.h
 arch/x86/include/asm/disabled-features.h
 arch/x86/include/asm/required-features.h
 arch/x86/include/asm/cpufeatures.h
@@ -66,5 +68,10 @@ done
 # diff with extra ignore lines
 check arch/x86/lib/memcpy_64.S        -I "^EXPORT_SYMBOL" -I "^#include <asm/export.h>"
 check arch/x86/lib/memset_64.S        -I "^EXPORT_SYMBOL" -I "^#include <asm/export.h>"
+check arch/arm64/lib/memcpy.S         -B
+check arch/arm64/lib/copy_template.S  -B
+check arch/arm64/lib/memset.S         -B
+check arch/arm64/lib/copy_page.S      -B
+check arch/arm64/lib/clear_page.S     -B
 check include/uapi/asm-generic/mman.h -I "^#include <\(uapi/\)*asm-generic/mman-common.h>"
 check include/uapi/linux/mman.h       -I "^#include <\(uapi/\)*asm/mman.h>"